@@ -0,0 +1,85 @@
+#!/usr/bin/env bash
+
+# bench.sh - measure the throughput of ixfcvt on generated IXF files
+#
+# Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Usage: bench.sh [ROWS [REPEAT]]
+#
+# Generates an IXF file of ROWS rows (default 200000) for each scenario
+# below with ixfgen, converts it REPEAT times (default 3) with ixfcvt and
+# writes the best run as a line of JSON to the standard output:
+#
+#   {"scenario":"mixed","rows":200000,"bytes":28411977,"seconds":0.412,
+#    "mb_per_s":65.77,"rows_per_s":485437}
+#
+# MB/s is of the input IXF file. Options in IXFCVT_OPTS are passed to
+# ixfcvt, e.g. IXFCVT_OPTS="-d postgresql".
+
+set -e
+
+ROWS=${1:-200000}
+REPEAT=${2:-3}
+IXFCVT=${IXFCVT:-./ixfcvt}
+IXFGEN=${IXFGEN:-./ixfgen}
+DIR=${TMPDIR:-/tmp}/ixfbench.$$
+
+# name and ixfgen options of each scenario
+SCENARIOS=(
+	"integers	-s INTEGER,SMALLINT,BIGINT,BIGINT"
+	"decimals	-s INTEGER,DECIMAL(11,2),DECIMAL(31,8),DECIMAL(5,0)"
+	"floats		-s INTEGER,DOUBLE,REAL,DOUBLE"
+	"decfloats	-s INTEGER,DECFLOAT(16),DECFLOAT(34)"
+	"datetime	-s INTEGER,DATE,TIME,TIMESTAMP(6)"
+	"short_text	-s INTEGER,VARCHAR(20),CHAR(10)"
+	"long_text	-s INTEGER,VARCHAR(1000) -l 500:1000"
+	"quotes		-s INTEGER,VARCHAR(200) -q 5"
+	"ebcdic		-s INTEGER,VARCHAR(200),CHAR(40) -C 37"
+	"graphic	-s INTEGER,VARGRAPHIC(100),GRAPHIC(20)"
+	"binary		-s INTEGER,VARBINARY(100),BINARY(16)"
+	"nulls		-s INTEGER,VARCHAR(40),DECIMAL(11,2),DATE,DOUBLE -N 30"
+	"multi_drec	-s INTEGER,VARCHAR(40),DECIMAL(11,2),DATE,VARCHAR(40),DOUBLE -D 48"
+	"mixed		-s INTEGER,CHAR(8),VARCHAR(60),DECIMAL(13,2),DATE,TIMESTAMP(6),DOUBLE,SMALLINT -N 5 -q 1"
+)
+
+mkdir "$DIR"
+trap 'rm -rf "$DIR"' EXIT
+
+TIMEFORMAT=%R
+for scenario in "${SCENARIOS[@]}"; do
+	read -r name gen_opts <<< "$scenario"
+	ixf=$DIR/$name.ixf
+	# shellcheck disable=SC2086
+	"$IXFGEN" -n "$ROWS" -t "$name" -o "$ixf" $gen_opts
+	bytes=$(wc -c < "$ixf")
+
+	best=
+	for ((i = 0; i < REPEAT; ++i)); do
+		# shellcheck disable=SC2086
+		secs=$( { time "$IXFCVT" $IXFCVT_OPTS "$ixf" > /dev/null; } 2>&1 )
+		if [ -z "$best" ] || awk "BEGIN { exit !($secs < $best) }"; then
+			best=$secs
+		fi
+	done
+
+	awk -v name="$name" -v rows="$ROWS" -v bytes="$bytes" -v secs="$best" '
+	BEGIN {
+		t = secs > 0 ? secs : 0.001	# below the timer resolution
+		printf("{\"scenario\":\"%s\",\"rows\":%d,\"bytes\":%.0f," \
+		       "\"seconds\":%.3f,\"mb_per_s\":%.2f,\"rows_per_s\":%.0f}\n",
+		       name, rows, bytes, secs, bytes / t / 1048576, rows / t)
+	}'
+	rm -f "$ixf"
+done
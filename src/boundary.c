@@ -0,0 +1,413 @@
+/*
+ * boundary.c - find the record boundaries of an IXF file on several threads
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The records of an IXF file form a chain: where one starts is known only
+ * from the length of the one before.  To walk the data part of a file on
+ * several threads without an index, it is cut into byte ranges, and each
+ * thread guesses where the first record of its range starts: 6 digits and
+ * an A record, or a D record with an IXFDRID of the table, and so on for
+ * the next CHAIN_CHECK records.  It walks the chain from there to the first
+ * record at or past the end of its range.  A guess is only trusted when the
+ * walk of the range before ends exactly on it; a range guessed wrong is
+ * walked again from there, so the result never depends on the guesses.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "boundary.h"
+#include "pagecache.h"
+#include "stats.h"
+#include "util.h"
+
+#define REC_LEN_BYTES 6
+#define HEADER_BYTES 7		/* record length and type */
+#define IXFDRID_OFFSET 1	/* from the record type */
+#define IXFDRID_BYTES 3
+#define D_HEADER_BYTES (REC_LEN_BYTES + IXFDRID_OFFSET + IXFDRID_BYTES)
+#define MAX_DRID 999
+#define CHAIN_CHECK 4		/* records chained to confirm a guess */
+#define WINDOW_SIZE (1 << 20)	/* bytes read at a time, over a record */
+/* longer than any record, so that every range holds the start of one */
+#define MIN_RANGE (4 << 20)
+
+/* a range of the file and the thread looking for its records */
+struct finder {
+	int f_fd;
+	off_t f_size;		/* of the file */
+	off_t f_from;		/* first byte of the range */
+	off_t f_to;		/* first byte after it */
+	int f_ndrec;		/* D records of a row */
+	struct record_range *f_range;
+	unsigned long f_reads;
+	unsigned long long f_bytes;
+};
+
+static void *find_in_range(void *arg);
+static int count_d_records(struct window *w, off_t pos);
+static bool walk_chain(struct window *w, off_t pos, off_t end, int ndrec,
+		       bool strict, struct record_range *r);
+static bool chains_forward(struct window *w, off_t pos, int ndrec);
+static long data_record_length(struct window *w, off_t off, int ndrec,
+			       unsigned char *type);
+static long parse_digits(const unsigned char *p, int n);
+
+/* Returns the processors online, 1 if unknown. */
+int online_cpus(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > MAX_THREADS)
+		return MAX_THREADS;
+	return n > 0 ? (int)n : 1;
+#else
+	return 1;
+#endif
+}
+
+/*
+ * Cuts the records of IXF file `fd' from the one at `start', known to be
+ * a record start, to the end of the file into at most `nthreads' ranges
+ * found on as many threads.  Returns the number of ranges put in
+ * `ranges', consecutive and each ending on the start of the next, or 0 if
+ * the file is not a regular one or too small to be worth the threads.
+ * The last range is cut short where a record length is not a number or
+ * a record runs past the end of the file.
+ */
+int find_record_ranges(int fd, off_t start, int nthreads,
+		       struct record_range *ranges)
+{
+	struct finder finders[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+	struct window w;
+	struct stat st;
+	off_t step;
+	off_t pos;
+	int ndrec;
+	int n;
+	int i;
+	int rc;
+
+	if (fstat(fd, &st) == -1)
+		err_exit("fstat");
+	if (!S_ISREG(st.st_mode) || start >= st.st_size)
+		return 0;
+	n = nthreads < MAX_THREADS ? nthreads : MAX_THREADS;
+	if ((st.st_size - start) / n < MIN_RANGE)
+		n = (int)((st.st_size - start) / MIN_RANGE);
+	if (n < 2)
+		return 0;
+
+	open_window(&w, fd, st.st_size);
+	ndrec = count_d_records(&w, start);
+	step = (st.st_size - start) / n;
+	for (i = 0; i < n; ++i) {
+		finders[i].f_fd = fd;
+		finders[i].f_size = st.st_size;
+		finders[i].f_from = start + step * i;
+		finders[i].f_to = i == n - 1 ? st.st_size
+		    : start + step * (i + 1);
+		finders[i].f_ndrec = ndrec;
+		finders[i].f_range = &ranges[i];
+	}
+
+	/* the first range is looked into by the calling thread */
+	for (i = 1; i < n; ++i) {
+		rc = pthread_create(&threads[i], NULL, find_in_range,
+				    &finders[i]);
+		if (rc != 0)
+			fmt_err_exit("pthread_create: %s", strerror(rc));
+	}
+	find_in_range(&finders[0]);
+	for (i = 1; i < n; ++i) {
+		rc = pthread_join(threads[i], NULL);
+		if (rc != 0)
+			fmt_err_exit("pthread_join: %s", strerror(rc));
+	}
+
+	/* follow the chain from `start', walking again where it was lost */
+	pos = start;
+	for (i = 0; i < n; ++i) {
+		count_reads(finders[i].f_reads, finders[i].f_bytes);
+		if (!ranges[i].rr_found || ranges[i].rr_start != pos)
+			walk_chain(&w, pos, finders[i].f_to, ndrec, true,
+				   &ranges[i]);
+		pos = ranges[i].rr_end;
+		if (ranges[i].rr_eof || ranges[i].rr_broken) {
+			++i;
+			break;
+		}
+	}
+	close_window(&w);
+	count_reads(w.w_reads, w.w_bytes);
+
+	return i;
+}
+
+/*
+ * Walks the records of IXF file `fd' from the one at `start' to the end
+ * of the file into `r' on the calling thread, a window at a time.  Returns
+ * false if the file is not a regular one.
+ */
+bool walk_records(int fd, off_t start, struct record_range *r)
+{
+	struct window w;
+	struct stat st;
+
+	if (fstat(fd, &st) == -1)
+		err_exit("fstat");
+	if (!S_ISREG(st.st_mode))
+		return false;
+
+	open_window(&w, fd, st.st_size);
+	walk_chain(&w, start, st.st_size, MAX_DRID, true, r);
+	close_window(&w);
+	count_reads(w.w_reads, w.w_bytes);
+
+	return true;
+}
+
+/* Looks for the records of the range of finder `arg'. */
+static void *find_in_range(void *arg)
+{
+	struct finder *f;
+	struct window w;
+	off_t pos;
+
+	f = arg;
+	f->f_range->rr_found = false;
+	open_window(&w, f->f_fd, f->f_size);
+	for (pos = f->f_from; pos < f->f_to; ++pos) {
+		if (chains_forward(&w, pos, f->f_ndrec)) {
+			walk_chain(&w, pos, f->f_to, f->f_ndrec, false,
+				   f->f_range);
+			break;
+		}
+	}
+	close_window(&w);
+	f->f_reads = w.w_reads;
+	f->f_bytes = w.w_bytes;
+
+	return NULL;
+}
+
+/*
+ * Returns the D records of a row, from the IXFDRIDs of the first row at
+ * `pos'; MAX_DRID if they do not tell.
+ */
+static int count_d_records(struct window *w, off_t pos)
+{
+	unsigned char type;
+	long len;
+	long drid;
+	int n;
+
+	for (n = 0; n < MAX_DRID; ++n) {
+		len = data_record_length(w, pos, MAX_DRID, &type);
+		if (len == -1 || type != 'D')
+			break;
+		drid = parse_digits(peek_window(w, pos, D_HEADER_BYTES)
+				    + HEADER_BYTES, IXFDRID_BYTES);
+		if (drid == 1 && n > 0)
+			break;	/* the first of the next row */
+		if (drid != n + 1)
+			return MAX_DRID;
+		pos += REC_LEN_BYTES + len;
+	}
+
+	return n > 0 ? n : MAX_DRID;
+}
+
+/*
+ * Walks the chain of records from `pos' to the first one at or past `end'
+ * into `r'.  Unless `strict', stops at the first header that cannot be
+ * one of the data part of the file and returns false; with it, any type
+ * goes, and the range is broken at a length that is not a number or at a
+ * record that runs past the end of the file.
+ */
+static bool walk_chain(struct window *w, off_t pos, off_t end, int ndrec,
+		       bool strict, struct record_range *r)
+{
+	const unsigned char *hdr;
+	unsigned char type;
+	long len;
+
+	r->rr_start = pos;
+	r->rr_nrecs = 0L;
+	r->rr_dcnt = 0L;
+	r->rr_maxlen = 0;
+	r->rr_found = false;
+	r->rr_broken = false;
+	while (pos < end && pos + HEADER_BYTES <= w->w_size) {
+		if (strict) {
+			if (!(hdr = peek_window(w, pos, HEADER_BYTES)))
+				break;	/* truncated since fstat() */
+			type = hdr[REC_LEN_BYTES];
+			if ((len = parse_digits(hdr, REC_LEN_BYTES)) < 1) {
+				r->rr_broken = true;
+				break;
+			}
+		} else if ((len = data_record_length(w, pos, ndrec, &type))
+			   == -1) {
+			return false;
+		}
+		if (pos + REC_LEN_BYTES + len > w->w_size) {
+			if (!strict)
+				return false;
+			r->rr_broken = true;	/* truncated file */
+			break;
+		}
+		++r->rr_nrecs;
+		if (type == 'D')
+			++r->rr_dcnt;
+		if ((size_t) len > r->rr_maxlen)
+			r->rr_maxlen = (size_t) len;
+		pos += REC_LEN_BYTES + len;
+	}
+	r->rr_end = pos;
+	r->rr_found = true;
+	/* not even the header of another record is left */
+	r->rr_eof = !r->rr_broken && pos + HEADER_BYTES > w->w_size;
+
+	return true;
+}
+
+/* Returns true if CHAIN_CHECK records of the data part chain from `pos'. */
+static bool chains_forward(struct window *w, off_t pos, int ndrec)
+{
+	unsigned char type;
+	long len;
+	int i;
+
+	for (i = 0; i < CHAIN_CHECK; ++i) {
+		if (pos + HEADER_BYTES > w->w_size)
+			return i > 0;	/* the end of the file */
+		len = data_record_length(w, pos, ndrec, &type);
+		if (len == -1)
+			return false;
+		pos += REC_LEN_BYTES + len;
+	}
+
+	return true;
+}
+
+/*
+ * Returns the length of the record at `off', and its type in `type', if
+ * it can be one of the data part of the file: 6 digits, then an A record,
+ * or a D record with an IXFDRID from 1 to `ndrec'; -1 if it cannot.
+ */
+static long data_record_length(struct window *w, off_t off, int ndrec,
+			       unsigned char *type)
+{
+	const unsigned char *hdr;
+	long len;
+	long drid;
+
+	if (!(hdr = peek_window(w, off, HEADER_BYTES)))
+		return -1L;
+	if ((len = parse_digits(hdr, REC_LEN_BYTES)) < 1)
+		return -1L;
+	*type = hdr[REC_LEN_BYTES];
+	if (*type == 'A')
+		return len;
+	if (*type != 'D' || len < IXFDRID_OFFSET + IXFDRID_BYTES
+	    || !(hdr = peek_window(w, off, D_HEADER_BYTES)))
+		return -1L;
+	drid = parse_digits(hdr + HEADER_BYTES, IXFDRID_BYTES);
+
+	return drid >= 1 && drid <= ndrec ? len : -1L;
+}
+
+/* Returns the number of the `n' decimal digits at `p', -1 if not all are. */
+static long parse_digits(const unsigned char *p, int n)
+{
+	long val;
+	int i;
+
+	val = 0L;
+	for (i = 0; i < n; ++i) {
+		if (p[i] < '0' || p[i] > '9')
+			return -1L;
+		val = val * 10 + (p[i] - '0');
+	}
+
+	return val;
+}
+
+/* Opens window `w' on file `fd' of `size' bytes. */
+void open_window(struct window *w, int fd, off_t size)
+{
+	w->w_fd = fd;
+	w->w_size = size;
+	w->w_buff = alloc_buff(WINDOW_SIZE);
+	w->w_base = 0;
+	w->w_len = 0;
+	w->w_reads = 0UL;
+	w->w_bytes = 0ULL;
+}
+
+/* Closes window `w', dropping its bytes with --drop-cache. */
+void close_window(struct window *w)
+{
+	cache_read_at(w->w_fd, w->w_base, w->w_len);
+	free_buff(w->w_buff);
+	w->w_buff = NULL;
+}
+
+/*
+ * Returns the `n' bytes at `off', no more than WINDOW_SIZE, reading them
+ * with pread() if they are not in the window yet; NULL past the end of the
+ * file.
+ */
+const unsigned char *peek_window(struct window *w, off_t off, size_t n)
+{
+	size_t want;
+	ssize_t got;
+
+	if (off >= w->w_base && off + (off_t) n <= w->w_base + (off_t) w->w_len)
+		return w->w_buff + (off - w->w_base);
+	if (off + (off_t) n > w->w_size)
+		return NULL;
+
+	cache_read_at(w->w_fd, w->w_base, w->w_len);
+	want = w->w_size - off < WINDOW_SIZE ? (size_t) (w->w_size - off)
+	    : WINDOW_SIZE;
+	w->w_base = off;
+	w->w_len = 0;
+	while (w->w_len < want) {
+		got = pread(w->w_fd, w->w_buff + w->w_len, want - w->w_len,
+			    off + (off_t) w->w_len);
+		if (got == -1 && errno == EINTR)
+			continue;
+		if (got == -1)
+			err_exit("pread");
+		if (got == 0)
+			break;	/* truncated since fstat() */
+		w->w_len += (size_t) got;
+		++w->w_reads;
+		w->w_bytes += (unsigned long long)got;
+	}
+
+	return w->w_len >= n ? w->w_buff : NULL;
+}
@@ -0,0 +1,59 @@
+/*
+ * boundary.h - declarations of the parallel discovery of record boundaries
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_BOUNDARY_H_
+#define IXFCVT_BOUNDARY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define MAX_THREADS 64
+
+/* bytes of a file read at a time with pread(), one per thread */
+struct window {
+	int w_fd;
+	off_t w_size;		/* of the file */
+	unsigned char *w_buff;
+	off_t w_base;		/* file offset of `w_buff' */
+	size_t w_len;		/* bytes in `w_buff' */
+	unsigned long w_reads;
+	unsigned long long w_bytes;
+};
+
+/* a run of whole records of an IXF file */
+struct record_range {
+	off_t rr_start;		/* of the first record */
+	off_t rr_end;		/* of the record after the last one */
+	long rr_nrecs;		/* records in the range */
+	long rr_dcnt;		/* D records among them */
+	size_t rr_maxlen;	/* longest record length */
+	bool rr_found;		/* walked from rr_start to rr_end */
+	bool rr_eof;		/* the last range of the file */
+	bool rr_broken;		/* the chain breaks at rr_end */
+};
+
+int online_cpus(void);
+int find_record_ranges(int fd, off_t start, int nthreads,
+		       struct record_range *ranges);
+bool walk_records(int fd, off_t start, struct record_range *r);
+void open_window(struct window *w, int fd, off_t size);
+void close_window(struct window *w);
+const unsigned char *peek_window(struct window *w, off_t off, size_t n);
+
+#endif
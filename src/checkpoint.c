@@ -0,0 +1,165 @@
+/*
+ * checkpoint.c - save and restore the checkpoints of --checkpoint/--resume
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "util.h"
+
+/*
+ * A checkpoint is a few lines of text of a fixed width, overwritten in
+ * place at each COMMIT, so that a file is never left half written.
+ */
+#define CKPT_FORMAT "ixfcvt checkpoint\n" \
+		    "ixf_size %020lld\n" \
+		    "ixf_offset %020lld\n" \
+		    "sql_offset %020lld\n" \
+		    "rows_read %020ld\n" \
+		    "rows_skipped %020ld\n" \
+		    "rows_output %020ld\n"
+#define CKPT_SCAN_FORMAT "ixfcvt checkpoint ixf_size %lld ixf_offset %lld " \
+			 "sql_offset %lld rows_read %ld rows_skipped %ld " \
+			 "rows_output %ld"
+#define CKPT_FIELDS 6
+#define CKPT_BUFF_SIZE 256
+
+static int ckpt_fd = -1;	/* -1 if no checkpoint is saved */
+static off_t ixf_size;		/* to tell the IXF file of a checkpoint */
+static bool resuming;		/* from `resume_point' on */
+static struct checkpoint resume_point;
+
+static bool load_checkpoint(struct checkpoint *ck);
+
+/*
+ * Starts saving checkpoints to `file'. If `resume' is set, the last
+ * checkpoint in it, if any, is checked against the IXF file `ifd' and the
+ * output `ofd' is cut back to it; otherwise `ofd' starts empty.
+ */
+void open_checkpoint(const char *file, bool resume, int ifd, int ofd)
+{
+	struct stat st;
+	off_t sql_size;
+
+	ckpt_fd = open_file(file, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR |
+			    S_IRGRP | S_IROTH);
+	if (fstat(ifd, &st) == -1)
+		err_exit("fstat");
+	ixf_size = st.st_size;
+
+	resuming = resume && load_checkpoint(&resume_point);
+	if (!resuming) {
+		sql_size = 0;
+		if (ftruncate(ckpt_fd, 0) == -1)
+			err_exit("ftruncate");
+	} else {
+		sql_size = resume_point.ck_sql;
+		if (fstat(ofd, &st) == -1)
+			err_exit("fstat");
+		if (st.st_size < sql_size)
+			fmt_err_exit("Output file is shorter than checkpoint "
+				     "%s, cannot resume", file);
+	}
+
+	/* drop what was output after the checkpoint */
+	if (ftruncate(ofd, sql_size) == -1)
+		err_exit("ftruncate");
+	seek_file(ofd, sql_size, SEEK_SET);
+}
+
+/*
+ * Returns true and fills in `ck' if the conversion resumes from a
+ * checkpoint, false if it starts from the first row.
+ */
+bool get_resume_point(struct checkpoint *ck)
+{
+	if (!resuming)
+		return false;
+
+	*ck = resume_point;
+	return true;
+}
+
+/*
+ * Saves the position of the IXF file `ifd' and the output `ofd', called
+ * right after a COMMIT, with the rows read, skipped and output so far.
+ * The output is flushed to the disk first, so that a checkpoint never
+ * names output lost with a crash.
+ */
+void save_checkpoint(int ifd, int ofd, long rows, long skipped, long taken)
+{
+	char buff[CKPT_BUFF_SIZE];
+	int len;
+
+	if (ckpt_fd == -1)
+		return;
+
+	len = snprintf(buff, sizeof(buff), CKPT_FORMAT, (long long)ixf_size,
+		       (long long)seek_file(ifd, 0, SEEK_CUR),
+		       (long long)seek_file(ofd, 0, SEEK_CUR), rows, skipped,
+		       taken);
+	if (fdatasync(ofd) == -1 && errno != EINVAL)
+		err_exit("fdatasync");
+	if (pwrite(ckpt_fd, buff, (size_t)len, 0) != len)
+		err_exit("checkpoint");
+}
+
+/* stop saving checkpoints */
+void close_checkpoint(void)
+{
+	if (ckpt_fd == -1)
+		return;
+
+	close_file(ckpt_fd);
+	ckpt_fd = -1;
+}
+
+/*
+ * Returns true and fills in `ck' if a checkpoint is found, false if the
+ * file is empty. Exits if it is not a checkpoint of the IXF file.
+ */
+static bool load_checkpoint(struct checkpoint *ck)
+{
+	char buff[CKPT_BUFF_SIZE];
+	long long size;
+	long long ixf;
+	long long sql;
+	ssize_t n_read;
+
+	n_read = pread(ckpt_fd, buff, sizeof(buff) - 1, 0);
+	if (n_read == -1)
+		err_exit("read");
+	if (n_read == 0)
+		return false;
+	buff[n_read] = '\0';
+
+	if (sscanf(buff, CKPT_SCAN_FORMAT, &size, &ixf, &sql, &ck->ck_rows,
+		   &ck->ck_skipped, &ck->ck_taken) != CKPT_FIELDS)
+		fmt_err_exit("%s", "Invalid checkpoint file");
+	if (size != (long long)ixf_size)
+		fmt_err_exit("%s", "Checkpoint is of another IXF file");
+	if (ixf < 0 || ixf > size || sql < 0)
+		fmt_err_exit("%s", "Invalid checkpoint file");
+
+	ck->ck_ixf = (off_t)ixf;
+	ck->ck_sql = (off_t)sql;
+	return true;
+}
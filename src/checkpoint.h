@@ -0,0 +1,39 @@
+/*
+ * checkpoint.h - declarations of the checkpoints of --checkpoint/--resume
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_CHECKPOINT_H_
+#define IXFCVT_CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* state of a conversion right after a COMMIT */
+struct checkpoint {
+	off_t ck_ixf;		/* offset of the next row in the IXF file */
+	off_t ck_sql;		/* size of the output */
+	long ck_rows;		/* rows read */
+	long ck_skipped;	/* rows skipped for --offset */
+	long ck_taken;		/* rows output */
+};
+
+void open_checkpoint(const char *file, bool resume, int ifd, int ofd);
+bool get_resume_point(struct checkpoint *ck);
+void save_checkpoint(int ifd, int ofd, long rows, long skipped, long taken);
+void close_checkpoint(void);
+
+#endif
@@ -0,0 +1,591 @@
+/*
+ * codepage.c - transcode character data of DB2 code pages to UTF-8
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <iconv.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "codepage.h"
+#include "util.h"
+
+#define BYTE_VALUES 256
+#define DBCS_ENTRIES 65536	/* indexed by lead byte << 8 | trail byte */
+#define REPLACEMENT_CHAR 0xFFFD
+#define ONE_BYTES 0x0101010101010101ULL
+#define HIGH_BITS 0x8080808080808080ULL
+
+enum codec_kind {
+	CK_SBCS,		/* single-byte, built-in table */
+	CK_MBCS,		/* single/double-byte, table built via iconv */
+	CK_UTF16		/* UTF-16 big-endian */
+};
+
+/* UTF-8 sequence of a character, at most 3 bytes (BMP only) */
+struct u8seq {
+	unsigned char s_len;	/* 0 for a lead byte of a double-byte char */
+	unsigned char s_byte[3];
+};
+
+struct codec {
+	enum codec_kind cc_kind;
+	const unsigned short *cc_ucs;	/* CK_SBCS: byte to UCS-2 */
+	const char *const *cc_names;	/* CK_MBCS: iconv names to try */
+	bool cc_ready;		/* tables built */
+	bool cc_ascii;		/* 0x00-0x7F map to themselves */
+	struct u8seq cc_single[BYTE_VALUES];
+	struct u8seq *cc_double;	/* CK_MBCS: DBCS_ENTRIES entries */
+};
+
+static const unsigned short cp037_ucs[BYTE_VALUES] = {
+	0x0000, 0x0001, 0x0002, 0x0003, 0x009C, 0x0009, 0x0086, 0x007F,
+	0x0097, 0x008D, 0x008E, 0x000B, 0x000C, 0x000D, 0x000E, 0x000F,
+	0x0010, 0x0011, 0x0012, 0x0013, 0x009D, 0x0085, 0x0008, 0x0087,
+	0x0018, 0x0019, 0x0092, 0x008F, 0x001C, 0x001D, 0x001E, 0x001F,
+	0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x000A, 0x0017, 0x001B,
+	0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x0005, 0x0006, 0x0007,
+	0x0090, 0x0091, 0x0016, 0x0093, 0x0094, 0x0095, 0x0096, 0x0004,
+	0x0098, 0x0099, 0x009A, 0x009B, 0x0014, 0x0015, 0x009E, 0x001A,
+	0x0020, 0x00A0, 0x00E2, 0x00E4, 0x00E0, 0x00E1, 0x00E3, 0x00E5,
+	0x00E7, 0x00F1, 0x00A2, 0x002E, 0x003C, 0x0028, 0x002B, 0x007C,
+	0x0026, 0x00E9, 0x00EA, 0x00EB, 0x00E8, 0x00ED, 0x00EE, 0x00EF,
+	0x00EC, 0x00DF, 0x0021, 0x0024, 0x002A, 0x0029, 0x003B, 0x00AC,
+	0x002D, 0x002F, 0x00C2, 0x00C4, 0x00C0, 0x00C1, 0x00C3, 0x00C5,
+	0x00C7, 0x00D1, 0x00A6, 0x002C, 0x0025, 0x005F, 0x003E, 0x003F,
+	0x00F8, 0x00C9, 0x00CA, 0x00CB, 0x00C8, 0x00CD, 0x00CE, 0x00CF,
+	0x00CC, 0x0060, 0x003A, 0x0023, 0x0040, 0x0027, 0x003D, 0x0022,
+	0x00D8, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x00AB, 0x00BB, 0x00F0, 0x00FD, 0x00FE, 0x00B1,
+	0x00B0, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070,
+	0x0071, 0x0072, 0x00AA, 0x00BA, 0x00E6, 0x00B8, 0x00C6, 0x00A4,
+	0x00B5, 0x007E, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078,
+	0x0079, 0x007A, 0x00A1, 0x00BF, 0x00D0, 0x00DD, 0x00DE, 0x00AE,
+	0x005E, 0x00A3, 0x00A5, 0x00B7, 0x00A9, 0x00A7, 0x00B6, 0x00BC,
+	0x00BD, 0x00BE, 0x005B, 0x005D, 0x00AF, 0x00A8, 0x00B4, 0x00D7,
+	0x007B, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x00AD, 0x00F4, 0x00F6, 0x00F2, 0x00F3, 0x00F5,
+	0x007D, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050,
+	0x0051, 0x0052, 0x00B9, 0x00FB, 0x00FC, 0x00F9, 0x00FA, 0x00FF,
+	0x005C, 0x00F7, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058,
+	0x0059, 0x005A, 0x00B2, 0x00D4, 0x00D6, 0x00D2, 0x00D3, 0x00D5,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x00B3, 0x00DB, 0x00DC, 0x00D9, 0x00DA, 0x009F
+};
+
+static const unsigned short cp500_ucs[BYTE_VALUES] = {
+	0x0000, 0x0001, 0x0002, 0x0003, 0x009C, 0x0009, 0x0086, 0x007F,
+	0x0097, 0x008D, 0x008E, 0x000B, 0x000C, 0x000D, 0x000E, 0x000F,
+	0x0010, 0x0011, 0x0012, 0x0013, 0x009D, 0x0085, 0x0008, 0x0087,
+	0x0018, 0x0019, 0x0092, 0x008F, 0x001C, 0x001D, 0x001E, 0x001F,
+	0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x000A, 0x0017, 0x001B,
+	0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x0005, 0x0006, 0x0007,
+	0x0090, 0x0091, 0x0016, 0x0093, 0x0094, 0x0095, 0x0096, 0x0004,
+	0x0098, 0x0099, 0x009A, 0x009B, 0x0014, 0x0015, 0x009E, 0x001A,
+	0x0020, 0x00A0, 0x00E2, 0x00E4, 0x00E0, 0x00E1, 0x00E3, 0x00E5,
+	0x00E7, 0x00F1, 0x005B, 0x002E, 0x003C, 0x0028, 0x002B, 0x0021,
+	0x0026, 0x00E9, 0x00EA, 0x00EB, 0x00E8, 0x00ED, 0x00EE, 0x00EF,
+	0x00EC, 0x00DF, 0x005D, 0x0024, 0x002A, 0x0029, 0x003B, 0x005E,
+	0x002D, 0x002F, 0x00C2, 0x00C4, 0x00C0, 0x00C1, 0x00C3, 0x00C5,
+	0x00C7, 0x00D1, 0x00A6, 0x002C, 0x0025, 0x005F, 0x003E, 0x003F,
+	0x00F8, 0x00C9, 0x00CA, 0x00CB, 0x00C8, 0x00CD, 0x00CE, 0x00CF,
+	0x00CC, 0x0060, 0x003A, 0x0023, 0x0040, 0x0027, 0x003D, 0x0022,
+	0x00D8, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x00AB, 0x00BB, 0x00F0, 0x00FD, 0x00FE, 0x00B1,
+	0x00B0, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070,
+	0x0071, 0x0072, 0x00AA, 0x00BA, 0x00E6, 0x00B8, 0x00C6, 0x00A4,
+	0x00B5, 0x007E, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078,
+	0x0079, 0x007A, 0x00A1, 0x00BF, 0x00D0, 0x00DD, 0x00DE, 0x00AE,
+	0x00A2, 0x00A3, 0x00A5, 0x00B7, 0x00A9, 0x00A7, 0x00B6, 0x00BC,
+	0x00BD, 0x00BE, 0x00AC, 0x007C, 0x00AF, 0x00A8, 0x00B4, 0x00D7,
+	0x007B, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x00AD, 0x00F4, 0x00F6, 0x00F2, 0x00F3, 0x00F5,
+	0x007D, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050,
+	0x0051, 0x0052, 0x00B9, 0x00FB, 0x00FC, 0x00F9, 0x00FA, 0x00FF,
+	0x005C, 0x00F7, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058,
+	0x0059, 0x005A, 0x00B2, 0x00D4, 0x00D6, 0x00D2, 0x00D3, 0x00D5,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x00B3, 0x00DB, 0x00DC, 0x00D9, 0x00DA, 0x009F
+};
+
+static const unsigned short cp1047_ucs[BYTE_VALUES] = {
+	0x0000, 0x0001, 0x0002, 0x0003, 0x009C, 0x0009, 0x0086, 0x007F,
+	0x0097, 0x008D, 0x008E, 0x000B, 0x000C, 0x000D, 0x000E, 0x000F,
+	0x0010, 0x0011, 0x0012, 0x0013, 0x009D, 0x0085, 0x0008, 0x0087,
+	0x0018, 0x0019, 0x0092, 0x008F, 0x001C, 0x001D, 0x001E, 0x001F,
+	0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x000A, 0x0017, 0x001B,
+	0x0088, 0x0089, 0x008A, 0x008B, 0x008C, 0x0005, 0x0006, 0x0007,
+	0x0090, 0x0091, 0x0016, 0x0093, 0x0094, 0x0095, 0x0096, 0x0004,
+	0x0098, 0x0099, 0x009A, 0x009B, 0x0014, 0x0015, 0x009E, 0x001A,
+	0x0020, 0x00A0, 0x00E2, 0x00E4, 0x00E0, 0x00E1, 0x00E3, 0x00E5,
+	0x00E7, 0x00F1, 0x00A2, 0x002E, 0x003C, 0x0028, 0x002B, 0x007C,
+	0x0026, 0x00E9, 0x00EA, 0x00EB, 0x00E8, 0x00ED, 0x00EE, 0x00EF,
+	0x00EC, 0x00DF, 0x0021, 0x0024, 0x002A, 0x0029, 0x003B, 0x005E,
+	0x002D, 0x002F, 0x00C2, 0x00C4, 0x00C0, 0x00C1, 0x00C3, 0x00C5,
+	0x00C7, 0x00D1, 0x00A6, 0x002C, 0x0025, 0x005F, 0x003E, 0x003F,
+	0x00F8, 0x00C9, 0x00CA, 0x00CB, 0x00C8, 0x00CD, 0x00CE, 0x00CF,
+	0x00CC, 0x0060, 0x003A, 0x0023, 0x0040, 0x0027, 0x003D, 0x0022,
+	0x00D8, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x00AB, 0x00BB, 0x00F0, 0x00FD, 0x00FE, 0x00B1,
+	0x00B0, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070,
+	0x0071, 0x0072, 0x00AA, 0x00BA, 0x00E6, 0x00B8, 0x00C6, 0x00A4,
+	0x00B5, 0x007E, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078,
+	0x0079, 0x007A, 0x00A1, 0x00BF, 0x00D0, 0x005B, 0x00DE, 0x00AE,
+	0x00AC, 0x00A3, 0x00A5, 0x00B7, 0x00A9, 0x00A7, 0x00B6, 0x00BC,
+	0x00BD, 0x00BE, 0x00DD, 0x00A8, 0x00AF, 0x005D, 0x00B4, 0x00D7,
+	0x007B, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x00AD, 0x00F4, 0x00F6, 0x00F2, 0x00F3, 0x00F5,
+	0x007D, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050,
+	0x0051, 0x0052, 0x00B9, 0x00FB, 0x00FC, 0x00F9, 0x00FA, 0x00FF,
+	0x005C, 0x00F7, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058,
+	0x0059, 0x005A, 0x00B2, 0x00D4, 0x00D6, 0x00D2, 0x00D3, 0x00D5,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x00B3, 0x00DB, 0x00DC, 0x00D9, 0x00DA, 0x009F
+};
+
+static const char *const gbk_names[] = { "GBK", "CP936", "IBM-1386", NULL };
+static const char *const sjis_names[] = { "IBM943", "IBM-943", "CP943",
+	"SHIFT_JIS", NULL
+};
+
+static struct codec cp037 = { CK_SBCS, cp037_ucs, NULL, false, false,
+	{{0, {0}}}, NULL
+};
+static struct codec cp500 = { CK_SBCS, cp500_ucs, NULL, false, false,
+	{{0, {0}}}, NULL
+};
+static struct codec cp1047 = { CK_SBCS, cp1047_ucs, NULL, false, false,
+	{{0, {0}}}, NULL
+};
+static struct codec gbk = { CK_MBCS, NULL, gbk_names, false, false,
+	{{0, {0}}}, NULL
+};
+static struct codec sjis = { CK_MBCS, NULL, sjis_names, false, false,
+	{{0, {0}}}, NULL
+};
+static struct codec utf16 = { CK_UTF16, NULL, NULL, true, false,
+	{{0, {0}}}, NULL
+};
+
+static const struct codec *prepare_codec(struct codec *cc, int code_page);
+static void build_sbcs(struct codec *cc);
+static bool build_mbcs(struct codec *cc);
+static bool iconv_seq(iconv_t cd, const unsigned char *src, size_t len,
+		      struct u8seq *seq);
+static void ucs_to_seq(unsigned long ucs, struct u8seq *seq);
+static char *put_utf8(char *dst, unsigned long ucs);
+static char *utf16_to_utf8(char *dst, const unsigned char *src, size_t len,
+			   int flags);
+static bool must_double(unsigned c, int flags);
+static size_t utf8_seq_len(unsigned char lead);
+static long find_encoding(const struct codec *cc, const unsigned char *seq,
+			  size_t len);
+static bool seq_equals(const struct u8seq *seq, const unsigned char *bytes,
+		       size_t len);
+
+/*
+ * Returns the codec of `code_page' (IXFCSBCP or IXFCDBCP of a C record),
+ * or NULL if the data is to be written untranslated, which is the case
+ * of UTF-8 (1208) and of code pages not known to this program.
+ */
+const struct codec *find_codec(int code_page)
+{
+	switch (code_page) {
+	case 37:
+		return prepare_codec(&cp037, code_page);
+	case 500:
+		return prepare_codec(&cp500, code_page);
+	case 1047:
+		return prepare_codec(&cp1047, code_page);
+	case 1385:		/* GBK, double-byte part */
+	case 1386:
+		return prepare_codec(&gbk, code_page);
+	case 941:		/* Japanese, double-byte part */
+	case 943:
+		return prepare_codec(&sjis, code_page);
+	case 1200:
+	case 13488:
+		return &utf16;
+	default:
+		return NULL;
+	}
+}
+
+/* build the tables of `cc' on first use, returns NULL on failure */
+static const struct codec *prepare_codec(struct codec *cc, int code_page)
+{
+	if (cc->cc_ready)
+		return cc;
+
+	if (cc->cc_kind == CK_SBCS) {
+		build_sbcs(cc);
+	} else if (!build_mbcs(cc)) {
+		err_msg("Code page %d not supported by iconv, "
+			"data is written untranslated\n", code_page);
+		return NULL;
+	}
+	cc->cc_ready = true;
+
+	return cc;
+}
+
+/* fill in the UTF-8 table of a single-byte code page */
+static void build_sbcs(struct codec *cc)
+{
+	int i;
+
+	for (i = 0; i < BYTE_VALUES; ++i)
+		ucs_to_seq(cc->cc_ucs[i], &cc->cc_single[i]);
+	cc->cc_ascii = false;
+}
+
+/*
+ * Fills in the UTF-8 tables of a mixed single/double-byte code page by
+ * asking iconv for every byte and every byte pair following a lead byte.
+ * Returns false if iconv knows none of the names of the code page.
+ */
+static bool build_mbcs(struct codec *cc)
+{
+	const char *const *name;
+	iconv_t cd;
+	unsigned char pair[2];
+	struct u8seq *seq;
+	int lead;
+	int trail;
+
+	cd = (iconv_t) - 1;
+	for (name = cc->cc_names; *name && cd == (iconv_t) - 1; ++name)
+		cd = iconv_open("UTF-8", *name);
+	if (cd == (iconv_t) - 1)
+		return false;
+
+	cc->cc_double = alloc_buff(DBCS_ENTRIES * sizeof(struct u8seq));
+	cc->cc_ascii = true;
+	for (lead = 0; lead < BYTE_VALUES; ++lead) {
+		pair[0] = (unsigned char)lead;
+		seq = &cc->cc_single[lead];
+		if (iconv_seq(cd, pair, 1, seq)) {
+			if (lead < 0x80 && (seq->s_len != 1
+					    || seq->s_byte[0] != lead))
+				cc->cc_ascii = false;
+			continue;
+		}
+		if (errno != EINVAL) {
+			/* neither a character nor a lead byte */
+			ucs_to_seq(REPLACEMENT_CHAR, seq);
+			continue;
+		}
+
+		seq->s_len = 0;
+		for (trail = 0; trail < BYTE_VALUES; ++trail) {
+			pair[1] = (unsigned char)trail;
+			seq = &cc->cc_double[lead << 8 | trail];
+			if (!iconv_seq(cd, pair, 2, seq))
+				ucs_to_seq(REPLACEMENT_CHAR, seq);
+		}
+	}
+
+	iconv_close(cd);
+	return true;
+}
+
+/*
+ * Converts exactly `len' bytes of `src' to a single UTF-8 sequence,
+ * returns false (errno set to EINVAL for an incomplete input) otherwise.
+ */
+static bool iconv_seq(iconv_t cd, const unsigned char *src, size_t len,
+		      struct u8seq *seq)
+{
+	char in[2];
+	char out[8];
+	char *inp;
+	char *outp;
+	size_t in_left;
+	size_t out_left;
+
+	memcpy(in, src, len);
+	inp = in;
+	outp = out;
+	in_left = len;
+	out_left = sizeof(out);
+
+	iconv(cd, NULL, NULL, NULL, NULL);	/* reset shift state */
+	if (iconv(cd, &inp, &in_left, &outp, &out_left) == (size_t) - 1)
+		return false;
+	if (in_left != 0 || outp == out || outp - out > 3) {
+		errno = EILSEQ;
+		return false;
+	}
+
+	seq->s_len = (unsigned char)(outp - out);
+	memcpy(seq->s_byte, out, seq->s_len);
+	return true;
+}
+
+/* store the UTF-8 sequence of a BMP character */
+static void ucs_to_seq(unsigned long ucs, struct u8seq *seq)
+{
+	char buff[4];
+
+	seq->s_len = (unsigned char)(put_utf8(buff, ucs) - buff);
+	memcpy(seq->s_byte, buff, seq->s_len);
+}
+
+/* write the UTF-8 encoding of `ucs' to `dst', returns the end of it */
+static char *put_utf8(char *dst, unsigned long ucs)
+{
+	if (ucs < 0x80) {
+		*dst++ = (char)ucs;
+	} else if (ucs < 0x800) {
+		*dst++ = (char)(0xC0 | ucs >> 6);
+		*dst++ = (char)(0x80 | (ucs & 0x3F));
+	} else if (ucs < 0x10000) {
+		*dst++ = (char)(0xE0 | ucs >> 12);
+		*dst++ = (char)(0x80 | (ucs >> 6 & 0x3F));
+		*dst++ = (char)(0x80 | (ucs & 0x3F));
+	} else {
+		*dst++ = (char)(0xF0 | ucs >> 18);
+		*dst++ = (char)(0x80 | (ucs >> 12 & 0x3F));
+		*dst++ = (char)(0x80 | (ucs >> 6 & 0x3F));
+		*dst++ = (char)(0x80 | (ucs & 0x3F));
+	}
+
+	return dst;
+}
+
+/*
+ * Transcodes `len' bytes of `src' in the code page of `cc' to UTF-8,
+ * doubling quotes or backslashes as `flags' requests, writes the result
+ * to `dst' and returns a pointer to the byte following the last written.
+ * `dst' must have room for U8_MAX_GROWTH * `len' bytes.
+ */
+char *to_utf8(char *dst, const unsigned char *src, size_t len,
+	      const struct codec *cc, int flags)
+{
+	static const struct u8seq REPLACEMENT = { 3, {0xEF, 0xBF, 0xBD} };
+	const unsigned char *end;
+	const struct u8seq *seq;
+	size_t run;
+
+	if (cc->cc_kind == CK_UTF16)
+		return utf16_to_utf8(dst, src, len, flags);
+
+	end = src + len;
+	while (src < end) {
+		/* fast path: copy a run of plain ASCII bytes as is */
+		if (cc->cc_ascii && *src < 0x80) {
+			run = plain_run_len(src, (size_t)(end - src),
+					    flags | CP_ASCII_ONLY);
+			memcpy(dst, src, run);
+			dst += run;
+			src += run;
+			if (src == end)
+				break;
+		}
+
+		seq = &cc->cc_single[*src];
+		if (seq->s_len > 0) {
+			src++;
+		} else if (src + 1 < end) {
+			seq = &cc->cc_double[src[0] << 8 | src[1]];
+			src += 2;
+		} else {
+			seq = &REPLACEMENT;	/* truncated character */
+			src++;
+		}
+
+		memcpy(dst, seq->s_byte, seq->s_len);
+		dst += seq->s_len;
+		if (seq->s_len == 1 && must_double(seq->s_byte[0], flags))
+			*dst++ = (char)seq->s_byte[0];
+	}
+
+	return dst;
+}
+
+/* transcode UTF-16BE (GRAPHIC data of Unicode databases) to UTF-8 */
+static char *utf16_to_utf8(char *dst, const unsigned char *src, size_t len,
+			   int flags)
+{
+	const unsigned char *end;
+	unsigned long ucs;
+	unsigned long low;
+
+	end = src + len - len % 2;
+	while (src < end) {
+		ucs = (unsigned long)src[0] << 8 | src[1];
+		src += 2;
+
+		if (ucs < 0x80) {
+			if (must_double((unsigned)ucs, flags))
+				*dst++ = (char)ucs;
+			*dst++ = (char)ucs;
+			continue;
+		}
+
+		if (ucs >= 0xD800 && ucs <= 0xDBFF && src < end) {
+			low = (unsigned long)src[0] << 8 | src[1];
+			if (low >= 0xDC00 && low <= 0xDFFF) {
+				ucs = 0x10000 + ((ucs - 0xD800) << 10)
+				    + (low - 0xDC00);
+				src += 2;
+			}
+		}
+		if (ucs >= 0xD800 && ucs <= 0xDFFF)
+			ucs = REPLACEMENT_CHAR;	/* unpaired surrogate */
+
+		dst = put_utf8(dst, ucs);
+	}
+
+	if (len % 2)
+		dst = put_utf8(dst, REPLACEMENT_CHAR);
+
+	return dst;
+}
+
+/* whether an ASCII character is to be doubled under `flags' */
+static bool must_double(unsigned c, int flags)
+{
+	return (c == '\'' && (flags & CP_DOUBLE_QUOTE))
+	    || (c == '\\' && (flags & CP_DOUBLE_BS));
+}
+
+/*
+ * Returns the number of leading bytes of `src' that can be copied as is,
+ * that is, bytes before the first quote or backslash to be doubled, or
+ * before the first non-ASCII byte if CP_ASCII_ONLY is set in `flags'.
+ * Eight bytes are examined at a time.
+ */
+size_t plain_run_len(const unsigned char *src, size_t len, int flags)
+{
+	const uint64_t QUOTES = ONE_BYTES * '\'';
+	const uint64_t BACKSLASHES = ONE_BYTES * '\\';
+	uint64_t word;
+	uint64_t mask;
+	uint64_t x;
+	size_t i;
+
+	for (i = 0; i + sizeof(word) <= len; i += sizeof(word)) {
+		memcpy(&word, src + i, sizeof(word));
+		mask = 0;
+		if (flags & CP_DOUBLE_QUOTE) {
+			x = word ^ QUOTES;
+			mask |= (x - ONE_BYTES) & ~x;
+		}
+		if (flags & CP_DOUBLE_BS) {
+			x = word ^ BACKSLASHES;
+			mask |= (x - ONE_BYTES) & ~x;
+		}
+		if (flags & CP_ASCII_ONLY)
+			mask |= word;
+		if (mask & HIGH_BITS)
+			break;
+	}
+
+	for (; i < len; ++i)
+		if (must_double(src[i], flags)
+		    || (src[i] >= 0x80 && (flags & CP_ASCII_ONLY)))
+			break;
+
+	return i;
+}
+
+/*
+ * Encodes `len' bytes of UTF-8 in `src' into the code page of `cc',
+ * writes the result to `dst', which must have room for `len' bytes,
+ * and returns its length, or -1 if a character cannot be encoded.
+ * Characters are looked up in the decoding tables one by one, which
+ * is meant for short literals only.
+ */
+ssize_t from_utf8(unsigned char *dst, const char *src, size_t len,
+		  const struct codec *cc)
+{
+	const unsigned char *s;
+	const unsigned char *end;
+	unsigned char *d;
+	size_t seq_len;
+	long code;
+
+	if (cc->cc_kind == CK_UTF16)
+		return -1;
+
+	s = (const unsigned char *)src;
+	end = s + len;
+	d = dst;
+	while (s < end) {
+		seq_len = utf8_seq_len(*s);
+		if (seq_len == 0 || seq_len > (size_t)(end - s))
+			return -1;
+		code = find_encoding(cc, s, seq_len);
+		if (code == -1)
+			return -1;
+		if (code >= BYTE_VALUES)
+			*d++ = (unsigned char)(code >> 8);
+		*d++ = (unsigned char)code;
+		s += seq_len;
+	}
+
+	return d - dst;
+}
+
+/* length of a UTF-8 sequence of a BMP character by its lead byte, or 0 */
+static size_t utf8_seq_len(unsigned char lead)
+{
+	if (lead < 0x80)
+		return 1;
+	if (lead >= 0xC2 && lead < 0xE0)
+		return 2;
+	if (lead >= 0xE0 && lead < 0xF0)
+		return 3;
+	return 0;
+}
+
+/*
+ * Returns the single or double-byte code of the character encoded as
+ * `seq' in UTF-8, or -1 if the code page has no such character.
+ */
+static long find_encoding(const struct codec *cc, const unsigned char *seq,
+			  size_t len)
+{
+	long lead;
+	long trail;
+
+	for (lead = 0; lead < BYTE_VALUES; ++lead)
+		if (seq_equals(&cc->cc_single[lead], seq, len))
+			return lead;
+	if (!cc->cc_double)
+		return -1;
+
+	for (lead = 0; lead < BYTE_VALUES; ++lead) {
+		if (cc->cc_single[lead].s_len != 0)
+			continue;
+		for (trail = 0; trail < BYTE_VALUES; ++trail)
+			if (seq_equals(&cc->cc_double[lead << 8 | trail], seq,
+				       len))
+				return lead << 8 | trail;
+	}
+
+	return -1;
+}
+
+/* whether `seq' holds the `len' bytes of `bytes' */
+static bool seq_equals(const struct u8seq *seq, const unsigned char *bytes,
+		       size_t len)
+{
+	return seq->s_len == len && memcmp(seq->s_byte, bytes, len) == 0;
+}
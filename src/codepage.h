@@ -0,0 +1,41 @@
+/*
+ * codepage.h - declarations of code page transcoding functions
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_CODEPAGE_H_
+#define IXFCVT_CODEPAGE_H_
+
+#include <sys/types.h>
+
+/* max number of UTF-8 bytes written per input byte, quotes doubled */
+#define U8_MAX_GROWTH 3
+
+/* flags of to_utf8() and plain_run_len() */
+#define CP_DOUBLE_QUOTE 0x01	/* double single quotes */
+#define CP_DOUBLE_BS 0x02	/* double backslashes */
+#define CP_ASCII_ONLY 0x04	/* stop at non-ASCII bytes */
+
+struct codec;
+
+const struct codec *find_codec(int code_page);
+char *to_utf8(char *dst, const unsigned char *src, size_t len,
+	      const struct codec *cc, int flags);
+size_t plain_run_len(const unsigned char *src, size_t len, int flags);
+ssize_t from_utf8(unsigned char *dst, const char *src, size_t len,
+		  const struct codec *cc);
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * convmain.c - reading and writing of the converters of --emit-converter
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Not compiled alone: the source written by `ixfcvt --emit-converter'
+ * defines the CONV_ constants of its table, includes this file, and then
+ * defines format_row().  The kernels are static
+ * functions of parse_d.c and d2sql.c, so those files are compiled into the
+ * converter rather than linked, as into microbench.
+ *
+ * The IXF file is read and the statements written in blocks of 1M rather
+ * than a record or a row at a time, and the converter refuses a file whose
+ * C records do not hash to CONV_DIGEST.
+ */
+
+#include "parse_d.c"
+#include "d2sql.c"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define REC_LEN_BYTES 6
+#define IXFDRID_OFFSET 1
+#define IXFDRID_BYTES 3
+#define IN_BUFF_SIZE (1 << 20)	/* bytes read at a time, at least */
+#define OUT_BUFF_SIZE (1 << 20)	/* bytes written at a time, about */
+#define OVERREAD_SLACK (0xFFFF * GRAPHIC_CHAR_BYTES)	/* longest value */
+#define MAX_INTEGER_LEN 20	/* -9223372036854775808 */
+#define COMMIT "commit;\n"
+
+static char *format_row(char *buff, const unsigned char *const *recs);
+/* not static, as a table may have no integer column to use it */
+char *put_integer(char *buff, long long value);
+static void init_codecs(void);
+static void build_insert_into(void);
+static void write_row(const unsigned char *const *recs);
+static const unsigned char *next_record(size_t *len);
+static size_t fill_input(size_t need);
+static void check_d_record_id(const unsigned char *rec, int expected);
+static void flush_output(void);
+
+static const char USAGE_INFO[] = "\
+Usage: %s [-o OFILE] IXFFILE\n\
+Converts <IXFFILE>, whose C records must be those the converter was\n\
+generated from, to INSERT statements written to <OFILE> or the standard\n\
+output\
+";
+
+static const size_t DREC_SIZES[CONV_NDREC] = CONV_DREC_SIZES;
+static const char TABLE_NAME[] = CONV_TABLE_NAME;
+static const char *const COLUMN_NAMES[CONV_NCOLS] = CONV_COLUMN_NAMES;
+/* of the values transcoded to UTF-8 of each column, 0 for none */
+static const int CODE_PAGES[CONV_NCOLS] = CONV_CODE_PAGES;
+
+static const struct codec *codecs[CONV_NCOLS];	/* of CODE_PAGES */
+
+static int in_fd;
+static unsigned char *in_buff;
+static size_t in_size;
+static size_t in_len;		/* bytes in `in_buff' */
+static size_t in_pos;		/* of the next record in `in_buff' */
+static size_t in_keep;		/* bytes from here on are kept by a fill */
+static int out_fd;
+static char *out_buff;
+static size_t out_len;
+static char *insert_into;	/* "INSERT INTO t (c1,c2) VALUES " */
+static size_t insert_len;
+static long txn_rows;		/* rows since the last COMMIT */
+static const char *begin;	/* starts a transaction, NULL if implicit */
+static size_t begin_len;
+
+int main(int argc, char *argv[])
+{
+	const char *ofile;
+	const unsigned char *recs[CONV_NDREC];
+	size_t offs[CONV_NDREC];	/* of the D records from `in_keep' */
+	const unsigned char *rec;
+	uint64_t digest;
+	bool checked;		/* digest compared */
+	size_t len;
+	int drid;
+	int c;
+
+	ofile = NULL;
+	while ((c = getopt(argc, argv, "o:h")) != -1) {
+		switch (c) {
+		case 'o':
+			ofile = optarg;
+			break;
+		case 'h':
+			usage(EXIT_SUCCESS, USAGE_INFO, argv[0]);
+			break;
+		default:
+			usage(EXIT_FAILURE, USAGE_INFO, argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(EXIT_FAILURE, USAGE_INFO, argv[0]);
+
+	in_fd = open_file(argv[optind], O_RDONLY, 0);
+	out_fd = ofile ? open_file(ofile, O_WRONLY | O_CREAT | O_TRUNC,
+				   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)
+	    : STDOUT_FILENO;
+	str_flags = CP_DOUBLE_QUOTE | (CONV_ESCBS ? CP_DOUBLE_BS : 0);
+	choose_literals(CONV_DIALECT);
+	begin = CONV_COMMIT_SIZE != 0 ? begin_statement(CONV_DIALECT) : NULL;
+	begin_len = begin ? strlen(begin) : 0;
+	init_codecs();
+	build_insert_into();
+
+	in_size = IN_BUFF_SIZE;
+	in_buff = alloc_buff(in_size + OVERREAD_SLACK);
+	/* a whole statement always fits after OUT_BUFF_SIZE bytes */
+	out_buff = alloc_buff(OUT_BUFF_SIZE + begin_len + insert_len
+			      + CONV_ROW_SIZE + strlen(";\n") + strlen(COMMIT)
+			      + 1);
+
+	digest = FNV1A_BASIS;
+	checked = false;
+	drid = 0;
+	for (;;) {
+		if (drid == 0)
+			in_keep = in_pos;	/* nothing of a row to keep */
+		if (!(rec = next_record(&len)))
+			break;
+
+		switch (*rec) {
+		case 'H':
+		case 'T':
+		case 'A':
+			break;
+		case 'C':
+			digest = fnv1a_hash(digest, rec, len);
+			break;
+		case 'D':
+			if (!checked && digest != CONV_DIGEST)
+				fmt_err_exit("%s: not the table the converter "
+					     "was generated for", argv[optind]);
+			checked = true;
+			if (CONV_NDREC > 1)
+				check_d_record_id(rec, drid + 1);
+			if (len < DREC_SIZES[drid])
+				fmt_err_exit("D record %d too short: %lu bytes",
+					     drid + 1, (unsigned long)len);
+			offs[drid] = (size_t)(rec - in_buff) - in_keep;
+			if (++drid < CONV_NDREC)
+				break;
+
+			/* a fill may have moved the records of the row */
+			for (drid = 0; drid < CONV_NDREC; ++drid)
+				recs[drid] = in_buff + in_keep + offs[drid];
+			drid = 0;
+			write_row(recs);
+			break;
+		default:
+			fmt_err_exit("Unknown record type encountered: %c",
+				     *rec);
+		}
+	}
+	if (drid != 0)
+		fmt_err_exit("%s", "Incomplete row at the end of input file");
+	if (!checked && digest != CONV_DIGEST)
+		fmt_err_exit("%s: not the table the converter was generated "
+			     "for", argv[optind]);
+
+	if (CONV_COMMIT_SIZE != 0 && txn_rows > 0) {
+		memcpy(out_buff + out_len, COMMIT, strlen(COMMIT));
+		out_len += strlen(COMMIT);
+	}
+	flush_output();
+
+	close_file(in_fd);
+	if (out_fd != STDOUT_FILENO)
+		close_file(out_fd);
+	free_buff(in_buff);
+	free_buff(out_buff);
+	free_buff(insert_into);
+
+	return 0;
+}
+
+/* find the transcoders of CODE_PAGES, exits if one is missing */
+static void init_codecs(void)
+{
+	int i;
+
+	for (i = 0; i < CONV_NCOLS; ++i) {
+		if (CODE_PAGES[i] == 0)
+			continue;
+		codecs[i] = find_codec(CODE_PAGES[i]);
+		if (!codecs[i])
+			fmt_err_exit("No transcoder of code page %d",
+				     CODE_PAGES[i]);
+	}
+}
+
+/* write `value' to `buff' as "%lld" does, returns the end of it */
+char *put_integer(char *buff, long long value)
+{
+	char digits[MAX_INTEGER_LEN];
+	unsigned long long mag;
+	char *p;
+
+	if (value < 0) {
+		*buff++ = '-';
+		mag = 0ULL - (unsigned long long)value;
+	} else {
+		mag = (unsigned long long)value;
+	}
+
+	p = digits + sizeof(digits);
+	do {
+		*--p = (char)('0' + mag % 10);
+		mag /= 10;
+	} while (mag > 0);
+
+	memcpy(buff, p, (size_t)(digits + sizeof(digits) - p));
+	return buff + (digits + sizeof(digits) - p);
+}
+
+/* make `insert_into' from the names of the table and its columns */
+static void build_insert_into(void)
+{
+	char *p;
+	int i;
+
+	insert_len = strlen("INSERT INTO ") + strlen(TABLE_NAME)
+	    + strlen(" () VALUES ");
+	for (i = 0; i < CONV_NCOLS; ++i)
+		insert_len += strlen(COLUMN_NAMES[i]) + (i > 0);
+	insert_into = alloc_buff(insert_len + 1);
+
+	p = insert_into + sprintf(insert_into, "INSERT INTO %s (", TABLE_NAME);
+	for (i = 0; i < CONV_NCOLS; ++i)
+		p += sprintf(p, "%s%s", i > 0 ? "," : "", COLUMN_NAMES[i]);
+	strcpy(p, ") VALUES ");
+}
+
+/*
+ * Adds the INSERT statement of the row in D records `recs' to the output,
+ * and a COMMIT statement every CONV_COMMIT_SIZE rows, each transaction
+ * begun as the dialect needs.
+ */
+static void write_row(const unsigned char *const *recs)
+{
+	char *p;
+
+	p = out_buff + out_len;
+	if (begin && txn_rows == 0) {
+		memcpy(p, begin, begin_len);
+		p += begin_len;
+	}
+	memcpy(p, insert_into, insert_len);
+	p = format_row(p + insert_len, recs);
+	*p++ = ';';
+	*p++ = '\n';
+	if (CONV_COMMIT_SIZE != 0 && ++txn_rows == CONV_COMMIT_SIZE) {
+		memcpy(p, COMMIT, strlen(COMMIT));
+		p += strlen(COMMIT);
+		txn_rows = 0;
+	}
+
+	out_len = (size_t)(p - out_buff);
+	if (out_len >= OUT_BUFF_SIZE)
+		flush_output();
+}
+
+/*
+ * Returns the next record of the IXF file, of `len' bytes after its
+ * length, or NULL at the end of the file.  It stays in `in_buff' until
+ * the next call, which may move the bytes from `in_keep' on.
+ */
+static const unsigned char *next_record(size_t *len)
+{
+	char digits[REC_LEN_BYTES + 1];
+	const unsigned char *rec;
+	size_t avail;
+	long rec_len;
+
+	avail = fill_input(REC_LEN_BYTES);
+	if (avail == 0)
+		return NULL;
+	if (avail < REC_LEN_BYTES)
+		fmt_err_exit("%s", "Error reading input file");
+
+	memcpy(digits, in_buff + in_pos, REC_LEN_BYTES);
+	digits[REC_LEN_BYTES] = '\0';
+	rec_len = str_to_long(digits);
+	if (rec_len <= 0)
+		return NULL;	/* as the end of the file, like ixfcvt */
+	*len = (size_t)rec_len;
+
+	if (fill_input(REC_LEN_BYTES + *len) < REC_LEN_BYTES + *len)
+		fmt_err_exit("%s", "Error reading input file");
+	rec = in_buff + in_pos + REC_LEN_BYTES;
+	in_pos += REC_LEN_BYTES + *len;
+
+	return rec;
+}
+
+/*
+ * Reads the IXF file until `need' bytes from `in_pos' are in `in_buff' or
+ * the file ends, and returns the bytes there are.  The bytes before
+ * `in_keep' make room for it first, and then the buffer grows.
+ */
+static size_t fill_input(size_t need)
+{
+	ssize_t n_read;
+
+	if (in_len - in_pos >= need)
+		return in_len - in_pos;
+
+	memmove(in_buff, in_buff + in_keep, in_len - in_keep);
+	in_len -= in_keep;
+	in_pos -= in_keep;
+	in_keep = 0;
+	if (in_pos + need > in_size) {
+		in_size = (in_pos + need) * 2;
+		in_buff = resize_buff(in_buff, in_size + OVERREAD_SLACK);
+	}
+
+	while (in_len - in_pos < need) {
+		n_read = read(in_fd, in_buff + in_len, in_size - in_len);
+		if (n_read == -1)
+			err_exit("read");
+		if (n_read == 0)
+			break;
+		in_len += (size_t)n_read;
+	}
+
+	return in_len - in_pos;
+}
+
+/* exit unless D record `rec' is the `expected'th of its row */
+static void check_d_record_id(const unsigned char *rec, int expected)
+{
+	char buff[IXFDRID_BYTES + 1];
+	long drid;
+
+	memcpy(buff, rec + IXFDRID_OFFSET, IXFDRID_BYTES);
+	buff[IXFDRID_BYTES] = '\0';
+	drid = str_to_long(buff);
+	if (drid != expected)
+		fmt_err_exit("D record %ld found where %d expected", drid,
+			     expected);
+}
+
+/* write the statements in `out_buff' */
+static void flush_output(void)
+{
+	write_bytes(out_fd, out_buff, out_len);
+	out_len = 0;
+}
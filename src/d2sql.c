@@ -19,95 +19,523 @@
 #include <float.h>
 #include <stdio.h>
 #include <string.h>
-#include <unistd.h>
 
+#include "codepage.h"
+#include "hex.h"
 #include "ixfcvt.h"
 #include "parse_d.h"
+#include "stats.h"
 #include "util.h"
 
+/*
+ * With --memoize, the SQL text of the values of each column selected
+ * whose values are short is kept in a table by their bytes, so that a
+ * value seen before is copied instead of formatted again. A value goes
+ * to the slot of its hash, in place of the one there. A column whose
+ * values hit the table less than half of the time is no longer cached.
+ */
+#define MEMO_SLOTS 4096		/* values cached of a column, a power of 2 */
+#define MEMO_MAX_KEY 32		/* bytes of a value cached, at most */
+#define MEMO_MAX_TEXT 64	/* and of its SQL text */
+#define MEMO_BUDGET (16UL << 20)	/* bytes of the tables of all columns */
+#define MEMO_WINDOW 65536	/* lookups between checks of the hit rate */
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+#define TIMESTAMP_INT_LEN 20	/* characters before the fraction */
+#define ORACLE_MAX_FRACTION 9	/* digits of FF9 */
+
+/* the SQL text of values of a column of --memoize */
+struct memo {
+	size_t m_key_size;	/* bytes of each slot of `m_keys' */
+	size_t m_text_size;	/* bytes of each slot of `m_texts' */
+	unsigned char *m_keys;	/* bytes of the values */
+	char *m_texts;		/* their SQL text */
+	unsigned char *m_key_lens;
+	unsigned char *m_text_lens;	/* 0 for an empty slot */
+	long m_lookups;		/* since the last check of the hit rate */
+	long m_hits;
+};
+
+/*
+ * The rows of an output partition are written as INSERT statements of up
+ * to --insert-rows rows and --insert-bytes bytes, and a COMMIT follows
+ * every -s rows or --commit-bytes bytes, whichever comes first. A
+ * statement is left open for the next row until it is full, and closed
+ * before a COMMIT.
+ */
+struct batch {
+	long b_rows;		/* rows of the INSERT statement open, 0 if none */
+	size_t b_bytes;		/* bytes of it so far */
+	long b_txn_rows;	/* rows and statements since the last COMMIT */
+	size_t b_txn_bytes;	/* bytes of them */
+	bool b_begun;		/* transaction begun since the last COMMIT */
+};
+
 static void init_static_args(const struct summary *sum,
 			     const struct table_desc *tbl);
 static void dispose_static_buffs(void);
+static bool count_statement(int ofd, int part, size_t len,
+			    const struct summary *sum);
+static bool commit_due(const struct batch *bt, size_t len,
+		       const struct summary *sum);
+static void close_statement(int ofd, int part);
+static void begin_transaction(int ofd, struct batch *bt);
+static const char *begin_statement(enum sql_dialect dialect);
+static bool statement_full(const struct batch *bt, size_t len,
+			   const struct summary *sum);
+static void init_statement_texts(const struct summary *sum);
 static size_t insert_into_clause_size(const struct table_desc *tbl);
+static size_t diff_statement_size(const struct table_desc *tbl);
+static char *fill_in_key_condition(char *buff,
+				   const unsigned char *const *recs);
+static bool same_value(const unsigned char *const *a,
+		       const unsigned char *const *b,
+		       const struct column_desc *col);
 static void gen_insert_into_clause(char *buff, const struct table_desc *tbl);
 static size_t max_d_values_size(const struct table_desc *tbl);
-static size_t col_value_size(const struct column_desc *col);
-static void fill_in_values(char *buff, const unsigned char *rec,
-			   const struct column_desc *col_head,
-			   struct column_desc **colptr);
+static char *fill_in_values(char *buff, const unsigned char *const *recs,
+			   const struct table_desc *tbl);
 static char *fill_in_a_value(char *buff, const unsigned char *src,
 			     const struct column_desc *col);
-static char *write_as_sql_str(char *buff, const unsigned char *src, size_t len);
+static char *fill_in_column(char *buff, const unsigned char *const *recs,
+			    const struct column_desc *col, int i);
+static void init_memos(const struct table_desc *tbl);
+static void free_memo(struct memo *memo);
+static char *write_as_sql_str(char *buff, const unsigned char *src, size_t len,
+			      const struct codec *cc);
+static char *write_as_hex(char *buff, const unsigned char *src, size_t len);
+static char *write_as_datetime(char *buff, const unsigned char *src, int type,
+			       size_t len);
+static char *write_oracle_datetime(char *buff, const unsigned char *src,
+				   int type, size_t len);
+static void iso_time(char *hms);
+static char *write_as_decfloat(char *buff, const unsigned char *src,
+			       size_t bytes);
 
 static char *restrict insert_into_clause;
-static char *restrict values_buff;
-static size_t values_buff_size;
-static bool escape_backslash;
+static char *stmt_open;		/* starts an INSERT statement */
+static char *stmt_sep;		/* between its rows */
+static const char *stmt_close;	/* ends it */
+static const char *txn_begin;	/* starts a transaction, NULL if implicit */
+static size_t open_len;
+static size_t sep_len;
+static size_t close_len;
+static char *restrict values_buff;	/* an INSERT statement and values */
+static char *values_start;	/* values part of `values_buff' */
+static int str_flags;		/* flags of to_utf8() and plain_run_len() */
+static const char *hex_prefix;	/* e.g. "X'" of X'0A1B' */
+static const char *hex_suffix;
+static size_t hex_prefix_len;
+static size_t hex_suffix_len;
+static enum sql_dialect datetime_dialect;	/* of DATE, TIME, TIMESTAMP */
+static size_t datetime_wrapper_len;	/* e.g. TO_DATE(,'YYYY-MM-DD') */
+static bool decfloat_quoted;	/* DECFLOAT as strings, not numbers */
+static struct batch *batches;	/* of each output partition */
+static int nparts;
+static const struct column_desc **keys;	/* identify the rows of --diff */
+static int nkeys;
+static char *diff_buff;		/* an UPDATE or DELETE statement */
+static struct memo **memos;	/* of each column selected, NULL for none */
+static int nmemos;
 
-/* convert a D record to (part of) an INSERT statement */
-void d_record_to_sql(int ofd, const unsigned char *rec,
-		     const struct summary *sum, const struct table_desc *tbl)
+/*
+ * Converts the D records of a row to an INSERT statement of output
+ * partition `part' (0 if not partitioned), written to `ofd'. Returns true
+ * if a COMMIT statement followed it.
+ */
+bool row_to_sql(int ofd, int part, const unsigned char *const *recs,
+		const struct summary *sum, const struct table_desc *tbl)
 {
-	static struct column_desc *col = NULL;
-	static long recs = 0L;
-	static long rows = 0L;
+	struct batch *bt;
+	char *start;
+	char *end;
+	bool closed;
 
-	if (recs == 0L)
+	if (!values_buff)
 		init_static_args(sum, tbl);
 
-	/* a new row */
-	if (!col) {
-		col = tbl->c_head;
-		write_file(ofd, insert_into_clause);
-		++rows;
+	bt = &batches[part];
+	end = fill_in_values(values_start, recs, tbl);
+	closed = bt->b_rows > 0
+	    && statement_full(bt, (size_t)(end - values_start), sum);
+
+	/* the text joining the row to the statement goes right before it */
+	start = values_start;
+	if (bt->b_rows > 0 && !closed) {
+		start -= sep_len;
+		memcpy(start, stmt_sep, sep_len);
+	} else {
+		start -= open_len;
+		memcpy(start, stmt_open, open_len);
+		bt->b_bytes = 0;
+		bt->b_rows = 0;
+	}
+	bt->b_bytes += (size_t)(end - start);
+	++bt->b_rows;
+	if (closed) {
+		start -= close_len;
+		memcpy(start, stmt_close, close_len);
 	}
 
-	/* output values of a D record */
-	memset(values_buff, 0x00, values_buff_size);
-	fill_in_values(values_buff, rec, tbl->c_head, &col);
-	write_file(ofd, values_buff);
-	++recs;
+	if (bt->b_rows == sum->s_insert_rows
+	    || commit_due(bt, (size_t)(end - start) + close_len, sum)) {
+		memcpy(end, stmt_close, close_len);
+		end += close_len;
+		bt->b_rows = 0;
+	}
+	begin_transaction(ofd, bt);
+	write_bytes(ofd, start, (size_t)(end - start));
+
+	return count_statement(ofd, part, (size_t)(end - start), sum);
+}
+
+/*
+ * Writes an UPDATE statement to `ofd' setting the columns selected in
+ * `tbl' whose values differ between rows `old' and `recs' to those of
+ * `recs', for --diff. Returns false, writing nothing, if none differs.
+ */
+bool update_to_sql(int ofd, const unsigned char *const *old,
+		   const unsigned char *const *recs,
+		   const struct summary *sum, const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	char *buff;
+	int i;
+
+	if (!values_buff)
+		init_static_args(sum, tbl);
+
+	buff = diff_buff + sprintf(diff_buff, "UPDATE %s SET ", tbl->t_name);
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
+		if (same_value(old, recs, col))
+			continue;
+		buff += sprintf(buff, "%s=", col->c_name);
+		buff = fill_in_a_value(buff, recs[col->c_drid - 1]
+				       + IXFDCOLS_OFFSET + col->c_offset, col);
+		*buff++ = ',';
+	}
+	if (buff[-1] != ',')
+		return false;	/* nothing changed */
+
+	buff = fill_in_key_condition(buff - 1, recs);
+	strcpy(buff, ";\n");
+	buff += strlen(";\n");
+	close_statement(ofd, 0);
+	begin_transaction(ofd, &batches[0]);
+	write_bytes(ofd, diff_buff, (size_t)(buff - diff_buff));
+	count_statement(ofd, 0, (size_t)(buff - diff_buff), sum);
+
+	return true;
+}
+
+/* write a DELETE statement of row `recs' to `ofd', for --diff */
+void delete_to_sql(int ofd, const unsigned char *const *recs,
+		   const struct summary *sum, const struct table_desc *tbl)
+{
+	char *buff;
+
+	if (!values_buff)
+		init_static_args(sum, tbl);
 
-	if (ofd != STDOUT_FILENO)
-		show_progress(recs, sum->s_dcnt);
+	buff = diff_buff + sprintf(diff_buff, "DELETE FROM %s", tbl->t_name);
+	buff = fill_in_key_condition(buff, recs);
+	strcpy(buff, ";\n");
+	buff += strlen(";\n");
+	close_statement(ofd, 0);
+	begin_transaction(ofd, &batches[0]);
+	write_bytes(ofd, diff_buff, (size_t)(buff - diff_buff));
+	count_statement(ofd, 0, (size_t)(buff - diff_buff), sum);
+}
+
+/*
+ * count a row or statement of `len' bytes written to `ofd' of output
+ * partition `part', and output a COMMIT statement if necessary, returns
+ * true if it did
+ */
+static bool count_statement(int ofd, int part, size_t len,
+			    const struct summary *sum)
+{
+	struct batch *bt;
 
-	/* output a COMMIT statement if necessary */
-	if (!col && sum->s_cmtsz != 0
-	    && (rows == sum->s_cmtsz || recs == sum->s_dcnt)) {
+	bt = &batches[part];
+	if (commit_due(bt, len, sum)) {
 		write_file(ofd, "commit;\n");
-		rows = 0;
+		bt->b_txn_rows = 0;
+		bt->b_txn_bytes = 0;
+		bt->b_begun = false;
+		return true;
 	}
 
-	if (recs == sum->s_dcnt)
-		dispose_static_buffs();
+	++bt->b_txn_rows;
+	bt->b_txn_bytes += len;
+	return false;
+}
+
+/* tell whether a COMMIT is due after a row of `len' more bytes */
+static bool commit_due(const struct batch *bt, size_t len,
+		       const struct summary *sum)
+{
+	return (sum->s_cmtsz != 0 && bt->b_txn_rows + 1 >= sum->s_cmtsz)
+	    || (sum->s_commit_bytes != 0
+		&& bt->b_txn_bytes + len >= sum->s_commit_bytes);
+}
+
+/* tell whether a row of `len' bytes is too long for the statement open */
+static bool statement_full(const struct batch *bt, size_t len,
+			   const struct summary *sum)
+{
+	return sum->s_insert_bytes != 0
+	    && bt->b_bytes + sep_len + len + close_len > sum->s_insert_bytes;
+}
+
+/* end the INSERT statement left open in `ofd' of partition `part' */
+static void close_statement(int ofd, int part)
+{
+	struct batch *bt;
+
+	bt = &batches[part];
+	if (bt->b_rows == 0)
+		return;
+
+	write_bytes(ofd, stmt_close, close_len);
+	bt->b_txn_bytes += close_len;
+	bt->b_rows = 0;
+}
+
+/* start a transaction in `ofd' of batch `bt' before its first statement */
+static void begin_transaction(int ofd, struct batch *bt)
+{
+	if (!txn_begin || bt->b_begun)
+		return;
+
+	write_file(ofd, txn_begin);
+	bt->b_begun = true;
+}
+
+/*
+ * Returns the statement that starts a transaction in `dialect', or NULL
+ * if one starts by itself. Their clients commit each statement otherwise,
+ * and SQLite fails a COMMIT outside of a transaction.
+ */
+static const char *begin_statement(enum sql_dialect dialect)
+{
+	switch (dialect) {
+	case SQL_POSTGRESQL:
+	case SQL_SQLITE:
+		return "begin;\n";
+	case SQL_MYSQL:
+		return "start transaction;\n";
+	default:
+		return NULL;	/* DB2 and Oracle */
+	}
 }
 
 /*
- * initialize file scope static variables
- * read out whether to escape backslashes, allocate memory
- * for buffers, build an INSERT INTO clause
+ * commit the rows output since the last COMMIT to each output `ofds'
+ * (one for each partition), after the last row
  */
+void finish_sql(const int *ofds, const struct summary *sum)
+{
+	int i;
+
+	if (!values_buff)
+		return;		/* no row output */
+
+	for (i = 0; i < nparts; ++i) {
+		close_statement(ofds[i], i);
+		if ((sum->s_cmtsz != 0 || sum->s_commit_bytes != 0)
+		    && batches[i].b_txn_rows > 0)
+			write_file(ofds[i], "commit;\n");
+	}
+
+	dispose_static_buffs();
+}
+
 static void init_static_args(const struct summary *sum,
 			     const struct table_desc *tbl)
 {
-	size_t size;
+	size_t clause_size;
 
-	escape_backslash = sum->s_escbs;
+	reject_xml(tbl);
+	str_flags = CP_DOUBLE_QUOTE | (sum->s_escbs ? CP_DOUBLE_BS : 0);
+	nparts = sum->s_nparts > 0 ? sum->s_nparts : 1;
+	batches = alloc_buff((size_t) nparts * sizeof(*batches));
+	memset(batches, 0, (size_t) nparts * sizeof(*batches));
+	choose_literals(sum->s_dialect);
+	/* without a COMMIT, each statement commits by itself */
+	txn_begin = sum->s_cmtsz != 0 || sum->s_commit_bytes != 0
+	    ? begin_statement(sum->s_dialect) : NULL;
 
-	size = insert_into_clause_size(tbl);
-	insert_into_clause = alloc_buff(size);
+	clause_size = insert_into_clause_size(tbl);
+	insert_into_clause = alloc_buff(clause_size);
 	gen_insert_into_clause(insert_into_clause, tbl);
+	init_statement_texts(sum);
+
+	/*
+	 * a row is written at a time, after the end of the statement before
+	 * it and the start of its own, and followed by its end
+	 */
+	values_buff = alloc_buff(close_len + open_len + max_d_values_size(tbl)
+				 + close_len);
+	values_start = values_buff + close_len + open_len;
+
+	if (sum->s_diff_fd >= 0) {
+		keys = select_key(tbl, sum->s_skey, &nkeys);
+		diff_buff = alloc_buff(diff_statement_size(tbl));
+	}
+	if (sum->s_memoize)
+		init_memos(tbl);
+}
+
+/*
+ * exit if an XML column is selected: a D record holds only the XML data
+ * specifier of its document, not the document
+ */
+void reject_xml(const struct table_desc *tbl)
+{
+	int i;
+
+	for (i = 0; i < tbl->t_nsel; ++i)
+		if (tbl->t_sel[i]->c_type == XML)
+			fmt_err_exit(E_XML_COLUMN, tbl->t_sel[i]->c_name);
+}
+
+/* make a table for each column selected whose values are short enough */
+static void init_memos(const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	struct memo *memo;
+	size_t budget;
+	int i;
+
+	nmemos = tbl->t_nsel;
+	memos = alloc_buff((size_t) nmemos * sizeof(*memos));
+	budget = MEMO_BUDGET;
+	for (i = 0; i < nmemos; ++i) {
+		memos[i] = NULL;
+		col = tbl->t_sel[i];
+		if (column_span(col) > MEMO_MAX_KEY
+		    || col_value_size(col) > MEMO_MAX_TEXT)
+			continue;
+
+		memo = alloc_buff(sizeof(*memo));
+		memo->m_key_size = column_span(col);
+		memo->m_text_size = col_value_size(col);
+		if (MEMO_SLOTS * (memo->m_key_size + memo->m_text_size + 2)
+		    > budget) {
+			free_buff(memo);
+			continue;
+		}
+		budget -= MEMO_SLOTS * (memo->m_key_size
+					+ memo->m_text_size + 2);
+
+		memo->m_keys = alloc_buff(MEMO_SLOTS * memo->m_key_size);
+		memo->m_texts = alloc_buff(MEMO_SLOTS * memo->m_text_size);
+		memo->m_key_lens = alloc_buff(MEMO_SLOTS);
+		memo->m_text_lens = alloc_buff(MEMO_SLOTS);
+		memset(memo->m_text_lens, 0, MEMO_SLOTS);
+		memo->m_lookups = memo->m_hits = 0L;
+		memos[i] = memo;
+	}
+}
+
+static void free_memo(struct memo *memo)
+{
+	free_buff(memo->m_keys);
+	free_buff(memo->m_texts);
+	free_buff(memo->m_key_lens);
+	free_buff(memo->m_text_lens);
+	free_buff(memo);
+}
+
+/* choose the form of binary string and date/time literals of `dialect' */
+void choose_literals(enum sql_dialect dialect)
+{
+	switch (dialect) {
+	case SQL_POSTGRESQL:
+		hex_prefix = "'\\x";
+		hex_suffix = "'";
+		break;
+	case SQL_ORACLE:
+		hex_prefix = "HEXTORAW('";
+		hex_suffix = "')";
+		break;
+	default:
+		hex_prefix = "X'";
+		hex_suffix = "'";
+		break;
+	}
+	hex_prefix_len = strlen(hex_prefix);
+	hex_suffix_len = strlen(hex_suffix);
 
-	size = max_d_values_size(tbl);
-	values_buff = alloc_buff(size);
-	values_buff_size = size;
+	datetime_dialect = dialect;
+	datetime_wrapper_len = dialect == SQL_ORACLE
+	    ? strlen("TO_TIMESTAMP(,'YYYY-MM-DD-HH24.MI.SS.FF9')") : 0;
+	/* a VARCHAR of MySQL, which reads a number as a DOUBLE */
+	decfloat_quoted = dialect == SQL_MYSQL;
 }
 
-/* free buffers `insert_into_clause' and `values_buff' */
+/*
+ * free buffers `insert_into_clause', `values_buff', `rows', the keys and
+ * the memos
+ */
 static void dispose_static_buffs(void)
 {
+	int i;
+
+	for (i = 0; i < nmemos; ++i)
+		if (memos[i])
+			free_memo(memos[i]);
+	free_buff(memos);
+	memos = NULL;
+	nmemos = 0;
+
 	free_buff(insert_into_clause);
+	free_buff(stmt_open);
+	free_buff(stmt_sep);
 	free_buff(values_buff);
+	free_buff(batches);
+	free_buff(keys);
+	free_buff(diff_buff);
+	insert_into_clause = NULL;
+	stmt_open = NULL;
+	stmt_sep = NULL;
+	values_buff = NULL;
+	batches = NULL;
+	keys = NULL;
+	diff_buff = NULL;
+	nkeys = 0;
+}
+
+/*
+ * Makes the texts starting, joining the rows of and ending an INSERT
+ * statement: "INSERT INTO t (c) VALUES (...),\n(...);\n", or for Oracle
+ * "INSERT ALL\nINTO t (c) VALUES (...)\nINTO t (c) VALUES (...)\n
+ * SELECT 1 FROM DUAL;\n" when a statement may have more than one row.
+ */
+static void init_statement_texts(const struct summary *sum)
+{
+	const char *into;
+
+	/* "INTO t (c) VALUES " of the INSERT INTO clause */
+	into = insert_into_clause + strlen("INSERT ");
+	if (sum->s_dialect == SQL_ORACLE && sum->s_insert_rows != 1) {
+		stmt_open = alloc_buff(strlen("INSERT ALL\n") + strlen(into) + 1);
+		sprintf(stmt_open, "INSERT ALL\n%s", into);
+		stmt_sep = alloc_buff(strlen("\n") + strlen(into) + 1);
+		sprintf(stmt_sep, "\n%s", into);
+		stmt_close = "\nSELECT 1 FROM DUAL;\n";
+	} else {
+		stmt_open = alloc_buff(strlen(insert_into_clause) + 1);
+		strcpy(stmt_open, insert_into_clause);
+		stmt_sep = alloc_buff(strlen(",\n") + 1);
+		strcpy(stmt_sep, ",\n");
+		stmt_close = ";\n";
+	}
+	open_len = strlen(stmt_open);
+	sep_len = strlen(stmt_sep);
+	close_len = strlen(stmt_close);
 }
 
 /* calculate and return the required size of buffer `insert_into_clause' */
@@ -116,13 +544,13 @@ static size_t insert_into_clause_size(const struct table_desc *tbl)
 	const size_t COMMA_LEN = 1;
 	const size_t NULL_TERM_LEN = 1;
 	size_t size;
-	const struct column_desc *col;
+	int i;
 
 	size = strlen("INSERT INTO ");
 	size += strlen(tbl->t_name);
 	size += strlen(" (");
-	for (col = tbl->c_head; col; col = col->next)
-		size += strlen(col->c_name) + COMMA_LEN;
+	for (i = 0; i < tbl->t_nsel; ++i)
+		size += strlen(tbl->t_sel[i]->c_name) + COMMA_LEN;
 	size += strlen(" VALUES ");
 	size += NULL_TERM_LEN;
 
@@ -136,10 +564,12 @@ static size_t insert_into_clause_size(const struct table_desc *tbl)
 static void gen_insert_into_clause(char *buff, const struct table_desc *tbl)
 {
 	const struct column_desc *col;
+	int i;
 
 	buff += sprintf(buff, "INSERT INTO %s (", tbl->t_name);
 
-	for (col = tbl->c_head; col; col = col->next) {
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
 		strcpy(buff, col->c_name);
 		buff += strlen(col->c_name);
 		*buff++ = ',';
@@ -149,49 +579,129 @@ static void gen_insert_into_clause(char *buff, const struct table_desc *tbl)
 	strcpy(--buff, ") VALUES ");
 }
 
-/* calculate and return max size of a string representation of a D record */
+/*
+ * calculate and return the required size of buffer `diff_buff', for an
+ * UPDATE statement of all the columns selected, the longer of the two
+ */
+static size_t diff_statement_size(const struct table_desc *tbl)
+{
+	const size_t NULL_LEN = 4;	/* a null as a value or "IS NULL" */
+	size_t size;
+	int i;
+
+	size = strlen("UPDATE ") + strlen(tbl->t_name) + strlen(" SET ");
+	for (i = 0; i < tbl->t_nsel; ++i)
+		size += strlen(tbl->t_sel[i]->c_name) + strlen("=,")
+		    + col_value_size(tbl->t_sel[i]) + NULL_LEN;
+	size += strlen(" WHERE ");
+	for (i = 0; i < nkeys; ++i)
+		size += strlen(keys[i]->c_name) + strlen(" IS NULL AND ")
+		    + col_value_size(keys[i]) + NULL_LEN;
+
+	return size + strlen(";\n") + 1;
+}
+
+/*
+ * write the WHERE clause matching the key of row `recs' to `buff', i.e.
+ * " WHERE key1=val1 AND key2 IS NULL", returns a pointer to its end
+ */
+static char *fill_in_key_condition(char *buff,
+				   const unsigned char *const *recs)
+{
+	const unsigned char *src;
+	const struct column_desc *col;
+	int i;
+
+	buff += sprintf(buff, " WHERE ");
+	for (i = 0; i < nkeys; ++i) {
+		if (i > 0)
+			buff += sprintf(buff, " AND ");
+		col = keys[i];
+		src = recs[col->c_drid - 1] + IXFDCOLS_OFFSET + col->c_offset;
+		if (col->c_nullable && column_is_null(src)) {
+			buff += sprintf(buff, "%s IS NULL", col->c_name);
+		} else {
+			buff += sprintf(buff, "%s=", col->c_name);
+			buff = fill_in_a_value(buff, src, col);
+		}
+	}
+
+	return buff;
+}
+
+/* Return true if the values of `col' in rows `a' and `b' are the same. */
+static bool same_value(const unsigned char *const *a,
+		       const unsigned char *const *b,
+		       const struct column_desc *col)
+{
+	const unsigned char *val_a;
+	const unsigned char *val_b;
+	size_t len;
+
+	len = column_value(a, col, &val_a);
+	if (column_value(b, col, &val_b) != len || !val_a != !val_b)
+		return false;
+
+	return !val_a || memcmp(val_a, val_b, len) == 0;
+}
+
+/* calculate and return max size of a string representation of a row */
 static size_t max_d_values_size(const struct table_desc *tbl)
 {
 	const size_t COMMA_LEN = 1;
 	const size_t WRAPPER_LEN = 4;
-	size_t max;
 	size_t size;
-	const struct column_desc *col;
+	int i;
 
-	max = 0;
 	size = 0;
-	for (col = tbl->c_head; col; col = col->next) {
-		size += col_value_size(col) + COMMA_LEN;
-		if (!col->next || col->next->c_offset == 0) {
-			max = size > max ? size : max;
-			size = 0;
-		}
-	}
+	for (i = 0; i < tbl->t_nsel; ++i)
+		size += col_value_size(tbl->t_sel[i]) + COMMA_LEN;
 
-	return max + WRAPPER_LEN;
+	return size + WRAPPER_LEN;
 }
 
 /* return size of the string representation of column pointed to by `col' */
-static size_t col_value_size(const struct column_desc *col)
+size_t col_value_size(const struct column_desc *col)
 {
 	const size_t SIGN_LEN = 1;
+	const size_t POINT_LEN = 1;
+	const size_t ZERO_LEN = 1;	/* before the point of DECIMAL(p,p) */
+	const size_t NUL_LEN = 1;	/* ends a decimal until squeezed */
 	const size_t SINGLE_QUOTES_LEN = 2;
+	const size_t QUOTE_DOUBLING = 2;
+	const size_t HEX_WRAPPER_LEN = 12;	/* HEXTORAW('') */
 	const size_t SMALLINT_STR_LEN = 6;	/* -32768 */
 	const size_t INTEGER_STR_LEN = 11;	/* -2147483648 */
 	const size_t BIGINT_STR_LEN = 20;	/* -9223372036854775808 */
 	const size_t REAL_STR_LEN = FLT_DIG + 6;	/* -d.d{FLT_DIG-1}E+dd */
 	const size_t DOUBLE_STR_LEN = DBL_DIG + 7;	/* -d.d{DBL_DIG-1}E+ddd */
+	const size_t DECFLOAT_EXTRA_LEN = 14;	/* -0.00000 or -.E+dddd, '' */
 
 	size_t size;
 
 	size = 0;
+	if (col->c_bitdata)
+		return col->c_len * HEX_DIGITS_PER_BYTE + HEX_WRAPPER_LEN;
+
 	switch (col->c_type) {
 	case CHAR:
 	case VARCHAR:
+	case LONG_VARCHAR:
+		size = col->c_len * (col->c_codec ? U8_MAX_GROWTH :
+				     QUOTE_DOUBLING) + SINGLE_QUOTES_LEN;
+		break;
+	case GRAPHIC:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		size = col->c_len * GRAPHIC_CHAR_BYTES *
+		    (col->c_codec ? U8_MAX_GROWTH : QUOTE_DOUBLING) +
+		    SINGLE_QUOTES_LEN;
+		break;
 	case DATE:
 	case TIME:
 	case TIMESTAMP:
-		size = col->c_len + SINGLE_QUOTES_LEN;
+		size = col->c_len * QUOTE_DOUBLING + SINGLE_QUOTES_LEN
+		    + datetime_wrapper_len;
 		break;
 	case SMALLINT:
 		size = SMALLINT_STR_LEN;
@@ -203,11 +713,16 @@ static size_t col_value_size(const struct column_desc *col)
 		size = BIGINT_STR_LEN;
 		break;
 	case DECIMAL:
-		size = col->c_len / 100 + SIGN_LEN;
+		/* every nibble is a digit before the zeros are squeezed */
+		size = (col->c_len / 100 + 2) / 2 * 2 - 1 + SIGN_LEN
+		    + ZERO_LEN + POINT_LEN + NUL_LEN;
 		break;
 	case FLOATING_POINT:
 		size = col->c_len == 4 ? REAL_STR_LEN : DOUBLE_STR_LEN;
 		break;
+	case DECFLOAT:
+		size = col->c_len + DECFLOAT_EXTRA_LEN;
+		break;
 	default:
 		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
 	}
@@ -216,37 +731,101 @@ static size_t col_value_size(const struct column_desc *col)
 }
 
 /*
- * Converts a D record to a string of row values, i.e.
- * "(val1,val2,...);\n", or part of it, saves it into `buff', and
- * returns a pointer to the byte following the last written byte.
- * If a row consists of mutiple D records, `*colptr' returns the
- * column corresponding to the beginning of the next D record,
- * or NULL to indicate the end of a row.
+ * Converts the D records of a row to a string of row values, i.e.
+ * "(val1,val2,...)", of the columns selected in `tbl', and saves it
+ * into `buff', returns a pointer to its end. `recs[i]' is the D record
+ * whose IXFDRID is i + 1. With --stats, each value is timed by the type
+ * of its column.
  */
-static void fill_in_values(char *buff, const unsigned char *rec,
-			   const struct column_desc *col_head,
-			   struct column_desc **colptr)
+static char *fill_in_values(char *buff, const unsigned char *const *recs,
+			   const struct table_desc *tbl)
 {
-	const unsigned char *pos;
-	struct column_desc *col;
+	const struct column_desc *col;
+	bool timed;
+	double start;
+	int i;
 
-	col = *colptr;
-	do {
-		if (col == col_head)
-			*buff++ = '(';
-		else
+	timed = stats_enabled();
+	*buff++ = '(';
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		if (i > 0)
 			*buff++ = ',';
 
-		pos = rec + IXFDCOLS_OFFSET + col->c_offset;
-		buff = fill_in_a_value(buff, pos, col);
-		col = col->next;
-	} while (col && col->c_offset > 0);
-	/* col->c_offset == 0 means a new record beginning */
+		col = tbl->t_sel[i];
+		if (timed) {
+			start = stats_clock();
+			buff = fill_in_column(buff, recs, col, i);
+			count_format(col->c_type, stats_clock() - start);
+		} else {
+			buff = fill_in_column(buff, recs, col, i);
+		}
+	}
 
-	if (!col)		/* end of a row */
-		strcpy(buff, ");\n");
+	*buff++ = ')';
+	return buff;
+}
 
-	*colptr = col;
+/*
+ * write the string value of `col', the `i'th column selected, of row
+ * `recs' to `buff', from its memo if it has one
+ */
+static char *fill_in_column(char *buff, const unsigned char *const *recs,
+			    const struct column_desc *col, int i)
+{
+	const unsigned char *src;
+	const unsigned char *val;
+	struct memo *memo;
+	unsigned char *key;
+	char *end;
+	size_t len;
+	size_t slot;
+	size_t j;
+	unsigned hash;
+
+	src = recs[col->c_drid - 1] + IXFDCOLS_OFFSET + col->c_offset;
+	memo = memos ? memos[i] : NULL;
+	if (!memo)
+		return fill_in_a_value(buff, src, col);
+
+	len = column_value(recs, col, &val);
+	if (!val || len > memo->m_key_size)
+		return fill_in_a_value(buff, src, col);
+
+	hash = FNV_OFFSET_BASIS;
+	for (j = 0; j < len; ++j)
+		hash = (hash ^ val[j]) * FNV_PRIME;
+	slot = hash & (MEMO_SLOTS - 1);
+	key = memo->m_keys + slot * memo->m_key_size;
+
+	++memo->m_lookups;
+	if (memo->m_text_lens[slot] > 0 && memo->m_key_lens[slot] == len
+	    && memcmp(key, val, len) == 0) {
+		++memo->m_hits;
+		memcpy(buff, memo->m_texts + slot * memo->m_text_size,
+		       memo->m_text_lens[slot]);
+		return buff + memo->m_text_lens[slot];
+	}
+
+	end = fill_in_a_value(buff, src, col);
+	if ((size_t) (end - buff) <= memo->m_text_size) {
+		memcpy(key, val, len);
+		memo->m_key_lens[slot] = (unsigned char)len;
+		memcpy(memo->m_texts + slot * memo->m_text_size, buff,
+		       (size_t) (end - buff));
+		memo->m_text_lens[slot] = (unsigned char)(end - buff);
+	}
+
+	if (memo->m_lookups == MEMO_WINDOW) {
+		if (memo->m_hits < MEMO_WINDOW / 2) {
+			/* too many distinct values to pay off */
+			free_memo(memo);
+			memos[i] = NULL;
+		} else {
+			memo->m_lookups = memo->m_hits = 0L;
+		}
+	}
+
+	return end;
 }
 
 /*
@@ -273,15 +852,47 @@ static char *fill_in_a_value(char *buff, const unsigned char *src,
 
 	switch (col->c_type) {
 	case CHAR:
+		if (col->c_bitdata)
+			buff = write_as_hex(buff, src, col->c_len);
+		else
+			buff = write_as_sql_str(buff, src, col->c_len,
+						col->c_codec);
+		break;
+	case BINARY:
+		buff = write_as_hex(buff, src, col->c_len);
+		break;
 	case DATE:
 	case TIME:
 	case TIMESTAMP:
-		buff = write_as_sql_str(buff, src, col->c_len);
+		buff = write_as_datetime(buff, src, col->c_type, col->c_len);
 		break;
 	case VARCHAR:
+	case LONG_VARCHAR:
+		cur_len = get_varchar_cur_len(src);
+		src += VARCHAR_CUR_LEN_IND_BYTES;
+		if (col->c_bitdata)
+			buff = write_as_hex(buff, src, cur_len);
+		else
+			buff = write_as_sql_str(buff, src, cur_len,
+						col->c_codec);
+		break;
+	case VARBINARY:
+		cur_len = get_varchar_cur_len(src);
+		src += VARCHAR_CUR_LEN_IND_BYTES;
+		buff = write_as_hex(buff, src, cur_len);
+		break;
+	case GRAPHIC:
+		buff = write_as_sql_str(buff, src,
+					col->c_len * GRAPHIC_CHAR_BYTES,
+					col->c_codec);
+		break;
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
 		cur_len = get_varchar_cur_len(src);
 		src += VARCHAR_CUR_LEN_IND_BYTES;
-		buff = write_as_sql_str(buff, src, cur_len);
+		buff = write_as_sql_str(buff, src,
+					cur_len * GRAPHIC_CHAR_BYTES,
+					col->c_codec);
 		break;
 	case SMALLINT:
 		num_val = parse_ixf_integer(src, col->c_len);
@@ -303,6 +914,9 @@ static char *fill_in_a_value(char *buff, const unsigned char *src,
 		buff += sprintf(buff, "%.*G",
 				col->c_len == 4 ? FLT_DIG : DBL_DIG, flt_val);
 		break;
+	case DECFLOAT:
+		buff = write_as_decfloat(buff, src, decfloat_size(col->c_len));
+		break;
 	default:
 		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
 	}
@@ -312,25 +926,140 @@ static char *fill_in_a_value(char *buff, const unsigned char *src,
 
 /*
  * This function escapes single quotes and backslashes (if required),
- * wraps it in single quotes, writes the result into the buffer,
- * and returns a pointer to the byte following the last written
- * byte in the buffer.
- * `len' is the number of characters to be processed in `src'.
+ * transcodes it to UTF-8 if `cc' is not NULL, wraps it in single quotes,
+ * writes the result into the buffer, and returns a pointer to the byte
+ * following the last written byte in the buffer.
+ * `len' is the number of bytes to be processed in `src'.
  */
-static char *write_as_sql_str(char *buff, const unsigned char *src, size_t len)
+static char *write_as_sql_str(char *buff, const unsigned char *src, size_t len,
+			      const struct codec *cc)
 {
-	size_t i;
-	const char *orig;
+	size_t run;
 
-	orig = (const char *)src;
 	*buff++ = '\'';
-	for (i = 0; i < len; ++i) {
-		*buff++ = *orig;
-		if (*orig == '\'' || (*orig == '\\' && escape_backslash))
-			*buff++ = *orig;
-		orig++;
+	if (cc) {
+		buff = to_utf8(buff, src, len, cc, str_flags);
+	} else {
+		while (len > 0) {
+			/* copy bytes up to the next one to be doubled */
+			run = plain_run_len(src, len, str_flags);
+			memcpy(buff, src, run);
+			buff += run;
+			src += run;
+			len -= run;
+			if (len == 0)
+				break;
+
+			*buff++ = (char)*src;
+			*buff++ = (char)*src++;
+			len--;
+		}
 	}
 	*buff++ = '\'';
 
 	return buff;
 }
+
+/*
+ * write `len' bytes of binary data in `src' to `buff' as a hexadecimal
+ * string literal of the target dialect, returns a pointer to the byte
+ * following the last written byte
+ */
+static char *write_as_hex(char *buff, const unsigned char *src, size_t len)
+{
+	memcpy(buff, hex_prefix, hex_prefix_len);
+	buff = hex_encode(buff + hex_prefix_len, src, len);
+	memcpy(buff, hex_suffix, hex_suffix_len);
+
+	return buff + hex_suffix_len;
+}
+
+/*
+ * write the DATE, TIME or TIMESTAMP value of `type' in `src', the `len'
+ * bytes of its DB2 text such as 1987-07-31-15.33.36.351631, to `buff' as
+ * a literal of the target dialect, returns a pointer to the byte
+ * following the last written byte
+ */
+static char *write_as_datetime(char *buff, const unsigned char *src, int type,
+			       size_t len)
+{
+	char *text;
+
+	/* TIME of Oracle is a VARCHAR2 of the DB2 text */
+	if (datetime_dialect == SQL_ORACLE && type != TIME)
+		return write_oracle_datetime(buff, src, type, len);
+
+	text = buff + 1;	/* after the quote */
+	buff = write_as_sql_str(buff, src, len, NULL);
+	if (datetime_dialect == SQL_DB2 || datetime_dialect == SQL_ORACLE)
+		return buff;
+
+	/* yyyy-mm-dd hh:mm:ss.ffffff for the others */
+	if (type == TIME) {
+		iso_time(text);
+	} else if (type == TIMESTAMP) {
+		if (text[10] == '-')
+			text[10] = ' ';
+		iso_time(text + 11);
+	}
+
+	return buff;
+}
+
+/*
+ * write the DATE or TIMESTAMP value of `type' in `src', the `len' bytes of
+ * its DB2 text, to `buff' as TO_DATE() or TO_TIMESTAMP() of Oracle, whose
+ * fraction has ORACLE_MAX_FRACTION digits at most
+ */
+static char *write_oracle_datetime(char *buff, const unsigned char *src,
+				   int type, size_t len)
+{
+	size_t digits;
+
+	if (type == DATE) {
+		buff += sprintf(buff, "TO_DATE(");
+		buff = write_as_sql_str(buff, src, len, NULL);
+		return buff + sprintf(buff, ",'YYYY-MM-DD')");
+	}
+
+	digits = len > TIMESTAMP_INT_LEN ? len - TIMESTAMP_INT_LEN : 0;
+	if (digits > ORACLE_MAX_FRACTION)
+		digits = ORACLE_MAX_FRACTION;
+	buff += sprintf(buff, "TO_TIMESTAMP(");
+	if (digits == 0) {
+		/* without the point either */
+		buff = write_as_sql_str(buff, src, TIMESTAMP_INT_LEN - 1, NULL);
+		return buff + sprintf(buff, ",'YYYY-MM-DD-HH24.MI.SS')");
+	}
+	buff = write_as_sql_str(buff, src, TIMESTAMP_INT_LEN + digits, NULL);
+
+	return buff + sprintf(buff, ",'YYYY-MM-DD-HH24.MI.SS.FF%d')",
+			      (int)digits);
+}
+
+/* turn the hh.mm.ss at `hms' into hh:mm:ss */
+static void iso_time(char *hms)
+{
+	if (hms[2] == '.')
+		hms[2] = ':';
+	if (hms[5] == '.')
+		hms[5] = ':';
+}
+
+/*
+ * write the DECFLOAT of `bytes' bytes in `src' to `buff', as a number or,
+ * if it is Infinity or NaN or the dialect wants it so, as a string,
+ * returns a pointer to the byte following the last written byte
+ */
+static char *write_as_decfloat(char *buff, const unsigned char *src,
+			       size_t bytes)
+{
+	if (!decfloat_quoted && decfloat_is_finite(src, bytes))
+		return decode_decfloat(buff, src, bytes);
+
+	*buff++ = '\'';
+	buff = decode_decfloat(buff, src, bytes);
+	*buff++ = '\'';
+
+	return buff;
+}
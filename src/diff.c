@@ -0,0 +1,176 @@
+/*
+ * diff.c - turn the rows of an older IXF file into those of a newer one
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "diff.h"
+#include "sort.h"
+#include "util.h"
+
+/*
+ * The rows of both files are sorted together by key, those of the older
+ * file first, so that a row of the older file is followed by the row of
+ * the newer one of the same key, if any. An older row is kept until the
+ * next row tells whether it was updated or deleted.
+ */
+struct diff_output {
+	int d_ofd;
+	const struct summary *d_sum;
+	const struct table_desc *d_tbl;
+	uint64_t d_nold;	/* rows of the older file */
+	unsigned char **d_old;	/* older row not matched yet */
+	size_t *d_sizes;	/* of the buffers of `d_old', at least what
+				   may be read of each D record */
+	bool d_pending;		/* whether `d_old' holds a row */
+	unsigned char **d_new;	/* last row of the newer file */
+	size_t *d_new_sizes;	/* of the buffers of `d_new' */
+	bool d_seen_new;	/* whether `d_new' holds a row */
+	long d_stmts;		/* statements written */
+};
+
+static bool diff_row(const unsigned char *const *recs, const size_t *lens,
+		     uint64_t seq, void *arg);
+static void check_new_key(struct diff_output *dd,
+			  const unsigned char *const *recs,
+			  const size_t *lens);
+static void copy_row(unsigned char **dst, size_t *sizes, int ndrec,
+		     const unsigned char *const *recs, const size_t *lens);
+
+/*
+ * Writes the INSERT, UPDATE and DELETE statements that turn the first
+ * `nold' rows sorted, those of the older file, into the others to `ofd'.
+ * Returns the number of statements written.
+ */
+long write_diff(int ofd, uint64_t nold, const struct summary *sum,
+		const struct table_desc *tbl)
+{
+	struct diff_output dd;
+	int i;
+
+	dd.d_ofd = ofd;
+	dd.d_sum = sum;
+	dd.d_tbl = tbl;
+	dd.d_nold = nold;
+	dd.d_old = alloc_buff((size_t) tbl->t_ndrec * sizeof(*dd.d_old));
+	dd.d_sizes = record_spans(tbl);
+	dd.d_new = alloc_buff((size_t) tbl->t_ndrec * sizeof(*dd.d_new));
+	dd.d_new_sizes = record_spans(tbl);
+	for (i = 0; i < tbl->t_ndrec; ++i) {
+		dd.d_old[i] = alloc_buff(dd.d_sizes[i]);
+		dd.d_new[i] = alloc_buff(dd.d_new_sizes[i]);
+	}
+	dd.d_pending = false;
+	dd.d_seen_new = false;
+	dd.d_stmts = 0L;
+
+	output_sorted_rows(diff_row, &dd);
+	if (dd.d_pending) {
+		delete_to_sql(ofd, (const unsigned char *const *)dd.d_old,
+			      sum, tbl);
+		++dd.d_stmts;
+	}
+	close_sort();
+
+	for (i = 0; i < tbl->t_ndrec; ++i) {
+		free_buff(dd.d_old[i]);
+		free_buff(dd.d_new[i]);
+	}
+	free_buff(dd.d_old);
+	free_buff(dd.d_sizes);
+	free_buff(dd.d_new);
+	free_buff(dd.d_new_sizes);
+
+	return dd.d_stmts;
+}
+
+/* compare a row of output_sorted_rows() with the older row kept */
+static bool diff_row(const unsigned char *const *recs, const size_t *lens,
+		     uint64_t seq, void *arg)
+{
+	struct diff_output *dd;
+	const unsigned char *const *old;
+
+	dd = arg;
+	old = (const unsigned char *const *)dd->d_old;
+	if (seq >= dd->d_nold)
+		check_new_key(dd, recs, lens);
+	if (dd->d_pending) {
+		dd->d_pending = false;
+		if (compare_sort_keys(old, recs) != 0) {
+			delete_to_sql(dd->d_ofd, old, dd->d_sum, dd->d_tbl);
+			++dd->d_stmts;
+		} else if (seq < dd->d_nold) {
+			fmt_err_exit("%s", "Key repeated in the older file, "
+				     "give unique columns with --sort-key");
+		} else {
+			if (update_to_sql(dd->d_ofd, old, recs, dd->d_sum,
+					  dd->d_tbl))
+				++dd->d_stmts;
+			return true;
+		}
+	}
+
+	if (seq < dd->d_nold) {
+		copy_row(dd->d_old, dd->d_sizes, dd->d_tbl->t_ndrec, recs,
+			 lens);
+		dd->d_pending = true;
+	} else {
+		row_to_sql(dd->d_ofd, 0, recs, dd->d_sum, dd->d_tbl);
+		++dd->d_stmts;
+	}
+
+	return true;
+}
+
+/*
+ * exit if the row in D records `recs' of the newer file has the key of
+ * the one before it, else keep it to compare with the next one
+ */
+static void check_new_key(struct diff_output *dd,
+			  const unsigned char *const *recs,
+			  const size_t *lens)
+{
+	if (dd->d_seen_new
+	    && compare_sort_keys((const unsigned char *const *)dd->d_new,
+				 recs) == 0)
+		fmt_err_exit("%s", "Key repeated in the newer file, "
+			     "give unique columns with --sort-key");
+
+	copy_row(dd->d_new, dd->d_new_sizes, dd->d_tbl->t_ndrec, recs, lens);
+	dd->d_seen_new = true;
+}
+
+/*
+ * copy the row in `ndrec' D records `recs' of `lens' bytes to the
+ * buffers `dst' of `sizes' bytes, growing them as needed, with zeros
+ * after a record shorter than what may be read of it
+ */
+static void copy_row(unsigned char **dst, size_t *sizes, int ndrec,
+		     const unsigned char *const *recs, const size_t *lens)
+{
+	int i;
+
+	for (i = 0; i < ndrec; ++i) {
+		if (lens[i] > sizes[i]) {
+			dst[i] = resize_buff(dst[i], lens[i]);
+			sizes[i] = lens[i];
+		}
+		memcpy(dst[i], recs[i], lens[i]);
+		memset(dst[i] + lens[i], 0, sizes[i] - lens[i]);
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * diff.h - declarations of the statements of --diff
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_DIFF_H_
+#define IXFCVT_DIFF_H_
+
+#include <stdint.h>
+
+#include "ixfcvt.h"
+
+long write_diff(int ofd, uint64_t nold, const struct summary *sum,
+		const struct table_desc *tbl);
+
+#endif
@@ -0,0 +1,385 @@
+/*
+ * emit.c - generate the C source of a converter specialized for the table
+ *          of an IXF file: --emit-converter
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The converter writes the INSERT statements row_to_sql() would, but the
+ * D record, offset, length and null indicator of each column are constants
+ * of an unrolled format_row(), which calls the kernel of the column type
+ * directly: no list of columns is walked and no type switched on per
+ * value.  The source defines the CONV_ constants, includes convmain.c for
+ * the reading and writing, and is built by `make converter'.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "emit.h"
+#include "parse_d.h"
+#include "util.h"
+
+#define DEF_BUFF_SIZE 8192
+#define EXPR_SIZE 64		/* of an expression of append_value() */
+#define NULL_TEXT_LEN 4		/* "null" */
+#define COMMA_LEN 1
+#define PARENS_LEN 2
+
+static void append_constants(const struct summary *sum,
+			     const struct table_desc *tbl);
+static void append_format_row(const struct table_desc *tbl);
+static void append_column(const struct column_desc *col, int i);
+static void append_value(const struct column_desc *col, int i, size_t off,
+			 const char *ind);
+static void append_string(const char *str);
+static bool has_codec(const struct column_desc *col);
+static size_t row_size(const struct table_desc *tbl);
+static size_t fixed_size(const struct column_desc *col);
+static void append(const char *format, ...);
+
+static const char *const DIALECT_NAMES[] = {
+	"SQL_DB2", "SQL_POSTGRESQL", "SQL_MYSQL", "SQL_ORACLE", "SQL_SQLITE"
+};
+
+static char *code;		/* source being built */
+static size_t code_size;
+static size_t code_len;
+
+/*
+ * Writes to `fd' the source of a converter of the columns selected in
+ * `tbl' to the SQL of the options in `sum'.
+ */
+void emit_converter(int fd, const struct summary *sum,
+		    const struct table_desc *tbl)
+{
+	reject_xml(tbl);
+	code_size = DEF_BUFF_SIZE;
+	code = alloc_buff(code_size);
+	code_len = 0;
+
+	append("/*\n"
+	       " * Converter of an IXF file to INSERT statements, generated by\n"
+	       " * `ixfcvt --emit-converter' for the table of its C records.\n"
+	       " * Do not edit; build it with `make converter'.\n"
+	       " */\n\n");
+	append_constants(sum, tbl);
+	append("\n#include \"convmain.c\"\n");
+	append_format_row(tbl);
+
+	write_file(fd, code);
+	free_buff(code);
+	code = NULL;
+}
+
+/* append the CONV_ macros convmain.c is built from */
+static void append_constants(const struct summary *sum,
+			     const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	size_t *sizes;		/* of each D record, at least */
+	size_t end;
+	int i;
+
+	append("#define CONV_DIGEST 0x%016llXULL\t/* of the C records */\n",
+	       (unsigned long long)tbl->t_digest);
+	append("#define CONV_NDREC %d\t\t/* D records of a row */\n",
+	       tbl->t_ndrec);
+	append("#define CONV_NCOLS %d\t\t/* columns output */\n", tbl->t_nsel);
+	/* the values are as long as those of the dialect */
+	choose_literals(sum->s_dialect);
+	append("#define CONV_ROW_SIZE %lu\t/* of the longest \"(...)\" */\n",
+	       (unsigned long)row_size(tbl));
+	append("#define CONV_COMMIT_SIZE %d\t/* rows between COMMITs */\n",
+	       sum->s_cmtsz);
+	append("#define CONV_DIALECT %s\n", DIALECT_NAMES[sum->s_dialect]);
+	append("#define CONV_ESCBS %s\n", sum->s_escbs ? "true" : "false");
+
+	/* the D records must reach the fixed part of each column read */
+	sizes = alloc_buff((size_t) tbl->t_ndrec * sizeof(*sizes));
+	memset(sizes, 0, (size_t) tbl->t_ndrec * sizeof(*sizes));
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
+		end = IXFDCOLS_OFFSET + (size_t) col->c_offset
+		    + fixed_size(col);
+		if (end > sizes[col->c_drid - 1])
+			sizes[col->c_drid - 1] = end;
+	}
+	append("#define CONV_DREC_SIZES {");
+	for (i = 0; i < tbl->t_ndrec; ++i)
+		append("%s%lu", i > 0 ? ", " : "", (unsigned long)sizes[i]);
+	append("}\n");
+	free_buff(sizes);
+
+	append("#define CONV_TABLE_NAME ");
+	append_string(tbl->t_name);
+	append("\n#define CONV_COLUMN_NAMES {");
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		append("%s \\\n\t", i > 0 ? "," : "");
+		append_string(tbl->t_sel[i]->c_name);
+	}
+	append(" \\\n}\n");
+
+	append("#define CONV_CODE_PAGES {");
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
+		append("%s%d", i > 0 ? ", " : "", !has_codec(col) ? 0
+		       : col->c_type == GRAPHIC || col->c_type == VARGRAPHIC
+		       || col->c_type == LONG_VARGRAPHIC ? col->c_dbcp
+		       : col->c_sbcp);
+	}
+	append("}\n");
+}
+
+/* append format_row(), a block of code for each column in turn */
+static void append_format_row(const struct table_desc *tbl)
+{
+	bool *used;		/* D records with a column selected */
+	int i;
+
+	used = alloc_buff((size_t) tbl->t_ndrec * sizeof(*used));
+	memset(used, 0, (size_t) tbl->t_ndrec * sizeof(*used));
+	for (i = 0; i < tbl->t_nsel; ++i)
+		used[tbl->t_sel[i]->c_drid - 1] = true;
+
+	append("\n/* write the values of the row in D records `recs' to `buff' "
+	       "as \"(...)\" */\n"
+	       "static char *format_row(char *buff, "
+	       "const unsigned char *const *recs)\n{\n");
+	for (i = 0; i < tbl->t_ndrec; ++i)
+		if (used[i])
+			append("\tconst unsigned char *r%d = recs[%d] + "
+			       "IXFDCOLS_OFFSET;\n", i + 1, i);
+	free_buff(used);
+
+	append("\n\t*buff++ = '(';\n");
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		if (i > 0)
+			append("\t*buff++ = ',';\n");
+		append_column(tbl->t_sel[i], i);
+	}
+	append("\t*buff++ = ')';\n\n\treturn buff;\n}\n");
+}
+
+/* append the code writing `col', the `i'th column selected */
+static void append_column(const struct column_desc *col, int i)
+{
+	size_t off;
+
+	off = (size_t) col->c_offset;
+	append("\t/* %d: type %d, length %lu%s */\n", i + 1, col->c_type,
+	       (unsigned long)col->c_len, col->c_nullable ? ", nullable" : "");
+	if (!col->c_nullable) {
+		append_value(col, i, off, "\t");
+		return;
+	}
+
+	/* the null indicator is 0xFFFF, the value follows it */
+	append("\tif (r%d[%lu] == 0xFF && r%d[%lu] == 0xFF) {\n"
+	       "\t\tmemcpy(buff, \"null\", %d);\n"
+	       "\t\tbuff += %d;\n"
+	       "\t} else {\n", col->c_drid, (unsigned long)off, col->c_drid,
+	       (unsigned long)off + 1, NULL_TEXT_LEN, NULL_TEXT_LEN);
+	append_value(col, i, off + NULL_VAL_IND_BYTES, "\t\t");
+	append("\t}\n");
+}
+
+/*
+ * append the code writing the value of `col', the `i'th column selected,
+ * at `off' of its D record, each line indented by `ind', the way
+ * fill_in_a_value() does
+ */
+static void append_value(const struct column_desc *col, int i, size_t off,
+			 const char *ind)
+{
+	char val[EXPR_SIZE];	/* the value */
+	char data[EXPR_SIZE];	/* after its length indicator */
+	char cur_len[EXPR_SIZE * 2];	/* in the length indicator */
+	char codec[EXPR_SIZE];
+
+	sprintf(val, "r%d + %lu", col->c_drid, (unsigned long)off);
+	sprintf(data, "r%d + %lu", col->c_drid,
+		(unsigned long)(off + VARCHAR_CUR_LEN_IND_BYTES));
+	sprintf(cur_len, "get_varchar_cur_len(%s)", val);
+	if (has_codec(col))
+		sprintf(codec, "codecs[%d]", i);
+	else
+		strcpy(codec, "NULL");
+
+	switch (col->c_type) {
+	case CHAR:
+		if (col->c_bitdata)
+			append("%sbuff = write_as_hex(buff, %s, %lu);\n", ind,
+			       val, (unsigned long)col->c_len);
+		else
+			append("%sbuff = write_as_sql_str(buff, %s, %lu, %s);\n",
+			       ind, val, (unsigned long)col->c_len, codec);
+		break;
+	case BINARY:
+		append("%sbuff = write_as_hex(buff, %s, %lu);\n", ind, val,
+		       (unsigned long)col->c_len);
+		break;
+	case DATE:
+	case TIME:
+	case TIMESTAMP:
+		append("%sbuff = write_as_datetime(buff, %s, %s, %lu);\n", ind,
+		       val, col->c_type == DATE ? "DATE"
+		       : col->c_type == TIME ? "TIME" : "TIMESTAMP",
+		       (unsigned long)col->c_len);
+		break;
+	case VARCHAR:
+	case LONG_VARCHAR:
+		if (col->c_bitdata)
+			append("%sbuff = write_as_hex(buff, %s, %s);\n", ind,
+			       data, cur_len);
+		else
+			append("%sbuff = write_as_sql_str(buff, %s, %s, %s);\n",
+			       ind, data, cur_len, codec);
+		break;
+	case VARBINARY:
+		append("%sbuff = write_as_hex(buff, %s, %s);\n", ind, data,
+		       cur_len);
+		break;
+	case GRAPHIC:
+		append("%sbuff = write_as_sql_str(buff, %s, %lu, %s);\n", ind,
+		       val, (unsigned long)col->c_len * GRAPHIC_CHAR_BYTES,
+		       codec);
+		break;
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		append("%sbuff = write_as_sql_str(buff, %s, %s * %d, %s);\n",
+		       ind, data, cur_len, GRAPHIC_CHAR_BYTES, codec);
+		break;
+	case SMALLINT:
+	case INTEGER:
+	case BIGINT:
+		append("%sbuff = put_integer(buff, parse_ixf_integer(%s, %lu));\n",
+		       ind, val, (unsigned long)col->c_len);
+		break;
+	case DECIMAL:
+		append("%sbuff = decode_packed_decimal(buff, %s, %lu);\n", ind,
+		       val, (unsigned long)col->c_len);
+		break;
+	case FLOATING_POINT:
+		append("%sbuff += sprintf(buff, \"%%.*G\", %s,\n"
+		       "%s\t\tparse_ixf_float(%s, %lu));\n", ind,
+		       col->c_len == 4 ? "FLT_DIG" : "DBL_DIG", ind, val,
+		       (unsigned long)col->c_len);
+		break;
+	case DECFLOAT:
+		append("%sbuff = write_as_decfloat(buff, %s, %lu);\n", ind, val,
+		       (unsigned long)decfloat_size(col->c_len));
+		break;
+	default:
+		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
+	}
+}
+
+/* append `str' as a C string literal */
+static void append_string(const char *str)
+{
+	const unsigned char *p;
+
+	append("\"");
+	for (p = (const unsigned char *)str; *p; ++p) {
+		if (*p == '"' || *p == '\\')
+			append("\\%c", *p);
+		else if (*p < ' ' || *p > '~')
+			append("\\%03o", *p);	/* never runs into a digit */
+		else
+			append("%c", *p);
+	}
+	append("\"");
+}
+
+/* tell whether the values of `col' are transcoded to UTF-8 */
+static bool has_codec(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case CHAR:
+	case VARCHAR:
+	case LONG_VARCHAR:
+		return col->c_codec && !col->c_bitdata;
+	case GRAPHIC:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		return col->c_codec != NULL;
+	default:
+		return false;
+	}
+}
+
+/* the bytes of the longest "(...)" of values of the columns of `tbl' */
+static size_t row_size(const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	size_t size;
+	size_t len;
+	int i;
+
+	size = PARENS_LEN;
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
+		len = col_value_size(col);
+		if (col->c_nullable && len < NULL_TEXT_LEN)
+			len = NULL_TEXT_LEN;
+		size += len + (i > 0 ? COMMA_LEN : 0);
+	}
+
+	return size;
+}
+
+/*
+ * the bytes of `col' in a D record up to its value, or to the end of its
+ * value if it is of fixed length
+ */
+static size_t fixed_size(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case VARCHAR:
+	case LONG_VARCHAR:
+	case VARBINARY:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+	case XML:
+		return (col->c_nullable ? NULL_VAL_IND_BYTES : 0)
+		    + VARCHAR_CUR_LEN_IND_BYTES;
+	default:
+		return column_span(col);
+	}
+}
+
+/* append formatted text to `code', growing it as needed */
+static void append(const char *format, ...)
+{
+	va_list ap;
+	int len;
+
+	for (;;) {
+		va_start(ap, format);
+		len = vsnprintf(code + code_len, code_size - code_len, format,
+				ap);
+		va_end(ap);
+		if (len < 0)
+			err_exit("vsnprintf");
+		if (code_len + (size_t)len < code_size)
+			break;
+		code_size = (code_len + (size_t)len + 1) * 2;
+		code = resize_buff(code, code_size);
+	}
+	code_len += (size_t)len;
+}
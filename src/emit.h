@@ -0,0 +1,27 @@
+/*
+ * emit.h - declarations of the converter generator of --emit-converter
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_EMIT_H_
+#define IXFCVT_EMIT_H_
+
+#include "ixfcvt.h"
+
+void emit_converter(int fd, const struct summary *sum,
+		    const struct table_desc *tbl);
+
+#endif
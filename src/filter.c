@@ -0,0 +1,829 @@
+/*
+ * filter.c - select rows by a --where expression on the raw D records
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "codepage.h"
+#include "filter.h"
+#include "parse_d.h"
+#include "util.h"
+
+#define LOW_NIBBLE 0x0F
+#define HIGH_NIBBLE 0xF0
+#define POSITIVE_SIGN 0x0C
+#define NEGATIVE_SIGN 0x0D
+#define DATE_PART_LEN 10	/* yyyy-mm-dd of a TIMESTAMP */
+#define SECONDS_PART_LEN 19	/* yyyy-mm-dd-hh.mm.ss of a TIMESTAMP */
+
+enum token_type {
+	TK_END,			/* end of the expression */
+	TK_WORD,		/* keyword or column name */
+	TK_NAME,		/* "quoted" column name */
+	TK_STRING,		/* 'string' literal */
+	TK_NUMBER,		/* numeric literal */
+	TK_OP,			/* comparison operator */
+	TK_LPAREN,
+	TK_RPAREN,
+	TK_COMMA
+};
+
+enum node_type {
+	ND_AND,
+	ND_OR,
+	ND_NOT,
+	ND_CMP,			/* column <op> literal */
+	ND_IN,			/* column IN (literal, ...) */
+	ND_IS_NULL
+};
+
+enum cmp_op {
+	OP_EQ,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE
+};
+
+/* how the values of a column are compared */
+enum value_kind {
+	VK_NONE,		/* only IS NULL applies */
+	VK_INTEGER,		/* SMALLINT, INTEGER, BIGINT */
+	VK_FLOAT,		/* REAL, DOUBLE */
+	VK_PACKED,		/* DECIMAL, nibble by nibble */
+	VK_DATETIME,		/* DATE, TIME, TIMESTAMP, as fixed strings */
+	VK_CHAR,		/* CHAR, blank-padded */
+	VK_VARCHAR		/* VARCHAR, LONG VARCHAR, blank-padded */
+};
+
+/* result of SQL three-valued logic */
+enum truth {
+	T_FALSE,
+	T_TRUE,
+	T_UNKNOWN
+};
+
+/* a literal encoded like the values of the column it is compared with */
+struct literal {
+	long long l_int;	/* VK_INTEGER */
+	double l_flt;		/* VK_FLOAT */
+	unsigned char *l_bytes;	/* the others */
+	size_t l_len;
+};
+
+/* node of a compiled expression */
+struct node {
+	enum node_type n_type;
+	struct node *n_left;	/* operands of AND, OR and NOT */
+	struct node *n_right;
+	const struct column_desc *n_col;	/* column of a predicate */
+	enum value_kind n_kind;
+	enum cmp_op n_op;
+	struct literal *n_lits;	/* literal(s) of ND_CMP and ND_IN */
+	int n_nlits;
+	unsigned char n_blank;	/* blank in the code page of `n_col' */
+};
+
+struct filter {
+	struct node *f_root;
+};
+
+/* state of the recursive descent parser */
+struct parser {
+	const struct table_desc *p_tbl;
+	const char *p_start;	/* start of the current token */
+	const char *p_next;	/* character following the current token */
+	enum token_type p_type;	/* type of the current token */
+	char *p_text;		/* the current token, quotes removed */
+};
+
+/* formats of date and time values, '9' for a digit */
+static const char DATE_FORMAT[] = "9999-99-99";
+static const char TIME_FORMAT[] = "99.99.99";
+static const char TIMESTAMP_FORMAT[] = "9999-99-99-99.99.99.999999999999";
+
+static void next_token(struct parser *ps);
+static void syntax_error(const struct parser *ps, const char *expected);
+static bool is_keyword(const struct parser *ps, const char *keyword);
+static void expect(struct parser *ps, enum token_type type,
+		   const char *expected);
+static struct node *parse_or(struct parser *ps);
+static struct node *parse_and(struct parser *ps);
+static struct node *parse_not(struct parser *ps);
+static struct node *parse_predicate(struct parser *ps);
+static enum cmp_op parse_op(const struct parser *ps);
+static void add_literal(struct parser *ps, struct node *nd);
+static struct node *new_node(enum node_type type, struct node *left,
+			     struct node *right);
+static struct node *new_predicate(enum node_type type,
+				  const struct column_desc *col);
+static enum value_kind value_kind(const struct column_desc *col);
+static void encode_literal(const char *text, const struct node *nd,
+			   struct literal *lit);
+static void encode_packed(const char *text, const struct column_desc *col,
+			  struct literal *lit);
+static void encode_datetime(const char *text, const struct column_desc *col,
+			    struct literal *lit);
+static void encode_chars(const char *text, const struct column_desc *col,
+			 struct literal *lit);
+static bool is_decimal(const char *text);
+static void put_nibble(unsigned char *buff, size_t pos, int value);
+static void bad_literal(const char *text, const struct column_desc *col);
+static enum truth eval_node(const struct node *nd,
+			    const unsigned char *const *recs);
+static int compare_value(const struct node *nd, const unsigned char *src,
+			 const struct literal *lit);
+static int compare_padded(const unsigned char *src, size_t len,
+			  const struct literal *lit, unsigned char blank);
+static bool op_holds(enum cmp_op op, int cmp);
+static void free_node(struct node *nd);
+
+/*
+ * Compiles `expr' against the columns of `tbl', exits on error.
+ * Supported are comparisons (=, <>, !=, <, <=, >, >=), IN lists,
+ * BETWEEN and IS NULL, each optionally negated by NOT, combined with
+ * AND, OR and parentheses. Literals are encoded like the values of the
+ * column they are compared with, so that rows are tested without being
+ * decoded.
+ */
+struct filter *compile_filter(const char *expr, const struct table_desc *tbl)
+{
+	struct filter *flt;
+	struct parser ps;
+
+	ps.p_tbl = tbl;
+	ps.p_next = expr;
+	ps.p_text = alloc_buff(strlen(expr) + 1);
+	next_token(&ps);
+
+	flt = alloc_buff(sizeof(struct filter));
+	flt->f_root = parse_or(&ps);
+	if (ps.p_type != TK_END)
+		syntax_error(&ps, "AND, OR or end of expression");
+
+	free_buff(ps.p_text);
+	return flt;
+}
+
+/* Return true if the row in the D records `recs' satisfies `flt'. */
+bool row_matches(const struct filter *flt, const unsigned char *const *recs)
+{
+	return eval_node(flt->f_root, recs) == T_TRUE;
+}
+
+void free_filter(struct filter *flt)
+{
+	free_node(flt->f_root);
+	free_buff(flt);
+}
+
+/* read the token following the current one */
+static void next_token(struct parser *ps)
+{
+	const char *s;
+	char *t;
+	char quote;
+
+	s = ps->p_next;
+	while (isspace((unsigned char)*s))
+		++s;
+	ps->p_start = s;
+	t = ps->p_text;
+
+	if (*s == '\0') {
+		ps->p_type = TK_END;
+	} else if (*s == '(' || *s == ')' || *s == ',') {
+		ps->p_type = *s == '(' ? TK_LPAREN
+		    : *s == ')' ? TK_RPAREN : TK_COMMA;
+		*t++ = *s++;
+	} else if (strchr("=<>!", *s)) {
+		ps->p_type = TK_OP;
+		*t++ = *s++;
+		if (*s == '=' || (t[-1] == '<' && *s == '>'))
+			*t++ = *s++;
+	} else if (*s == '\'' || *s == '"') {
+		ps->p_type = *s == '\'' ? TK_STRING : TK_NAME;
+		quote = *s++;
+		/* a doubled quote stands for itself */
+		while (*s != quote || s[1] == quote) {
+			if (*s == '\0')
+				syntax_error(ps, "closing quote");
+			if (*s == quote)
+				++s;
+			*t++ = *s++;
+		}
+		++s;
+	} else if (isdigit((unsigned char)*s)
+		   || ((*s == '-' || *s == '+' || *s == '.')
+		       && (isdigit((unsigned char)s[1]) || s[1] == '.'))) {
+		ps->p_type = TK_NUMBER;
+		*t++ = *s++;
+		while (isalnum((unsigned char)*s) || *s == '.'
+		       || ((*s == '-' || *s == '+')
+			   && (t[-1] == 'e' || t[-1] == 'E')))
+			*t++ = *s++;
+	} else if (isalpha((unsigned char)*s) || *s == '_') {
+		ps->p_type = TK_WORD;
+		while (isalnum((unsigned char)*s)
+		       || (*s != '\0' && strchr("_$#@", *s)))
+			*t++ = *s++;
+	} else {
+		syntax_error(ps, "column name, literal or operator");
+	}
+
+	*t = '\0';
+	ps->p_next = s;
+}
+
+static void syntax_error(const struct parser *ps, const char *expected)
+{
+	fmt_err_exit("Invalid --where expression, %s expected at: %s",
+		     expected, *ps->p_start ? ps->p_start : "end of expression");
+}
+
+static bool is_keyword(const struct parser *ps, const char *keyword)
+{
+	return ps->p_type == TK_WORD && strcasecmp(ps->p_text, keyword) == 0;
+}
+
+/* skip a token of `type', exits if the current token is not */
+static void expect(struct parser *ps, enum token_type type,
+		   const char *expected)
+{
+	if (ps->p_type != type)
+		syntax_error(ps, expected);
+	next_token(ps);
+}
+
+/* expression: and-expression [OR and-expression]... */
+static struct node *parse_or(struct parser *ps)
+{
+	struct node *nd;
+
+	nd = parse_and(ps);
+	while (is_keyword(ps, "OR")) {
+		next_token(ps);
+		nd = new_node(ND_OR, nd, parse_and(ps));
+	}
+
+	return nd;
+}
+
+/* and-expression: not-expression [AND not-expression]... */
+static struct node *parse_and(struct parser *ps)
+{
+	struct node *nd;
+
+	nd = parse_not(ps);
+	while (is_keyword(ps, "AND")) {
+		next_token(ps);
+		nd = new_node(ND_AND, nd, parse_not(ps));
+	}
+
+	return nd;
+}
+
+/* not-expression: [NOT] not-expression | (expression) | predicate */
+static struct node *parse_not(struct parser *ps)
+{
+	struct node *nd;
+
+	if (is_keyword(ps, "NOT")) {
+		next_token(ps);
+		return new_node(ND_NOT, parse_not(ps), NULL);
+	}
+
+	if (ps->p_type == TK_LPAREN) {
+		next_token(ps);
+		nd = parse_or(ps);
+		expect(ps, TK_RPAREN, "')'");
+		return nd;
+	}
+
+	return parse_predicate(ps);
+}
+
+/*
+ * predicate: column op literal
+ *          | column IS [NOT] NULL
+ *          | column [NOT] IN (literal [, literal]...)
+ *          | column [NOT] BETWEEN literal AND literal
+ */
+static struct node *parse_predicate(struct parser *ps)
+{
+	const struct column_desc *col;
+	struct node *nd;
+	struct node *high;
+	bool negated;
+
+	if (ps->p_type != TK_WORD && ps->p_type != TK_NAME)
+		syntax_error(ps, "column name");
+	col = find_column(ps->p_tbl, ps->p_text);
+	if (!col)
+		fmt_err_exit("Unknown column in --where expression: %s",
+			     ps->p_text);
+	next_token(ps);
+
+	if (ps->p_type == TK_OP) {
+		nd = new_predicate(ND_CMP, col);
+		nd->n_op = parse_op(ps);
+		next_token(ps);
+		add_literal(ps, nd);
+		return nd;
+	}
+
+	if (is_keyword(ps, "IS")) {
+		next_token(ps);
+		negated = is_keyword(ps, "NOT");
+		if (negated)
+			next_token(ps);
+		if (!is_keyword(ps, "NULL"))
+			syntax_error(ps, "NULL");
+		next_token(ps);
+		nd = new_predicate(ND_IS_NULL, col);
+		return negated ? new_node(ND_NOT, nd, NULL) : nd;
+	}
+
+	negated = is_keyword(ps, "NOT");
+	if (negated)
+		next_token(ps);
+
+	nd = NULL;
+	if (is_keyword(ps, "IN")) {
+		next_token(ps);
+		expect(ps, TK_LPAREN, "'('");
+		nd = new_predicate(ND_IN, col);
+		add_literal(ps, nd);
+		while (ps->p_type == TK_COMMA) {
+			next_token(ps);
+			add_literal(ps, nd);
+		}
+		expect(ps, TK_RPAREN, "')'");
+	} else if (is_keyword(ps, "BETWEEN")) {
+		next_token(ps);
+		nd = new_predicate(ND_CMP, col);
+		nd->n_op = OP_GE;
+		add_literal(ps, nd);
+		if (!is_keyword(ps, "AND"))
+			syntax_error(ps, "AND");
+		next_token(ps);
+		high = new_predicate(ND_CMP, col);
+		high->n_op = OP_LE;
+		add_literal(ps, high);
+		nd = new_node(ND_AND, nd, high);
+	} else {
+		syntax_error(ps, "comparison operator, IS, IN or BETWEEN");
+	}
+
+	return negated ? new_node(ND_NOT, nd, NULL) : nd;
+}
+
+static enum cmp_op parse_op(const struct parser *ps)
+{
+	static const struct {
+		const char *name;
+		enum cmp_op op;
+	} OPS[] = {
+		{"=", OP_EQ},
+		{"<>", OP_NE},
+		{"!=", OP_NE},
+		{"<", OP_LT},
+		{"<=", OP_LE},
+		{">", OP_GT},
+		{">=", OP_GE}
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(OPS) / sizeof(OPS[0]); ++i)
+		if (strcmp(ps->p_text, OPS[i].name) == 0)
+			return OPS[i].op;
+
+	syntax_error(ps, "comparison operator");
+	return OP_EQ;
+}
+
+/* encode the current token as a literal of predicate `nd' */
+static void add_literal(struct parser *ps, struct node *nd)
+{
+	if (is_keyword(ps, "NULL"))
+		fmt_err_exit("%s", "Use IS NULL to test for null values "
+			     "in --where expression");
+	if (ps->p_type != TK_STRING && ps->p_type != TK_NUMBER)
+		syntax_error(ps, "literal");
+
+	nd->n_lits = resize_buff(nd->n_lits, (size_t) (nd->n_nlits + 1)
+				 * sizeof(struct literal));
+	encode_literal(ps->p_text, nd, &nd->n_lits[nd->n_nlits++]);
+	next_token(ps);
+}
+
+static struct node *new_node(enum node_type type, struct node *left,
+			     struct node *right)
+{
+	struct node *nd;
+
+	nd = alloc_buff(sizeof(struct node));
+	nd->n_type = type;
+	nd->n_left = left;
+	nd->n_right = right;
+	nd->n_col = NULL;
+	nd->n_kind = VK_NONE;
+	nd->n_op = OP_EQ;
+	nd->n_lits = NULL;
+	nd->n_nlits = 0;
+	nd->n_blank = ' ';
+
+	return nd;
+}
+
+/* new predicate on `col', exits if its values cannot be compared */
+static struct node *new_predicate(enum node_type type,
+				  const struct column_desc *col)
+{
+	struct node *nd;
+
+	nd = new_node(type, NULL, NULL);
+	nd->n_col = col;
+	nd->n_kind = value_kind(col);
+	if (type != ND_IS_NULL && nd->n_kind == VK_NONE)
+		fmt_err_exit("Column %s (data type %d) can only be tested "
+			     "with IS NULL in --where expression",
+			     col->c_name, col->c_type);
+
+	if (col->c_codec && from_utf8(&nd->n_blank, " ", 1, col->c_codec) != 1)
+		nd->n_blank = ' ';
+
+	return nd;
+}
+
+static enum value_kind value_kind(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case SMALLINT:
+	case INTEGER:
+	case BIGINT:
+		return VK_INTEGER;
+	case FLOATING_POINT:
+		return VK_FLOAT;
+	case DECIMAL:
+		return VK_PACKED;
+	case DATE:
+	case TIME:
+	case TIMESTAMP:
+		return VK_DATETIME;
+	case CHAR:
+		return col->c_bitdata ? VK_NONE : VK_CHAR;
+	case VARCHAR:
+	case LONG_VARCHAR:
+		return col->c_bitdata ? VK_NONE : VK_VARCHAR;
+	default:
+		return VK_NONE;
+	}
+}
+
+static void encode_literal(const char *text, const struct node *nd,
+			   struct literal *lit)
+{
+	char *end;
+
+	lit->l_int = 0LL;
+	lit->l_flt = 0.0;
+	lit->l_bytes = NULL;
+	lit->l_len = 0;
+
+	errno = 0;
+	switch (nd->n_kind) {
+	case VK_INTEGER:
+		lit->l_int = strtoll(text, &end, 10);
+		if (errno != 0 || end == text || *end != '\0')
+			bad_literal(text, nd->n_col);
+		break;
+	case VK_FLOAT:
+		lit->l_flt = strtod(text, &end);
+		if (errno != 0 || end == text || *end != '\0')
+			bad_literal(text, nd->n_col);
+		break;
+	case VK_PACKED:
+		encode_packed(text, nd->n_col, lit);
+		break;
+	case VK_DATETIME:
+		encode_datetime(text, nd->n_col, lit);
+		break;
+	case VK_CHAR:
+	case VK_VARCHAR:
+		encode_chars(text, nd->n_col, lit);
+		break;
+	default:
+		break;
+	}
+}
+
+/* encode a decimal literal as a packed decimal of the column's size */
+static void encode_packed(const char *text, const struct column_desc *col,
+			  struct literal *lit)
+{
+	int precision;
+	int scale;
+	const char *s;
+	const char *int_part;	/* significant integer digits */
+	const char *frac_part;
+	size_t int_len;
+	size_t frac_len;
+	size_t pos;		/* nibble of the next digit */
+	size_t i;
+	bool is_neg;
+
+	if (!is_decimal(text))
+		bad_literal(text, col);
+
+	precision = (int)col->c_len / 100;
+	scale = (int)col->c_len % 100;
+	lit->l_len = packed_decimal_size(col->c_len);
+
+	s = text;
+	is_neg = *s == '-';
+	if (*s == '-' || *s == '+')
+		++s;
+	while (*s == '0')
+		++s;
+	int_part = s;
+	for (int_len = 0; isdigit((unsigned char)int_part[int_len]); ++int_len) ;
+	frac_part = int_part + int_len + (int_part[int_len] == '.');
+	frac_len = strlen(frac_part);
+
+	if (int_len > (size_t) (precision - scale))
+		fmt_err_exit("Literal %s out of the range of column %s",
+			     text, col->c_name);
+	for (i = (size_t) scale; i < frac_len; ++i)
+		if (frac_part[i] != '0')
+			fmt_err_exit("Literal %s has more decimal places "
+				     "than column %s", text, col->c_name);
+
+	lit->l_bytes = alloc_buff(lit->l_len);
+	memset(lit->l_bytes, 0, lit->l_len);
+	pos = lit->l_len * 2 - 1 - (size_t) scale - int_len;
+	for (i = 0; i < int_len; ++i)
+		put_nibble(lit->l_bytes, pos++, int_part[i] - '0');
+	for (i = 0; i < frac_len && i < (size_t) scale; ++i)
+		put_nibble(lit->l_bytes, pos++, frac_part[i] - '0');
+	put_nibble(lit->l_bytes, lit->l_len * 2 - 1,
+		   is_neg ? NEGATIVE_SIGN : POSITIVE_SIGN);
+}
+
+/*
+ * Encode a DATE, TIME or TIMESTAMP literal as stored in IXF, that is,
+ * yyyy-mm-dd, hh.mm.ss and yyyy-mm-dd-hh.mm.ss.nnnnnn. Colons are
+ * accepted for dots, a blank or T for the dash before the time of a
+ * TIMESTAMP, which may also omit the time or its fraction of a second.
+ */
+static void encode_datetime(const char *text, const struct column_desc *col,
+			    struct literal *lit)
+{
+	const char *format;
+	size_t len;
+	size_t i;
+
+	format = col->c_type == DATE ? DATE_FORMAT
+	    : col->c_type == TIME ? TIME_FORMAT : TIMESTAMP_FORMAT;
+	len = strlen(text);
+	if (col->c_len > strlen(format) || len > col->c_len
+	    || (len < col->c_len
+		&& !(col->c_type == TIMESTAMP
+		     && (len == DATE_PART_LEN || len >= SECONDS_PART_LEN))))
+		bad_literal(text, col);
+
+	lit->l_len = col->c_len;
+	lit->l_bytes = alloc_buff(lit->l_len);
+	for (i = 0; i < lit->l_len; ++i) {
+		if (i >= len)
+			lit->l_bytes[i] = format[i] == '9' ? '0' : format[i];
+		else if (format[i] == '9' ? isdigit((unsigned char)text[i])
+			 : text[i] == format[i])
+			lit->l_bytes[i] = text[i];
+		else if ((format[i] == '.' && text[i] == ':')
+			 || (format[i] == '-' && i == DATE_PART_LEN
+			     && (text[i] == ' ' || text[i] == 'T')))
+			lit->l_bytes[i] = format[i];
+		else
+			bad_literal(text, col);
+	}
+}
+
+/* encode a character literal into the code page of the column */
+static void encode_chars(const char *text, const struct column_desc *col,
+			 struct literal *lit)
+{
+	ssize_t len;
+
+	len = (ssize_t) strlen(text);
+	lit->l_bytes = alloc_buff(len > 0 ? (size_t) len : 1);
+	if (col->c_codec)
+		len = from_utf8(lit->l_bytes, text, (size_t) len,
+				col->c_codec);
+	else
+		memcpy(lit->l_bytes, text, (size_t) len);
+
+	if (len == -1)
+		fmt_err_exit("Literal '%s' cannot be encoded in code page %d "
+			     "of column %s", text, col->c_sbcp, col->c_name);
+	lit->l_len = (size_t) len;
+}
+
+/* Return true if `text' is [+|-]digits[.[digits]] or [+|-].digits */
+static bool is_decimal(const char *text)
+{
+	size_t digits;
+
+	digits = 0;
+	if (*text == '-' || *text == '+')
+		++text;
+	for (; isdigit((unsigned char)*text); ++text)
+		++digits;
+	if (*text == '.')
+		for (++text; isdigit((unsigned char)*text); ++text)
+			++digits;
+
+	return digits > 0 && *text == '\0';
+}
+
+/* set the `pos'th nibble of `buff', counting from the high one */
+static void put_nibble(unsigned char *buff, size_t pos, int value)
+{
+	if (pos % 2)
+		buff[pos / 2] |= (unsigned char)(value & LOW_NIBBLE);
+	else
+		buff[pos / 2] |= (unsigned char)(value << 4 & HIGH_NIBBLE);
+}
+
+static void bad_literal(const char *text, const struct column_desc *col)
+{
+	fmt_err_exit("Invalid literal for column %s in --where expression: %s",
+		     col->c_name, text);
+}
+
+static enum truth eval_node(const struct node *nd,
+			    const unsigned char *const *recs)
+{
+	const struct column_desc *col;
+	const unsigned char *src;
+	enum truth left;
+	enum truth right;
+	int i;
+
+	switch (nd->n_type) {
+	case ND_AND:
+		left = eval_node(nd->n_left, recs);
+		if (left == T_FALSE)
+			return T_FALSE;
+		right = eval_node(nd->n_right, recs);
+		if (right == T_FALSE)
+			return T_FALSE;
+		return left == T_TRUE && right == T_TRUE ? T_TRUE : T_UNKNOWN;
+	case ND_OR:
+		left = eval_node(nd->n_left, recs);
+		if (left == T_TRUE)
+			return T_TRUE;
+		right = eval_node(nd->n_right, recs);
+		if (right == T_TRUE)
+			return T_TRUE;
+		return left == T_FALSE && right == T_FALSE ? T_FALSE : T_UNKNOWN;
+	case ND_NOT:
+		left = eval_node(nd->n_left, recs);
+		if (left == T_UNKNOWN)
+			return T_UNKNOWN;
+		return left == T_TRUE ? T_FALSE : T_TRUE;
+	default:
+		break;
+	}
+
+	col = nd->n_col;
+	src = recs[col->c_drid - 1] + IXFDCOLS_OFFSET + col->c_offset;
+	if (col->c_nullable) {
+		if (column_is_null(src))
+			return nd->n_type == ND_IS_NULL ? T_TRUE : T_UNKNOWN;
+		src += NULL_VAL_IND_BYTES;
+	}
+
+	if (nd->n_type == ND_IS_NULL)
+		return T_FALSE;
+	if (nd->n_type == ND_CMP)
+		return op_holds(nd->n_op, compare_value(nd, src, nd->n_lits))
+		    ? T_TRUE : T_FALSE;
+
+	for (i = 0; i < nd->n_nlits; ++i)
+		if (compare_value(nd, src, &nd->n_lits[i]) == 0)
+			return T_TRUE;
+	return T_FALSE;
+}
+
+/*
+ * Compares the non-null value at `src' of the column of predicate `nd'
+ * with `lit', returns an integer less than, equal to, or greater than
+ * zero if the value is less than, equal to, or greater than `lit'.
+ */
+static int compare_value(const struct node *nd, const unsigned char *src,
+			 const struct literal *lit)
+{
+	long long int_val;
+	double flt_val;
+	size_t cur_len;
+
+	switch (nd->n_kind) {
+	case VK_INTEGER:
+		int_val = parse_ixf_integer(src, nd->n_col->c_len);
+		return (int_val > lit->l_int) - (int_val < lit->l_int);
+	case VK_FLOAT:
+		flt_val = parse_ixf_float(src, nd->n_col->c_len);
+		return (flt_val > lit->l_flt) - (flt_val < lit->l_flt);
+	case VK_PACKED:
+		return compare_packed_decimal(src, lit->l_bytes, lit->l_len);
+	case VK_DATETIME:
+		return memcmp(src, lit->l_bytes, lit->l_len);
+	case VK_CHAR:
+		return compare_padded(src, nd->n_col->c_len, lit,
+				      nd->n_blank);
+	case VK_VARCHAR:
+		cur_len = get_varchar_cur_len(src);
+		return compare_padded(src + VARCHAR_CUR_LEN_IND_BYTES, cur_len,
+				      lit, nd->n_blank);
+	default:
+		return 0;
+	}
+}
+
+/* compare strings like SQL does, the shorter padded with blanks */
+static int compare_padded(const unsigned char *src, size_t len,
+			  const struct literal *lit, unsigned char blank)
+{
+	size_t common;
+	size_t i;
+	int cmp;
+
+	common = len < lit->l_len ? len : lit->l_len;
+	cmp = memcmp(src, lit->l_bytes, common);
+	if (cmp != 0)
+		return cmp;
+
+	for (i = common; i < len; ++i)
+		if (src[i] != blank)
+			return src[i] - blank;
+	for (i = common; i < lit->l_len; ++i)
+		if (lit->l_bytes[i] != blank)
+			return blank - lit->l_bytes[i];
+
+	return 0;
+}
+
+static bool op_holds(enum cmp_op op, int cmp)
+{
+	switch (op) {
+	case OP_EQ:
+		return cmp == 0;
+	case OP_NE:
+		return cmp != 0;
+	case OP_LT:
+		return cmp < 0;
+	case OP_LE:
+		return cmp <= 0;
+	case OP_GT:
+		return cmp > 0;
+	case OP_GE:
+		return cmp >= 0;
+	default:
+		return false;
+	}
+}
+
+static void free_node(struct node *nd)
+{
+	int i;
+
+	if (!nd)
+		return;
+
+	free_node(nd->n_left);
+	free_node(nd->n_right);
+	for (i = 0; i < nd->n_nlits; ++i)
+		free_buff(nd->n_lits[i].l_bytes);
+	free_buff(nd->n_lits);
+	free_buff(nd);
+}
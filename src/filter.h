@@ -0,0 +1,32 @@
+/*
+ * filter.h - declarations of the row filter of --where
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_FILTER_H_
+#define IXFCVT_FILTER_H_
+
+#include <stdbool.h>
+
+#include "ixfcvt.h"
+
+struct filter;
+
+struct filter *compile_filter(const char *expr, const struct table_desc *tbl);
+bool row_matches(const struct filter *flt, const unsigned char *const *recs);
+void free_filter(struct filter *flt);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * hex.c - encode binary data as hexadecimal digits
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hex.h"
+
+#define LOW_NIBBLE 0x0F
+
+static const char HEX_PAIRS[] =
+    "000102030405060708090A0B0C0D0E0F"
+    "101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F"
+    "303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F"
+    "505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F"
+    "707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F"
+    "909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+    "B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+    "D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+    "F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+#ifdef __SSE2__
+static __m128i nibbles_to_ascii(__m128i nibbles);
+#endif
+
+/*
+ * Writes `len' bytes of `src' to `dst' as upper-case hexadecimal digits,
+ * two per byte, and returns a pointer to the byte following the last
+ * written. With SSE2, 16 bytes are split into nibbles and translated to
+ * 32 digits at a time; the rest goes through a table of digit pairs.
+ */
+char *hex_encode(char *dst, const unsigned char *src, size_t len)
+{
+#ifdef __SSE2__
+	const __m128i MASK = _mm_set1_epi8(LOW_NIBBLE);
+	__m128i bytes;
+	__m128i high;
+	__m128i low;
+
+	for (; len >= 16; len -= 16, src += 16, dst += 32) {
+		bytes = _mm_loadu_si128((const __m128i *)src);
+		high = _mm_and_si128(_mm_srli_epi16(bytes, 4), MASK);
+		low = _mm_and_si128(bytes, MASK);
+		_mm_storeu_si128((__m128i *) dst,
+				 nibbles_to_ascii(_mm_unpacklo_epi8(high, low)));
+		_mm_storeu_si128((__m128i *) (dst + 16),
+				 nibbles_to_ascii(_mm_unpackhi_epi8(high, low)));
+	}
+#endif
+
+	for (; len > 0; --len, dst += HEX_DIGITS_PER_BYTE)
+		memcpy(dst, HEX_PAIRS + *src++ * HEX_DIGITS_PER_BYTE,
+		       HEX_DIGITS_PER_BYTE);
+
+	return dst;
+}
+
+#ifdef __SSE2__
+/* map each byte of value 0-15 to '0'-'9' or 'A'-'F' */
+static __m128i nibbles_to_ascii(__m128i nibbles)
+{
+	const __m128i NINE = _mm_set1_epi8(9);
+	const __m128i DIGIT_ZERO = _mm_set1_epi8('0');
+	const __m128i ALPHA_GAP = _mm_set1_epi8('A' - '0' - 10);
+	__m128i is_alpha;
+
+	is_alpha = _mm_cmpgt_epi8(nibbles, NINE);
+	return _mm_add_epi8(_mm_add_epi8(nibbles, DIGIT_ZERO),
+			    _mm_and_si128(is_alpha, ALPHA_GAP));
+}
+#endif
@@ -0,0 +1,28 @@
+/*
+ * hex.h - declaration of the hexadecimal encoder
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_HEX_H_
+#define IXFCVT_HEX_H_
+
+#include <sys/types.h>
+
+#define HEX_DIGITS_PER_BYTE 2
+
+char *hex_encode(char *dst, const unsigned char *src, size_t len);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * ixf.h - libixf, a library for reading the rows of an IBM PC/IXF file
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * An ixf_file holds all the state of an open file, so that any number of
+ * files can be read at once, each by one thread at a time. No function
+ * exits the process; errors are returned as an ixf_status, with a message
+ * from ixf_errmsg(). Values point into the buffer of the file and stay
+ * valid until the next ixf_next_row() or ixf_close().
+ *
+ *	struct ixf_file *ixf;
+ *	struct ixf_value val;
+ *	int rc;
+ *	int i;
+ *
+ *	if ((rc = ixf_open("t.ixf", &ixf)) != IXF_OK)
+ *		fail(ixf_errmsg(ixf));
+ *	while ((rc = ixf_next_row(ixf)) == IXF_OK)
+ *		for (i = 0; i < ixf_column_count(ixf); ++i)
+ *			ixf_get_value(ixf, i, &val);
+ *	if (rc != IXF_END)
+ *		fail(ixf_errmsg(ixf));
+ *	ixf_close(ixf);
+ */
+
+#ifndef IXFCVT_IXF_H_
+#define IXFCVT_IXF_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* bytes of the buffers of ixf_decimal() and ixf_decfloat() */
+#define IXF_DECIMAL_BUFF_SIZE 40
+#define IXF_DECFLOAT_BUFF_SIZE 64
+
+enum ixf_status {
+	IXF_OK = 0,
+	IXF_END = 1,		/* no more rows */
+	IXF_ERR_IO = -1,	/* open() or read() failed, see errno */
+	IXF_ERR_FORMAT = -2,	/* not a valid IXF file */
+	IXF_ERR_NOMEM = -3,	/* out of memory */
+	IXF_ERR_ARG = -4	/* no such column, or no current row */
+};
+
+/* DB2 data types of the columns */
+enum ixf_type {
+	IXF_CHAR = 452,
+	IXF_VARCHAR = 448,
+	IXF_LONG_VARCHAR = 456,
+	IXF_GRAPHIC = 468,
+	IXF_VARGRAPHIC = 464,
+	IXF_LONG_VARGRAPHIC = 472,
+	IXF_BINARY = 912,
+	IXF_VARBINARY = 908,
+	IXF_SMALLINT = 500,
+	IXF_INTEGER = 496,
+	IXF_BIGINT = 492,
+	IXF_DECIMAL = 484,
+	IXF_DATE = 384,
+	IXF_TIME = 388,
+	IXF_TIMESTAMP = 392,
+	IXF_FLOATING_POINT = 480,	/* REAL if `length' is 4, else DOUBLE */
+	IXF_DECFLOAT = 996,
+	IXF_XML = 988
+};
+
+/* a column of the table of an IXF file */
+struct ixf_column {
+	const char *name;
+	int type;		/* enum ixf_type */
+	size_t length;		/* bytes, characters of GRAPHIC data,
+				   precision * 100 + scale of DECIMAL,
+				   precision (16 or 34) of DECFLOAT */
+	bool nullable;
+	int pk_pos;		/* position in the primary key, 0 if none */
+	int sbcp;		/* single-byte code page */
+	int dbcp;		/* double-byte code page */
+	bool bit_data;		/* binary data, FOR BIT DATA included */
+};
+
+/*
+ * A value of a row, as stored in the IXF file: little-endian integers,
+ * native floats, packed decimals, DECFLOATs in DPD, date and time as
+ * characters, character data in the code page of the column.
+ */
+struct ixf_value {
+	const unsigned char *data;	/* NULL if null */
+	size_t len;		/* bytes at `data' */
+};
+
+struct ixf_file;
+
+int ixf_open(const char *path, struct ixf_file **ixf);
+int ixf_open_fd(int fd, struct ixf_file **ixf);
+void ixf_close(struct ixf_file *ixf);
+const char *ixf_errmsg(const struct ixf_file *ixf);
+
+const char *ixf_table_name(const struct ixf_file *ixf);
+int ixf_column_count(const struct ixf_file *ixf);
+const struct ixf_column *ixf_column(const struct ixf_file *ixf, int i);
+
+int ixf_next_row(struct ixf_file *ixf);
+long ixf_row_number(const struct ixf_file *ixf);
+int ixf_get_value(struct ixf_file *ixf, int i, struct ixf_value *val);
+
+long long ixf_integer(const struct ixf_value *val);
+double ixf_double(const struct ixf_value *val);
+char *ixf_decimal(char *buff, const struct ixf_column *col,
+		  const struct ixf_value *val);
+char *ixf_decfloat(char *buff, const struct ixf_value *val);
+
+#endif
@@ -16,19 +16,113 @@
  * limitations under the License.
  */
 
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "checkpoint.h"
+#include "codepage.h"
+#include "diff.h"
+#include "emit.h"
+#include "filter.h"
 #include "ixfcvt.h"
+#include "metrics.h"
+#include "pagecache.h"
+#include "partition.h"
+#include "sort.h"
+#include "split.h"
+#include "stats.h"
 #include "util.h"
+#include "verify.h"
 
 #define REC_LEN_BYTES 6
+#define IXFDRID_OFFSET 1
+#define IXFDRID_BYTES 3
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+#define MAX_COUNT_LEN 24	/* digits of a long and a newline */
+#define TWO_POW_53 9007199254740992.0	/* 2^53, precision of a double */
+#define READ_AHEAD_SIZE (1UL << 20)	/* bytes read at a time, --split-ixf */
 
+/* where write_sorted_row() writes the sorted rows */
+struct sorted_output {
+	int so_ofd;
+	const struct summary *so_sum;
+	const struct table_desc *so_tbl;
+	long so_skipped;	/* rows skipped for `s_offset' */
+	long so_taken;		/* rows output */
+};
+
+/* the state of the conversion of parse_and_output() */
+struct conversion {
+	int cv_ifd;
+	int cv_ofd;
+	const struct summary *cv_sum;
+	struct table_desc *cv_tbl;
+	unsigned char **cv_recs;	/* D records of a row, by IXFDRID */
+	size_t cv_recsz;	/* size of each buffer of `cv_recs' */
+	size_t *cv_lens;	/* bytes of each record of `cv_recs' */
+	struct filter *cv_flt;	/* rows to output, NULL for all */
+	uint64_t cv_nold;	/* rows of the older file of --diff */
+	long cv_rows;		/* rows read */
+	long cv_skipped;	/* rows skipped for `s_offset' */
+	long cv_taken;		/* rows output */
+	int cv_to_poll;		/* rows before the next poll of the progress */
+};
+
+static void init_conversion(struct conversion *cv, int ifd, int ofd,
+			    const struct summary *sum);
+static void add_column(const unsigned char *rec, size_t len,
+		       struct table_desc *tbl);
+static void start_rows(struct conversion *cv);
+static bool resume_rows(struct conversion *cv);
+static void output_row(struct conversion *cv);
+static void finish_rows(struct conversion *cv);
+static void write_trailer(const struct conversion *cv, int cfd,
+			  off_t first_d, bool all_read);
+static void free_conversion(struct conversion *cv);
 static ssize_t get_record_len(int fd);
 static void get_record(int fd, unsigned char *rec, size_t rec_size);
+static ssize_t read_input(int fd, unsigned char *dst, size_t n);
+static void start_read_ahead(int fd);
+static void stop_read_ahead(void);
+static unsigned char **prepare_rows(struct table_desc *tbl,
+				    const struct summary *sum,
+				    unsigned char **recs, size_t recsz);
+static void grow_rows(unsigned char **recs, int nrecs, size_t recsz);
+static void free_rows(unsigned char **recs, int ndrec);
+static bool row_selected(const struct summary *sum, const struct filter *flt,
+			 const unsigned char *const *recs, long rowno);
+static bool row_sampled(unsigned long seed, long rowno, double fraction);
+static bool all_rows_wanted(const struct summary *sum);
+static void write_count(int fd, long rows);
+static void poll_progress(long rows, long taken, const struct summary *sum,
+			  const struct table_desc *tbl);
+static void write_partitioned(const unsigned char *const *recs,
+			      const size_t *lens, const struct summary *sum,
+			      const struct table_desc *tbl);
+static long write_sorted_rows(int ofd, const struct summary *sum,
+			      const struct table_desc *tbl);
+static bool write_sorted_row(const unsigned char *const *recs,
+			     const size_t *lens, uint64_t seq, void *arg);
+static uint64_t add_old_rows(int fd, const struct summary *sum,
+			     const struct table_desc *tbl,
+			     const struct filter *flt);
+static void check_same_columns(const struct table_desc *old,
+			       const struct table_desc *tbl);
+static void check_d_record_id(const unsigned char *rec, int expected);
+static void invalid_c_record(const struct column_desc *col);
+static void choose_codec(struct column_desc *col);
 static void append_column(struct column_desc *col, struct table_desc *tbl);
 static void free_table(struct table_desc *tbl);
 static void free_columns(struct column_desc *head);
 
+/* the input read ahead in large blocks, when its offset is not needed */
+static int ahead_fd = -1;	/* -1 if none */
+static unsigned char *ahead;
+static size_t ahead_pos;	/* of the next byte to return */
+static size_t ahead_len;	/* bytes in `ahead' */
+
 /*
  * perform the conversion process
  *
@@ -38,31 +132,88 @@ static void free_columns(struct column_desc *head);
  */
 void parse_and_output(int ifd, int ofd, int cfd, const struct summary *sum)
 {
+	struct conversion cv;
 	struct table_desc *tbl;
-	struct column_desc *col;
 	unsigned char *rec;
+	int drid;		/* index of the next D record of a row */
+	bool done;		/* no more rows wanted */
+	off_t first_d;		/* offset of the first D record, -1 if none */
 	ssize_t rec_len;
 
-	rec = alloc_buff(sum->s_recsz);
-	tbl = alloc_buff(sizeof(struct table_desc));
-	tbl->c_head = NULL;
+	init_conversion(&cv, ifd, ofd, sum);
+	tbl = cv.cv_tbl;
+	drid = 0;
+	done = false;
+	first_d = -1;
 
-	while ((rec_len = get_record_len(ifd)) > 0) {
+	/* nothing else reads the input or needs its offset */
+	if (sum->s_split)
+		start_read_ahead(ifd);
+	enter_phase(PHASE_SCHEMA);
+	while (!done && (rec_len = get_record_len(ifd)) > 0) {
+		if ((size_t) rec_len > cv.cv_recsz) {
+			cv.cv_recsz = (size_t) rec_len;
+			grow_rows(cv.cv_recs, tbl->t_sel ? tbl->t_ndrec : 1,
+				  cv.cv_recsz);
+		}
+		rec = cv.cv_recs[drid];
 		get_record(ifd, rec, (size_t) rec_len);
+		count_record(*rec, (size_t) rec_len);
+		/*
+		 * all but the rows go to every file of --split-ixf, except
+		 * an A record within a row, which goes with the row
+		 */
+		if (sum->s_split && *rec != 'D') {
+			if (drid == 0)
+				split_record(ALL_SPLITS, rec, (size_t) rec_len);
+			else
+				hold_record(rec, (size_t) rec_len, drid);
+		}
 
 		switch (*rec) {
 		case 'H':
 			break;
 		case 'T':
-			parse_t_record(rec, tbl, sum->s_tname);
+			if (!parse_t_record(rec, tbl, sum->s_tname))
+				fmt_err_exit("%s", "Invalid T record");
 			break;
 		case 'C':
-			col = alloc_buff(sizeof(struct column_desc));
-			parse_c_record(rec, col);
-			append_column(col, tbl);
+			add_column(rec, (size_t) rec_len, tbl);
 			break;
 		case 'D':
-			d_record_to_sql(ofd, rec, sum, tbl);
+			if (sum->s_verify) {
+				/* read again from here by verify_file() */
+				first_d = seek_file(ifd, 0, SEEK_CUR)
+				    - (off_t) (REC_LEN_BYTES + rec_len);
+				done = true;
+				break;
+			}
+			if (sum->s_schema_only || sum->s_emit
+			    || (drid == 0 && cv.cv_taken == sum->s_limit)) {
+				done = true;
+				break;
+			}
+			if (!tbl->t_sel) {
+				enter_phase(PHASE_ROWS);
+				start_rows(&cv);
+				if (sum->s_count && all_rows_wanted(sum)) {
+					/* counted by get_ixf_summary() */
+					cv.cv_taken = sum->s_dcnt
+					    / tbl->t_ndrec;
+					done = true;
+					break;
+				}
+				if (resume_rows(&cv))
+					break;
+			}
+			if (tbl->t_ndrec > 1)
+				check_d_record_id(rec, drid + 1);
+			cv.cv_lens[drid] = (size_t) rec_len;
+			if (++drid < tbl->t_ndrec)
+				break;
+
+			drid = 0;
+			output_row(&cv);
 			break;
 		case 'A':
 			break;
@@ -74,12 +225,532 @@ void parse_and_output(int ifd, int ofd, int cfd, const struct summary *sum)
 
 	if (rec_len == -1)
 		err_exit("read");
+	if (drid != 0)
+		fmt_err_exit("%s", "Incomplete row at the end of input file");
+	stop_read_ahead();
+	if (sum->s_progress)
+		show_progress(1L, 1L);	/* or stopped before the last row */
+	finish_rows(&cv);
+	write_trailer(&cv, cfd, first_d, rec_len == 0);
+	free_conversion(&cv);
+}
+
+/* set up `cv' to convert the input `ifd' to `ofd' */
+static void init_conversion(struct conversion *cv, int ifd, int ofd,
+			    const struct summary *sum)
+{
+	struct table_desc *tbl;
+
+	cv->cv_ifd = ifd;
+	cv->cv_ofd = ofd;
+	cv->cv_sum = sum;
+	cv->cv_recsz = sum->s_recsz;
+	cv->cv_recs = alloc_buff(sizeof(unsigned char *));
+	cv->cv_recs[0] = alloc_buff(cv->cv_recsz);
+	tbl = alloc_buff(sizeof(struct table_desc));
+	tbl->t_ncols = 0;
+	tbl->t_ndrec = 0;
+	tbl->c_head = NULL;
+	tbl->t_sel = NULL;
+	tbl->t_digest = FNV1A_BASIS;
+	cv->cv_tbl = tbl;
+	cv->cv_lens = NULL;
+	cv->cv_flt = NULL;
+	cv->cv_nold = 0;
+	cv->cv_rows = cv->cv_skipped = cv->cv_taken = 0L;
+	cv->cv_to_poll = METRICS_POLL_ROWS;
+}
+
+/* add the column of the C record `rec' of `len' bytes to `tbl' */
+static void add_column(const unsigned char *rec, size_t len,
+		       struct table_desc *tbl)
+{
+	struct column_desc *col;
+
+	col = alloc_buff(sizeof(struct column_desc));
+	if (!parse_c_record(rec, col))
+		invalid_c_record(col);
+	choose_codec(col);
+	append_column(col, tbl);
+	tbl->t_digest = fnv1a_hash(tbl->t_digest, rec, len);
+}
+
+/*
+ * prepare `cv' for the rows, once all the columns are known: the buffers
+ * of a row, the --where filter and the rows of the older file of --diff
+ */
+static void start_rows(struct conversion *cv)
+{
+	const struct summary *sum;
+	struct table_desc *tbl;
+
+	sum = cv->cv_sum;
+	tbl = cv->cv_tbl;
+	cv->cv_recs = prepare_rows(tbl, sum, cv->cv_recs, cv->cv_recsz);
+	cv->cv_lens = alloc_buff((size_t) tbl->t_ndrec * sizeof(*cv->cv_lens));
+	if (sum->s_where)
+		cv->cv_flt = compile_filter(sum->s_where, tbl);
+	if (sum->s_diff_fd >= 0)
+		cv->cv_nold = add_old_rows(sum->s_diff_fd, sum, tbl,
+					   cv->cv_flt);
+}
+
+/*
+ * Moves the input of `cv' to the checkpoint of --resume, the rows before
+ * it being output. Returns false if there is no checkpoint to resume from.
+ */
+static bool resume_rows(struct conversion *cv)
+{
+	struct checkpoint ck;
+
+	if (!get_resume_point(&ck))
+		return false;
+
+	seek_file(cv->cv_ifd, ck.ck_ixf, SEEK_SET);
+	cv->cv_rows = ck.ck_rows;
+	cv->cv_skipped = ck.ck_skipped;
+	cv->cv_taken = ck.ck_taken;
+	return true;
+}
+
+/*
+ * output the row read into `cv', unless it is not selected or skipped for
+ * --offset, or keep it for --sort-by-pk; rows not wanted are never
+ * formatted
+ */
+static void output_row(struct conversion *cv)
+{
+	const struct summary *sum;
+	const unsigned char *const *recs;
+
+	sum = cv->cv_sum;
+	recs = (const unsigned char *const *)cv->cv_recs;
+	if (--cv->cv_to_poll == 0) {
+		cv->cv_to_poll = METRICS_POLL_ROWS;
+		poll_metrics(cv->cv_rows, cv->cv_taken);
+		poll_progress(cv->cv_rows, cv->cv_taken, sum, cv->cv_tbl);
+	}
+	if (!row_selected(sum, cv->cv_flt, recs, cv->cv_rows++)) {
+		if (sum->s_split)
+			drop_held();
+		return;
+	}
+	if (sum->s_sort) {
+		/* sorted rows come after all other records */
+		if (sum->s_split)
+			split_held(ALL_SPLITS);
+		/* --offset and --limit count sorted rows */
+		add_sort_row(recs, cv->cv_lens);
+		return;
+	}
+	if (cv->cv_skipped < sum->s_offset) {
+		if (sum->s_split)
+			drop_held();
+		++cv->cv_skipped;
+		return;
+	}
+
+	if (sum->s_profile)
+		row_to_profile(recs, cv->cv_tbl);
+	else if (sum->s_nparts > 0)
+		write_partitioned(recs, cv->cv_lens, sum, cv->cv_tbl);
+	else if (!sum->s_count
+		 && row_to_sql(cv->cv_ofd, 0, recs, sum, cv->cv_tbl))
+		save_checkpoint(cv->cv_ifd, cv->cv_ofd, cv->cv_rows,
+				cv->cv_skipped, cv->cv_taken + 1);
+	++cv->cv_taken;
+}
+
+/*
+ * output the rows kept for --diff or --sort-by-pk once all the rows are
+ * read, and count the rows of `cv'
+ */
+static void finish_rows(struct conversion *cv)
+{
+	const struct summary *sum;
+	struct table_desc *tbl;
+
+	sum = cv->cv_sum;
+	tbl = cv->cv_tbl;
+	/* no row in the newer file, all the older ones are deleted */
+	if (sum->s_diff_fd >= 0 && !tbl->t_sel && tbl->t_ndrec > 0)
+		start_rows(cv);
+
+	if (sum->s_diff_fd >= 0 && tbl->t_sel)
+		cv->cv_taken = write_diff(cv->cv_ofd, cv->cv_nold, sum, tbl);
+	else if (sum->s_sort && tbl->t_sel)
+		cv->cv_taken = write_sorted_rows(cv->cv_ofd, sum, tbl);
+	count_rows(cv->cv_rows, cv->cv_taken);
+	close_metrics(cv->cv_rows, cv->cv_taken);
+}
+
+/*
+ * write what follows the rows of `cv': the profile, the converter, the
+ * verification or the count, or else the end of the SQL and the CREATE
+ * TABLE statement to `cfd'. `first_d' is the offset of the first D
+ * record, `all_read' whether the rows were read to the end of the input.
+ */
+static void write_trailer(const struct conversion *cv, int cfd,
+			  off_t first_d, bool all_read)
+{
+	const struct summary *sum;
+	struct table_desc *tbl;
+
+	sum = cv->cv_sum;
+	tbl = cv->cv_tbl;
+	enter_phase(PHASE_DDL);
+	if (!tbl->t_sel)
+		select_columns(tbl, sum->s_cols);
+	if (sum->s_profile) {
+		profile_to_json(cv->cv_ofd, tbl);
+	} else if (sum->s_emit) {
+		emit_converter(cv->cv_ofd, sum, tbl);
+	} else if (sum->s_verify) {
+		verify_file(cv->cv_ifd, cv->cv_ofd, sum, tbl, first_d);
+	} else if (sum->s_count) {
+		write_count(cv->cv_ofd, cv->cv_taken);
+	} else {
+		finish_sql(sum->s_nparts > 0 ? partition_fds() : &cv->cv_ofd,
+			   sum);
+		if (all_read)	/* all rows are output */
+			save_checkpoint(cv->cv_ifd, cv->cv_ofd, cv->cv_rows,
+					cv->cv_skipped, cv->cv_taken);
+		/* output CREATE TABLE statement */
+		table_desc_to_sql(cfd, sum, tbl);
+	}
+}
+
+/* free the buffers, the filter and the table of `cv' */
+static void free_conversion(struct conversion *cv)
+{
+	/* only the first buffer exists if no row was prepared */
+	free_rows(cv->cv_recs, cv->cv_tbl->t_sel ? cv->cv_tbl->t_ndrec : 1);
+	free_buff(cv->cv_lens);
+	if (cv->cv_flt)
+		free_filter(cv->cv_flt);
+	free_table(cv->cv_tbl);
+}
+
+/*
+ * Return true if the `rowno'th row (from 0) of the file, held in `recs',
+ * is in the sample and satisfies the --where expression `flt'.
+ */
+static bool row_selected(const struct summary *sum, const struct filter *flt,
+			 const unsigned char *const *recs, long rowno)
+{
+	if (sum->s_sample < 1.0
+	    && !row_sampled(sum->s_seed, rowno, sum->s_sample))
+		return false;
+
+	return !flt || row_matches(flt, recs);
+}
+
+/*
+ * Decides whether a row is in a sample of `fraction' of the rows by a
+ * hash of its number and `seed', so that the sample of a file with the
+ * same seed is always the same.
+ */
+static bool row_sampled(unsigned long seed, long rowno, double fraction)
+{
+	uint64_t x;
 
-	/* output CREATE TABLE statement */
-	table_desc_to_sql(cfd, tbl);
+	x = hash64((uint64_t) seed * GOLDEN_GAMMA + (uint64_t) rowno);
 
-	free_buff(rec);
-	free_table(tbl);
+	return (double)(x >> 11) / TWO_POW_53 < fraction;
+}
+
+/* Return true if no --where, --sample, --offset or --limit is given. */
+static bool all_rows_wanted(const struct summary *sum)
+{
+	return !sum->s_where && !(sum->s_sample < 1.0) && sum->s_offset == 0
+	    && sum->s_limit < 0;
+}
+
+/* write the number of rows for --count */
+static void write_count(int fd, long rows)
+{
+	char buff[MAX_COUNT_LEN];
+
+	sprintf(buff, "%ld\n", rows);
+	write_file(fd, buff);
+}
+
+/*
+ * show the percent of the rows read, or of the rows of --limit output when
+ * the rows are not counted, every METRICS_POLL_ROWS rows
+ */
+static void poll_progress(long rows, long taken, const struct summary *sum,
+			  const struct table_desc *tbl)
+{
+	if (!sum->s_progress)
+		return;
+
+	if (sum->s_dcnt > 0)
+		show_progress(rows, sum->s_dcnt / tbl->t_ndrec);
+	else if (sum->s_limit > 0)
+		show_progress(taken, sum->s_limit);
+}
+
+/*
+ * write the row in D records `recs', of `lens' bytes each, to the output
+ * partition of its key, or the next one with --round-robin
+ */
+static void write_partitioned(const unsigned char *const *recs,
+			      const size_t *lens, const struct summary *sum,
+			      const struct table_desc *tbl)
+{
+	int part;
+
+	part = sum->s_round_robin ? next_partition() : partition_of(recs);
+	if (sum->s_split)
+		split_row(part, recs, lens, tbl->t_ndrec);
+	else
+		row_to_sql(partition_fds()[part], part, recs, sum, tbl);
+}
+
+/*
+ * Writes the rows sorted by --sort-by-pk to `ofd', or to the partitions,
+ * after --offset and up to --limit. Returns the number of rows output.
+ */
+static long write_sorted_rows(int ofd, const struct summary *sum,
+			      const struct table_desc *tbl)
+{
+	struct sorted_output so;
+
+	so.so_ofd = ofd;
+	so.so_sum = sum;
+	so.so_tbl = tbl;
+	so.so_skipped = 0L;
+	so.so_taken = 0L;
+	if (sum->s_limit != 0)
+		output_sorted_rows(write_sorted_row, &so);
+	close_sort();
+
+	return so.so_taken;
+}
+
+/* write a row of output_sorted_rows(), returns false after --limit rows */
+static bool write_sorted_row(const unsigned char *const *recs,
+			     const size_t *lens, uint64_t seq, void *arg)
+{
+	struct sorted_output *so;
+
+	(void)seq;
+	so = arg;
+	if (so->so_skipped < so->so_sum->s_offset) {
+		++so->so_skipped;
+		return true;
+	}
+
+	if (so->so_sum->s_nparts > 0)
+		write_partitioned(recs, lens, so->so_sum, so->so_tbl);
+	else
+		row_to_sql(so->so_ofd, 0, recs, so->so_sum, so->so_tbl);
+
+	return ++so->so_taken != so->so_sum->s_limit;
+}
+
+/*
+ * Adds the rows of the older IXF file `fd' of --diff that are in the
+ * sample and satisfy `flt' to the sort, after making sure that it has
+ * the columns of `tbl'. Returns the number of rows added.
+ */
+static uint64_t add_old_rows(int fd, const struct summary *sum,
+			     const struct table_desc *tbl,
+			     const struct filter *flt)
+{
+	struct summary old_sum;
+	struct table_desc *old;
+	struct column_desc *col;
+	unsigned char **recs;	/* D records of a row, by IXFDRID */
+	unsigned char *rec;
+	size_t *lens;
+	size_t recsz;
+	bool checked;		/* columns compared */
+	uint64_t added;
+	long rows;
+	int drid;
+	int i;
+	ssize_t rec_len;
+
+	old_sum = *sum;
+	old_sum.s_scan_all = false;
+	get_ixf_summary(fd, &old_sum);
+	if (old_sum.s_ccnt == 0)
+		fmt_err_exit("%s", "No C record in the older file of --diff");
+
+	recsz = old_sum.s_recsz;
+	recs = alloc_buff((size_t) tbl->t_ndrec * sizeof(*recs));
+	lens = alloc_buff((size_t) tbl->t_ndrec * sizeof(*lens));
+	for (i = 0; i < tbl->t_ndrec; ++i)
+		recs[i] = alloc_buff(recsz);
+	old = alloc_buff(sizeof(struct table_desc));
+	old->t_name = NULL;
+	old->t_pkname = NULL;
+	old->t_ncols = 0;
+	old->t_ndrec = 0;
+	old->c_head = NULL;
+	old->t_sel = NULL;
+	old->t_digest = FNV1A_BASIS;
+	checked = false;
+	added = 0;
+	rows = 0L;
+	drid = 0;
+
+	while ((rec_len = get_record_len(fd)) > 0) {
+		if ((size_t) rec_len > recsz) {
+			recsz = (size_t) rec_len;
+			grow_rows(recs, tbl->t_ndrec, recsz);
+		}
+		rec = recs[drid];
+		get_record(fd, rec, (size_t) rec_len);
+
+		switch (*rec) {
+		case 'H':
+		case 'A':
+			break;
+		case 'T':
+			if (!parse_t_record(rec, old, sum->s_tname))
+				fmt_err_exit("%s", "Invalid T record");
+			break;
+		case 'C':
+			col = alloc_buff(sizeof(struct column_desc));
+			if (!parse_c_record(rec, col))
+				invalid_c_record(col);
+			append_column(col, old);
+			break;
+		case 'D':
+			if (!checked) {
+				check_same_columns(old, tbl);
+				checked = true;
+			}
+			if (tbl->t_ndrec > 1)
+				check_d_record_id(rec, drid + 1);
+			lens[drid] = (size_t) rec_len;
+			if (++drid < tbl->t_ndrec)
+				break;
+
+			drid = 0;
+			if (row_selected(sum, flt, (const unsigned char *const *)
+					 recs, rows++)) {
+				add_sort_row((const unsigned char *const *)recs,
+					     lens);
+				++added;
+			}
+			break;
+		default:
+			fmt_err_exit("Unknown record type encountered: %c",
+				     *rec);
+		}
+	}
+
+	if (rec_len == -1)
+		err_exit("read");
+	if (drid != 0)
+		fmt_err_exit("%s", "Incomplete row at the end of older file");
+	if (!checked)
+		check_same_columns(old, tbl);
+
+	for (i = 0; i < tbl->t_ndrec; ++i)
+		free_buff(recs[i]);
+	free_buff(recs);
+	free_buff(lens);
+	free_table(old);
+
+	return added;
+}
+
+/*
+ * make sure the older file `old' of --diff has the columns of `tbl',
+ * stored alike, exits otherwise
+ */
+static void check_same_columns(const struct table_desc *old,
+			       const struct table_desc *tbl)
+{
+	const struct column_desc *a;
+	const struct column_desc *b;
+
+	for (a = old->c_head, b = tbl->c_head; a && b;
+	     a = a->next, b = b->next)
+		if (strcmp(a->c_name, b->c_name) != 0
+		    || a->c_type != b->c_type || a->c_len != b->c_len
+		    || a->c_offset != b->c_offset || a->c_drid != b->c_drid
+		    || a->c_nullable != b->c_nullable
+		    || a->c_pkpos != b->c_pkpos || a->c_sbcp != b->c_sbcp
+		    || a->c_dbcp != b->c_dbcp)
+			fmt_err_exit("Column %s differs in the older file",
+				     b->c_name);
+	if (a || b)
+		fmt_err_exit("%s", "The older file has other columns");
+}
+
+/*
+ * Chooses the columns to output and allocates a buffer of `recsz' bytes
+ * for each D record of a row, the first of which is `recs[0]'.
+ * Returns the reallocated array of buffers.
+ */
+static unsigned char **prepare_rows(struct table_desc *tbl,
+				    const struct summary *sum,
+				    unsigned char **recs, size_t recsz)
+{
+	int i;
+
+	if (tbl->t_ndrec == 0)
+		fmt_err_exit("%s", "D record found before any C record");
+	select_columns(tbl, sum->s_cols);
+	if (sum->s_nparts > 0 && !sum->s_round_robin)
+		set_partition_key(tbl, sum->s_pkey);
+	if (sum->s_sort)
+		open_sort(tbl, sum->s_skey, sum->s_sort_mem);
+
+	recs = resize_buff(recs, (size_t) tbl->t_ndrec * sizeof(*recs));
+	for (i = 1; i < tbl->t_ndrec; ++i)
+		recs[i] = alloc_buff(recsz);
+
+	return recs;
+}
+
+/* enlarge the first `nrecs' buffers of `recs' to `recsz' bytes */
+static void grow_rows(unsigned char **recs, int nrecs, size_t recsz)
+{
+	int i;
+
+	for (i = 0; i < nrecs; ++i)
+		recs[i] = resize_buff(recs[i], recsz);
+}
+
+/* free the D record buffers allocated by prepare_rows() */
+static void free_rows(unsigned char **recs, int ndrec)
+{
+	int i;
+
+	for (i = 1; i < ndrec; ++i)
+		free_buff(recs[i]);
+	free_buff(recs[0]);
+	free_buff(recs);
+}
+
+/* make sure the D records of a row come in order, exits otherwise */
+static void check_d_record_id(const unsigned char *rec, int expected)
+{
+	char buff[IXFDRID_BYTES + 1];
+	long drid;
+
+	memcpy(buff, rec + IXFDRID_OFFSET, IXFDRID_BYTES);
+	buff[IXFDRID_BYTES] = '\0';
+	drid = str_to_long(buff);
+	if (drid != expected)
+		fmt_err_exit("D record %ld found where %d expected", drid,
+			     expected);
+}
+
+/* exit on a C record parse_c_record() failed, naming its column if read */
+static void invalid_c_record(const struct column_desc *col)
+{
+	if (!col->c_name)
+		fmt_err_exit("%s", "Invalid C record");
+	fmt_err_exit("Invalid C record of column %s, of type %d and length "
+		     "%lu", col->c_name, col->c_type, (unsigned long)col->c_len);
 }
 
 /* Fills the buffer with a record, exits on error. */
@@ -87,41 +758,128 @@ static void get_record(int fd, unsigned char *rec, size_t rec_size)
 {
 	ssize_t n_read;
 
-	n_read = read(fd, rec, rec_size);
+	n_read = read_input(fd, rec, rec_size);
 	if (n_read == -1)
 		err_exit("read");
 	else if ((size_t) n_read < rec_size)
 		fmt_err_exit("%s", "Error reading input file");
-
 }
 
 /* Returns the size of next record on success, -1 on error, 0 on EOF. */
 static ssize_t get_record_len(int fd)
 {
-	static char buff[REC_LEN_BYTES + 1];
+	static unsigned char buff[REC_LEN_BYTES + 1];
 	ssize_t num_read;
 
-	num_read = read(fd, buff, REC_LEN_BYTES);
+	num_read = read_input(fd, buff, REC_LEN_BYTES);
 	if (num_read == REC_LEN_BYTES)
-		return str_to_long(buff);
+		return str_to_long((char *)buff);
 	else
 		return num_read;
 }
 
-/* append a column description structure to the singly-linked list */
+/*
+ * Reads `n' bytes of `fd' into `dst', from the bytes read ahead if `fd'
+ * is read ahead. Returns the bytes read, fewer only at the end of the
+ * file, or -1 on error.
+ */
+static ssize_t read_input(int fd, unsigned char *dst, size_t n)
+{
+	ssize_t num_read;
+	size_t done;
+	size_t len;
+
+	if (fd != ahead_fd) {
+		num_read = read(fd, dst, n);
+		if (num_read >= 0) {
+			count_read((size_t) num_read);
+			cache_read(fd, (size_t) num_read);
+		}
+		return num_read;
+	}
+
+	for (done = 0; done < n; done += len) {
+		if (ahead_pos == ahead_len) {
+			num_read = read(fd, ahead, READ_AHEAD_SIZE);
+			if (num_read == -1)
+				return -1;
+			count_read((size_t) num_read);
+			cache_read(fd, (size_t) num_read);
+			if (num_read == 0)
+				break;
+			ahead_pos = 0;
+			ahead_len = (size_t) num_read;
+		}
+		len = ahead_len - ahead_pos < n - done ? ahead_len - ahead_pos
+		    : n - done;
+		memcpy(dst + done, ahead + ahead_pos, len);
+		ahead_pos += len;
+	}
+
+	return (ssize_t) done;
+}
+
+/*
+ * Reads `fd' READ_AHEAD_SIZE bytes at a time rather than a record at a
+ * time, from its current offset, which is no longer kept in step.
+ */
+static void start_read_ahead(int fd)
+{
+	ahead = alloc_buff(READ_AHEAD_SIZE);
+	ahead_pos = ahead_len = 0;
+	ahead_fd = fd;
+}
+
+/* read the input a record at a time again */
+static void stop_read_ahead(void)
+{
+	free_buff(ahead);
+	ahead = NULL;
+	ahead_fd = -1;
+}
+
+/* pick the transcoder of a character column by its code page */
+static void choose_codec(struct column_desc *col)
+{
+	switch (col->c_type) {
+	case CHAR:
+	case VARCHAR:
+	case LONG_VARCHAR:
+		col->c_codec = find_codec(col->c_sbcp);
+		break;
+	case GRAPHIC:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		col->c_codec = find_codec(col->c_dbcp);
+		break;
+	default:
+		col->c_codec = NULL;
+		break;
+	}
+}
+
+/*
+ * append a column description structure to the singly-linked list,
+ * numbering the columns and counting D records per row on the way
+ */
 static void append_column(struct column_desc *col, struct table_desc *tbl)
 {
 	struct column_desc *node;
 
+	col->c_colno = 1;
 	if (tbl->c_head) {
 		node = tbl->c_head;
 		while (node->next)
 			node = node->next;
 		node->next = col;
+		col->c_colno = node->c_colno + 1;
 	} else {
 		tbl->c_head = col;
 	}
 	col->next = NULL;
+
+	if (col->c_drid > tbl->t_ndrec)
+		tbl->t_ndrec = col->c_drid;
 }
 
 /* free truct table_desc */
@@ -130,6 +888,7 @@ static void free_table(struct table_desc *tbl)
 	free_buff(tbl->t_name);
 	free_buff(tbl->t_pkname);
 	free_columns(tbl->c_head);
+	free_buff(tbl->t_sel);
 	free_buff(tbl);
 }
 
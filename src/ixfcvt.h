@@ -20,14 +20,23 @@
 #define IXFCVT_IXFCVT_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #define E_DATA_TYPE_NOT_IMPL "data type (%d) not yet implemented"
+#define E_XML_COLUMN "Column %s is XML, whose documents are kept outside " \
+	"the IXF file; leave it out with --columns"
 
 enum DB2_DATA_TYPE {
 	/* *not* a complete list */
 	CHAR = 452,
 	VARCHAR = 448,
+	LONG_VARCHAR = 456,
+	GRAPHIC = 468,
+	VARGRAPHIC = 464,
+	LONG_VARGRAPHIC = 472,
+	BINARY = 912,
+	VARBINARY = 908,
 	SMALLINT = 500,
 	INTEGER = 496,
 	BIGINT = 492,
@@ -35,19 +44,61 @@ enum DB2_DATA_TYPE {
 	DATE = 384,
 	TIME = 388,
 	TIMESTAMP = 392,
-	FLOATING_POINT = 480	/* DOUBLE or REAL */
+	FLOATING_POINT = 480,	/* DOUBLE or REAL */
+	DECFLOAT = 996,
+	XML = 988		/* XML data specifier (XDS) */
+};
+
+/* dialect of the generated SQL */
+enum sql_dialect {
+	SQL_DB2,
+	SQL_POSTGRESQL,
+	SQL_MYSQL,
+	SQL_ORACLE,
+	SQL_SQLITE
 };
 
 /* requirements and basic info of input IXF file */
 struct summary {
 	int s_cmtsz;		/* commit size */
+	size_t s_commit_bytes;	/* bytes between COMMITs, 0 for no limit */
+	long s_insert_rows;	/* rows of an INSERT at most, 0 for no limit */
+	size_t s_insert_bytes;	/* bytes of an INSERT at most, 0 for no limit */
 	char *s_tname;		/* user-defined table name */
 	bool s_escbs;		/* escape backslash */
+	enum sql_dialect s_dialect;	/* target database */
+	const char *s_cols;	/* columns to output, NULL for all */
+	const char *s_where;	/* row filter expression, NULL for all */
+	long s_limit;		/* maximum rows to output, -1 for all */
+	long s_offset;		/* rows to skip before output */
+	double s_sample;	/* fraction of rows to sample, 1 for all */
+	unsigned long s_seed;	/* seed of the sampling */
+	bool s_profile;		/* output column statistics, not SQL */
+	bool s_schema_only;	/* output CREATE TABLE only */
+	bool s_count;		/* output the number of rows only */
+	bool s_scan_all;	/* count D records in advance */
+	int s_threads;		/* threads of the count and --verify */
+	int s_nparts;		/* output partitions, 0 if not partitioned */
+	const char *s_pkey;	/* columns to partition by, NULL for the pk */
+	bool s_sort;		/* output the rows in key order */
+	const char *s_skey;	/* columns to sort by, NULL for the pk */
+	size_t s_sort_mem;	/* bytes of rows sorted in memory at most */
+	int s_diff_fd;		/* older file of --diff, -1 if none */
+	bool s_split;		/* copy the rows to IXF partitions, not SQL */
+	bool s_round_robin;	/* deal the rows to the partitions in turn */
+	bool s_memoize;		/* cache the SQL text of repeated values */
+	int s_post_fd;		/* post-load DDL script, -1 if none */
+	bool s_emit;		/* output a converter of the table, not SQL */
+	bool s_verify;		/* check the file, not convert it */
+	int s_max_errors;	/* errors reported by --verify at most */
+	bool s_progress;	/* show the percent done on stderr */
 	int s_ccnt;		/* C record count */
-	long s_dcnt;		/* D record conut */
+	long s_dcnt;		/* D record conut, -1 if not counted */
 	size_t s_recsz;		/* maximum record size */
 };
 
+struct codec;
+
 /* TO-DO: IXFCDEFL, IXFCDEFV */
 /* singly linked list of column definition */
 struct column_desc {
@@ -57,8 +108,14 @@ struct column_desc {
 	/* If data type is decimal, the first 3 digits of `c_len'
 	   is the precision, the last 2 digits is the scale */
 	off_t c_offset;		/* offset from beginning of a D record */
+	int c_drid;		/* which D record of a row holds it, from 1 */
+	int c_colno;		/* ordinal position in the table, from 1 */
 	bool c_nullable;	/* whether accepts null values */
 	int c_pkpos;		/* position in primary key */
+	int c_sbcp;		/* single-byte code page */
+	int c_dbcp;		/* double-byte code page */
+	const struct codec *c_codec;	/* to UTF-8, NULL if untranslated */
+	bool c_bitdata;		/* binary data: FOR BIT DATA, BINARY, etc. */
 	struct column_desc *next;
 };
 
@@ -66,18 +123,43 @@ struct table_desc {
 	char *t_name;		/* table name, data name as default */
 	char *t_pkname;		/* primary key name */
 	int t_ncols;		/* number of columns */
+	int t_ndrec;		/* number of D records per row */
 	struct column_desc *c_head;	/* point to first column_desc */
+	struct column_desc **t_sel;	/* columns to output, in order */
+	int t_nsel;		/* number of columns to output */
+	uint64_t t_digest;	/* FNV-1a hash of the C records */
 };
 
 void get_ixf_summary(int fd, struct summary *sum);
 void parse_and_output(int ifd, int ofd, int cfd, const struct summary *sum);
-void parse_t_record(const unsigned char *rec, struct table_desc *tbl,
+bool parse_t_record(const unsigned char *rec, struct table_desc *tbl,
 		    const char *table_name);
-void parse_c_record(const unsigned char *rec, struct column_desc *col);
+bool parse_c_record(const unsigned char *rec, struct column_desc *col);
 void parse_d_record(const unsigned char *record,
 		    const struct column_desc *col_head);
-void table_desc_to_sql(int fd, const struct table_desc *tbl);
-void d_record_to_sql(int ofd, const unsigned char *rec,
-		     const struct summary *sum, const struct table_desc *tbl);
+void select_columns(struct table_desc *tbl, const char *list);
+struct column_desc *find_column(const struct table_desc *tbl, const char *name);
+const struct column_desc **select_key(const struct table_desc *tbl,
+				      const char *list, int *ncols);
+size_t column_value(const unsigned char *const *recs,
+		    const struct column_desc *col, const unsigned char **val);
+size_t column_span(const struct column_desc *col);
+size_t col_value_size(const struct column_desc *col);
+void choose_literals(enum sql_dialect dialect);
+void reject_xml(const struct table_desc *tbl);
+size_t *record_spans(const struct table_desc *tbl);
+void table_desc_to_sql(int fd, const struct summary *sum,
+		       const struct table_desc *tbl);
+bool row_to_sql(int ofd, int part, const unsigned char *const *recs,
+		const struct summary *sum, const struct table_desc *tbl);
+bool update_to_sql(int ofd, const unsigned char *const *old,
+		   const unsigned char *const *recs,
+		   const struct summary *sum, const struct table_desc *tbl);
+void delete_to_sql(int ofd, const unsigned char *const *recs,
+		   const struct summary *sum, const struct table_desc *tbl);
+void finish_sql(const int *ofds, const struct summary *sum);
+void row_to_profile(const unsigned char *const *recs,
+		    const struct table_desc *tbl);
+void profile_to_json(int fd, const struct table_desc *tbl);
 
 #endif
@@ -0,0 +1,1124 @@
+/*
+ * ixfgen.c - generate IXF files of synthetic rows for benchmarks
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "codepage.h"
+#include "ixfcvt.h"
+#include "parse_d.h"
+#include "util.h"
+
+#define DEFAULT_ROWS 100000L
+#define DEFAULT_SCHEMA "INTEGER,VARCHAR(40),DECIMAL(11,2),DATE"
+#define DEFAULT_TNAME "BENCH"
+#define DEFAULT_SBCP 1208	/* UTF-8 */
+#define GRAPHIC_DBCP 1200	/* UTF-16 big-endian */
+
+#define REC_LEN_BYTES 6
+#define H_REC_LEN 51
+#define T_REC_LEN 1604
+#define C_REC_LEN 862
+#define MAX_D_COLS_LEN 32763	/* column bytes of a D record */
+#define OUT_BUFF_SIZE 65536
+
+/* fields of the H record */
+#define IXFHID_OFFSET 1
+#define IXFHVERS_OFFSET 4
+#define IXFHPROD_OFFSET 8
+#define IXFHDATE_OFFSET 20
+#define IXFHTIME_OFFSET 28
+#define IXFHHCNT_OFFSET 34
+#define IXFHSBCP_OFFSET 39
+#define IXFHDBCP_OFFSET 44
+
+/* fields of the T record */
+#define IXFTNAML_OFFSET 1
+#define IXFTNAME_OFFSET 4
+#define IXFTNAME_BYTES 256
+#define IXFTDATA_OFFSET 531
+#define IXFTFORM_OFFSET 532
+#define IXFTLOC_OFFSET 538
+#define IXFTCCNT_OFFSET 539
+#define IXFTPKNM_OFFSET 576
+#define IXFTPKNM_BYTES 257
+
+/* fields of the C record */
+#define IXFCNAML_OFFSET 1
+#define IXFCNAME_OFFSET 4
+#define IXFCNULL_OFFSET 260
+#define IXFCDEF_OFFSET 261
+#define IXFCSLCT_OFFSET 262
+#define IXFCKPOS_OFFSET 263
+#define IXFCCLAS_OFFSET 265
+#define IXFCTYPE_OFFSET 266
+#define IXFCSBCP_OFFSET 269
+#define IXFCDBCP_OFFSET 274
+#define IXFCLENG_OFFSET 279
+#define IXFCDRID_OFFSET 284
+#define IXFCPOSN_OFFSET 287
+
+/* fields of the D record */
+#define IXFDRID_OFFSET 1
+
+#define FIELD_BUFF_SIZE 16	/* a formatted numeric field and its NUL */
+#define MAX_COL_NAME_LEN 12
+#define DATETIME_BUFF_SIZE 64
+#define ALPHABET "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz" \
+	"0123456789 "
+#define ASCII_CHARS 128
+#define NULL_IND_BYTE 0xFF
+#define PACKED_POSITIVE 0x0C
+#define PACKED_NEGATIVE 0x0D
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+#define TWO_POW_53 9007199254740992.0	/* 2^53, precision of a double */
+#define FIRST_YEAR 1970
+#define YEARS 68
+#define DECFLOAT16_DIGITS 16
+#define DECFLOAT34_DIGITS 34
+#define DECFLOAT16_EXP_CONT_BITS 8
+#define DECFLOAT34_EXP_CONT_BITS 12
+#define DECFLOAT16_BIAS 398
+#define DECFLOAT34_BIAS 6176
+#define DECFLOAT_COMB_BITS 5
+#define DECLET_BITS 10
+#define DECLET_DIGITS 3
+#define MAX_EXPONENT 2		/* of generated DECFLOAT values */
+#define MIN_EXPONENT -8
+#define XDS_FORMAT "<XDS FIL='%s.001.xml' OFF='%ld' LEN='%lu' />"
+#define XDS_LEN 96		/* room for the XDS of a document */
+#define MAX_DOC_LEN 4096	/* of the documents an XDS points to */
+
+/* a column type accepted in a schema */
+struct type_name {
+	const char *tn_name;
+	int tn_type;
+	int tn_nargs;		/* 0: none, 1: length, 2: precision, scale */
+	size_t tn_deflen;	/* length if not given, 0 if required */
+	size_t tn_maxlen;
+};
+
+/* a column of the generated table */
+struct gen_column {
+	int g_type;		/* DB2 data type */
+	size_t g_leng;		/* IXFCLENG */
+	size_t g_width;		/* bytes in a D record, null indicator too */
+	bool g_nullable;
+	bool g_serial;		/* primary key numbered 1, 2, ... */
+	int g_drid;		/* D record of a row holding it, from 1 */
+	size_t g_posn;		/* IXFCPOSN, from 1 */
+};
+
+/* what to generate */
+struct gen_options {
+	long o_rows;
+	const char *o_tname;
+	double o_nulls;		/* fraction of null values */
+	double o_quotes;	/* fraction of quotes in strings */
+	size_t o_minlen;	/* length range of varying-length values */
+	size_t o_maxlen;
+	int o_sbcp;		/* code page of CHAR and VARCHAR */
+	size_t o_drec_cols;	/* maximum column bytes of a D record */
+	unsigned long o_seed;
+};
+
+static const struct type_name TYPE_NAMES[] = {
+	{"SMALLINT", SMALLINT, 0, 2, 2},
+	{"INTEGER", INTEGER, 0, 4, 4},
+	{"BIGINT", BIGINT, 0, 8, 8},
+	{"DECIMAL", DECIMAL, 2, 5, 31},
+	{"REAL", FLOATING_POINT, 0, 4, 4},
+	{"DOUBLE", FLOATING_POINT, 0, 8, 8},
+	{"CHAR", CHAR, 1, 1, 254},
+	{"VARCHAR", VARCHAR, 1, 0, 32672},
+	{"GRAPHIC", GRAPHIC, 1, 1, 127},
+	{"VARGRAPHIC", VARGRAPHIC, 1, 0, 16336},
+	{"BINARY", BINARY, 1, 1, 255},
+	{"VARBINARY", VARBINARY, 1, 0, 32672},
+	{"DATE", DATE, 0, 10, 10},
+	{"TIME", TIME, 0, 8, 8},
+	{"TIMESTAMP", TIMESTAMP, 1, 6, 12},
+	{"DECFLOAT", DECFLOAT, 1, 34, 34},
+	{"LONG VARCHAR", LONG_VARCHAR, 1, 32700, 32700},
+	{"LONG VARGRAPHIC", LONG_VARGRAPHIC, 1, 16350, 16350},
+	{"XML", XML, 0, XDS_LEN, XDS_LEN}
+};
+
+static int out_fd;
+static unsigned char *out_buff;
+static size_t out_used;
+static uint64_t rng_state;
+static unsigned char text_bytes[ASCII_CHARS];	/* in the CHAR code page */
+
+static int parse_schema(const char *spec, struct gen_column **cols);
+static const char *parse_column(const char *s, struct gen_column *col);
+static size_t parse_size(const char **s, const char *spec);
+static size_t value_width(const struct gen_column *col);
+static int layout_columns(struct gen_column *cols, int ncols,
+			  size_t max_cols_len, size_t *drec_len);
+static void prepare_text(int sbcp);
+static void write_header(unsigned char *rec, int ncols,
+			 const struct gen_options *opt);
+static void write_table(unsigned char *rec, const struct gen_column *cols,
+			int ncols, const struct gen_options *opt);
+static void write_column(unsigned char *rec, const struct gen_column *col,
+			 int colno, const struct gen_options *opt);
+static void write_rows(unsigned char *rec, const struct gen_column *cols,
+		       int ncols, const size_t *drec_len, int ndrec,
+		       const struct gen_options *opt);
+static void fill_value(unsigned char *dst, const struct gen_column *col,
+		       long rowno, const struct gen_options *opt);
+static void fill_integer(unsigned char *dst, size_t bytes, long long value);
+static void fill_packed(unsigned char *dst, size_t leng);
+static void fill_decfloat(unsigned char *dst, size_t bytes);
+static void encode_decfloat(unsigned char *dst, size_t bytes,
+			    const unsigned *digits, int exponent, bool neg);
+static unsigned encode_declet(const unsigned *digits);
+static void put_bits(unsigned char *be, int pos, int nbits, unsigned value);
+static void fill_xds(unsigned char *dst, long rowno,
+		     const struct gen_options *opt);
+static void fill_float(unsigned char *dst, size_t bytes);
+static void fill_text(unsigned char *dst, size_t len, size_t width,
+		      const struct gen_options *opt);
+static void fill_graphic(unsigned char *dst, size_t len, size_t width,
+			 const struct gen_options *opt);
+static void fill_datetime(unsigned char *dst, int type, size_t leng);
+static size_t varying_length(size_t maxlen, const struct gen_options *opt);
+static long long random_integer(int max_digits);
+static char random_char(const struct gen_options *opt);
+static void put_field(unsigned char *dst, size_t bytes, long value);
+static void put_record(const unsigned char *rec, size_t len);
+static void put_bytes(const unsigned char *src, size_t len);
+static void flush_output(void);
+static uint64_t next_random(void);
+static uint64_t random_below(uint64_t n);
+static bool random_chance(double fraction);
+static double parse_fraction(const char *prog, const char *opt,
+			     const char *arg);
+static void parse_length_range(const char *prog, const char *arg,
+			       struct gen_options *opt);
+
+int main(int argc, char *argv[])
+{
+	const char USAGE_INFO[] = "\
+\n\
+ixfgen: generate an IXF file of synthetic rows for benchmarking ixfcvt\n\
+Usage: %s [-n ROWS] [-s SCHEMA] [-N PERCENT] [-q PERCENT] [-l MIN:MAX]\n\
+          [-C CODEPAGE] [-D BYTES] [-r SEED] [-t TNAME] [-o OFILE]\n\
+\n\
+Options:\n\
+    -n <ROWS>     number of rows (default 100000)\n\
+    -s <SCHEMA>   comma-separated column types, e.g. (the default)\n\
+                  \"%s\"\n\
+                  SMALLINT, INTEGER, BIGINT, DECIMAL(p,s), REAL, DOUBLE,\n\
+                  CHAR(n), VARCHAR(n), GRAPHIC(n), VARGRAPHIC(n),\n\
+                  BINARY(n), VARBINARY(n), DATE, TIME, TIMESTAMP(p),\n\
+                  DECFLOAT(16|34), LONG VARCHAR(n), LONG VARGRAPHIC(n),\n\
+                  XML (the XML data specifiers only, not the documents)\n\
+                  A leading INTEGER or BIGINT is a serial primary key\n\
+    -N <PERCENT>  make the other columns nullable, <PERCENT>%% null\n\
+    -q <PERCENT>  <PERCENT>%% of the characters of strings are quotes\n\
+    -l <MIN:MAX>  length range of strings and binary data, in characters\n\
+                  (default 0 up to the declared length)\n\
+    -C <CODEPAGE> code page of CHAR and VARCHAR, e.g. 37 (default 1208)\n\
+    -D <BYTES>    start another D record of a row once the columns take\n\
+                  more than <BYTES> bytes (default and maximum %d)\n\
+    -r <SEED>     seed of the data (default 0), the same seed and options\n\
+                  always produce the same file\n\
+    -t <TNAME>    table name (default BENCH)\n\
+    -o <OFILE>    output file, the standard output if not specified\n\
+    -h            display this help and exit\
+";
+	struct gen_options opt;
+	struct gen_column *cols;
+	const char *schema;
+	const char *ofile;
+	size_t *drec_len;	/* length of each D record of a row */
+	unsigned char *rec;
+	size_t recsz;
+	int ncols;
+	int ndrec;
+	int errflg;
+	int c;
+
+	opt.o_rows = DEFAULT_ROWS;
+	opt.o_tname = DEFAULT_TNAME;
+	opt.o_nulls = 0.0;
+	opt.o_quotes = 0.0;
+	opt.o_minlen = 0;
+	opt.o_maxlen = (size_t)-1;
+	opt.o_sbcp = DEFAULT_SBCP;
+	opt.o_drec_cols = MAX_D_COLS_LEN;
+	opt.o_seed = 0UL;
+	schema = DEFAULT_SCHEMA;
+	ofile = NULL;
+	errflg = 0;
+	while ((c = getopt(argc, argv, ":n:s:N:q:l:C:D:r:t:o:h")) != -1) {
+		switch (c) {
+		case 'n':
+			opt.o_rows = str_to_long(optarg);
+			if (opt.o_rows < 0)
+				fmt_err_exit("%s: -n must not be negative",
+					     argv[0]);
+			break;
+		case 's':
+			schema = optarg;
+			break;
+		case 'N':
+			opt.o_nulls = parse_fraction(argv[0], "-N", optarg);
+			break;
+		case 'q':
+			opt.o_quotes = parse_fraction(argv[0], "-q", optarg);
+			break;
+		case 'l':
+			parse_length_range(argv[0], optarg, &opt);
+			break;
+		case 'C':
+			opt.o_sbcp = (int)str_to_long(optarg);
+			break;
+		case 'D':
+			opt.o_drec_cols = (size_t)str_to_long(optarg);
+			if (opt.o_drec_cols < 1
+			    || opt.o_drec_cols > MAX_D_COLS_LEN)
+				fmt_err_exit("%s: -D must be in [1, %d]",
+					     argv[0], MAX_D_COLS_LEN);
+			break;
+		case 'r':
+			opt.o_seed = (unsigned long)str_to_long(optarg);
+			break;
+		case 't':
+			opt.o_tname = optarg;
+			if (strlen(optarg) > IXFTNAME_BYTES)
+				fmt_err_exit("%s: table name too long",
+					     argv[0]);
+			break;
+		case 'o':
+			ofile = optarg;
+			break;
+		case 'h':
+			usage(EXIT_SUCCESS, USAGE_INFO, argv[0],
+			      DEFAULT_SCHEMA, MAX_D_COLS_LEN);
+			break;
+		case ':':
+			err_msg("Option -%c requires an argument\n", optopt);
+			errflg++;
+			break;
+		default:
+			err_msg("Unrecognized option: -%c\n", optopt);
+			errflg++;
+			break;
+		}
+	}
+	if (optind < argc) {
+		err_msg("%s\n", "Too many arguments");
+		errflg++;
+	}
+	if (errflg)
+		usage(EXIT_FAILURE, USAGE_INFO, argv[0], DEFAULT_SCHEMA,
+		      MAX_D_COLS_LEN);
+
+	ncols = parse_schema(schema, &cols);
+	cols[0].g_serial = cols[0].g_type == INTEGER
+	    || cols[0].g_type == BIGINT;
+	for (c = 0; c < ncols; ++c) {
+		cols[c].g_nullable = opt.o_nulls > 0.0 && !cols[c].g_serial;
+		cols[c].g_width = value_width(&cols[c]);
+	}
+	drec_len = alloc_buff((size_t)ncols * sizeof(*drec_len));
+	ndrec = layout_columns(cols, ncols, opt.o_drec_cols, drec_len);
+	prepare_text(opt.o_sbcp);
+	rng_state = (uint64_t)opt.o_seed * GOLDEN_GAMMA;
+
+	out_fd = ofile ? open_file(ofile, O_WRONLY | O_CREAT | O_TRUNC,
+				   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)
+	    : STDOUT_FILENO;
+	out_buff = alloc_buff(OUT_BUFF_SIZE);
+	out_used = 0;
+	recsz = T_REC_LEN + IXFDCOLS_OFFSET + MAX_D_COLS_LEN;
+	rec = alloc_buff(recsz);
+
+	write_header(rec, ncols, &opt);
+	write_table(rec, cols, ncols, &opt);
+	for (c = 0; c < ncols; ++c)
+		write_column(rec, &cols[c], c + 1, &opt);
+	write_rows(rec, cols, ncols, drec_len, ndrec, &opt);
+	flush_output();
+
+	if (out_fd != STDOUT_FILENO)
+		close_file(out_fd);
+	free_buff(rec);
+	free_buff(out_buff);
+	free_buff(drec_len);
+	free_buff(cols);
+
+	return 0;
+}
+
+/*
+ * Parses the comma-separated column types of `spec' into an array stored
+ * in `*cols', and returns the number of columns. Exits on error.
+ */
+static int parse_schema(const char *spec, struct gen_column **cols)
+{
+	const char *s;
+	int ncols;
+
+	ncols = 1;
+	for (s = spec; *s; ++s)
+		if (*s == ',')
+			++ncols;	/* at least as many as commas */
+	*cols = alloc_buff((size_t)ncols * sizeof(**cols));
+
+	ncols = 0;
+	s = spec;
+	do {
+		s = parse_column(s, &(*cols)[ncols++]);
+		while (isspace((unsigned char)*s))
+			++s;
+		if (*s != ',' && *s != '\0')
+			fmt_err_exit("Invalid schema near \"%s\"", s);
+	} while (*s++ == ',');
+
+	return ncols;
+}
+
+/* Parses a column type at `s' into `col', returns the text after it. */
+static const char *parse_column(const char *s, struct gen_column *col)
+{
+	const struct type_name *tn;
+	const char *name;
+	size_t len;
+	size_t scale;
+	size_t i;
+
+	while (isspace((unsigned char)*s))
+		++s;
+	name = s;
+	/* two words for LONG VARCHAR and LONG VARGRAPHIC */
+	while (isalpha((unsigned char)*s)
+	       || (*s == ' ' && isalpha((unsigned char)s[1])))
+		++s;
+
+	tn = NULL;
+	for (i = 0; i < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); ++i)
+		if (strlen(TYPE_NAMES[i].tn_name) == (size_t)(s - name)
+		    && strncasecmp(name, TYPE_NAMES[i].tn_name,
+				   (size_t)(s - name)) == 0)
+			tn = &TYPE_NAMES[i];
+	if (!tn)
+		fmt_err_exit("Unknown column type near \"%s\"", name);
+
+	len = tn->tn_deflen;
+	scale = 0;
+	while (isspace((unsigned char)*s))
+		++s;
+	if (*s == '(' && tn->tn_nargs > 0) {
+		++s;
+		len = parse_size(&s, name);
+		if (*s == ',' && tn->tn_nargs == 2) {
+			++s;
+			scale = parse_size(&s, name);
+		}
+		if (*s++ != ')')
+			fmt_err_exit("Invalid schema near \"%s\"", name);
+	}
+	if (len == 0 || len > tn->tn_maxlen)
+		fmt_err_exit("Length missing or out of range near \"%s\"",
+			     name);
+	if (tn->tn_nargs == 2 && scale >= len)
+		fmt_err_exit("Scale must be less than precision near \"%s\"",
+			     name);
+	if (tn->tn_type == DECFLOAT && len != DECFLOAT16_DIGITS
+	    && len != DECFLOAT34_DIGITS)
+		fmt_err_exit("DECFLOAT must be of 16 or 34 digits near \"%s\"",
+			     name);
+
+	col->g_type = tn->tn_type;
+	col->g_leng = tn->tn_nargs == 2 ? len * 100 + scale : len;
+	col->g_serial = false;
+
+	return s;
+}
+
+/* Parses the unsigned number at `*s' and moves `*s' past it. */
+static size_t parse_size(const char **s, const char *spec)
+{
+	unsigned long n;
+	char *end;
+
+	errno = 0;
+	n = strtoul(*s, &end, 10);
+	if (errno != 0 || end == *s)
+		fmt_err_exit("Invalid number near \"%s\"", spec);
+	*s = end;
+
+	return (size_t)n;
+}
+
+/* bytes of a value of `col' in a D record */
+static size_t value_width(const struct gen_column *col)
+{
+	size_t width;
+
+	switch (col->g_type) {
+	case DECIMAL:
+		width = packed_decimal_size(col->g_leng);
+		break;
+	case GRAPHIC:
+		width = col->g_leng * GRAPHIC_CHAR_BYTES;
+		break;
+	case DECFLOAT:
+		width = col->g_leng == DECFLOAT16_DIGITS ? 8 : 16;
+		break;
+	case VARCHAR:
+	case LONG_VARCHAR:
+	case VARBINARY:
+	case XML:
+		width = VARCHAR_CUR_LEN_IND_BYTES + col->g_leng;
+		break;
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		width = VARCHAR_CUR_LEN_IND_BYTES +
+		    col->g_leng * GRAPHIC_CHAR_BYTES;
+		break;
+	case TIMESTAMP:
+		width = col->g_leng + 20;
+		break;
+	default:
+		width = col->g_leng;
+		break;
+	}
+
+	return width + (col->g_nullable ? NULL_VAL_IND_BYTES : 0);
+}
+
+/*
+ * Places the columns in D records, starting a new one when a column does
+ * not fit in `max_cols_len' bytes, stores the length of each D record in
+ * `drec_len' and returns the number of D records of a row.
+ */
+static int layout_columns(struct gen_column *cols, int ncols,
+			  size_t max_cols_len, size_t *drec_len)
+{
+	size_t used;		/* column bytes of the current D record */
+	int drid;
+	int i;
+
+	drid = 1;
+	used = 0;
+	for (i = 0; i < ncols; ++i) {
+		if (used > 0 && used + cols[i].g_width > max_cols_len) {
+			drec_len[drid - 1] = IXFDCOLS_OFFSET + used;
+			++drid;
+			used = 0;
+		}
+		cols[i].g_drid = drid;
+		cols[i].g_posn = used + 1;
+		used += cols[i].g_width;
+	}
+	drec_len[drid - 1] = IXFDCOLS_OFFSET + used;
+
+	return drid;
+}
+
+/* encode the characters of generated strings in code page `sbcp' */
+static void prepare_text(int sbcp)
+{
+	const struct codec *cc;
+	const char *chars;
+	char c;
+
+	cc = find_codec(sbcp);
+	chars = ALPHABET "'";
+	while ((c = *chars++) != '\0') {
+		text_bytes[(int)c] = (unsigned char)c;
+		if (cc && from_utf8(&text_bytes[(int)c], &c, 1, cc) != 1)
+			fmt_err_exit("Code page %d is not a single-byte code "
+				     "page with ASCII letters", sbcp);
+	}
+}
+
+/* write the H record */
+static void write_header(unsigned char *rec, int ncols,
+			 const struct gen_options *opt)
+{
+	memset(rec, ' ', H_REC_LEN);
+	rec[0] = 'H';
+	memcpy(rec + IXFHID_OFFSET, "IXF", 3);
+	memcpy(rec + IXFHVERS_OFFSET, "0002", 4);
+	memcpy(rec + IXFHPROD_OFFSET, "IXFGEN", 6);
+	/* a fixed date and time keep the output reproducible */
+	memcpy(rec + IXFHDATE_OFFSET, "19700101", 8);
+	memcpy(rec + IXFHTIME_OFFSET, "000000", 6);
+	put_field(rec + IXFHHCNT_OFFSET, 5, ncols + 2L);
+	put_field(rec + IXFHSBCP_OFFSET, 5, opt->o_sbcp);
+	put_field(rec + IXFHDBCP_OFFSET, 5, 0L);
+	put_record(rec, H_REC_LEN);
+}
+
+/* write the T record */
+static void write_table(unsigned char *rec, const struct gen_column *cols,
+			int ncols, const struct gen_options *opt)
+{
+	size_t len;
+
+	memset(rec, ' ', T_REC_LEN);
+	rec[0] = 'T';
+	len = strlen(opt->o_tname);
+	put_field(rec + IXFTNAML_OFFSET, 3, (long)len);
+	memcpy(rec + IXFTNAME_OFFSET, opt->o_tname, len);
+	rec[IXFTDATA_OFFSET] = 'C';
+	rec[IXFTFORM_OFFSET] = 'M';
+	rec[IXFTLOC_OFFSET] = 'I';
+	put_field(rec + IXFTCCNT_OFFSET, 5, ncols);
+	memset(rec + IXFTPKNM_OFFSET, '\0', IXFTPKNM_BYTES);
+	if (cols[0].g_serial)
+		sprintf((char *)rec + IXFTPKNM_OFFSET, "PK_%.*s",
+			IXFTPKNM_BYTES - 4, opt->o_tname);
+	put_record(rec, T_REC_LEN);
+}
+
+/* write the C record of `col', the `colno'th column */
+static void write_column(unsigned char *rec, const struct gen_column *col,
+			 int colno, const struct gen_options *opt)
+{
+	char name[MAX_COL_NAME_LEN];
+	int sbcp;
+	int dbcp;
+
+	memset(rec, ' ', C_REC_LEN);
+	rec[0] = 'C';
+	sprintf(name, "C%d", colno);
+	put_field(rec + IXFCNAML_OFFSET, 3, (long)strlen(name));
+	memcpy(rec + IXFCNAME_OFFSET, name, strlen(name));
+	rec[IXFCNULL_OFFSET] = col->g_nullable ? 'Y' : 'N';
+	rec[IXFCDEF_OFFSET] = 'N';
+	rec[IXFCSLCT_OFFSET] = 'Y';
+	if (col->g_serial)
+		put_field(rec + IXFCKPOS_OFFSET, 2, 1L);
+	else
+		rec[IXFCKPOS_OFFSET] = 'N';
+	rec[IXFCCLAS_OFFSET] = 'R';
+	put_field(rec + IXFCTYPE_OFFSET, 3, col->g_type);
+
+	sbcp = dbcp = 0;
+	if (col->g_type == CHAR || col->g_type == VARCHAR
+	    || col->g_type == LONG_VARCHAR)
+		sbcp = opt->o_sbcp;
+	else if (col->g_type == XML)
+		sbcp = DEFAULT_SBCP;
+	else if (col->g_type == GRAPHIC || col->g_type == VARGRAPHIC
+		 || col->g_type == LONG_VARGRAPHIC)
+		dbcp = GRAPHIC_DBCP;
+	put_field(rec + IXFCSBCP_OFFSET, 5, sbcp);
+	put_field(rec + IXFCDBCP_OFFSET, 5, dbcp);
+	put_field(rec + IXFCLENG_OFFSET, 5, (long)col->g_leng);
+	put_field(rec + IXFCDRID_OFFSET, 3, col->g_drid);
+	put_field(rec + IXFCPOSN_OFFSET, 6, (long)col->g_posn);
+	put_record(rec, C_REC_LEN);
+}
+
+/* write the D records of all the rows */
+static void write_rows(unsigned char *rec, const struct gen_column *cols,
+		       int ncols, const size_t *drec_len, int ndrec,
+		       const struct gen_options *opt)
+{
+	const struct gen_column *col;
+	unsigned char *dst;
+	long rowno;
+	int drid;
+	int i;
+
+	for (rowno = 0; rowno < opt->o_rows; ++rowno) {
+		for (drid = 1, i = 0; drid <= ndrec; ++drid) {
+			memset(rec, ' ', IXFDCOLS_OFFSET);
+			rec[0] = 'D';
+			put_field(rec + IXFDRID_OFFSET, 3, drid);
+			for (; i < ncols && cols[i].g_drid == drid; ++i) {
+				col = &cols[i];
+				dst = rec + IXFDCOLS_OFFSET + col->g_posn - 1;
+				if (!col->g_nullable) {
+					fill_value(dst, col, rowno, opt);
+				} else if (random_chance(opt->o_nulls)) {
+					memset(dst, '\0', col->g_width);
+					dst[0] = dst[1] = NULL_IND_BYTE;
+				} else {
+					dst[0] = dst[1] = '\0';
+					fill_value(dst + NULL_VAL_IND_BYTES,
+						   col, rowno, opt);
+				}
+			}
+			put_record(rec, drec_len[drid - 1]);
+		}
+	}
+}
+
+/* fill in a value of `col' for the `rowno'th row (from 0) */
+static void fill_value(unsigned char *dst, const struct gen_column *col,
+		       long rowno, const struct gen_options *opt)
+{
+	size_t len;
+	size_t i;
+
+	switch (col->g_type) {
+	case SMALLINT:
+		fill_integer(dst, 2, random_integer(4));
+		break;
+	case INTEGER:
+		fill_integer(dst, 4, col->g_serial ? rowno + 1LL
+			     : random_integer(9));
+		break;
+	case BIGINT:
+		fill_integer(dst, 8, col->g_serial ? rowno + 1LL
+			     : random_integer(18));
+		break;
+	case DECIMAL:
+		fill_packed(dst, col->g_leng);
+		break;
+	case DECFLOAT:
+		fill_decfloat(dst, col->g_leng == DECFLOAT16_DIGITS ? 8 : 16);
+		break;
+	case FLOATING_POINT:
+		fill_float(dst, col->g_leng);
+		break;
+	case CHAR:
+		fill_text(dst, varying_length(col->g_leng, opt), col->g_leng,
+			  opt);
+		break;
+	case VARCHAR:
+	case LONG_VARCHAR:
+		len = varying_length(col->g_leng, opt);
+		fill_integer(dst, VARCHAR_CUR_LEN_IND_BYTES, (long long)len);
+		fill_text(dst + VARCHAR_CUR_LEN_IND_BYTES, len, len, opt);
+		break;
+	case GRAPHIC:
+		fill_graphic(dst, varying_length(col->g_leng, opt),
+			     col->g_leng, opt);
+		break;
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		len = varying_length(col->g_leng, opt);
+		fill_integer(dst, VARCHAR_CUR_LEN_IND_BYTES, (long long)len);
+		fill_graphic(dst + VARCHAR_CUR_LEN_IND_BYTES, len, len, opt);
+		break;
+	case BINARY:
+	case VARBINARY:
+		len = col->g_leng;
+		if (col->g_type == VARBINARY) {
+			len = varying_length(col->g_leng, opt);
+			fill_integer(dst, VARCHAR_CUR_LEN_IND_BYTES,
+				     (long long)len);
+			dst += VARCHAR_CUR_LEN_IND_BYTES;
+		}
+		for (i = 0; i < len; ++i)
+			dst[i] = (unsigned char)next_random();
+		break;
+	case XML:
+		fill_xds(dst, rowno, opt);
+		break;
+	default:
+		fill_datetime(dst, col->g_type, col->g_leng);
+		break;
+	}
+}
+
+/* store `value' as an integer of `bytes' bytes, little-endian */
+static void fill_integer(unsigned char *dst, size_t bytes, long long value)
+{
+	unsigned long long u;
+	size_t i;
+
+	u = (unsigned long long)value;
+	for (i = 0; i < bytes; ++i, u >>= 8)
+		dst[i] = (unsigned char)(u & 0xFF);
+}
+
+/* store a random packed decimal of IXFCLENG `leng' */
+static void fill_packed(unsigned char *dst, size_t leng)
+{
+	size_t bytes;
+	size_t nibbles;		/* digits and the sign */
+	size_t ndigits;
+	size_t i;
+	unsigned digit;
+
+	bytes = packed_decimal_size(leng);
+	nibbles = bytes * 2;
+	ndigits = 1 + (size_t)random_below(leng / 100);
+	memset(dst, '\0', bytes);
+	for (i = nibbles - 1 - ndigits; i < nibbles - 1; ++i) {
+		digit = (unsigned)random_below(10);
+		dst[i / 2] |= (unsigned char)(i % 2 ? digit : digit << 4);
+	}
+	dst[bytes - 1] |= random_below(4) ? PACKED_POSITIVE : PACKED_NEGATIVE;
+}
+
+/* store a random DECFLOAT of `bytes' bytes (8 or 16) */
+static void fill_decfloat(unsigned char *dst, size_t bytes)
+{
+	unsigned digits[DECFLOAT34_DIGITS];	/* most significant first */
+	int ndigits;		/* of the coefficient */
+	int i;
+
+	ndigits = bytes == 8 ? DECFLOAT16_DIGITS : DECFLOAT34_DIGITS;
+	/* up to as many digits as a DECIMAL(31) holds */
+	memset(digits, 0, sizeof(digits));
+	for (i = ndigits - 1 - (int)random_below(ndigits < 31 ? ndigits : 31);
+	     i < ndigits; ++i)
+		digits[i] = (unsigned)random_below(10);
+	encode_decfloat(dst, bytes, digits, MIN_EXPONENT +
+			(int)random_below(MAX_EXPONENT - MIN_EXPONENT + 1),
+			random_below(4) == 0);
+}
+
+/*
+ * store the DECFLOAT of coefficient `digits' (16 or 34 of them, as `bytes'
+ * is 8 or 16) and `exponent' in densely packed decimal encoding and
+ * little-endian byte order, see decode_decfloat()
+ */
+static void encode_decfloat(unsigned char *dst, size_t bytes,
+			    const unsigned *digits, int exponent, bool neg)
+{
+	unsigned char be[16];	/* big-endian */
+	int ndigits;
+	int exp_cont_bits;
+	unsigned biased;	/* exponent */
+	unsigned comb;		/* combination field */
+	unsigned exp_msbs;	/* two most significant bits of exponent */
+	int pos;		/* of the next declet, in bits */
+	int i;
+
+	if (bytes == 8) {
+		ndigits = DECFLOAT16_DIGITS;
+		exp_cont_bits = DECFLOAT16_EXP_CONT_BITS;
+		biased = (unsigned)(exponent + DECFLOAT16_BIAS);
+	} else {
+		ndigits = DECFLOAT34_DIGITS;
+		exp_cont_bits = DECFLOAT34_EXP_CONT_BITS;
+		biased = (unsigned)(exponent + DECFLOAT34_BIAS);
+	}
+
+	memset(be, 0, bytes);
+	exp_msbs = biased >> exp_cont_bits;
+	if (digits[0] < 8)
+		comb = exp_msbs << 3 | digits[0];
+	else
+		comb = 0x18 | exp_msbs << 1 | (digits[0] & 1);
+	put_bits(be, 0, 1, neg);
+	put_bits(be, 1, DECFLOAT_COMB_BITS, comb);
+	put_bits(be, 1 + DECFLOAT_COMB_BITS, exp_cont_bits,
+		 biased & ((1U << exp_cont_bits) - 1));
+	pos = 1 + DECFLOAT_COMB_BITS + exp_cont_bits;
+	for (i = 1; i < ndigits; i += DECLET_DIGITS, pos += DECLET_BITS)
+		put_bits(be, pos, DECLET_BITS, encode_declet(digits + i));
+
+	for (i = 0; i < (int)bytes; ++i)
+		dst[i] = be[bytes - 1 - (size_t)i];
+}
+
+/* Returns the densely packed decimal declet of the 3 `digits'. */
+static unsigned encode_declet(const unsigned *digits)
+{
+	unsigned d2, d1, d0;	/* hundreds, tens and units */
+	unsigned big;		/* which of them are 8 or 9 */
+
+	d2 = digits[0];
+	d1 = digits[1];
+	d0 = digits[2];
+	big = (d2 > 7) << 2 | (d1 > 7) << 1 | (d0 > 7);
+
+	/* the bits "pqr stu v wxy" of IEEE 754-2008, table 3.3 */
+	switch (big) {
+	case 0:
+		return d2 << 7 | d1 << 4 | d0;
+	case 1:
+		return d2 << 7 | d1 << 4 | 0x8 | (d0 & 1);
+	case 2:
+		return d2 << 7 | (d0 & 6) << 4 | (d1 & 1) << 4 | 0xA | (d0 & 1);
+	case 4:
+		return (d0 & 6) << 7 | (d2 & 1) << 7 | d1 << 4 | 0xC | (d0 & 1);
+	case 6:
+		return (d0 & 6) << 7 | (d2 & 1) << 7 | (d1 & 1) << 4 | 0xE
+		    | (d0 & 1);
+	case 5:
+		return (d1 & 6) << 7 | (d2 & 1) << 7 | 0x20 | (d1 & 1) << 4
+		    | 0xE | (d0 & 1);
+	case 3:
+		return d2 << 7 | 0x40 | (d1 & 1) << 4 | 0xE | (d0 & 1);
+	default:
+		return (d2 & 1) << 7 | 0x60 | (d1 & 1) << 4 | 0xE | (d0 & 1);
+	}
+}
+
+/* set `nbits' bits of `be' from bit `pos' (0 is the highest) to `value' */
+static void put_bits(unsigned char *be, int pos, int nbits, unsigned value)
+{
+	int i;
+	int bit;
+
+	for (i = 0; i < nbits; ++i) {
+		bit = pos + i;
+		if (value >> (nbits - 1 - i) & 1)
+			be[bit / 8] |= (unsigned char)(0x80 >> bit % 8);
+	}
+}
+
+/*
+ * store the XML data specifier of the document of the `rowno'th row, as
+ * if the documents followed each other in a file of their own
+ */
+static void fill_xds(unsigned char *dst, long rowno,
+		     const struct gen_options *opt)
+{
+	char xds[XDS_LEN + 1];
+	int len;
+
+	len = snprintf(xds, sizeof(xds), XDS_FORMAT, opt->o_tname,
+		       rowno * MAX_DOC_LEN,
+		       1 + (unsigned long)random_below(MAX_DOC_LEN));
+	if (len < 0 || len > XDS_LEN)
+		fmt_err_exit("Table name too long for an XDS: %s",
+			     opt->o_tname);
+	fill_integer(dst, VARCHAR_CUR_LEN_IND_BYTES, len);
+	memcpy(dst + VARCHAR_CUR_LEN_IND_BYTES, xds, (size_t)len);
+}
+
+/* store a random REAL or DOUBLE of `bytes' bytes */
+static void fill_float(unsigned char *dst, size_t bytes)
+{
+	double value;
+	float real;
+	int exp;
+
+	/* a mantissa in (-1, 1) scaled by 10^-6 to 10^9 */
+	value = (double)(next_random() >> 11) / TWO_POW_53 * 2.0 - 1.0;
+	for (exp = (int)random_below(16) - 6; exp > 0; --exp)
+		value *= 10.0;
+	for (; exp < 0; ++exp)
+		value /= 10.0;
+
+	if (bytes == sizeof(double)) {
+		memcpy(dst, &value, bytes);
+	} else {
+		real = (float)value;
+		memcpy(dst, &real, bytes);
+	}
+}
+
+/* store `len' random characters padded with blanks to `width' */
+static void fill_text(unsigned char *dst, size_t len, size_t width,
+		      const struct gen_options *opt)
+{
+	size_t i;
+
+	for (i = 0; i < len; ++i)
+		dst[i] = text_bytes[(int)random_char(opt)];
+	memset(dst + len, text_bytes[' '], width - len);
+}
+
+/* fill_text() in UTF-16 big-endian, `len' and `width' in characters */
+static void fill_graphic(unsigned char *dst, size_t len, size_t width,
+			 const struct gen_options *opt)
+{
+	size_t i;
+
+	for (i = 0; i < width; ++i) {
+		*dst++ = '\0';
+		*dst++ = (unsigned char)(i < len ? random_char(opt) : ' ');
+	}
+}
+
+/* store a random DATE, TIME or TIMESTAMP with `leng' fraction digits */
+static void fill_datetime(unsigned char *dst, int type, size_t leng)
+{
+	static const int DAYS[] = {
+		31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+	};
+	char buff[DATETIME_BUFF_SIZE];
+	int month;
+	size_t i;
+
+	month = (int)random_below(12);
+	sprintf(buff, "%04d-%02d-%02d", FIRST_YEAR + (int)random_below(YEARS),
+		month + 1, 1 + (int)random_below((uint64_t)DAYS[month]));
+	if (type == DATE) {
+		memcpy(dst, buff, 10);
+		return;
+	}
+
+	sprintf(buff + 10, "-%02d.%02d.%02d.", (int)random_below(24),
+		(int)random_below(60), (int)random_below(60));
+	if (type == TIME) {
+		memcpy(dst, buff + 11, 8);
+		return;
+	}
+
+	memcpy(dst, buff, 20);
+	for (i = 0; i < leng; ++i)
+		dst[20 + i] = (unsigned char)('0' + random_below(10));
+}
+
+/* a random length in the range of -l, up to `maxlen' */
+static size_t varying_length(size_t maxlen, const struct gen_options *opt)
+{
+	size_t lo;
+	size_t hi;
+
+	hi = opt->o_maxlen < maxlen ? opt->o_maxlen : maxlen;
+	lo = opt->o_minlen < hi ? opt->o_minlen : hi;
+
+	return lo + (size_t)random_below(hi - lo + 1);
+}
+
+/* a random integer of up to `max_digits' digits, a quarter negative */
+static long long random_integer(int max_digits)
+{
+	long long bound;
+	long long value;
+	int ndigits;
+
+	ndigits = 1 + (int)random_below((uint64_t)max_digits);
+	for (bound = 1; ndigits > 0; --ndigits)
+		bound *= 10;
+	value = (long long)random_below((uint64_t)bound);
+
+	return random_below(4) ? value : -value;
+}
+
+/* a random character of a string, a quote at the rate of -q */
+static char random_char(const struct gen_options *opt)
+{
+	if (opt->o_quotes > 0.0 && random_chance(opt->o_quotes))
+		return '\'';
+
+	return ALPHABET[random_below(sizeof(ALPHABET) - 1)];
+}
+
+/* store `value' in `bytes' decimal digits, zero-padded */
+static void put_field(unsigned char *dst, size_t bytes, long value)
+{
+	char buff[FIELD_BUFF_SIZE];
+
+	sprintf(buff, "%0*ld", (int)bytes, value);
+	memcpy(dst, buff, bytes);
+}
+
+/* write the length of a record followed by the record */
+static void put_record(const unsigned char *rec, size_t len)
+{
+	unsigned char prefix[REC_LEN_BYTES];
+
+	put_field(prefix, REC_LEN_BYTES, (long)len);
+	put_bytes(prefix, REC_LEN_BYTES);
+	put_bytes(rec, len);
+}
+
+/* append `len' bytes to the output buffer, flushing it when full */
+static void put_bytes(const unsigned char *src, size_t len)
+{
+	size_t n;
+
+	while (len > 0) {
+		if (out_used == OUT_BUFF_SIZE)
+			flush_output();
+		n = OUT_BUFF_SIZE - out_used;
+		if (n > len)
+			n = len;
+		memcpy(out_buff + out_used, src, n);
+		out_used += n;
+		src += n;
+		len -= n;
+	}
+}
+
+/* write out the buffered records */
+static void flush_output(void)
+{
+	const unsigned char *p;
+	ssize_t n;
+
+	for (p = out_buff; out_used > 0; p += n, out_used -= (size_t)n) {
+		n = write(out_fd, p, out_used);
+		if (n == -1)
+			err_exit("write");
+	}
+}
+
+/* next number of the SplitMix64 sequence */
+static uint64_t next_random(void)
+{
+	rng_state += GOLDEN_GAMMA;
+	return hash64(rng_state);
+}
+
+/* a random number in [0, n) */
+static uint64_t random_below(uint64_t n)
+{
+	return next_random() % n;
+}
+
+/* Returns true at the rate of `fraction'. */
+static bool random_chance(double fraction)
+{
+	return (double)(next_random() >> 11) / TWO_POW_53 < fraction;
+}
+
+/* Returns the percentage `arg' of option `opt' as a fraction. */
+static double parse_fraction(const char *prog, const char *opt,
+			     const char *arg)
+{
+	double pct;
+	char *end;
+
+	errno = 0;
+	pct = strtod(arg, &end);
+	if (errno != 0 || end == arg || *end != '\0' || pct < 0.0
+	    || pct > 100.0)
+		fmt_err_exit("%s: %s must be a percentage in [0, 100]", prog,
+			     opt);
+
+	return pct / 100.0;
+}
+
+/* parse the MIN:MAX length range of -l */
+static void parse_length_range(const char *prog, const char *arg,
+			       struct gen_options *opt)
+{
+	unsigned long lo;
+	unsigned long hi;
+	char *end;
+
+	errno = 0;
+	lo = strtoul(arg, &end, 10);
+	if (errno == 0 && end != arg && *end == ':') {
+		arg = end + 1;
+		hi = strtoul(arg, &end, 10);
+		if (errno == 0 && end != arg && *end == '\0' && lo <= hi) {
+			opt->o_minlen = (size_t)lo;
+			opt->o_maxlen = (size_t)hi;
+			return;
+		}
+	}
+	fmt_err_exit("%s: -l must be MIN:MAX with MIN <= MAX", prog);
+}
@@ -0,0 +1,588 @@
+/*
+ * libixf.c - read the schema and the rows of an IXF file, see ixf.h
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ixf.h"
+#include "ixfcvt.h"
+#include "parse_d.h"
+
+#define REC_LEN_BYTES 6
+#define IXFDRID_OFFSET 1
+#define IXFDRID_BYTES 3
+#define T_RECORD_MIN_LEN 577	/* up to the first byte of IXFTPKNM */
+#define C_RECORD_MIN_LEN 293	/* up to the end of IXFCPOSN */
+#define READ_SIZE 262144	/* bytes of the first buffer */
+#define ERRMSG_SIZE 256
+
+/* an open IXF file, all the state of the library */
+struct ixf_file {
+	int fd;
+	bool own_fd;		/* opened by ixf_open(), to be closed */
+	unsigned char *buff;	/* records read */
+	size_t size;		/* of `buff' */
+	size_t pos;		/* of the next record in `buff' */
+	size_t end;		/* of the bytes read into `buff' */
+	bool eof;
+	char *t_name;		/* data name of the T record */
+	struct column_desc *cols;	/* of the C records, in order */
+	struct ixf_column *info;	/* of `cols', for the caller */
+	int ncols;
+	int ndrec;		/* D records per row */
+	const unsigned char **drecs;	/* of the current row, by IXFDRID */
+	size_t *drec_lens;
+	size_t *drec_offs;	/* from `pos', while a row is read */
+	bool in_row;		/* a row is read */
+	long rows;		/* rows read */
+	char errmsg[ERRMSG_SIZE];
+};
+
+static int open_file(struct ixf_file *ixf);
+static int fail(struct ixf_file *ixf, int status, const char *format, ...);
+static int fail_io(struct ixf_file *ixf, const char *what);
+static int fill(struct ixf_file *ixf, size_t bytes);
+static int peek_record(struct ixf_file *ixf, size_t off, size_t *len);
+static int read_schema(struct ixf_file *ixf);
+static int parse_table(struct ixf_file *ixf, const unsigned char *rec,
+		       size_t len);
+static int add_column(struct ixf_file *ixf, const unsigned char *rec,
+		      size_t len);
+static int prepare_columns(struct ixf_file *ixf);
+static size_t fixed_value_size(const struct column_desc *col);
+static bool is_varying(int type);
+
+/*
+ * Opens the IXF file `path' and reads its schema. `*ixf' is set, unless
+ * out of memory, even if it fails: the message is then in ixf_errmsg(),
+ * and it must be closed by ixf_close().
+ */
+int ixf_open(const char *path, struct ixf_file **ixf)
+{
+	struct ixf_file *f;
+
+	*ixf = f = calloc(1, sizeof(struct ixf_file));
+	if (!f)
+		return IXF_ERR_NOMEM;
+
+	f->fd = open(path, O_RDONLY);
+	if (f->fd == -1)
+		return fail_io(f, path);
+	f->own_fd = true;
+
+	return open_file(f);
+}
+
+/* Same as ixf_open(), of the open file `fd', which is left open. */
+int ixf_open_fd(int fd, struct ixf_file **ixf)
+{
+	struct ixf_file *f;
+
+	*ixf = f = calloc(1, sizeof(struct ixf_file));
+	if (!f)
+		return IXF_ERR_NOMEM;
+
+	f->fd = fd;
+	f->own_fd = false;
+
+	return open_file(f);
+}
+
+/* close the IXF file and free everything of it */
+void ixf_close(struct ixf_file *ixf)
+{
+	int i;
+
+	if (!ixf)
+		return;
+
+	if (ixf->own_fd)
+		close(ixf->fd);
+	for (i = 0; i < ixf->ncols; ++i)
+		free(ixf->cols[i].c_name);
+	free(ixf->cols);
+	free(ixf->info);
+	free(ixf->t_name);
+	free(ixf->buff);
+	free(ixf->drecs);
+	free(ixf->drec_lens);
+	free(ixf->drec_offs);
+	free(ixf);
+}
+
+/* Returns the message of the last error of `ixf'. */
+const char *ixf_errmsg(const struct ixf_file *ixf)
+{
+	if (!ixf)
+		return "Out of memory";
+
+	return ixf->errmsg;
+}
+
+/* Returns the data name of the T record, without ".ixf", or NULL. */
+const char *ixf_table_name(const struct ixf_file *ixf)
+{
+	return ixf->t_name;
+}
+
+/* Returns the number of columns. */
+int ixf_column_count(const struct ixf_file *ixf)
+{
+	return ixf->ncols;
+}
+
+/* Returns the `i'th column, from 0, or NULL if there is no such column. */
+const struct ixf_column *ixf_column(const struct ixf_file *ixf, int i)
+{
+	if (i < 0 || i >= ixf->ncols)
+		return NULL;
+
+	return &ixf->info[i];
+}
+
+/*
+ * Reads the next row. Returns IXF_OK, IXF_END after the last row, or an
+ * error. The D records of the row are left in the buffer, in one piece,
+ * for ixf_get_value() to point into.
+ */
+int ixf_next_row(struct ixf_file *ixf)
+{
+	const unsigned char *rec;
+	size_t off;		/* of the next record from `pos' */
+	size_t len;
+	long drid;
+	int rc;
+	int i;
+
+	ixf->in_row = false;
+	if (ixf->ndrec == 0)
+		return IXF_END;
+
+	off = 0;
+	for (i = 0; i < ixf->ndrec;) {
+		rc = peek_record(ixf, off, &len);
+		if (rc == IXF_END && i > 0)
+			return fail(ixf, IXF_ERR_FORMAT, "%s",
+				    "Incomplete row at the end of file");
+		if (rc != IXF_OK)
+			return rc;
+
+		rec = ixf->buff + ixf->pos + off + REC_LEN_BYTES;
+		if (*rec == 'D') {
+			if (ixf->ndrec > 1
+			    && (len < IXFDRID_OFFSET + IXFDRID_BYTES
+				|| !parse_ixf_field(rec + IXFDRID_OFFSET,
+						    IXFDRID_BYTES, &drid)
+				|| drid != i + 1))
+				return fail(ixf, IXF_ERR_FORMAT,
+					    "D record %d of row %ld not found",
+					    i + 1, ixf->rows + 1);
+			ixf->drec_offs[i] = off + REC_LEN_BYTES;
+			ixf->drec_lens[i] = len;
+			++i;
+		} else if (*rec != 'A') {
+			return fail(ixf, IXF_ERR_FORMAT,
+				    "%c record found among D records", *rec);
+		}
+		off += REC_LEN_BYTES + len;
+	}
+
+	/* `buff' does not move until the next row */
+	for (i = 0; i < ixf->ndrec; ++i)
+		ixf->drecs[i] = ixf->buff + ixf->pos + ixf->drec_offs[i];
+	ixf->pos += off;
+	++ixf->rows;
+	ixf->in_row = true;
+
+	return IXF_OK;
+}
+
+/* Returns the number of rows read, that of the current row from 1. */
+long ixf_row_number(const struct ixf_file *ixf)
+{
+	return ixf->rows;
+}
+
+/*
+ * Points `val' at the value of the `i'th column, from 0, of the current
+ * row, without the null and length indicators. Returns IXF_ERR_FORMAT if
+ * the value runs past the end of its D record.
+ */
+int ixf_get_value(struct ixf_file *ixf, int i, struct ixf_value *val)
+{
+	const struct column_desc *col;
+	const unsigned char *src;
+	size_t avail;		/* bytes of the D record from `src' */
+	size_t start;		/* of the value in the D record */
+	size_t len;
+
+	if (!ixf->in_row || i < 0 || i >= ixf->ncols)
+		return fail(ixf, IXF_ERR_ARG, "No column %d of a row", i);
+
+	col = &ixf->cols[i];
+	start = IXFDCOLS_OFFSET + (size_t) col->c_offset;
+	if (start > ixf->drec_lens[col->c_drid - 1])
+		goto out_of_record;
+	src = ixf->drecs[col->c_drid - 1] + start;
+	avail = ixf->drec_lens[col->c_drid - 1] - start;
+
+	if (col->c_nullable) {
+		if (avail < NULL_VAL_IND_BYTES)
+			goto out_of_record;
+		if (column_is_null(src)) {
+			val->data = NULL;
+			val->len = 0;
+			return IXF_OK;
+		}
+		src += NULL_VAL_IND_BYTES;
+		avail -= NULL_VAL_IND_BYTES;
+	}
+
+	if (is_varying(col->c_type)) {
+		if (avail < VARCHAR_CUR_LEN_IND_BYTES)
+			goto out_of_record;
+		len = get_varchar_cur_len(src);
+		if (col->c_type == VARGRAPHIC
+		    || col->c_type == LONG_VARGRAPHIC)
+			len *= GRAPHIC_CHAR_BYTES;
+		src += VARCHAR_CUR_LEN_IND_BYTES;
+		avail -= VARCHAR_CUR_LEN_IND_BYTES;
+	} else {
+		len = fixed_value_size(col);
+	}
+	if (len > avail)
+		goto out_of_record;
+
+	val->data = src;
+	val->len = len;
+	return IXF_OK;
+
+ out_of_record:
+	return fail(ixf, IXF_ERR_FORMAT, "Column %s of row %ld runs past "
+		    "its D record", col->c_name, ixf->rows);
+}
+
+/* Returns the SMALLINT, INTEGER or BIGINT value `val'. */
+long long ixf_integer(const struct ixf_value *val)
+{
+	return parse_ixf_integer(val->data, val->len);
+}
+
+/* Returns the REAL or DOUBLE value `val'. */
+double ixf_double(const struct ixf_value *val)
+{
+	return parse_ixf_float(val->data, val->len);
+}
+
+/*
+ * Writes the DECIMAL value `val' of `col' as a string into `buff', of
+ * IXF_DECIMAL_BUFF_SIZE bytes. Returns a pointer to its ending NUL.
+ */
+char *ixf_decimal(char *buff, const struct ixf_column *col,
+		  const struct ixf_value *val)
+{
+	return decode_packed_decimal(buff, val->data, col->length);
+}
+
+/*
+ * Writes the DECFLOAT value `val' as a string into `buff', of
+ * IXF_DECFLOAT_BUFF_SIZE bytes. Returns a pointer to its ending NUL.
+ */
+char *ixf_decfloat(char *buff, const struct ixf_value *val)
+{
+	return decode_decfloat(buff, val->data, val->len);
+}
+
+/* Reads the schema of a new `ixf', the records up to the first D record. */
+static int open_file(struct ixf_file *ixf)
+{
+	ixf->size = READ_SIZE;
+	ixf->buff = malloc(ixf->size);
+	if (!ixf->buff)
+		return fail(ixf, IXF_ERR_NOMEM, "%s", "Out of memory");
+
+	return read_schema(ixf);
+}
+
+/* Saves the message of an error in `ixf', returns `status'. */
+static int fail(struct ixf_file *ixf, int status, const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(ixf->errmsg, sizeof(ixf->errmsg), format, ap);
+	va_end(ap);
+
+	return status;
+}
+
+/* Saves the message of `errno' after `what', returns IXF_ERR_IO. */
+static int fail_io(struct ixf_file *ixf, const char *what)
+{
+	char msg[ERRMSG_SIZE];
+
+	if (strerror_r(errno, msg, sizeof(msg)) != 0)
+		snprintf(msg, sizeof(msg), "error %d", errno);
+
+	return fail(ixf, IXF_ERR_IO, "%s: %s", what, msg);
+}
+
+/*
+ * Makes sure that `bytes' bytes from `pos' are in the buffer, moving them
+ * to its start and reading more. Returns IXF_END if the file ends first.
+ */
+static int fill(struct ixf_file *ixf, size_t bytes)
+{
+	unsigned char *buff;
+	size_t size;
+	ssize_t n_read;
+
+	while (ixf->end - ixf->pos < bytes) {
+		if (ixf->eof)
+			return IXF_END;
+
+		if (ixf->pos > 0) {
+			memmove(ixf->buff, ixf->buff + ixf->pos,
+				ixf->end - ixf->pos);
+			ixf->end -= ixf->pos;
+			ixf->pos = 0;
+		}
+		if (bytes > ixf->size) {
+			size = ixf->size * 2 > bytes ? ixf->size * 2 : bytes;
+			buff = realloc(ixf->buff, size);
+			if (!buff)
+				return fail(ixf, IXF_ERR_NOMEM, "%s",
+					    "Out of memory");
+			ixf->buff = buff;
+			ixf->size = size;
+		}
+
+		n_read = read(ixf->fd, ixf->buff + ixf->end,
+			      ixf->size - ixf->end);
+		if (n_read == -1) {
+			if (errno == EINTR)
+				continue;
+			return fail_io(ixf, "read");
+		}
+		if (n_read == 0)
+			ixf->eof = true;
+		ixf->end += (size_t) n_read;
+	}
+
+	return IXF_OK;
+}
+
+/*
+ * Reads the record `off' bytes after `pos' into the buffer and its length,
+ * without the length field, into `len'. Returns IXF_END if the file ends
+ * right at `off'.
+ */
+static int peek_record(struct ixf_file *ixf, size_t off, size_t *len)
+{
+	long rec_len;
+	int rc;
+
+	rc = fill(ixf, off + REC_LEN_BYTES);
+	if (rc == IXF_END && ixf->end - ixf->pos == off)
+		return IXF_END;
+	if (rc == IXF_END)
+		return fail(ixf, IXF_ERR_FORMAT, "%s", "Truncated record");
+	if (rc != IXF_OK)
+		return rc;
+
+	if (!parse_ixf_field(ixf->buff + ixf->pos + off, REC_LEN_BYTES,
+			     &rec_len) || rec_len < 1)
+		return fail(ixf, IXF_ERR_FORMAT, "%s", "Invalid record length");
+
+	rc = fill(ixf, off + REC_LEN_BYTES + (size_t) rec_len);
+	if (rc == IXF_END)
+		return fail(ixf, IXF_ERR_FORMAT, "%s", "Truncated record");
+	if (rc != IXF_OK)
+		return rc;
+
+	*len = (size_t) rec_len;
+	return IXF_OK;
+}
+
+/* read the H, T, C and A records before the first D record */
+static int read_schema(struct ixf_file *ixf)
+{
+	const unsigned char *rec;
+	size_t len;
+	int rc;
+
+	while ((rc = peek_record(ixf, 0, &len)) == IXF_OK) {
+		rec = ixf->buff + ixf->pos + REC_LEN_BYTES;
+		switch (*rec) {
+		case 'H':
+		case 'A':
+			break;
+		case 'T':
+			rc = parse_table(ixf, rec, len);
+			break;
+		case 'C':
+			rc = add_column(ixf, rec, len);
+			break;
+		case 'D':
+			/* left for ixf_next_row() */
+			if (ixf->ncols == 0)
+				return fail(ixf, IXF_ERR_FORMAT, "%s",
+					    "D record found before any C "
+					    "record");
+			return prepare_columns(ixf);
+		default:
+			return fail(ixf, IXF_ERR_FORMAT,
+				    "Unknown record type encountered: %c", *rec);
+		}
+		if (rc != IXF_OK)
+			return rc;
+		ixf->pos += REC_LEN_BYTES + len;
+	}
+
+	return rc == IXF_END ? prepare_columns(ixf) : rc;
+}
+
+/* keep the table name of the T record `rec' of `len' bytes */
+static int parse_table(struct ixf_file *ixf, const unsigned char *rec,
+		       size_t len)
+{
+	struct table_desc tbl;
+	unsigned char *copy;	/* `rec' ended with a NUL */
+	bool ok;
+
+	if (len < T_RECORD_MIN_LEN)
+		return fail(ixf, IXF_ERR_FORMAT, "%s", "T record too short");
+
+	copy = malloc(len + 1);
+	if (!copy)
+		return fail(ixf, IXF_ERR_NOMEM, "%s", "Out of memory");
+	memcpy(copy, rec, len);
+	copy[len] = '\0';
+
+	tbl.t_name = NULL;
+	tbl.t_pkname = NULL;
+	ok = parse_t_record(copy, &tbl, NULL);
+	free(copy);
+	free(tbl.t_pkname);
+	if (!ok) {
+		free(tbl.t_name);
+		return fail(ixf, IXF_ERR_FORMAT, "%s", "Invalid T record");
+	}
+
+	free(ixf->t_name);
+	ixf->t_name = tbl.t_name;
+	return IXF_OK;
+}
+
+/* add the column of the C record `rec' of `len' bytes */
+static int add_column(struct ixf_file *ixf, const unsigned char *rec,
+		      size_t len)
+{
+	struct column_desc *cols;
+	struct column_desc *col;
+
+	if (len < C_RECORD_MIN_LEN)
+		return fail(ixf, IXF_ERR_FORMAT, "%s", "C record too short");
+
+	cols = realloc(ixf->cols, (size_t) (ixf->ncols + 1) * sizeof(*cols));
+	if (!cols)
+		return fail(ixf, IXF_ERR_NOMEM, "%s", "Out of memory");
+	ixf->cols = cols;
+
+	col = &cols[ixf->ncols];
+	if (!parse_c_record(rec, col)) {
+		free(col->c_name);
+		return fail(ixf, IXF_ERR_FORMAT, "Invalid C record of column "
+			    "%d", ixf->ncols + 1);
+	}
+	col->c_colno = ++ixf->ncols;
+	col->next = NULL;
+
+	if (col->c_drid > ixf->ndrec)
+		ixf->ndrec = col->c_drid;
+
+	return IXF_OK;
+}
+
+/* make the column info and the D record arrays of a row */
+static int prepare_columns(struct ixf_file *ixf)
+{
+	const struct column_desc *col;
+	struct ixf_column *info;
+	size_t n;
+	int i;
+
+	n = (size_t) (ixf->ndrec > 0 ? ixf->ndrec : 1);
+	ixf->info = calloc((size_t) ixf->ncols + 1, sizeof(*ixf->info));
+	ixf->drecs = calloc(n, sizeof(*ixf->drecs));
+	ixf->drec_lens = calloc(n, sizeof(*ixf->drec_lens));
+	ixf->drec_offs = calloc(n, sizeof(*ixf->drec_offs));
+	if (!ixf->info || !ixf->drecs || !ixf->drec_lens || !ixf->drec_offs)
+		return fail(ixf, IXF_ERR_NOMEM, "%s", "Out of memory");
+
+	for (i = 0; i < ixf->ncols; ++i) {
+		col = &ixf->cols[i];
+		info = &ixf->info[i];
+		info->name = col->c_name;
+		info->type = col->c_type;
+		info->length = col->c_len;
+		info->nullable = col->c_nullable;
+		info->pk_pos = col->c_pkpos;
+		info->sbcp = col->c_sbcp;
+		info->dbcp = col->c_dbcp;
+		info->bit_data = col->c_bitdata;
+	}
+
+	return IXF_OK;
+}
+
+/* Returns the bytes of a value of `col' of a type of a fixed length. */
+static size_t fixed_value_size(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case GRAPHIC:
+		return col->c_len * GRAPHIC_CHAR_BYTES;
+	case DECIMAL:
+		return packed_decimal_size(col->c_len);
+	case DECFLOAT:
+		return decfloat_size(col->c_len);
+	default:
+		return col->c_len;
+	}
+}
+
+/* Returns true if the values of `type' have a length indicator. */
+static bool is_varying(int type)
+{
+	switch (type) {
+	case VARCHAR:
+	case LONG_VARCHAR:
+	case VARBINARY:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+	case XML:
+		return true;
+	default:
+		return false;
+	}
+}
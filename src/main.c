@@ -16,14 +16,27 @@
  * limitations under the License.
  */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <locale.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
+#include "boundary.h"
+#include "checkpoint.h"
 #include "ixfcvt.h"
+#include "metrics.h"
+#include "pagecache.h"
+#include "partition.h"
+#include "sort.h"
+#include "split.h"
+#include "stats.h"
 #include "util.h"
+#include "verify.h"
 
 #ifdef DEBUG
 	#define VERSION "0.80 <debug>"
@@ -32,21 +45,120 @@
 #endif
 
 #define MAX_COMMIT_SIZE 0xFFFF
+#define DEF_COMMIT_SIZE 1000
 
+/* options without a short form */
+enum long_option {
+	OPT_COLUMNS = 256,
+	OPT_WHERE,
+	OPT_LIMIT,
+	OPT_OFFSET,
+	OPT_SAMPLE,
+	OPT_SEED,
+	OPT_PROFILE,
+	OPT_SCHEMA_ONLY,
+	OPT_COUNT,
+	OPT_STATS,
+	OPT_METRICS,
+	OPT_METRICS_INTERVAL,
+	OPT_CHECKPOINT,
+	OPT_RESUME,
+	OPT_PARTITION_BY_PK,
+	OPT_PARTITION_KEY,
+	OPT_SORT_BY_PK,
+	OPT_SORT_KEY,
+	OPT_SORT_MEMORY,
+	OPT_DIFF,
+	OPT_SPLIT_IXF,
+	OPT_ROUND_ROBIN,
+	OPT_MEMOIZE,
+	OPT_POST_LOAD,
+	OPT_INSERT_ROWS,
+	OPT_INSERT_BYTES,
+	OPT_COMMIT_BYTES,
+	OPT_DROP_CACHE,
+	OPT_DIRECT_IO,
+	OPT_EMIT_CONVERTER,
+	OPT_THREADS,
+	OPT_VERIFY,
+	OPT_MAX_ERRORS
+};
+
+/* the options of the command line */
+struct options {
+	const char *o_ifile;	/* input IXF file as data source */
+	const char *o_ofile;	/* output file to store INSERT statements */
+	const char *o_cfile;	/* output file to store CREATE TABLE SQL */
+	char *o_tname;		/* user defined table name */
+	long o_commit_size;	/* commit size, -1 for the default */
+	size_t o_commit_bytes;	/* bytes between COMMITs */
+	long o_insert_rows;	/* rows of an INSERT statement, -1 if unset */
+	size_t o_insert_bytes;	/* bytes of an INSERT statement */
+	bool o_esc_bs;		/* whether escape backslash */
+	int o_dialect;		/* target SQL dialect, -1 for DB2 */
+	const char *o_columns;	/* columns to output */
+	const char *o_where;	/* rows to output */
+	long o_limit;		/* maximum rows to output, -1 for all */
+	long o_offset;		/* rows to skip */
+	double o_sample;	/* fraction of rows to sample */
+	long o_seed;		/* seed of the sampling */
+	bool o_profile;		/* output column statistics */
+	bool o_schema_only;	/* output CREATE TABLE only */
+	bool o_count;		/* output the number of rows only */
+	const char *o_metrics;	/* destination of progress metrics */
+	double o_interval;	/* seconds between metrics */
+	const char *o_ckpt;	/* checkpoint file */
+	bool o_resume;		/* go on from the checkpoint */
+	long o_nparts;		/* output partitions, 0 for one output */
+	const char *o_pkey;	/* columns to partition by */
+	bool o_sort;		/* output the rows in key order */
+	const char *o_skey;	/* columns to sort by */
+	size_t o_sort_mem;	/* bytes of rows to sort in memory */
+	const char *o_diff;	/* older IXF file to compare with */
+	long o_nsplits;		/* IXF files to copy the rows to, 0 for SQL */
+	bool o_round_robin;	/* deal the rows to the files in turn */
+	bool o_memoize;		/* reuse the SQL text of repeated values */
+	const char *o_post;	/* output file of the post-load DDL */
+	bool o_drop_cache;	/* keep the files out of the page cache */
+	bool o_direct_io;	/* write the output with O_DIRECT */
+	bool o_emit;		/* output the source of a converter */
+	long o_threads;		/* threads of the count, -1 for the default */
+	bool o_verify;		/* check the file instead of converting it */
+	long o_max_errors;	/* errors written by --verify, -1 for default */
+};
+
+static void init_options(struct options *opts);
+static int parse_options(int argc, char *argv[], struct options *opts);
+static int check_options(const struct options *opts);
+static int check_sql_options(const struct options *o);
+static int check_split_options(const struct options *o);
+static int check_emit_options(const struct options *o);
+static int check_verify_options(const struct options *o);
+static bool row_options_given(const struct options *o);
+static int reject_if(bool bad, const char *msg);
+static void fill_summary(struct summary *sum, const struct options *opts);
+static int open_locked(const char *file, int oflags, mode_t mode,
+		       short lock_type);
 static void ignore_lock_fail_or_exit(const char *filename);
+static int parse_dialect(const char *name);
+static long parse_count(const char *prog, const char *opt, const char *arg);
+static double parse_percent(const char *prog, const char *arg);
+static double parse_seconds(const char *prog, const char *arg);
+static size_t parse_size(const char *prog, const char *opt, const char *arg);
 
-int main(int argc, char *argv[])
-{
-	const char VERSION_INFO[] = "\
+static const char VERSION_INFO[] = "\
 ixfcvt version %s\n\
 A tool for converting an IBM PC/IXF format file to SQL statements\n\
 \n\
 Currently supports the following DB2 data types:\n\
-CHAR, VARCHAR\n\
+CHAR, VARCHAR, LONG VARCHAR\n\
+GRAPHIC, VARGRAPHIC, LONG VARGRAPHIC\n\
+BINARY, VARBINARY\n\
 SMALLINT, INTEGER, BIGINT\n\
-DECIMAL\n\
+DECIMAL, DECFLOAT\n\
 REAL, DOUBLE\n\
 DATE, TIME, TIMESTAMP\n\
+XML\n\
 \n\
 Project on GitHub: <https://github.com/gxc/ixfcvt>\n\
 Report bugs to <https://github.com/gxc/ixfcvt/issues>\n\
@@ -65,15 +177,31 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.\n\
 See the License for the specific language governing permissions and\n\
 limitations under the License.\
 ";
-	const char USAGE_INFO[] = "\
+
+static const char USAGE_INFO[] = "\
 \n\
 ixfcvt: A tool for converting an IBM PC/IXF format file to SQL statements\n\
-Usage: %s [-c CFILE] [-t TNAME] [-e] [-o OFILE] [-s SIZE] [IXFFILE]\n\
+Usage: %s [-c CFILE] [-t TNAME] [-d DIALECT] [-e] [-o OFILE] [-s SIZE]\n\
+           [--columns LIST] [--where EXPR] [--limit N] [--offset N]\n\
+           [--sample PERCENT [--seed N]]\n\
+           [--insert-rows N] [--insert-bytes SIZE] [--commit-bytes SIZE]\n\
+           [--profile | --schema-only | --count] [--post-load FILE]\n\
+           [--stats] [--memoize] [--drop-cache] [--direct-io]\n\
+           [--emit-converter] [--threads N]\n\
+           [--verify [--max-errors N]]\n\
+           [--metrics DEST [--metrics-interval SECONDS]]\n\
+           [--checkpoint FILE [--resume]]\n\
+           [--partition-by-pk K [--partition-key LIST]]\n\
+           [--sort-by-pk [--sort-key LIST] [--sort-memory SIZE]]\n\
+           [--diff OLDFILE]\n\
+           [--split-ixf K [--partition-key LIST | --round-robin]] [IXFFILE]\n\
 \n\
 Argument:\n\
     <IXFFILE>     input IXF format file, the data source\n\
 Options:\n\
     -c <CFILE>    output CREATE TABLE statement to <CFILE> if specified\n\
+    -d <DIALECT>  generate SQL for <DIALECT>: db2 (default), postgresql,\n\
+                  mysql, oracle or sqlite\n\
     -e            escape backslash(\\), or use it as literal by default\n\
     -h            display this help and exit\n\
     -o <OFILE>    output data of <IXFFILE> as INSERT statements to <OFILE>\n\
@@ -83,73 +211,491 @@ Options:\n\
                   If <SIZE> is 0, no COMMIT statement will be issued\n\
     -t <TNAME>    use <TNAME> as the table name when output\n\
                   If not specified, use data name of <IXFFILE>\n\
-    -v            show version: \"ixfcvt v%s by Guo, Xingchun\"\
+    -v            show version: \"ixfcvt v%s by Guo, Xingchun\"\n\
+    --columns <LIST>\n\
+                  output only the columns in comma-separated <LIST>,\n\
+                  in that order, given by name or position (from 1)\n\
+    --where <EXPR>\n\
+                  output only the rows satisfying <EXPR>, made up of\n\
+                  comparisons (=, <>, <, <=, >, >=), IN, BETWEEN and\n\
+                  IS NULL on columns, joined by AND, OR and NOT\n\
+    --limit <N>   output at most <N> rows and stop reading\n\
+    --offset <N>  skip the first <N> rows that would be output\n\
+    --sample <PERCENT>\n\
+                  output a random sample of about <PERCENT>%% of the rows\n\
+    --seed <N>    seed of --sample (default 0), the same seed picks\n\
+                  the same rows\n\
+    --profile     output statistics of each column as JSON instead of SQL:\n\
+                  null count, estimated distinct count, min/max, lengths\n\
+    --schema-only output only the CREATE TABLE statement, to <CFILE> or\n\
+                  else as the output; no row is read\n\
+    --count       output only the number of rows\n\
+    --post-load <FILE>\n\
+                  create the table of -c or --schema-only without its\n\
+                  constraints, unlogged where the dialect allows it, and\n\
+                  write the statements adding them and gathering the\n\
+                  statistics to <FILE>, to run once the rows are loaded\n\
+    --insert-rows <N>\n\
+                  put up to <N> rows in an INSERT statement (default 1)\n\
+    --insert-bytes <SIZE>\n\
+                  end an INSERT statement before it grows past <SIZE>\n\
+                  bytes (K, M or G), also with no --insert-rows\n\
+    --commit-bytes <SIZE>\n\
+                  issue a COMMIT once <SIZE> bytes of statements are\n\
+                  output since the last one, also with -s 0\n\
+    --stats       write timings of each phase, I/O and record counters,\n\
+                  peak memory and formatting time per column type to\n\
+                  the standard error at exit\n\
+    --memoize     reuse the SQL text of values seen before in columns of\n\
+                  short values, as long as they repeat often enough\n\
+%s\
 ";
 
-	const char *ifile;	/* input IXF file as data source */
-	const char *ofile;	/* output file to store INSERT statements */
-	const char *cfile;	/* output file to store CREATE TABLE SQL */
-	char *tname;		/* user defined table name */
-	long commit_size;	/* commit size */
-	bool esc_bs;		/* whether escape backslash */
+/* longer than a string literal may be in C99 */
+static const char USAGE_INFO_MORE[] = "\
+    --metrics <DEST>\n\
+                  write progress as a line of JSON every interval to\n\
+                  <DEST>: a file, fd:<N> or unix:<SOCKET PATH>\n\
+    --metrics-interval <SECONDS>\n\
+                  seconds between the lines of --metrics (default 10)\n\
+    --checkpoint <FILE>\n\
+                  save the position of the conversion to <FILE> at each\n\
+                  COMMIT; needs -o and a <SIZE> other than 0 or\n\
+                  --commit-bytes\n\
+    --resume      go on from the checkpoint in <FILE> of --checkpoint,\n\
+                  cutting <OFILE> back to it, with the same options\n\
+    --partition-by-pk <K>\n\
+                  write the rows to <K> files <OFILE>.0 ... <OFILE>.<K-1>\n\
+                  by a hash of their primary key, each with its own COMMITs\n\
+    --partition-key <LIST>\n\
+                  hash the columns in comma-separated <LIST> instead of\n\
+                  the primary key\n\
+    --sort-by-pk  output the rows in the order of their primary key,\n\
+                  sorted in temporary files in $TMPDIR if they do not fit\n\
+                  in memory\n\
+    --sort-key <LIST>\n\
+                  sort by the columns in comma-separated <LIST> instead\n\
+    --sort-memory <SIZE>\n\
+                  bytes of rows to sort in memory, with a suffix K, M or G\n\
+                  (default 256M)\n\
+    --diff <OLDFILE>\n\
+                  output only the INSERT, UPDATE and DELETE statements\n\
+                  that turn the rows of <OLDFILE> into those of <IXFFILE>,\n\
+                  matched by primary key or --sort-key; both files must\n\
+                  have the same columns\n\
+    --split-ixf <K>\n\
+                  copy the rows to <K> IXF files <OFILE>.0 ... <OFILE>.<K-1>\n\
+                  by a hash of their primary key, each with the H, T and C\n\
+                  records of <IXFFILE>, for parallel IMPORT or LOAD\n\
+    --round-robin deal the rows of --split-ixf to the files in turn\n\
+    --drop-cache  drop the pages of <IXFFILE> from the page cache behind\n\
+                  the reads, and write the output back behind the writes\n\
+                  and drop its pages too, not to evict those of others\n\
+    --direct-io   write <OFILE> with O_DIRECT, bypassing the page cache;\n\
+                  needs -o, and cannot be given with --checkpoint\n\
+    --emit-converter\n\
+                  output the C source of a converter of files with the\n\
+                  C records of <IXFFILE> to the SQL of -t, -d, -e, -s and\n\
+                  --columns, the only other options allowed; no row is\n\
+                  read.  `make converter SCHEMA=<IXFFILE>' builds it\n\
+    --threads <N> count the rows of <IXFFILE> ahead of the conversion on\n\
+                  <N> threads, 0 for one per processor (default 1, or 0\n\
+                  with --verify)\n\
+    --verify      check <IXFFILE> instead of converting it: the record\n\
+                  framing, the C records against IXFTCCNT, and each value\n\
+                  against its column; writes the first errors with their\n\
+                  offsets and exits with 1 if there is any\n\
+    --max-errors <N>\n\
+                  errors written by --verify at most (default 20)\
+";
+
+static const struct option LONG_OPTIONS[] = {
+	{"dialect", required_argument, NULL, 'd'},
+	{"help", no_argument, NULL, 'h'},
+	{"version", no_argument, NULL, 'v'},
+	{"columns", required_argument, NULL, OPT_COLUMNS},
+	{"where", required_argument, NULL, OPT_WHERE},
+	{"limit", required_argument, NULL, OPT_LIMIT},
+	{"offset", required_argument, NULL, OPT_OFFSET},
+	{"sample", required_argument, NULL, OPT_SAMPLE},
+	{"seed", required_argument, NULL, OPT_SEED},
+	{"profile", no_argument, NULL, OPT_PROFILE},
+	{"schema-only", no_argument, NULL, OPT_SCHEMA_ONLY},
+	{"count", no_argument, NULL, OPT_COUNT},
+	{"stats", no_argument, NULL, OPT_STATS},
+	{"metrics", required_argument, NULL, OPT_METRICS},
+	{"metrics-interval", required_argument, NULL,
+	 OPT_METRICS_INTERVAL},
+	{"checkpoint", required_argument, NULL, OPT_CHECKPOINT},
+	{"resume", no_argument, NULL, OPT_RESUME},
+	{"partition-by-pk", required_argument, NULL,
+	 OPT_PARTITION_BY_PK},
+	{"partition-key", required_argument, NULL, OPT_PARTITION_KEY},
+	{"sort-by-pk", no_argument, NULL, OPT_SORT_BY_PK},
+	{"sort-key", required_argument, NULL, OPT_SORT_KEY},
+	{"sort-memory", required_argument, NULL, OPT_SORT_MEMORY},
+	{"diff", required_argument, NULL, OPT_DIFF},
+	{"split-ixf", required_argument, NULL, OPT_SPLIT_IXF},
+	{"round-robin", no_argument, NULL, OPT_ROUND_ROBIN},
+	{"memoize", no_argument, NULL, OPT_MEMOIZE},
+	{"post-load", required_argument, NULL, OPT_POST_LOAD},
+	{"insert-rows", required_argument, NULL, OPT_INSERT_ROWS},
+	{"insert-bytes", required_argument, NULL, OPT_INSERT_BYTES},
+	{"commit-bytes", required_argument, NULL, OPT_COMMIT_BYTES},
+	{"drop-cache", no_argument, NULL, OPT_DROP_CACHE},
+	{"direct-io", no_argument, NULL, OPT_DIRECT_IO},
+	{"emit-converter", no_argument, NULL, OPT_EMIT_CONVERTER},
+	{"threads", required_argument, NULL, OPT_THREADS},
+	{"verify", no_argument, NULL, OPT_VERIFY},
+	{"max-errors", required_argument, NULL, OPT_MAX_ERRORS},
+	{NULL, 0, NULL, 0}
+};
 
+int main(int argc, char *argv[])
+{
+	struct options opts;
 	struct summary sum;
 	int errflg;		/* error on command line arguments */
 	int ifd;
 	int ofd;
 	int cfd;
+	int dfd;
+	int pfd;
 	int oflags;
 	mode_t mode;
 
-	int c;
+	int i;
 
 	setlocale(LC_ALL, "");
 
 	if (argc == 1)
-		usage(EXIT_FAILURE, USAGE_INFO, argv[0], VERSION);
+		usage(EXIT_FAILURE, USAGE_INFO, argv[0], VERSION,
+		      USAGE_INFO_MORE);
+
+	init_options(&opts);
+	errflg = parse_options(argc, argv, &opts);
+	errflg += check_options(&opts);
+	if (errflg)
+		usage(EXIT_FAILURE, USAGE_INFO, argv[0], VERSION,
+		      USAGE_INFO_MORE);
+	if (opts.o_nsplits > 0)
+		opts.o_nparts = opts.o_nsplits;	/* the files are partitions */
+
+	oflags = O_WRONLY | O_CREAT | O_TRUNC;
+	mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;	/* 0644 */
+	init_page_cache(opts.o_drop_cache, opts.o_direct_io);
+	ifd = open_locked(opts.o_ifile, O_RDONLY, 0, F_RDLCK);
+	cache_input(ifd);
+	if (opts.o_metrics)
+		open_metrics(opts.o_metrics, opts.o_interval, ifd);
+	if (opts.o_diff) {
+		dfd = open_locked(opts.o_diff, O_RDONLY, 0, F_RDLCK);
+		cache_input(dfd);
+	} else {
+		dfd = -1;
+	}
+
+	if (opts.o_nparts > 0) {
+		open_partitions(opts.o_ofile, (int)opts.o_nparts, oflags, mode);
+		ofd = partition_fds()[0];	/* closed with the others */
+		for (i = 0; i < opts.o_nparts; ++i)
+			cache_output(partition_fds()[i]);
+		if (opts.o_nsplits > 0)
+			open_splits(partition_fds(), (int)opts.o_nparts);
+	} else if (opts.o_ofile) {
+		/* kept up to the checkpoint */
+		ofd = open_locked(opts.o_ofile, opts.o_resume
+				  ? oflags & ~O_TRUNC : oflags, mode, F_WRLCK);
+		cache_output(ofd);
+	} else {
+		ofd = STDOUT_FILENO;
+	}
+
+	if (opts.o_cfile)
+		cfd = open_locked(opts.o_cfile, oflags, mode, F_WRLCK);
+	else if (opts.o_schema_only)
+		cfd = ofd;	/* CREATE TABLE is the output */
+	else
+		cfd = open_file("/dev/null", O_WRONLY, 0);
+
+	pfd = opts.o_post ? open_locked(opts.o_post, oflags, mode, F_WRLCK)
+	    : -1;
+
+	if (opts.o_ckpt)
+		open_checkpoint(opts.o_ckpt, opts.o_resume, ifd, ofd);
+
+	fill_summary(&sum, &opts);
+	sum.s_diff_fd = dfd;
+	sum.s_post_fd = pfd;
+	/* while writing to a file, unless --metrics reports it */
+	sum.s_progress = ofd != STDOUT_FILENO && !opts.o_metrics;
+
+	if (sum.s_progress)
+		err_msg("%s\r", "Preparing...");
+	enter_phase(PHASE_SUMMARY);
+	get_ixf_summary(ifd, &sum);
+	if (sum.s_ccnt > 0)
+		parse_and_output(ifd, ofd, cfd, &sum);
+	else if (opts.o_verify)
+		fmt_err_exit("%s", "No C record in the IXF file");
+
+	close_checkpoint();
+	close_file(ifd);
+	if (dfd != -1)
+		close_file(dfd);
+	if (opts.o_nsplits > 0)
+		close_splits();
+	if (opts.o_nparts > 0)
+		close_partitions();
+	else
+		close_file(ofd);
+	if (cfd != ofd)
+		close_file(cfd);
+	if (pfd != -1)
+		close_file(pfd);
+	if (stats_enabled())
+		print_stats();
+
+	return opts.o_verify && !verify_passed() ? EXIT_FAILURE : 0;
+}
+
+/* set the options not given to their defaults */
+static void init_options(struct options *opts)
+{
+	opts->o_ifile = NULL;
+	opts->o_ofile = NULL;
+	opts->o_cfile = NULL;
+	opts->o_tname = NULL;
+	opts->o_commit_size = -1L;
+	opts->o_commit_bytes = 0;
+	opts->o_insert_rows = -1L;
+	opts->o_insert_bytes = 0;
+	opts->o_esc_bs = false;
+	opts->o_dialect = -1;
+	opts->o_columns = NULL;
+	opts->o_where = NULL;
+	opts->o_limit = -1L;
+	opts->o_offset = 0L;
+	opts->o_sample = 1.0;
+	opts->o_seed = 0L;
+	opts->o_profile = false;
+	opts->o_schema_only = false;
+	opts->o_count = false;
+	opts->o_metrics = NULL;
+	opts->o_interval = 10.0;
+	opts->o_ckpt = NULL;
+	opts->o_resume = false;
+	opts->o_nparts = 0L;
+	opts->o_pkey = NULL;
+	opts->o_sort = false;
+	opts->o_skey = NULL;
+	opts->o_sort_mem = 0;
+	opts->o_diff = NULL;
+	opts->o_nsplits = 0L;
+	opts->o_round_robin = false;
+	opts->o_memoize = false;
+	opts->o_post = NULL;
+	opts->o_drop_cache = false;
+	opts->o_direct_io = false;
+	opts->o_emit = false;
+	opts->o_threads = -1L;
+	opts->o_verify = false;
+	opts->o_max_errors = -1L;
+}
+
+/*
+ * Reads the options and the input file of the command line into `opts',
+ * exiting on a value out of range.  Returns the number of errors written.
+ */
+static int parse_options(int argc, char *argv[], struct options *opts)
+{
+	int errflg;
+	int c;
 
 	errflg = 0;
-	ifile = NULL;
-	ofile = NULL;
-	cfile = NULL;
-	tname = NULL;
-	esc_bs = 0;
-	commit_size = 1000L;
-	while ((c = getopt(argc, argv, ":c:o:s:t:ehv")) != -1) {
+	while ((c = getopt_long(argc, argv, ":c:d:o:s:t:ehv", LONG_OPTIONS,
+				NULL)) != -1) {
 		switch (c) {
 		case 'c':
-			cfile = optarg;
+			opts->o_cfile = optarg;
+			break;
+		case 'd':
+			opts->o_dialect = parse_dialect(optarg);
+			if (opts->o_dialect == -1)
+				fmt_err_exit("%s: Unknown SQL dialect: %s",
+					     argv[0], optarg);
 			break;
 		case 'e':
-			esc_bs = 1;
+			opts->o_esc_bs = true;
 			break;
 		case 'h':
 			usage(errflg ? EXIT_FAILURE : EXIT_SUCCESS, USAGE_INFO,
-			      argv[0], VERSION);
+			      argv[0], VERSION, USAGE_INFO_MORE);
 			break;
 		case 'o':
-			ofile = optarg;
+			opts->o_ofile = optarg;
 			break;
 		case 's':
-			commit_size = str_to_long(optarg);
-			if (commit_size < 0 || commit_size > MAX_COMMIT_SIZE)
-				fmt_err_exit
-				    ("%s: Commit size must be between 0 and %hu",
-				     argv[0], MAX_COMMIT_SIZE);
+			opts->o_commit_size = str_to_long(optarg);
+			if (opts->o_commit_size < 0
+			    || opts->o_commit_size > MAX_COMMIT_SIZE)
+				fmt_err_exit("%s: Commit size must be between "
+					     "0 and %hu", argv[0],
+					     MAX_COMMIT_SIZE);
 			break;
 		case 't':
-			tname = optarg;
+			opts->o_tname = optarg;
 			break;
 		case 'v':
 			usage(EXIT_SUCCESS, VERSION_INFO, VERSION);
 			break;
+		case OPT_COLUMNS:
+			opts->o_columns = optarg;
+			break;
+		case OPT_WHERE:
+			opts->o_where = optarg;
+			break;
+		case OPT_LIMIT:
+			opts->o_limit = parse_count(argv[0], "--limit", optarg);
+			break;
+		case OPT_OFFSET:
+			opts->o_offset = parse_count(argv[0], "--offset",
+						     optarg);
+			break;
+		case OPT_SAMPLE:
+			opts->o_sample = parse_percent(argv[0], optarg) / 100.0;
+			break;
+		case OPT_SEED:
+			opts->o_seed = parse_count(argv[0], "--seed", optarg);
+			break;
+		case OPT_PROFILE:
+			opts->o_profile = true;
+			break;
+		case OPT_SCHEMA_ONLY:
+			opts->o_schema_only = true;
+			break;
+		case OPT_COUNT:
+			opts->o_count = true;
+			break;
+		case OPT_STATS:
+			enable_stats();
+			break;
+		case OPT_METRICS:
+			opts->o_metrics = optarg;
+			break;
+		case OPT_METRICS_INTERVAL:
+			opts->o_interval = parse_seconds(argv[0], optarg);
+			break;
+		case OPT_CHECKPOINT:
+			opts->o_ckpt = optarg;
+			break;
+		case OPT_RESUME:
+			opts->o_resume = true;
+			break;
+		case OPT_PARTITION_BY_PK:
+			opts->o_nparts = str_to_long(optarg);
+			if (opts->o_nparts < 1
+			    || opts->o_nparts > MAX_PARTITIONS)
+				fmt_err_exit("%s: --partition-by-pk must be "
+					     "between 1 and %d", argv[0],
+					     MAX_PARTITIONS);
+			break;
+		case OPT_PARTITION_KEY:
+			opts->o_pkey = optarg;
+			break;
+		case OPT_SORT_BY_PK:
+			opts->o_sort = true;
+			break;
+		case OPT_SORT_KEY:
+			opts->o_skey = optarg;
+			break;
+		case OPT_SORT_MEMORY:
+			opts->o_sort_mem = parse_size(argv[0], "--sort-memory",
+						      optarg);
+			if (opts->o_sort_mem < MIN_SORT_MEMORY)
+				fmt_err_exit("%s: --sort-memory must be a size "
+					     "of at least 1M", argv[0]);
+			break;
+		case OPT_DIFF:
+			opts->o_diff = optarg;
+			break;
+		case OPT_SPLIT_IXF:
+			opts->o_nsplits = str_to_long(optarg);
+			if (opts->o_nsplits < 1
+			    || opts->o_nsplits > MAX_PARTITIONS)
+				fmt_err_exit("%s: --split-ixf must be "
+					     "between 1 and %d", argv[0],
+					     MAX_PARTITIONS);
+			break;
+		case OPT_ROUND_ROBIN:
+			opts->o_round_robin = true;
+			break;
+		case OPT_MEMOIZE:
+			opts->o_memoize = true;
+			break;
+		case OPT_POST_LOAD:
+			opts->o_post = optarg;
+			break;
+		case OPT_INSERT_ROWS:
+			opts->o_insert_rows = parse_count(argv[0],
+							  "--insert-rows",
+							  optarg);
+			if (opts->o_insert_rows == 0)
+				fmt_err_exit("%s: --insert-rows must be at "
+					     "least 1", argv[0]);
+			break;
+		case OPT_INSERT_BYTES:
+			opts->o_insert_bytes = parse_size(argv[0],
+							  "--insert-bytes",
+							  optarg);
+			break;
+		case OPT_COMMIT_BYTES:
+			opts->o_commit_bytes = parse_size(argv[0],
+							  "--commit-bytes",
+							  optarg);
+			break;
+		case OPT_DROP_CACHE:
+			opts->o_drop_cache = true;
+			break;
+		case OPT_DIRECT_IO:
+			opts->o_direct_io = true;
+			break;
+		case OPT_EMIT_CONVERTER:
+			opts->o_emit = true;
+			break;
+		case OPT_THREADS:
+			opts->o_threads = str_to_long(optarg);
+			if (opts->o_threads < 0
+			    || opts->o_threads > MAX_THREADS)
+				fmt_err_exit("%s: --threads must be between 0 "
+					     "and %d", argv[0], MAX_THREADS);
+			break;
+		case OPT_VERIFY:
+			opts->o_verify = true;
+			break;
+		case OPT_MAX_ERRORS:
+			opts->o_max_errors = str_to_long(optarg);
+			if (opts->o_max_errors < 1
+			    || opts->o_max_errors > MAX_ERRORS)
+				fmt_err_exit("%s: --max-errors must be between "
+					     "1 and %d", argv[0], MAX_ERRORS);
+			break;
 		case ':':
 			errflg++;
-			err_msg("Option -%c requires an argument\n", optopt);
+			if (optopt)
+				err_msg("Option -%c requires an argument\n",
+					optopt);
+			else
+				err_msg("Option %s requires an argument\n",
+					argv[optind - 1]);
 			break;
 		case '?':
 			errflg++;
-			err_msg("Unrecognized option: -%c\n", optopt);
+			if (optopt)
+				err_msg("Unrecognized option: -%c\n", optopt);
+			else
+				err_msg("Unrecognized option: %s\n",
+					argv[optind - 1]);
 			break;
 		}
 	}
@@ -161,49 +707,228 @@ Options:\n\
 		err_msg("%s\n", "Too many input files specified");
 		errflg++;
 	} else {
-		ifile = argv[optind];
+		opts->o_ifile = argv[optind];
 	}
 
-	if (errflg)
-		usage(EXIT_FAILURE, USAGE_INFO, argv[0], VERSION);
+	return errflg;
+}
 
-	oflags = O_WRONLY | O_CREAT | O_TRUNC;
-	mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;	/* 0644 */
-	ifd = open_file(ifile, O_RDONLY, 0);
-	if (!lock_entire_file(ifd, F_RDLCK))
-		ignore_lock_fail_or_exit(ifile);
-
-	if (ofile) {
-		ofd = open_file(ofile, oflags, mode);
-		if (!lock_entire_file(ofd, F_WRLCK))
-			ignore_lock_fail_or_exit(ofile);
-	} else {
-		ofd = STDOUT_FILENO;
-	}
+/*
+ * Checks the options of `opts' against each other, by mode.  Returns the
+ * number of conflicts written.
+ */
+static int check_options(const struct options *opts)
+{
+	int errflg;
 
-	if (cfile) {
-		cfd = open_file(cfile, oflags, mode);
-		if (!lock_entire_file(cfd, F_WRLCK))
-			ignore_lock_fail_or_exit(cfile);
-	} else {
-		cfd = open_file("/dev/null", O_WRONLY, 0);
-	}
+	errflg = check_sql_options(opts);
+	errflg += check_split_options(opts);
+	errflg += check_emit_options(opts);
+	errflg += check_verify_options(opts);
 
-	sum.s_cmtsz = (int)commit_size;
-	sum.s_tname = tname;
-	sum.s_escbs = esc_bs;
+	return errflg;
+}
 
-	if (ofd != STDOUT_FILENO)
-		err_msg("%s\r", "Preparing...");
-	get_ixf_summary(ifd, &sum);
-	if (sum.s_ccnt > 0)
-		parse_and_output(ifd, ofd, cfd, &sum);
+/* the options of the SQL output, its kind, restarts and order of rows */
+static int check_sql_options(const struct options *o)
+{
+	bool other_output;	/* --profile, --schema-only or --count */
+	int errflg;
 
-	close_file(ifd);
-	close_file(ofd);
-	close_file(cfd);
+	other_output = o->o_profile || o->o_schema_only || o->o_count;
+	errflg = reject_if(o->o_profile + o->o_schema_only + o->o_count > 1,
+			   "Only one of --profile, --schema-only and --count "
+			   "can be given");
+	errflg += reject_if(o->o_resume && !o->o_ckpt,
+			    "--resume needs --checkpoint");
+	errflg += reject_if(o->o_ckpt && (!o->o_ofile || other_output
+					  || (o->o_commit_size == 0
+					      && o->o_commit_bytes == 0)),
+			    "--checkpoint needs -o and a commit size, and "
+			    "cannot be given with --profile, --schema-only or "
+			    "--count");
+	errflg += reject_if((o->o_skey || o->o_sort_mem > 0) && !o->o_sort
+			    && !o->o_diff, "--sort-key and --sort-memory need "
+			    "--sort-by-pk or --diff");
+	errflg += reject_if(o->o_sort && (o->o_ckpt || other_output),
+			    "--sort-by-pk cannot be given with --checkpoint, "
+			    "--profile, --schema-only or --count");
+	errflg += reject_if(o->o_diff && (o->o_ckpt || other_output
+					  || o->o_nparts > 0 || o->o_nsplits > 0
+					  || o->o_limit >= 0
+					  || o->o_offset > 0),
+			    "--diff cannot be given with --checkpoint, "
+			    "--profile, --schema-only, --count, "
+			    "--partition-by-pk, --split-ixf, --limit or "
+			    "--offset");
+	errflg += reject_if(o->o_post && ((!o->o_cfile && !o->o_schema_only)
+					  || o->o_profile || o->o_count
+					  || o->o_nsplits > 0),
+			    "--post-load needs -c or --schema-only, and cannot "
+			    "be given with --profile, --count or --split-ixf");
+	/* a checkpoint seeks the output, past the buffer of O_DIRECT */
+	errflg += reject_if(o->o_direct_io && (!o->o_ofile || o->o_ckpt),
+			    "--direct-io needs -o, and cannot be given with "
+			    "--checkpoint");
+	errflg += reject_if(o->o_direct_io && !direct_io_supported(),
+			    "--direct-io is not supported on this system");
 
-	return 0;
+	return errflg;
+}
+
+/* the options writing the rows to several files */
+static int check_split_options(const struct options *o)
+{
+	int errflg;
+
+	errflg = reject_if(o->o_nparts > 0 && o->o_nsplits > 0,
+			   "Only one of --partition-by-pk and --split-ixf can "
+			   "be given");
+	errflg += reject_if(o->o_pkey && o->o_nparts == 0
+			    && o->o_nsplits == 0, "--partition-key needs "
+			    "--partition-by-pk or --split-ixf");
+	errflg += reject_if(o->o_round_robin && (o->o_nsplits == 0
+						 || o->o_pkey),
+			    "--round-robin needs --split-ixf, and cannot be "
+			    "given with --partition-key");
+	errflg += reject_if(o->o_nsplits > 0 && (!o->o_ofile || o->o_ckpt
+						 || o->o_profile
+						 || o->o_schema_only
+						 || o->o_count || o->o_columns),
+			    "--split-ixf needs -o, and cannot be given with "
+			    "--checkpoint, --profile, --schema-only, --count "
+			    "or --columns");
+	errflg += reject_if(o->o_nparts > 0 && (!o->o_ofile || o->o_ckpt
+						|| o->o_profile
+						|| o->o_schema_only
+						|| o->o_count),
+			    "--partition-by-pk needs -o, and cannot be given "
+			    "with --checkpoint, --profile, --schema-only or "
+			    "--count");
+
+	return errflg;
+}
+
+/* the converter writes what the options of the rows do by default */
+static int check_emit_options(const struct options *o)
+{
+	return reject_if(o->o_emit && row_options_given(o),
+			 "--emit-converter can be given with -o, -t, -d, -e, "
+			 "-s and --columns only");
+}
+
+/* nothing is converted by --verify */
+static int check_verify_options(const struct options *o)
+{
+	int errflg;
+
+	errflg = reject_if(o->o_verify && (row_options_given(o) || o->o_emit
+					   || o->o_tname || o->o_dialect >= 0
+					   || o->o_esc_bs
+					   || o->o_commit_size >= 0
+					   || o->o_columns),
+			   "--verify can be given with -o, --threads, "
+			   "--max-errors, --stats, --metrics and --drop-cache "
+			   "only");
+	errflg += reject_if(o->o_max_errors > 0 && !o->o_verify,
+			    "--max-errors needs --verify");
+
+	return errflg;
+}
+
+/*
+ * Tells whether an option is given of which rows are output and how,
+ * besides the columns and the SQL of -t, -d, -e and -s.
+ */
+static bool row_options_given(const struct options *o)
+{
+	return o->o_cfile || o->o_where || o->o_limit >= 0 || o->o_offset > 0
+	    || o->o_sample < 1.0 || o->o_profile || o->o_schema_only
+	    || o->o_count || o->o_post || o->o_ckpt || o->o_nparts > 0
+	    || o->o_sort || o->o_diff || o->o_nsplits > 0 || o->o_memoize
+	    || o->o_insert_rows >= 0 || o->o_insert_bytes > 0
+	    || o->o_commit_bytes > 0 || o->o_direct_io;
+}
+
+/* Writes `msg' if `bad'.  Returns 1 if it did, 0 if not. */
+static int reject_if(bool bad, const char *msg)
+{
+	if (!bad)
+		return 0;
+
+	err_msg("%s\n", msg);
+	return 1;
+}
+
+/* set the summary of the conversion from the options of `opts' */
+static void fill_summary(struct summary *sum, const struct options *opts)
+{
+	sum->s_cmtsz = opts->o_commit_size < 0 ? DEF_COMMIT_SIZE
+	    : (int)opts->o_commit_size;
+	sum->s_commit_bytes = opts->o_commit_bytes;
+	/* --insert-bytes alone puts as many rows as fit */
+	if (opts->o_insert_rows >= 0)
+		sum->s_insert_rows = opts->o_insert_rows;
+	else
+		sum->s_insert_rows = opts->o_insert_bytes > 0 ? 0L : 1L;
+	sum->s_insert_bytes = opts->o_insert_bytes;
+	sum->s_tname = opts->o_tname;
+	sum->s_escbs = opts->o_esc_bs;
+	sum->s_dialect = opts->o_dialect < 0 ? SQL_DB2
+	    : (enum sql_dialect)opts->o_dialect;
+	sum->s_cols = opts->o_columns;
+	sum->s_where = opts->o_where;
+	sum->s_limit = opts->o_limit;
+	sum->s_offset = opts->o_offset;
+	sum->s_sample = opts->o_sample;
+	sum->s_seed = (unsigned long)opts->o_seed;
+	sum->s_profile = opts->o_profile;
+	sum->s_schema_only = opts->o_schema_only;
+	sum->s_count = opts->o_count;
+	/*
+	 * a resumed conversion does not read the rows before it, and
+	 * --split-ixf copies them without counting them first
+	 */
+	sum->s_scan_all = opts->o_limit < 0 && !opts->o_schema_only
+	    && !opts->o_resume && !opts->o_emit && !opts->o_verify
+	    && opts->o_nsplits == 0;
+	/* --verify runs on all processors unless told otherwise */
+	if (opts->o_threads > 0)
+		sum->s_threads = (int)opts->o_threads;
+	else if (opts->o_threads == 0 || opts->o_verify)
+		sum->s_threads = online_cpus();
+	else
+		sum->s_threads = 1;
+	sum->s_nparts = (int)opts->o_nparts;
+	sum->s_pkey = opts->o_pkey;
+	/* the rows of both files of --diff are sorted by key */
+	sum->s_sort = opts->o_sort || opts->o_diff;
+	sum->s_skey = opts->o_skey;
+	sum->s_sort_mem = opts->o_sort_mem > 0 ? opts->o_sort_mem
+	    : DEF_SORT_MEMORY;
+	sum->s_split = opts->o_nsplits > 0;
+	sum->s_round_robin = opts->o_round_robin;
+	sum->s_memoize = opts->o_memoize;
+	sum->s_emit = opts->o_emit;
+	sum->s_verify = opts->o_verify;
+	sum->s_max_errors = opts->o_max_errors > 0 ? (int)opts->o_max_errors
+	    : DEF_MAX_ERRORS;
+}
+
+/*
+ * Opens `file' with `oflags' and `mode' and locks it with `lock_type',
+ * asking whether to go on if it cannot be locked.
+ */
+static int open_locked(const char *file, int oflags, mode_t mode,
+		       short lock_type)
+{
+	int fd;
+
+	fd = open_file(file, oflags, mode);
+	if (!lock_entire_file(fd, lock_type))
+		ignore_lock_fail_or_exit(file);
+
+	return fd;
 }
 
 /* prompt user to deside whether to ignore the file lock failure or to exit */
@@ -217,3 +942,102 @@ static void ignore_lock_fail_or_exit(const char *filename)
 	if (!is_ignored)
 		exit(EXIT_FAILURE);
 }
+
+/* Returns the sql_dialect named `name', or -1 if unknown. */
+static int parse_dialect(const char *name)
+{
+	static const struct {
+		const char *name;
+		enum sql_dialect dialect;
+	} DIALECTS[] = {
+		{"db2", SQL_DB2},
+		{"postgresql", SQL_POSTGRESQL},
+		{"postgres", SQL_POSTGRESQL},
+		{"mysql", SQL_MYSQL},
+		{"oracle", SQL_ORACLE},
+		{"sqlite", SQL_SQLITE}
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(DIALECTS) / sizeof(DIALECTS[0]); ++i)
+		if (strcasecmp(name, DIALECTS[i].name) == 0)
+			return (int)DIALECTS[i].dialect;
+
+	return -1;
+}
+
+/* Returns the non-negative integer argument `arg' of option `opt'. */
+static long parse_count(const char *prog, const char *opt, const char *arg)
+{
+	long n;
+
+	n = str_to_long(arg);
+	if (n < 0)
+		fmt_err_exit("%s: %s must not be negative", prog, opt);
+
+	return n;
+}
+
+/* Returns the percentage `arg' of --sample, greater than 0, up to 100. */
+static double parse_percent(const char *prog, const char *arg)
+{
+	double pct;
+	char *end;
+
+	errno = 0;
+	pct = strtod(arg, &end);
+	if (errno != 0 || end == arg || *end != '\0' || !(pct > 0.0)
+	    || pct > 100.0)
+		fmt_err_exit("%s: --sample must be a percentage in (0, 100]",
+			     prog);
+
+	return pct;
+}
+
+/* Returns the interval `arg' of --metrics-interval, greater than 0. */
+static double parse_seconds(const char *prog, const char *arg)
+{
+	double secs;
+	char *end;
+
+	errno = 0;
+	secs = strtod(arg, &end);
+	if (errno != 0 || end == arg || *end != '\0' || !(secs > 0.0))
+		fmt_err_exit("%s: --metrics-interval must be a positive "
+			     "number of seconds", prog);
+
+	return secs;
+}
+
+/* Returns the size `arg' of option `opt', in bytes, K, M or G. */
+static size_t parse_size(const char *prog, const char *opt, const char *arg)
+{
+	double size;
+	char *end;
+
+	errno = 0;
+	size = strtod(arg, &end);
+	switch (*end) {
+	case 'G':
+	case 'g':
+		size *= 1024.0;
+		/* fall through */
+	case 'M':
+	case 'm':
+		size *= 1024.0;
+		/* fall through */
+	case 'K':
+	case 'k':
+		size *= 1024.0;
+		++end;
+		break;
+	default:
+		break;
+	}
+	if (errno != 0 || end == arg || *end != '\0' || !(size >= 1.0)
+	    || size > (double)SIZE_MAX / 2)
+		fmt_err_exit("%s: %s must be a positive size, in bytes or with "
+			     "a suffix K, M or G", prog, opt);
+
+	return (size_t) size;
+}
@@ -0,0 +1,225 @@
+/*
+ * metrics.c - write progress metrics as JSON lines for --metrics
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "stats.h"
+#include "util.h"
+
+#define FD_PREFIX "fd:"
+#define UNIX_PREFIX "unix:"
+#define NS_PER_SEC 1000000000.0
+#define BYTES_PER_MB 1048576.0
+#define METRICS_LINE_SIZE 512
+#define ETA_SIZE 32
+
+static int metrics_fd = -1;	/* -1 if no metrics are written */
+static bool own_fd;		/* opened here, to be closed */
+static int ixf_fd;
+static off_t ixf_size;
+static double interval_ns;
+static double start_ns;
+static double next_ns;		/* time of the next line */
+static double last_ns;		/* time of the last line */
+static long last_rows;
+static off_t last_pos;
+
+static int connect_unix(const char *path);
+static ssize_t write_line(const char *line, size_t len);
+static void emit_metrics(double now, long rows_read, long rows_output,
+			 bool done);
+
+/*
+ * Starts writing metrics every `interval' seconds to `dest': "fd:N" for
+ * an open file descriptor, "unix:PATH" for a Unix domain stream socket,
+ * or else a file, to which they are appended. `ifd' is the IXF file.
+ */
+void open_metrics(const char *dest, double interval, int ifd)
+{
+	struct stat st;
+
+	if (strncmp(dest, FD_PREFIX, strlen(FD_PREFIX)) == 0) {
+		metrics_fd = (int)str_to_long(dest + strlen(FD_PREFIX));
+		own_fd = false;
+	} else if (strncmp(dest, UNIX_PREFIX, strlen(UNIX_PREFIX)) == 0) {
+		metrics_fd = connect_unix(dest + strlen(UNIX_PREFIX));
+		own_fd = true;
+	} else {
+		metrics_fd = open_file(dest, O_WRONLY | O_CREAT | O_APPEND,
+				       S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		own_fd = true;
+	}
+
+	if (fstat(ifd, &st) == -1)
+		err_exit("fstat");
+	ixf_fd = ifd;
+	ixf_size = st.st_size;
+	interval_ns = interval * NS_PER_SEC;
+	start_ns = last_ns = stats_clock();
+	next_ns = start_ns + interval_ns;
+	last_rows = 0L;
+	last_pos = 0;
+}
+
+/*
+ * Writes a line of metrics if the interval has passed since the last one.
+ * Called every METRICS_POLL_ROWS rows, so that the clock is rarely read.
+ */
+void poll_metrics(long rows_read, long rows_output)
+{
+	double now;
+
+	if (metrics_fd == -1)
+		return;
+
+	now = stats_clock();
+	if (now < next_ns)
+		return;
+
+	emit_metrics(now, rows_read, rows_output, false);
+	next_ns = now + interval_ns;
+}
+
+/* write the last line of metrics and stop */
+void close_metrics(long rows_read, long rows_output)
+{
+	if (metrics_fd == -1)
+		return;
+
+	emit_metrics(stats_clock(), rows_read, rows_output, true);
+	if (metrics_fd != -1 && own_fd)
+		close_file(metrics_fd);
+	metrics_fd = -1;
+}
+
+/* Returns a stream socket connected to the Unix domain socket `path'. */
+static int connect_unix(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		fmt_err_exit("Socket path too long: %s", path);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		err_exit("socket");
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+		fmt_err_exit("Cannot connect to %s: %s", path, strerror(errno));
+
+	return fd;
+}
+
+/*
+ * Writes a line of JSON: the rates are of the time since the last line,
+ * the ETA is of the average rate so far. Metrics are turned off, and the
+ * conversion goes on, if the line cannot be written.
+ */
+static void emit_metrics(double now, long rows_read, long rows_output,
+			 bool done)
+{
+	char line[METRICS_LINE_SIZE];
+	char eta[ETA_SIZE];
+	double elapsed;		/* seconds since the start */
+	double span;		/* seconds since the last line */
+	off_t pos;		/* bytes of the IXF file processed */
+	ssize_t written;
+	int len;
+
+	pos = done ? ixf_size : lseek(ixf_fd, 0, SEEK_CUR);
+	if (pos == -1)
+		pos = last_pos;
+	elapsed = (now - start_ns) / NS_PER_SEC;
+	span = (now - last_ns) / NS_PER_SEC;
+	if (span <= 0.0)
+		span = 1.0 / NS_PER_SEC;
+
+	if (done)
+		strcpy(eta, "0");
+	else if (pos > 0 && ixf_size > pos)
+		sprintf(eta, "%.0f", (double)(ixf_size - pos) * elapsed / pos);
+	else
+		strcpy(eta, "null");
+
+	len = snprintf(line, sizeof(line),
+		       "{\"time\":%ld,\"elapsed\":%.3f,\"rows_read\":%ld,"
+		       "\"rows_output\":%ld,\"bytes_read\":%lld,"
+		       "\"bytes_total\":%lld,\"percent\":%.1f,"
+		       "\"rows_per_s\":%.1f,\"mb_per_s\":%.3f,"
+		       "\"eta_s\":%s,\"done\":%s}\n",
+		       (long)time(NULL), elapsed, rows_read, rows_output,
+		       (long long)pos, (long long)ixf_size,
+		       ixf_size > 0 ? 100.0 * pos / ixf_size : 100.0,
+		       (rows_read - last_rows) / span,
+		       (pos - last_pos) / BYTES_PER_MB / span, eta,
+		       done ? "true" : "false");
+
+	written = write_line(line, (size_t)len);
+	if (written != len) {
+		err_msg("Metrics turned off: %s\n", written == -1 ?
+			strerror(errno) : "short write");
+		if (own_fd)
+			close(metrics_fd);
+		metrics_fd = -1;
+		return;
+	}
+
+	last_ns = now;
+	last_rows = rows_read;
+	last_pos = pos;
+}
+
+/*
+ * Writes `line' of `len' bytes to the metrics, with SIGPIPE ignored only
+ * meanwhile: a reader of the metrics that went away must not kill the
+ * conversion, while one of the output still ends it quietly.
+ */
+static ssize_t write_line(const char *line, size_t len)
+{
+	struct sigaction ign;
+	struct sigaction old;
+	ssize_t written;
+	int saved;
+
+	memset(&ign, 0, sizeof(ign));
+	ign.sa_handler = SIG_IGN;
+	sigemptyset(&ign.sa_mask);
+	if (sigaction(SIGPIPE, &ign, &old) == -1)
+		err_exit("sigaction");
+	written = write(metrics_fd, line, len);
+	saved = errno;
+	if (sigaction(SIGPIPE, &old, NULL) == -1)
+		err_exit("sigaction");
+	errno = saved;
+
+	return written;
+}
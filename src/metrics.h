@@ -0,0 +1,29 @@
+/*
+ * metrics.h - declarations of the progress metrics of --metrics
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_METRICS_H_
+#define IXFCVT_METRICS_H_
+
+/* rows between two looks at the clock */
+#define METRICS_POLL_ROWS 4096
+
+void open_metrics(const char *dest, double interval, int ifd);
+void poll_metrics(long rows_read, long rows_output);
+void close_metrics(long rows_read, long rows_output);
+
+#endif
@@ -0,0 +1,583 @@
+/*
+ * microbench.c - micro-benchmarks of the value formatting kernels
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The kernels are static functions of parse_d.c and d2sql.c, so those
+ * files are compiled into this program rather than linked.
+ */
+#include "parse_d.c"
+#include "d2sql.c"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define HAVE_TSC
+#endif
+
+#define DEFAULT_VALUES 1000000L
+#define DEFAULT_WARMUP 2
+#define DEFAULT_REPEAT 5
+#define MAX_REPEAT 1000
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+#define NS_PER_SEC 1000000000.0
+#define VALUE_BUFF_SIZE 256	/* the longest formatted value, and more */
+#define MAX_STR_LEN 60
+#define QUOTE_RATE 100		/* one character in 100 is a quote */
+#define DECIMAL_LENG 1102	/* DECIMAL(11,2) */
+#define POSITIVE_SIGN 0x0C
+#define DECIMAL_SLOT 40		/* unsqueezed DECIMAL(31,x) and a NUL */
+#define DATE_LEN 10
+#define TIMESTAMP_LEN 26
+#define ASCII_CHARS 128
+#define EBCDIC_CP 37
+#define ALPHABET "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz" \
+	"0123456789 "
+
+/* values of a kernel, stored `d_width' bytes apart */
+struct dataset {
+	unsigned char *d_vals;
+	size_t d_width;
+	size_t d_bytes;		/* bytes of IXF data of all the values */
+	struct column_desc d_col;	/* the column of the values */
+};
+
+/* a kernel run once over all the values, returns a checksum */
+typedef size_t (*kernel_fn) (const struct dataset *ds, size_t count);
+
+struct benchmark {
+	const char *b_name;
+	kernel_fn b_run;
+	const struct dataset *b_data;
+};
+
+/* result of a benchmark */
+struct timing {
+	double t_best_ns;	/* of a pass over all the values */
+	double t_median_ns;
+	double t_best_cycles;	/* -1 if not measured */
+};
+
+static uint64_t rng_state;
+static volatile size_t sink;	/* checksums, kept from the optimizer */
+
+static void make_integers(struct dataset *ds, size_t count, size_t bytes);
+static void make_doubles(struct dataset *ds, size_t count);
+static void make_packed(struct dataset *ds, size_t count);
+static void make_unsqueezed(struct dataset *ds, size_t count);
+static void make_strings(struct dataset *ds, size_t count, int code_page);
+static void make_datetimes(struct dataset *ds, size_t count, int type);
+static void set_column(struct dataset *ds, int type, size_t len);
+static size_t run_parse_integer(const struct dataset *ds, size_t count);
+static size_t run_parse_float(const struct dataset *ds, size_t count);
+static size_t run_decode_packed(const struct dataset *ds, size_t count);
+static size_t run_squeeze_zeros(const struct dataset *ds, size_t count);
+static size_t run_write_sql_str(const struct dataset *ds, size_t count);
+static size_t run_fill_value(const struct dataset *ds, size_t count);
+static void measure(const struct benchmark *b, size_t count, int warmup,
+		    int repeat, struct timing *tm);
+static void report(const struct benchmark *b, size_t count,
+		   const struct timing *tm, double ghz);
+static int compare_doubles(const void *a, const void *b);
+static double now_ns(void);
+static double read_cycles(void);
+static uint64_t random_below(uint64_t n);
+
+int main(int argc, char *argv[])
+{
+	const char USAGE_INFO[] = "\
+\n\
+microbench: time the value formatting kernels of ixfcvt in memory\n\
+Usage: %s [-n VALUES] [-w WARMUP] [-r REPEAT] [-k NAME] [-g GHZ]\n\
+\n\
+Options:\n\
+    -n <VALUES>   values per kernel (default 1000000)\n\
+    -w <WARMUP>   untimed passes before the timed ones (default 2)\n\
+    -r <REPEAT>   timed passes (default 5)\n\
+    -k <NAME>     run only the kernels whose name contains <NAME>\n\
+    -g <GHZ>      clock rate to convert time to cycles where the time\n\
+                  stamp counter cannot be read\n\
+    -h            display this help and exit\n\
+\n\
+Writes a line of JSON per kernel: the best and median ns/value of the\n\
+timed passes, and the cycles/byte of IXF data of the best pass.\
+";
+	struct dataset ints2, ints4, ints8, doubles, packed, unsqueezed;
+	struct dataset strs, ebcdic, dates, timestamps;
+	struct benchmark benchmarks[] = {
+		{"parse_ixf_integer/SMALLINT", run_parse_integer, &ints2},
+		{"parse_ixf_integer/INTEGER", run_parse_integer, &ints4},
+		{"parse_ixf_integer/BIGINT", run_parse_integer, &ints8},
+		{"parse_ixf_float/DOUBLE", run_parse_float, &doubles},
+		{"decode_packed_decimal/DECIMAL(11,2)", run_decode_packed,
+		 &packed},
+		{"squeeze_zeros", run_squeeze_zeros, &unsqueezed},
+		{"write_as_sql_str/ascii", run_write_sql_str, &strs},
+		{"write_as_sql_str/cp037", run_write_sql_str, &ebcdic},
+		{"fill_in_a_value/INTEGER", run_fill_value, &ints4},
+		{"fill_in_a_value/BIGINT", run_fill_value, &ints8},
+		{"fill_in_a_value/DECIMAL(11,2)", run_fill_value, &packed},
+		{"fill_in_a_value/DOUBLE", run_fill_value, &doubles},
+		{"fill_in_a_value/VARCHAR(60)", run_fill_value, &strs},
+		{"fill_in_a_value/DATE", run_fill_value, &dates},
+		{"fill_in_a_value/TIMESTAMP", run_fill_value, &timestamps}
+	};
+	const size_t NBENCH = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	struct timing tm;
+	const char *name;
+	long count;
+	int warmup;
+	int repeat;
+	double ghz;
+	size_t i;
+	int c;
+
+	count = DEFAULT_VALUES;
+	warmup = DEFAULT_WARMUP;
+	repeat = DEFAULT_REPEAT;
+	name = NULL;
+	ghz = -1.0;
+	while ((c = getopt(argc, argv, ":n:w:r:k:g:h")) != -1) {
+		switch (c) {
+		case 'n':
+			count = str_to_long(optarg);
+			break;
+		case 'w':
+			warmup = (int)str_to_long(optarg);
+			break;
+		case 'r':
+			repeat = (int)str_to_long(optarg);
+			break;
+		case 'k':
+			name = optarg;
+			break;
+		case 'g':
+			ghz = strtod(optarg, NULL);
+			break;
+		case 'h':
+			usage(EXIT_SUCCESS, USAGE_INFO, argv[0]);
+			break;
+		default:
+			usage(EXIT_FAILURE, USAGE_INFO, argv[0]);
+			break;
+		}
+	}
+	if (optind < argc || count < 1 || warmup < 0 || repeat < 1
+	    || repeat > MAX_REPEAT)
+		usage(EXIT_FAILURE, USAGE_INFO, argv[0]);
+
+	/* what row_to_sql() sets up for the default options */
+	str_flags = CP_DOUBLE_QUOTE;
+	choose_literals(SQL_DB2);
+
+	make_integers(&ints2, (size_t)count, 2);
+	make_integers(&ints4, (size_t)count, 4);
+	make_integers(&ints8, (size_t)count, 8);
+	make_doubles(&doubles, (size_t)count);
+	make_packed(&packed, (size_t)count);
+	make_unsqueezed(&unsqueezed, (size_t)count);
+	make_strings(&strs, (size_t)count, 0);
+	make_strings(&ebcdic, (size_t)count, EBCDIC_CP);
+	make_datetimes(&dates, (size_t)count, DATE);
+	make_datetimes(&timestamps, (size_t)count, TIMESTAMP);
+
+	for (i = 0; i < NBENCH; ++i) {
+		if (name && !strstr(benchmarks[i].b_name, name))
+			continue;
+		measure(&benchmarks[i], (size_t)count, warmup, repeat, &tm);
+		report(&benchmarks[i], (size_t)count, &tm, ghz);
+	}
+
+	free_buff(ints2.d_vals);
+	free_buff(ints4.d_vals);
+	free_buff(ints8.d_vals);
+	free_buff(doubles.d_vals);
+	free_buff(packed.d_vals);
+	free_buff(unsqueezed.d_vals);
+	free_buff(strs.d_vals);
+	free_buff(ebcdic.d_vals);
+	free_buff(dates.d_vals);
+	free_buff(timestamps.d_vals);
+
+	return 0;
+}
+
+/* integers of `bytes' bytes, of 1 to all digits evenly, a quarter negative */
+static void make_integers(struct dataset *ds, size_t count, size_t bytes)
+{
+	const int MAX_DIGITS[] = { 0, 0, 4, 0, 9, 0, 0, 0, 18 };
+	unsigned long long bound;
+	unsigned long long u;
+	size_t i;
+	size_t j;
+	int ndigits;
+
+	ds->d_vals = alloc_buff(count * bytes);
+	ds->d_width = ds->d_bytes = bytes;
+	ds->d_bytes *= count;
+	for (i = 0; i < count; ++i) {
+		ndigits = 1 + (int)random_below((uint64_t)MAX_DIGITS[bytes]);
+		for (bound = 1; ndigits > 0; --ndigits)
+			bound *= 10;
+		u = random_below(bound);
+		if (random_below(4) == 0)
+			u = -u;
+		for (j = 0; j < bytes; ++j, u >>= 8)
+			ds->d_vals[i * bytes + j] = (unsigned char)u;
+	}
+	set_column(ds, bytes == 2 ? SMALLINT : bytes == 4 ? INTEGER : BIGINT,
+		   bytes);
+}
+
+/* doubles of magnitudes from 10^-6 to 10^9 */
+static void make_doubles(struct dataset *ds, size_t count)
+{
+	double value;
+	int exp;
+	size_t i;
+
+	ds->d_vals = alloc_buff(count * sizeof(double));
+	ds->d_width = sizeof(double);
+	ds->d_bytes = count * sizeof(double);
+	for (i = 0; i < count; ++i) {
+		value = (double)random_below(2000000) / 1000000.0 - 1.0;
+		for (exp = (int)random_below(16) - 6; exp > 0; --exp)
+			value *= 10.0;
+		for (; exp < 0; ++exp)
+			value /= 10.0;
+		memcpy(ds->d_vals + i * sizeof(double), &value, sizeof(value));
+	}
+	set_column(ds, FLOATING_POINT, sizeof(double));
+}
+
+/* DECIMAL(11,2) values of 1 to 11 digits evenly, a quarter negative */
+static void make_packed(struct dataset *ds, size_t count)
+{
+	unsigned char *dst;
+	size_t bytes;
+	size_t ndigits;
+	size_t n;
+	size_t i;
+	size_t j;
+
+	bytes = packed_decimal_size(DECIMAL_LENG);
+	ds->d_vals = alloc_buff(count * bytes);
+	ds->d_width = bytes;
+	ds->d_bytes = count * bytes;
+	memset(ds->d_vals, 0, count * bytes);
+	n = bytes * 2 - 1;	/* digit nibbles */
+	for (i = 0; i < count; ++i) {
+		dst = ds->d_vals + i * bytes;
+		ndigits = 1 + (size_t)random_below(DECIMAL_LENG / 100);
+		for (j = n - ndigits; j < n; ++j)
+			dst[j / 2] |= (unsigned char)(random_below(10) <<
+						      (j % 2 ? 0 : 4));
+		dst[bytes - 1] |= random_below(4) ? POSITIVE_SIGN : NEGATIVE_SIGN;
+	}
+	set_column(ds, DECIMAL, DECIMAL_LENG);
+}
+
+/* the strings of decode_packed_decimal() before it calls squeeze_zeros() */
+static void make_unsqueezed(struct dataset *ds, size_t count)
+{
+	struct dataset pk;
+	const unsigned char *src;
+	char *dst;
+	size_t ndigits;
+	size_t scale;
+	size_t i;
+	size_t j;
+
+	make_packed(&pk, count);
+	ndigits = pk.d_width * 2 - 1;
+	scale = DECIMAL_LENG % 100;
+	ds->d_vals = alloc_buff(count * DECIMAL_SLOT);
+	ds->d_width = DECIMAL_SLOT;
+	ds->d_bytes = 0;
+	for (i = 0; i < count; ++i) {
+		src = pk.d_vals + i * pk.d_width;
+		dst = (char *)ds->d_vals + i * DECIMAL_SLOT;
+		if ((src[pk.d_width - 1] & LOW_NIBBLE) == NEGATIVE_SIGN)
+			*dst++ = '-';
+		for (j = 0; j < ndigits; ++j) {
+			if (j == ndigits - scale)
+				*dst++ = '.';
+			*dst++ = (char)(DIGIT_HIGH_NIBBLE | (j % 2 ?
+				src[j / 2] & LOW_NIBBLE : src[j / 2] >> 4));
+		}
+		*dst = '\0';
+		ds->d_bytes += strlen((char *)ds->d_vals + i * DECIMAL_SLOT);
+	}
+	free_buff(pk.d_vals);
+	set_column(ds, DECIMAL, DECIMAL_LENG);
+}
+
+/*
+ * VARCHAR(60) values of 0 to 60 characters evenly, one in QUOTE_RATE a
+ * quote, in UTF-8 if `code_page' is 0
+ */
+static void make_strings(struct dataset *ds, size_t count, int code_page)
+{
+	unsigned char xlat[ASCII_CHARS];
+	const struct codec *cc;
+	unsigned char *dst;
+	size_t len;
+	size_t i;
+	size_t j;
+	char ch;
+
+	cc = code_page ? find_codec(code_page) : NULL;
+	for (i = 0; i < ASCII_CHARS; ++i) {
+		ch = (char)i;
+		xlat[i] = (unsigned char)i;
+		if (cc && (strchr(ALPHABET "'", ch) && ch != '\0'))
+			from_utf8(&xlat[i], &ch, 1, cc);
+	}
+
+	ds->d_width = VARCHAR_CUR_LEN_IND_BYTES + MAX_STR_LEN;
+	ds->d_vals = alloc_buff(count * ds->d_width);
+	ds->d_bytes = 0;
+	for (i = 0; i < count; ++i) {
+		dst = ds->d_vals + i * ds->d_width;
+		len = (size_t)random_below(MAX_STR_LEN + 1);
+		dst[0] = (unsigned char)len;
+		dst[1] = 0;
+		for (j = 0; j < len; ++j) {
+			ch = random_below(QUOTE_RATE) ? ALPHABET[random_below(
+				sizeof(ALPHABET) - 1)] : '\'';
+			dst[VARCHAR_CUR_LEN_IND_BYTES + j] = xlat[(int)ch];
+		}
+		ds->d_bytes += VARCHAR_CUR_LEN_IND_BYTES + len;
+	}
+	set_column(ds, VARCHAR, MAX_STR_LEN);
+	ds->d_col.c_codec = cc;
+}
+
+/* DATE or TIMESTAMP values from 1970 to 2037 */
+static void make_datetimes(struct dataset *ds, size_t count, int type)
+{
+	char buff[VALUE_BUFF_SIZE];
+	size_t i;
+
+	ds->d_width = type == DATE ? DATE_LEN : TIMESTAMP_LEN;
+	ds->d_vals = alloc_buff(count * ds->d_width);
+	ds->d_bytes = count * ds->d_width;
+	for (i = 0; i < count; ++i) {
+		sprintf(buff, "%04u-%02u-%02u-%02u.%02u.%02u.%06u",
+			1970 + (unsigned)random_below(68),
+			1 + (unsigned)random_below(12),
+			1 + (unsigned)random_below(28),
+			(unsigned)random_below(24), (unsigned)random_below(60),
+			(unsigned)random_below(60),
+			(unsigned)random_below(1000000));
+		memcpy(ds->d_vals + i * ds->d_width, buff, ds->d_width);
+	}
+	set_column(ds, type, ds->d_width);
+}
+
+/* describe the values of `ds' as a NOT NULL column */
+static void set_column(struct dataset *ds, int type, size_t len)
+{
+	memset(&ds->d_col, 0, sizeof(ds->d_col));
+	ds->d_col.c_name = NULL;
+	ds->d_col.c_type = type;
+	ds->d_col.c_len = len;
+	ds->d_col.c_drid = 1;
+	ds->d_col.c_nullable = false;
+	ds->d_col.c_codec = NULL;
+	ds->d_col.c_bitdata = false;
+	ds->d_col.next = NULL;
+}
+
+static size_t run_parse_integer(const struct dataset *ds, size_t count)
+{
+	unsigned long long sum;
+	size_t i;
+
+	sum = 0;
+	for (i = 0; i < count; ++i)
+		sum += (unsigned long long)parse_ixf_integer(ds->d_vals +
+							     i * ds->d_width,
+							     ds->d_width);
+	return (size_t)sum;
+}
+
+static size_t run_parse_float(const struct dataset *ds, size_t count)
+{
+	double sum;
+	size_t i;
+
+	sum = 0.0;
+	for (i = 0; i < count; ++i)
+		sum += parse_ixf_float(ds->d_vals + i * ds->d_width,
+				       ds->d_width);
+	return (size_t)(sum > 0.0);
+}
+
+static size_t run_decode_packed(const struct dataset *ds, size_t count)
+{
+	char buff[VALUE_BUFF_SIZE];
+	size_t sum;
+	size_t i;
+
+	sum = 0;
+	for (i = 0; i < count; ++i)
+		sum += (size_t)(decode_packed_decimal(buff, ds->d_vals +
+						      i * ds->d_width,
+						      ds->d_col.c_len) - buff);
+	return sum;
+}
+
+/* each string is copied first, as squeeze_zeros() works in place */
+static size_t run_squeeze_zeros(const struct dataset *ds, size_t count)
+{
+	char buff[DECIMAL_SLOT];
+	size_t sum;
+	size_t i;
+
+	sum = 0;
+	for (i = 0; i < count; ++i) {
+		memcpy(buff, ds->d_vals + i * ds->d_width, DECIMAL_SLOT);
+		squeeze_zeros(buff);
+		sum += (unsigned char)buff[1];
+	}
+	return sum;
+}
+
+static size_t run_write_sql_str(const struct dataset *ds, size_t count)
+{
+	char buff[VALUE_BUFF_SIZE];
+	const unsigned char *src;
+	size_t sum;
+	size_t i;
+
+	sum = 0;
+	for (i = 0; i < count; ++i) {
+		src = ds->d_vals + i * ds->d_width;
+		sum += (size_t)(write_as_sql_str(buff, src +
+						 VARCHAR_CUR_LEN_IND_BYTES,
+						 get_varchar_cur_len(src),
+						 ds->d_col.c_codec) - buff);
+	}
+	return sum;
+}
+
+static size_t run_fill_value(const struct dataset *ds, size_t count)
+{
+	char buff[VALUE_BUFF_SIZE];
+	size_t sum;
+	size_t i;
+
+	sum = 0;
+	for (i = 0; i < count; ++i)
+		sum += (size_t)(fill_in_a_value(buff, ds->d_vals +
+						i * ds->d_width,
+						&ds->d_col) - buff);
+	return sum;
+}
+
+/* run `warmup' untimed passes of `b', then `repeat' timed ones */
+static void measure(const struct benchmark *b, size_t count, int warmup,
+		    int repeat, struct timing *tm)
+{
+	double ns[MAX_REPEAT];
+	double cycles;
+	double t0;
+	double c0;
+	int i;
+
+	for (i = 0; i < warmup; ++i)
+		sink += b->b_run(b->b_data, count);
+
+	tm->t_best_ns = -1.0;
+	tm->t_best_cycles = -1.0;
+	for (i = 0; i < repeat; ++i) {
+		c0 = read_cycles();
+		t0 = now_ns();
+		sink += b->b_run(b->b_data, count);
+		ns[i] = now_ns() - t0;
+		cycles = read_cycles() - c0;
+		if (tm->t_best_ns < 0.0 || ns[i] < tm->t_best_ns) {
+			tm->t_best_ns = ns[i];
+			tm->t_best_cycles = c0 < 0.0 ? -1.0 : cycles;
+		}
+	}
+
+	qsort(ns, (size_t)repeat, sizeof(ns[0]), compare_doubles);
+	tm->t_median_ns = ns[repeat / 2];
+}
+
+/* write the result of `b' as a line of JSON */
+static void report(const struct benchmark *b, size_t count,
+		   const struct timing *tm, double ghz)
+{
+	double cycles;
+
+	cycles = tm->t_best_cycles;
+	if (cycles < 0.0 && ghz > 0.0)
+		cycles = tm->t_best_ns * ghz;
+
+	printf("{\"kernel\":\"%s\",\"values\":%lu,\"bytes\":%lu,"
+	       "\"ns_per_value\":%.2f,\"ns_per_value_median\":%.2f,",
+	       b->b_name, (unsigned long)count,
+	       (unsigned long)b->b_data->d_bytes, tm->t_best_ns / count,
+	       tm->t_median_ns / count);
+	if (cycles < 0.0)
+		printf("\"cycles_per_byte\":null}\n");
+	else
+		printf("\"cycles_per_byte\":%.3f}\n",
+		       cycles / b->b_data->d_bytes);
+	fflush(stdout);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* nanoseconds of a monotonic clock */
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err_exit("clock_gettime");
+
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* the time stamp counter, or -1 if it cannot be read */
+static double read_cycles(void)
+{
+#ifdef HAVE_TSC
+	return (double)__builtin_ia32_rdtsc();
+#else
+	return -1.0;
+#endif
+}
+
+/* a random number in [0, n) of the SplitMix64 sequence */
+static uint64_t random_below(uint64_t n)
+{
+	rng_state += GOLDEN_GAMMA;
+	return hash64(rng_state) % n;
+}
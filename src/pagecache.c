@@ -0,0 +1,350 @@
+/*
+ * pagecache.c - keep a conversion from filling the page cache: --drop-cache
+ *               and --direct-io
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * A conversion reads the IXF file once (twice with the summary scan) and
+ * writes the SQL once, so neither is worth caching, but the kernel keeps
+ * both until memory runs short and evicts the pages of everything else
+ * on the machine first.  With --drop-cache the pages of the input are
+ * dropped behind the reads, and the output is written back behind the
+ * writes and its pages dropped once on disk.  With --direct-io the output
+ * bypasses the page cache altogether through an aligned buffer.
+ */
+
+#define _GNU_SOURCE		/* O_DIRECT and sync_file_range() */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pagecache.h"
+#include "stats.h"
+#include "util.h"
+
+#define DROP_INTERVAL (32 << 20)	/* bytes read between two drops */
+#define WRITE_BEHIND (8 << 20)	/* bytes written between two write-backs */
+#define DIRECT_ALIGN 4096	/* of the buffer, offsets and lengths */
+#define DIRECT_BUFF_SIZE (1 << 20)
+
+/* a file read or written by the conversion */
+struct cached_file {
+	bool cf_cached;		/* registered by cache_input/cache_output() */
+	bool cf_output;
+	bool cf_direct;		/* written through `cf_buff' with O_DIRECT */
+	bool cf_written;	/* with O_DIRECT once at least */
+	size_t cf_pending;	/* bytes since the last drop or write-back */
+	off_t cf_done;		/* dropped, or written back, up to */
+	off_t cf_prev;		/* start of the range being written back */
+	char *cf_buff;		/* aligned buffer of O_DIRECT */
+	size_t cf_used;
+};
+
+static struct cached_file *register_file(int fd);
+static void drop_behind(int fd, struct cached_file *f);
+static void write_behind(int fd, struct cached_file *f);
+static void write_direct(int fd, struct cached_file *f, size_t len);
+static bool set_direct(int fd, bool on);
+
+static bool drop_cache;
+static bool direct_io;
+static struct cached_file *files;	/* indexed by descriptor */
+static int nfiles;
+
+/* Returns true if the system can write a file with O_DIRECT. */
+bool direct_io_supported(void)
+{
+#ifdef O_DIRECT
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Drops the pages of the files registered below behind the conversion if
+ * `drop', and writes the output ones with O_DIRECT if `direct'.
+ */
+void init_page_cache(bool drop, bool direct)
+{
+	drop_cache = drop;
+	direct_io = direct;
+}
+
+/* Registers IXF file `fd', read from start to end. */
+void cache_input(int fd)
+{
+	if (!drop_cache || !register_file(fd))
+		return;
+	/* advisory only; a failure costs nothing but the cache */
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+/* Registers output file `fd', written from its current offset. */
+void cache_output(int fd)
+{
+	struct cached_file *f;
+
+	if (!(drop_cache || direct_io) || !(f = register_file(fd)))
+		return;
+	f->cf_output = true;
+	f->cf_done = f->cf_prev = lseek(fd, 0, SEEK_CUR);
+	/* O_DIRECT writes whole blocks from a block boundary */
+	if (direct_io && f->cf_done % DIRECT_ALIGN == 0
+	    && set_direct(fd, true)) {
+		if (posix_memalign((void **)&f->cf_buff, DIRECT_ALIGN,
+				   DIRECT_BUFF_SIZE) != 0)
+			fmt_err_exit("virtual memory exhausted");
+		f->cf_direct = true;
+	}
+}
+
+/* Counts `bytes' read from `fd', dropping them every DROP_INTERVAL. */
+void cache_read(int fd, size_t bytes)
+{
+	struct cached_file *f;
+
+	if (fd >= nfiles || !files[fd].cf_cached)
+		return;
+	f = &files[fd];
+	f->cf_pending += bytes;
+	if (f->cf_pending >= DROP_INTERVAL)
+		drop_behind(fd, f);
+}
+
+/*
+ * Drops the `len' bytes read from `fd' at `off' by pread() at once.  Safe
+ * to call from several threads, as the files are all registered by then.
+ */
+void cache_read_at(int fd, off_t off, size_t len)
+{
+	if (fd >= nfiles || !files[fd].cf_cached || len == 0)
+		return;
+	(void)posix_fadvise(fd, off, (off_t) len, POSIX_FADV_DONTNEED);
+}
+
+/*
+ * Takes the `len' bytes of `buff' to be written to `fd' if it is written
+ * with O_DIRECT, and returns true; returns false to leave them to write().
+ */
+bool cache_write(int fd, const void *buff, size_t len)
+{
+	struct cached_file *f;
+	const char *p;
+	size_t n;
+
+	if (fd >= nfiles || !files[fd].cf_direct)
+		return false;
+	f = &files[fd];
+	for (p = buff; len > 0; p += n, len -= n) {
+		n = DIRECT_BUFF_SIZE - f->cf_used;
+		if (n > len)
+			n = len;
+		memcpy(f->cf_buff + f->cf_used, p, n);
+		f->cf_used += n;
+		if (f->cf_used == DIRECT_BUFF_SIZE)
+			write_direct(fd, f, DIRECT_BUFF_SIZE);
+		if (!f->cf_direct) {	/* refused, the rest is buffered */
+			if (len > n)
+				write_bytes(fd, p + n, len - n);
+			break;
+		}
+	}
+
+	return true;
+}
+
+/* Counts `len' bytes written to `fd', writing them back every WRITE_BEHIND. */
+void cache_written(int fd, size_t len)
+{
+	struct cached_file *f;
+
+	if (fd >= nfiles || !files[fd].cf_cached || !drop_cache)
+		return;
+	f = &files[fd];
+	f->cf_pending += len;
+	if (f->cf_pending >= WRITE_BEHIND)
+		write_behind(fd, f);
+}
+
+/*
+ * Writes out what is left in the buffer of `fd', and drops what is left
+ * of it in the page cache, before it is closed.
+ */
+void cache_close(int fd)
+{
+	struct cached_file *f;
+	size_t aligned;
+
+	if (fd >= nfiles || !files[fd].cf_cached)
+		return;
+	f = &files[fd];
+	if (f->cf_direct) {
+		/* O_DIRECT takes whole blocks only, the tail goes buffered */
+		aligned = f->cf_used & ~(size_t) (DIRECT_ALIGN - 1);
+		if (aligned > 0)
+			write_direct(fd, f, aligned);
+		if (f->cf_direct) {
+			set_direct(fd, false);
+			f->cf_direct = false;
+		}
+		if (f->cf_used > 0)	/* moved to the start */
+			write_bytes(fd, f->cf_buff, f->cf_used);
+	}
+	if (drop_cache) {
+		if (f->cf_output && fdatasync(fd) == -1 && errno != EINVAL)
+			err_exit("fdatasync");
+		(void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	}
+	free(f->cf_buff);
+	memset(f, 0, sizeof(*f));
+}
+
+/*
+ * Returns the entry of `fd', NULL if it is not a regular file: the page
+ * cache of a pipe or a terminal is nothing to care about.
+ */
+static struct cached_file *register_file(int fd)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) == -1)
+		err_exit("fstat");
+	if (!S_ISREG(st.st_mode))
+		return NULL;
+	if (fd >= nfiles) {
+		files = resize_buff(files, (size_t) (fd + 1) * sizeof(*files));
+		memset(files + nfiles, 0,
+		       (size_t) (fd + 1 - nfiles) * sizeof(*files));
+		nfiles = fd + 1;
+	}
+	memset(&files[fd], 0, sizeof(files[fd]));
+	files[fd].cf_cached = true;
+
+	return &files[fd];
+}
+
+/* Drops the pages of input `fd' read since the last drop. */
+static void drop_behind(int fd, struct cached_file *f)
+{
+	off_t pos;
+
+	f->cf_pending = 0;
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos == -1)
+		err_exit("lseek");
+	if (pos < f->cf_done)	/* read again from an earlier offset */
+		f->cf_done = 0;
+	(void)posix_fadvise(fd, f->cf_done, pos - f->cf_done,
+			    POSIX_FADV_DONTNEED);
+	f->cf_done = pos;
+}
+
+/*
+ * Starts writing back the bytes written to output `fd' since the last
+ * call, waits for those of the call before, and drops them: the disk is
+ * kept busy but the dirty pages never pile up.  Without sync_file_range()
+ * everything written so far is synced and dropped at once.
+ */
+static void write_behind(int fd, struct cached_file *f)
+{
+	off_t end;
+
+	f->cf_pending = 0;
+	end = lseek(fd, 0, SEEK_CUR);
+	if (end == -1)
+		err_exit("lseek");
+	if (end < f->cf_done)	/* rewound by a checkpoint */
+		f->cf_done = f->cf_prev = 0;
+#ifdef SYNC_FILE_RANGE_WRITE
+	if (sync_file_range(fd, f->cf_done, end - f->cf_done,
+			    SYNC_FILE_RANGE_WRITE) == -1)
+		err_exit("sync_file_range");
+	if (f->cf_prev < f->cf_done) {
+		if (sync_file_range(fd, f->cf_prev, f->cf_done - f->cf_prev,
+				    SYNC_FILE_RANGE_WAIT_BEFORE
+				    | SYNC_FILE_RANGE_WRITE
+				    | SYNC_FILE_RANGE_WAIT_AFTER) == -1)
+			err_exit("sync_file_range");
+		(void)posix_fadvise(fd, f->cf_prev, f->cf_done - f->cf_prev,
+				    POSIX_FADV_DONTNEED);
+	}
+	f->cf_prev = f->cf_done;
+#else
+	if (fdatasync(fd) == -1)
+		err_exit("fdatasync");
+	(void)posix_fadvise(fd, f->cf_done, end - f->cf_done,
+			    POSIX_FADV_DONTNEED);
+#endif
+	f->cf_done = end;
+}
+
+/*
+ * Writes the first `len' bytes of the buffer of `fd' with O_DIRECT and
+ * moves the rest to its start.  If the file system refuses O_DIRECT, the
+ * file is written through the page cache from then on.
+ */
+static void write_direct(int fd, struct cached_file *f, size_t len)
+{
+	ssize_t written;
+
+	written = write(fd, f->cf_buff, len);
+	if (written == -1 && errno == EINVAL && !f->cf_written) {
+		err_msg("%s\n", "O_DIRECT refused by the file system, "
+			"writing through the page cache");
+		set_direct(fd, false);
+		f->cf_direct = false;
+		write_bytes(fd, f->cf_buff, f->cf_used);
+		f->cf_used = 0;
+		return;
+	}
+	if (written == -1)
+		fmt_err_exit("output file: %s", strerror(errno));
+	else if (written != (ssize_t) len)
+		fmt_err_exit("output file: resource limit reached");
+	count_write(len);
+	f->cf_written = true;
+	f->cf_used -= len;
+	memmove(f->cf_buff, f->cf_buff + len, f->cf_used);
+}
+
+/* Sets or clears O_DIRECT of `fd'; returns false if it cannot be set. */
+static bool set_direct(int fd, bool on)
+{
+#ifdef O_DIRECT
+	int flags;
+
+	if ((flags = fcntl(fd, F_GETFL)) == -1)
+		err_exit("fcntl");
+	flags = on ? flags | O_DIRECT : flags & ~O_DIRECT;
+	if (fcntl(fd, F_SETFL, flags) == 0)
+		return true;
+	if (!on)
+		err_exit("fcntl");
+	err_msg("%s\n", "O_DIRECT not supported, "
+		"writing through the page cache");
+	return false;
+#else
+	(void)fd;
+	(void)on;
+	return false;
+#endif
+}
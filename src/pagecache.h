@@ -0,0 +1,37 @@
+/*
+ * pagecache.h - declarations of the page cache friendly I/O of
+ *               --drop-cache and --direct-io
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_PAGECACHE_H_
+#define IXFCVT_PAGECACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+bool direct_io_supported(void);
+void init_page_cache(bool drop, bool direct);
+void cache_input(int fd);
+void cache_output(int fd);
+void cache_read(int fd, size_t bytes);
+void cache_read_at(int fd, off_t off, size_t len);
+bool cache_write(int fd, const void *buff, size_t len);
+void cache_written(int fd, size_t len);
+void cache_close(int fd);
+
+#endif
@@ -16,10 +16,11 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "ixfcvt.h"
-#include "util.h"
+#include "parse_d.h"
 
 #define IXFCNAML_OFFSET 1
 #define IXFCNAML_BYTES 3
@@ -28,60 +29,137 @@
 #define IXFCKPOS_BYTES 2
 #define IXFCTYPE_OFFSET 266
 #define IXFCTYPE_BYTES 3
+#define IXFCSBCP_OFFSET 269
+#define IXFCSBCP_BYTES 5
+#define IXFCDBCP_OFFSET 274
+#define IXFCDBCP_BYTES 5
 #define IXFCLENG_OFFSET 279
 #define IXFCLENG_BYTES 5
+#define IXFCDRID_OFFSET 284
+#define IXFCDRID_BYTES 3
 #define IXFCPOSN_OFFSET 287
 #define IXFCPOSN_BYTES 6
 #define IXFCNULL_OFFSET 260
-#define COL_ATTR_BUFF_SIZE 7	/* max of IXFCxxxx_BYTES + 1 */
+#define XDS_MAX_LEN 32767
+#define MAX_DECIMAL_PRECISION 31
 
 static void tweak_col_length(struct column_desc *col);
-static int get_pk_pos(const char *pkpos);
+static bool get_pk_pos(const unsigned char *rec, int *pkpos);
+static bool is_bit_data(const struct column_desc *col);
+static bool column_is_valid(const struct column_desc *col);
 
 /* ignore IXFCDEFL, IXFCDEFV now */
-/* parse a C record, store the info in a column_desc struct */
-void parse_c_record(const unsigned char *rec, struct column_desc *col)
+/*
+ * Parses a C record into a column_desc struct, leaving its codec NULL.
+ * Returns false if a field is not a number, the values of the column
+ * cannot be decoded or out of memory; `c_name' is then NULL or to be
+ * freed.
+ */
+bool parse_c_record(const unsigned char *rec, struct column_desc *col)
 {
-	char buff[COL_ATTR_BUFF_SIZE];
-	size_t c_name_len;
-
-	memset(buff, 0x00, COL_ATTR_BUFF_SIZE);
-	memcpy(buff, rec + IXFCNAML_OFFSET, IXFCNAML_BYTES);
-	c_name_len = (size_t) str_to_long(buff);
-	col->c_name = alloc_buff(c_name_len + 1);
-	memcpy(col->c_name, rec + IXFCNAME_OFFSET, c_name_len);
+	long c_name_len;
+	long val;
+
+	col->c_name = NULL;
+	col->c_codec = NULL;
+	if (!parse_ixf_field(rec + IXFCNAML_OFFSET, IXFCNAML_BYTES,
+			     &c_name_len) || c_name_len < 0)
+		return false;
+	col->c_name = malloc((size_t) c_name_len + 1);
+	if (!col->c_name)
+		return false;
+	memcpy(col->c_name, rec + IXFCNAME_OFFSET, (size_t) c_name_len);
 	col->c_name[c_name_len] = '\0';
 
-	memset(buff, 0x00, COL_ATTR_BUFF_SIZE);
-	memcpy(buff, rec + IXFCKPOS_OFFSET, IXFCKPOS_BYTES);
-	col->c_pkpos = get_pk_pos(buff);
+	if (!get_pk_pos(rec, &col->c_pkpos))
+		return false;
 
-	memset(buff, 0x00, COL_ATTR_BUFF_SIZE);
-	memcpy(buff, rec + IXFCTYPE_OFFSET, IXFCTYPE_BYTES);
-	col->c_type = (int)str_to_long(buff);
+	if (!parse_ixf_field(rec + IXFCTYPE_OFFSET, IXFCTYPE_BYTES, &val))
+		return false;
+	col->c_type = (int)val;
 
-	memset(buff, 0x00, COL_ATTR_BUFF_SIZE);
-	memcpy(buff, rec + IXFCLENG_OFFSET, IXFCLENG_BYTES);
-	col->c_len = (size_t) str_to_long(buff);
+	if (!parse_ixf_field(rec + IXFCSBCP_OFFSET, IXFCSBCP_BYTES, &val))
+		return false;
+	col->c_sbcp = (int)val;
+
+	if (!parse_ixf_field(rec + IXFCDBCP_OFFSET, IXFCDBCP_BYTES, &val))
+		return false;
+	col->c_dbcp = (int)val;
+	col->c_bitdata = is_bit_data(col);
+
+	if (!parse_ixf_field(rec + IXFCLENG_OFFSET, IXFCLENG_BYTES, &val)
+	    || val < 0)
+		return false;
+	col->c_len = (size_t) val;
 	tweak_col_length(col);
 
-	memset(buff, 0x00, COL_ATTR_BUFF_SIZE);
-	memcpy(buff, rec + IXFCPOSN_OFFSET, IXFCPOSN_BYTES);
+	if (!parse_ixf_field(rec + IXFCDRID_OFFSET, IXFCDRID_BYTES, &val))
+		return false;
+	col->c_drid = val < 1 ? 1 : (int)val;
+
 	/* the IXFDCOLS field of the D record starts at 1 (not 0) */
-	col->c_offset = str_to_long(buff) - 1;
+	if (!parse_ixf_field(rec + IXFCPOSN_OFFSET, IXFCPOSN_BYTES, &val)
+	    || val < 1)
+		return false;
+	col->c_offset = val - 1;
 
 	col->c_nullable = (char)rec[IXFCNULL_OFFSET] == 'Y';
+
+	return column_is_valid(col);
+}
+
+/*
+ * Reads the position of the column as part of the primary key, or 0 if
+ * the column is not part of the key. Returns false if it is not a number.
+ */
+static bool get_pk_pos(const unsigned char *rec, int *pkpos)
+{
+	long val;
+
+	if (rec[IXFCKPOS_OFFSET] == 'N') {
+		*pkpos = 0;
+		return true;
+	}
+	if (!parse_ixf_field(rec + IXFCKPOS_OFFSET, IXFCKPOS_BYTES, &val))
+		return false;
+	*pkpos = (int)val;
+	return true;
 }
 
 /*
- * Returns the position of the column as part of the primary key,
- * or 0 if the column is not part of the key.
+ * Returns true if the column holds binary data, that is, a BINARY or
+ * VARBINARY column, or a character column FOR BIT DATA (code page 0).
  */
-static int get_pk_pos(const char *pkpos)
+static bool is_bit_data(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case BINARY:
+	case VARBINARY:
+		return true;
+	case CHAR:
+	case VARCHAR:
+	case LONG_VARCHAR:
+		return col->c_sbcp == 0 && col->c_dbcp == 0;
+	default:
+		return false;
+	}
+}
+
+/* Returns true if the values of `col' can be decoded. */
+static bool column_is_valid(const struct column_desc *col)
 {
-	if (*pkpos == 'N')
-		return 0;
-	return (int)str_to_long(pkpos);
+	switch (col->c_type) {
+	case DECIMAL:
+		return col->c_len / 100 > 0
+		    && col->c_len / 100 <= MAX_DECIMAL_PRECISION
+		    && col->c_len % 100 <= col->c_len / 100;
+	case FLOATING_POINT:
+		return col->c_len == 4 || col->c_len == 8;
+	case DECFLOAT:
+		return col->c_len == 16 || col->c_len == 34;
+	default:
+		return true;
+	}
 }
 
 /* tweak column_desc.c_len */
@@ -107,6 +185,10 @@ static void tweak_col_length(struct column_desc *col)
 		/* 20 is the number of characters before point */
 		col->c_len += 20;
 		break;
+	case XML:
+		/* IXFCLENG is not used, the XDS is at most that long */
+		col->c_len = XDS_MAX_LEN;
+		break;
 	default:
 		break;
 	}
@@ -24,14 +24,24 @@
 
 #define IXFDCOLS_OFFSET 8
 #define VARCHAR_CUR_LEN_IND_BYTES 2
+#define GRAPHIC_CHAR_BYTES 2
 #define NULL_VAL_IND_BYTES 2
+#define IXF_FIELD_MAX_BYTES 6	/* IXFCPOSN and the record length */
 
+bool parse_ixf_field(const unsigned char *src, size_t bytes, long *value);
 long long parse_ixf_integer(const unsigned char *src, size_t bytes);
 double parse_ixf_float(const unsigned char *src, size_t bytes);
 bool column_is_null(const unsigned char *null_ind);
 char *decode_packed_decimal(char *buff, const unsigned char *src,
 			    size_t data_length);
+size_t packed_decimal_size(size_t data_length);
+int compare_packed_decimal(const unsigned char *a, const unsigned char *b,
+			   size_t bytes);
+bool packed_is_negative(const unsigned char *src, size_t bytes);
 size_t get_varchar_cur_len(const unsigned char *len_ind);
+size_t decfloat_size(size_t precision);
+bool decfloat_is_finite(const unsigned char *src, size_t bytes);
+char *decode_decfloat(char *buff, const unsigned char *src, size_t bytes);
 size_t varchar_len_ind_size(void);
 
 #endif
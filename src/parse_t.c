@@ -16,11 +16,12 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
 #include "ixfcvt.h"
-#include "util.h"
+#include "parse_d.h"
 
 #define IXFTNAML_OFFSET 1
 #define IXFTNAML_BYTES 3
@@ -28,43 +29,53 @@
 #define IXFTCCNT_OFFSET 539
 #define IXFTCCNT_BYTES 5
 #define IXFTPKNM_OFFSET 576
-#define TBL_ATTR_BUFF_SIZE 6
 
 static void strip_ext(char *name, const char *ext);
 
-/* parse a T record, store the info in a table struct */
-void parse_t_record(const unsigned char *rec, struct table_desc *tbl,
+/*
+ * Parses a T record into a table struct, named `table_name' if not NULL.
+ * The primary key name must end with a NUL within `rec'. Returns false if
+ * a field is not a number or out of memory, with the names allocated so
+ * far, if any, left in `tbl' to be freed.
+ */
+bool parse_t_record(const unsigned char *rec, struct table_desc *tbl,
 		    const char *table_name)
 {
-	char buff[TBL_ATTR_BUFF_SIZE];
-	size_t t_name_len;
+	long t_name_len;
+	long t_ncols;
 	size_t t_pkname_len;
 	const unsigned char *walker;
 
 	if (table_name) {
 		tbl->t_name = strdup(table_name);
 		if (!tbl->t_name)
-			err_exit("strdup");
+			return false;
 	} else {
-		memset(buff, 0x00, TBL_ATTR_BUFF_SIZE);
-		memcpy(buff, rec + IXFTNAML_OFFSET, IXFTNAML_BYTES);
-		t_name_len = (size_t) str_to_long(buff);
-		tbl->t_name = alloc_buff(t_name_len + 1);
-		memcpy(tbl->t_name, rec + IXFTNAME_OFFSET, t_name_len);
+		if (!parse_ixf_field(rec + IXFTNAML_OFFSET, IXFTNAML_BYTES,
+				     &t_name_len) || t_name_len < 0)
+			return false;
+		tbl->t_name = malloc((size_t) t_name_len + 1);
+		if (!tbl->t_name)
+			return false;
+		memcpy(tbl->t_name, rec + IXFTNAME_OFFSET, (size_t) t_name_len);
 		tbl->t_name[t_name_len] = '\0';
 		strip_ext(tbl->t_name, ".ixf");
 	}
 
-	memset(buff, 0x00, TBL_ATTR_BUFF_SIZE);
-	memcpy(buff, rec + IXFTCCNT_OFFSET, IXFTCCNT_BYTES);
-	tbl->t_ncols = (int)str_to_long(buff);
+	if (!parse_ixf_field(rec + IXFTCCNT_OFFSET, IXFTCCNT_BYTES, &t_ncols))
+		return false;
+	tbl->t_ncols = (int)t_ncols;
 
 	t_pkname_len = 0;
 	for (walker = rec + IXFTPKNM_OFFSET; *walker; walker++)
 		t_pkname_len++;
-	tbl->t_pkname = alloc_buff(t_pkname_len + 1);
+	tbl->t_pkname = malloc(t_pkname_len + 1);
+	if (!tbl->t_pkname)
+		return false;
 	memcpy(tbl->t_pkname, rec + IXFTPKNM_OFFSET, t_pkname_len);
 	tbl->t_pkname[t_pkname_len] = '\0';
+
+	return true;
 }
 
 /* This function strips the trailing `.ixf' of `tbl->t_name' */
@@ -0,0 +1,139 @@
+/*
+ * partition.c - route the rows to the output partitions of --partition-by-pk
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "partition.h"
+#include "util.h"
+
+#define MAX_SUFFIX_LEN 8	/* ".1023" and a NUL */
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+#define NULL_HASH 0x9E3779B97F4A7C15ULL	/* of a null key value */
+
+static uint64_t hash_value(uint64_t hash, const unsigned char *const *recs,
+			   const struct column_desc *col);
+
+static int *fds;		/* of the partitions, in order */
+static int nfds;
+static const struct column_desc **keys;	/* hashed to pick a partition */
+static int nkeys;
+static int turn;		/* partition of the next row dealt */
+
+/*
+ * Creates the `nparts' output files `ofile'.0, `ofile'.1, ... with
+ * `oflags' and `mode', each locked for writing.
+ */
+void open_partitions(const char *ofile, int nparts, int oflags, mode_t mode)
+{
+	char *name;
+	int i;
+
+	name = alloc_buff(strlen(ofile) + MAX_SUFFIX_LEN);
+	fds = alloc_buff((size_t) nparts * sizeof(*fds));
+	for (i = 0; i < nparts; ++i) {
+		sprintf(name, "%s.%d", ofile, i);
+		fds[i] = open_file(name, oflags, mode);
+		if (!lock_entire_file(fds[i], F_WRLCK))
+			fmt_err_exit("Failed to lock file: %s", name);
+	}
+	nfds = nparts;
+	free_buff(name);
+}
+
+/*
+ * Hashes the columns in the comma-separated `list' to pick the partition
+ * of a row, or the primary key of `tbl' in key order if `list' is NULL.
+ */
+void set_partition_key(const struct table_desc *tbl, const char *list)
+{
+	keys = select_key(tbl, list, &nkeys);
+	if (nkeys == 0)
+		fmt_err_exit("%s", "No primary key to partition by, "
+			     "give the columns with --partition-key");
+}
+
+/*
+ * Returns the partition of the row in D records `recs', from the raw
+ * bytes of its key values, so that equal keys always go to the same
+ * partition whatever the byte order of the machine.
+ */
+int partition_of(const unsigned char *const *recs)
+{
+	uint64_t hash;
+	int i;
+
+	hash = FNV_OFFSET_BASIS;
+	for (i = 0; i < nkeys; ++i)
+		hash = hash_value(hash, recs, keys[i]);
+
+	return (int)(hash64(hash) % (uint64_t) nfds);
+}
+
+/* Returns the partition of the next row when they are dealt in turn. */
+int next_partition(void)
+{
+	int part;
+
+	part = turn;
+	turn = (turn + 1) % nfds;
+
+	return part;
+}
+
+/* Returns the descriptors of the partitions, in order. */
+const int *partition_fds(void)
+{
+	return fds;
+}
+
+/* close the partitions and forget the key */
+void close_partitions(void)
+{
+	int i;
+
+	for (i = 0; i < nfds; ++i)
+		close_file(fds[i]);
+	free_buff(fds);
+	free_buff(keys);
+	fds = NULL;
+	keys = NULL;
+	nfds = nkeys = turn = 0;
+}
+
+/* add the value of `col' in `recs' to the FNV-1a hash `hash' */
+static uint64_t hash_value(uint64_t hash, const unsigned char *const *recs,
+			   const struct column_desc *col)
+{
+	const unsigned char *src;
+	size_t len;
+	size_t i;
+
+	len = column_value(recs, col, &src);
+	if (!src)
+		return (hash ^ NULL_HASH) * FNV_PRIME;
+
+	for (i = 0; i < len; ++i)
+		hash = (hash ^ src[i]) * FNV_PRIME;
+
+	/* "ab","c" and "a","bc" are different keys */
+	return (hash ^ len) * FNV_PRIME;
+}
@@ -0,0 +1,35 @@
+/*
+ * partition.h - declarations of the output partitions of --partition-by-pk
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_PARTITION_H_
+#define IXFCVT_PARTITION_H_
+
+#include <sys/types.h>
+
+#include "ixfcvt.h"
+
+#define MAX_PARTITIONS 1024
+
+void open_partitions(const char *ofile, int nparts, int oflags, mode_t mode);
+void set_partition_key(const struct table_desc *tbl, const char *list);
+int partition_of(const unsigned char *const *recs);
+int next_partition(void);
+const int *partition_fds(void);
+void close_partitions(void);
+
+#endif
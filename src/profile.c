@@ -0,0 +1,567 @@
+/*
+ * profile.c - collect per-column statistics of the rows, output as JSON
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "codepage.h"
+#include "ixfcvt.h"
+#include "parse_d.h"
+#include "util.h"
+
+#define HLL_BITS 14		/* registers indexed by the high bits of a hash */
+#define HLL_REGISTERS (1 << HLL_BITS)
+#define HASH_HIGH_BIT 0x8000000000000000ULL
+#define HASH_WORD_BYTES 8
+#define MAX_NUMBER_LEN 64	/* a number or a key of JSON */
+#define JSON_ESCAPE_GROWTH 6	/* \u001F for a control character */
+
+/* which statistics of a column are collected, besides nulls and distinct */
+enum stat_kind {
+	SK_INTEGER,		/* min and max */
+	SK_FLOAT,		/* min and max */
+	SK_DECIMAL,		/* min and max, packed */
+	SK_STRING,		/* min and max, raw bytes */
+	SK_NONE			/* binary data, DECFLOAT and XML */
+};
+
+struct col_stats {
+	enum stat_kind cs_kind;
+	bool cs_varying;	/* with a current length */
+	long cs_nulls;
+	long cs_values;		/* non-null values */
+	long long cs_imin;	/* SK_INTEGER */
+	long long cs_imax;
+	double cs_fmin;		/* SK_FLOAT */
+	double cs_fmax;
+	unsigned char *cs_min;	/* SK_DECIMAL and SK_STRING */
+	unsigned char *cs_max;
+	size_t cs_min_len;
+	size_t cs_max_len;
+	unsigned long long cs_len_sum;	/* current lengths, if varying */
+	size_t cs_len_max;
+	unsigned char *cs_hll;	/* HyperLogLog registers */
+};
+
+static void init_stats(const struct table_desc *tbl);
+static void dispose_stats(const struct table_desc *tbl);
+static size_t value_size(const struct column_desc *col);
+static void profile_value(struct col_stats *cs, const struct column_desc *col,
+			  const unsigned char *src);
+static void update_min_max(struct col_stats *cs,
+			   const struct column_desc *col,
+			   const unsigned char *val, size_t len);
+static int compare_bytes(const unsigned char *a, size_t a_len,
+			 const unsigned char *b, size_t b_len);
+static uint64_t hash_bytes(const unsigned char *src, size_t len);
+static void add_to_hll(unsigned char *regs, uint64_t hash);
+static double hll_estimate(const unsigned char *regs);
+static char *sprint_stats(char *buff, const struct col_stats *cs,
+			  const struct column_desc *col);
+static char *sprint_decimal(char *buff, const unsigned char *src,
+			    const struct column_desc *col);
+static char *sprint_json_str(char *buff, const unsigned char *src, size_t len,
+			     const struct codec *cc);
+static size_t stats_size(const struct col_stats *cs);
+static const char *type_name(const struct column_desc *col);
+static char *append(char *buff, const char *str);
+
+static struct col_stats *stats;	/* of the selected columns, in order */
+static long rows;
+
+/* add the values of a row in D records `recs' to the statistics */
+void row_to_profile(const unsigned char *const *recs,
+		    const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	int i;
+
+	if (!stats)
+		init_stats(tbl);
+
+	++rows;
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
+		profile_value(&stats[i], col, recs[col->c_drid - 1]
+			      + IXFDCOLS_OFFSET + col->c_offset);
+	}
+}
+
+/*
+ * This function writes the statistics of the selected columns of `tbl'
+ * to `fd' as a JSON object, after the last row.
+ */
+void profile_to_json(int fd, const struct table_desc *tbl)
+{
+	char *buff;
+	char *bp;
+	size_t size;
+	int i;
+
+	if (!stats)
+		init_stats(tbl);
+
+	buff = alloc_buff(strlen(tbl->t_name) * JSON_ESCAPE_GROWTH
+			  + MAX_NUMBER_LEN * 2);
+	bp = append(buff, "{\n  \"table\": ");
+	bp = sprint_json_str(bp, (const unsigned char *)tbl->t_name,
+			     strlen(tbl->t_name), NULL);
+	sprintf(bp, ",\n  \"rows\": %ld,\n  \"columns\": [\n", rows);
+	write_file(fd, buff);
+	free_buff(buff);
+
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		size = stats_size(&stats[i]) + strlen(tbl->t_sel[i]->c_name)
+		    * JSON_ESCAPE_GROWTH;
+		buff = alloc_buff(size);
+		bp = sprint_stats(buff, &stats[i], tbl->t_sel[i]);
+		strcpy(bp, i < tbl->t_nsel - 1 ? ",\n" : "\n");
+		write_file(fd, buff);
+		free_buff(buff);
+	}
+	write_file(fd, "  ]\n}\n");
+
+	dispose_stats(tbl);
+}
+
+static void init_stats(const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	struct col_stats *cs;
+	int i;
+
+	stats = alloc_buff((tbl->t_nsel ? (size_t) tbl->t_nsel : 1)
+			   * sizeof(struct col_stats));
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
+		cs = &stats[i];
+		memset(cs, 0, sizeof(*cs));
+
+		switch (col->c_type) {
+		case SMALLINT:
+		case INTEGER:
+		case BIGINT:
+			cs->cs_kind = SK_INTEGER;
+			break;
+		case FLOATING_POINT:
+			cs->cs_kind = SK_FLOAT;
+			break;
+		case DECIMAL:
+			cs->cs_kind = SK_DECIMAL;
+			break;
+		case CHAR:
+		case VARCHAR:
+		case LONG_VARCHAR:
+			cs->cs_kind = col->c_bitdata ? SK_NONE : SK_STRING;
+			break;
+		case GRAPHIC:
+		case VARGRAPHIC:
+		case LONG_VARGRAPHIC:
+		case DATE:
+		case TIME:
+		case TIMESTAMP:
+			cs->cs_kind = SK_STRING;
+			break;
+		default:
+			cs->cs_kind = SK_NONE;
+		}
+
+		switch (col->c_type) {
+		case VARCHAR:
+		case LONG_VARCHAR:
+		case VARGRAPHIC:
+		case LONG_VARGRAPHIC:
+		case VARBINARY:
+		case XML:
+			cs->cs_varying = true;
+			break;
+		default:
+			cs->cs_varying = false;
+		}
+
+		if (cs->cs_kind == SK_DECIMAL || cs->cs_kind == SK_STRING) {
+			cs->cs_min = alloc_buff(value_size(col));
+			cs->cs_max = alloc_buff(value_size(col));
+		}
+		cs->cs_hll = alloc_buff(HLL_REGISTERS);
+		memset(cs->cs_hll, 0, HLL_REGISTERS);
+	}
+}
+
+static void dispose_stats(const struct table_desc *tbl)
+{
+	int i;
+
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		free_buff(stats[i].cs_min);
+		free_buff(stats[i].cs_max);
+		free_buff(stats[i].cs_hll);
+	}
+	free_buff(stats);
+	stats = NULL;
+}
+
+/* maximum bytes of a value of `col', without indicators */
+static size_t value_size(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case GRAPHIC:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		return col->c_len * GRAPHIC_CHAR_BYTES;
+	case DECIMAL:
+		return packed_decimal_size(col->c_len);
+	case DECFLOAT:
+		return decfloat_size(col->c_len);
+	default:
+		return col->c_len;
+	}
+}
+
+static void profile_value(struct col_stats *cs, const struct column_desc *col,
+			  const unsigned char *src)
+{
+	size_t cur_len;		/* current length of varying-length data */
+	size_t len;		/* bytes of the value */
+
+	if (col->c_nullable) {
+		if (column_is_null(src)) {
+			++cs->cs_nulls;
+			return;
+		}
+		src += NULL_VAL_IND_BYTES;
+	}
+	++cs->cs_values;
+
+	if (cs->cs_varying) {
+		cur_len = get_varchar_cur_len(src);
+		src += VARCHAR_CUR_LEN_IND_BYTES;
+		cs->cs_len_sum += cur_len;
+		if (cur_len > cs->cs_len_max)
+			cs->cs_len_max = cur_len;
+		len = cur_len;
+		if (col->c_type == VARGRAPHIC || col->c_type == LONG_VARGRAPHIC)
+			len *= GRAPHIC_CHAR_BYTES;
+	} else {
+		len = value_size(col);
+	}
+
+	add_to_hll(cs->cs_hll, hash_bytes(src, len));
+	update_min_max(cs, col, src, len);
+}
+
+static void update_min_max(struct col_stats *cs,
+			   const struct column_desc *col,
+			   const unsigned char *val, size_t len)
+{
+	long long int_val;
+	double flt_val;
+	bool first;
+
+	first = cs->cs_values == 1;
+	switch (cs->cs_kind) {
+	case SK_INTEGER:
+		int_val = parse_ixf_integer(val, col->c_len);
+		if (first || int_val < cs->cs_imin)
+			cs->cs_imin = int_val;
+		if (first || int_val > cs->cs_imax)
+			cs->cs_imax = int_val;
+		break;
+	case SK_FLOAT:
+		flt_val = parse_ixf_float(val, col->c_len);
+		if (first || flt_val < cs->cs_fmin)
+			cs->cs_fmin = flt_val;
+		if (first || flt_val > cs->cs_fmax)
+			cs->cs_fmax = flt_val;
+		break;
+	case SK_DECIMAL:
+		if (first || compare_packed_decimal(val, cs->cs_min, len) < 0)
+			memcpy(cs->cs_min, val, len);
+		if (first || compare_packed_decimal(val, cs->cs_max, len) > 0)
+			memcpy(cs->cs_max, val, len);
+		break;
+	case SK_STRING:
+		if (first || compare_bytes(val, len, cs->cs_min,
+					   cs->cs_min_len) < 0) {
+			memcpy(cs->cs_min, val, len);
+			cs->cs_min_len = len;
+		}
+		if (first || compare_bytes(val, len, cs->cs_max,
+					   cs->cs_max_len) > 0) {
+			memcpy(cs->cs_max, val, len);
+			cs->cs_max_len = len;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* compare byte strings, a prefix being less than the longer string */
+static int compare_bytes(const unsigned char *a, size_t a_len,
+			 const unsigned char *b, size_t b_len)
+{
+	int cmp;
+
+	cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+	if (cmp != 0)
+		return cmp;
+
+	return (a_len > b_len) - (a_len < b_len);
+}
+
+/* hash a value, eight bytes at a time */
+static uint64_t hash_bytes(const unsigned char *src, size_t len)
+{
+	uint64_t hash;
+	uint64_t word;
+
+	hash = hash64(len);
+	for (; len >= HASH_WORD_BYTES; len -= HASH_WORD_BYTES) {
+		memcpy(&word, src, HASH_WORD_BYTES);
+		hash = hash64(hash ^ word);
+		src += HASH_WORD_BYTES;
+	}
+	word = 0;
+	memcpy(&word, src, len);
+
+	return hash64(hash ^ word);
+}
+
+/*
+ * Records a hash in the HyperLogLog registers `regs': its high bits pick
+ * a register, which keeps the highest rank (position of the first 1 bit)
+ * of the remaining bits.
+ */
+static void add_to_hll(unsigned char *regs, uint64_t hash)
+{
+	uint64_t rest;
+	size_t idx;
+	unsigned char rank;
+
+	idx = (size_t) (hash >> (64 - HLL_BITS));
+	rest = hash << HLL_BITS;
+	for (rank = 1; rank <= 64 - HLL_BITS && !(rest & HASH_HIGH_BIT); ++rank)
+		rest <<= 1;
+
+	if (rank > regs[idx])
+		regs[idx] = rank;
+}
+
+/* Returns the estimated number of distinct hashes added to `regs'. */
+static double hll_estimate(const unsigned char *regs)
+{
+	const double m = HLL_REGISTERS;
+	const double alpha = 0.7213 / (1.0 + 1.079 / m);
+	double sum;
+	double estimate;
+	int zeros;
+	int i;
+
+	sum = 0.0;
+	zeros = 0;
+	for (i = 0; i < HLL_REGISTERS; ++i) {
+		sum += ldexp(1.0, -regs[i]);
+		if (regs[i] == 0)
+			++zeros;
+	}
+
+	estimate = alpha * m * m / sum;
+	/* linear counting is more accurate for small cardinalities */
+	if (estimate <= 2.5 * m && zeros > 0)
+		estimate = m * log(m / zeros);
+
+	return estimate;
+}
+
+/* print the statistics of a column as a JSON object */
+static char *sprint_stats(char *buff, const struct col_stats *cs,
+			  const struct column_desc *col)
+{
+	double distinct;
+
+	buff = append(buff, "    {\"name\": ");
+	buff = sprint_json_str(buff, (const unsigned char *)col->c_name,
+			       strlen(col->c_name), NULL);
+
+	distinct = floor(hll_estimate(cs->cs_hll) + 0.5);
+	if (distinct > (double)cs->cs_values)
+		distinct = (double)cs->cs_values;
+	buff += sprintf(buff, ", \"type\": \"%s\", \"nulls\": %ld, "
+			"\"distinct\": %.0f", type_name(col), cs->cs_nulls,
+			distinct);
+
+	if (cs->cs_values > 0) {
+		switch (cs->cs_kind) {
+		case SK_INTEGER:
+			buff += sprintf(buff, ", \"min\": %lld, \"max\": %lld",
+					cs->cs_imin, cs->cs_imax);
+			break;
+		case SK_FLOAT:
+			if (isfinite(cs->cs_fmin) && isfinite(cs->cs_fmax))
+				buff += sprintf(buff, ", \"min\": %.*G, "
+						"\"max\": %.*G", DBL_DIG,
+						cs->cs_fmin, DBL_DIG,
+						cs->cs_fmax);
+			break;
+		case SK_DECIMAL:
+			buff = append(buff, ", \"min\": ");
+			buff = sprint_decimal(buff, cs->cs_min, col);
+			buff = append(buff, ", \"max\": ");
+			buff = sprint_decimal(buff, cs->cs_max, col);
+			break;
+		case SK_STRING:
+			buff = append(buff, ", \"min\": ");
+			buff = sprint_json_str(buff, cs->cs_min,
+					       cs->cs_min_len, col->c_codec);
+			buff = append(buff, ", \"max\": ");
+			buff = sprint_json_str(buff, cs->cs_max,
+					       cs->cs_max_len, col->c_codec);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (cs->cs_varying && cs->cs_values > 0)
+		buff += sprintf(buff, ", \"avg_length\": %.1f, "
+				"\"max_length\": %zu",
+				(double)cs->cs_len_sum / (double)cs->cs_values,
+				cs->cs_len_max);
+
+	return append(buff, "}");
+}
+
+/* print a packed decimal as a JSON number */
+static char *sprint_decimal(char *buff, const unsigned char *src,
+			    const struct column_desc *col)
+{
+	char *end;
+
+	end = decode_packed_decimal(buff, src, col->c_len);
+	if (end[-1] == '.')	/* scale 0 */
+		*--end = '\0';
+
+	return end;
+}
+
+/* print bytes of code page `cc' as a JSON string */
+static char *sprint_json_str(char *buff, const unsigned char *src, size_t len,
+			     const struct codec *cc)
+{
+	char *utf8;
+	char *end;
+	const char *s;
+
+	if (cc) {
+		utf8 = alloc_buff(len * U8_MAX_GROWTH + 1);
+		end = to_utf8(utf8, src, len, cc, 0);
+	} else {
+		utf8 = alloc_buff(len + 1);
+		memcpy(utf8, src, len);
+		end = utf8 + len;
+	}
+
+	*buff++ = '"';
+	for (s = utf8; s < end; ++s) {
+		if (*s == '"' || *s == '\\') {
+			*buff++ = '\\';
+			*buff++ = *s;
+		} else if ((unsigned char)*s < 0x20) {
+			buff += sprintf(buff, "\\u%04X", (unsigned)*s);
+		} else {
+			*buff++ = *s;
+		}
+	}
+	*buff++ = '"';
+	*buff = '\0';
+
+	free_buff(utf8);
+	return buff;
+}
+
+/* maximum length of the JSON object of a column, without the name */
+static size_t stats_size(const struct col_stats *cs)
+{
+	size_t size;
+
+	size = MAX_NUMBER_LEN * 8;
+	if (cs->cs_kind == SK_STRING)
+		size += (cs->cs_min_len + cs->cs_max_len) * U8_MAX_GROWTH
+		    * JSON_ESCAPE_GROWTH;
+
+	return size;
+}
+
+static const char *type_name(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case CHAR:
+		return "CHAR";
+	case VARCHAR:
+		return "VARCHAR";
+	case LONG_VARCHAR:
+		return "LONG VARCHAR";
+	case GRAPHIC:
+		return "GRAPHIC";
+	case VARGRAPHIC:
+		return "VARGRAPHIC";
+	case LONG_VARGRAPHIC:
+		return "LONG VARGRAPHIC";
+	case BINARY:
+		return "BINARY";
+	case VARBINARY:
+		return "VARBINARY";
+	case SMALLINT:
+		return "SMALLINT";
+	case INTEGER:
+		return "INTEGER";
+	case BIGINT:
+		return "BIGINT";
+	case DECIMAL:
+		return "DECIMAL";
+	case DECFLOAT:
+		return "DECFLOAT";
+	case FLOATING_POINT:
+		return col->c_len == 4 ? "REAL" : "DOUBLE";
+	case DATE:
+		return "DATE";
+	case TIME:
+		return "TIME";
+	case TIMESTAMP:
+		return "TIMESTAMP";
+	case XML:
+		return "XML";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+/* copy `str' to `buff', returns a pointer to the terminating null byte */
+static char *append(char *buff, const char *str)
+{
+	size_t len;
+
+	len = strlen(str);
+	memcpy(buff, str, len + 1);
+
+	return buff + len;
+}
@@ -0,0 +1,265 @@
+/*
+ * select.c - choose the columns to output
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ixfcvt.h"
+#include "parse_d.h"
+#include "util.h"
+
+static bool is_digits(const char *str);
+static char *trim_blanks(char *str);
+
+/*
+ * This function fills in `tbl->t_sel' with the columns named in `list',
+ * in that order, or with all the columns if `list' is NULL.
+ * `list' is a comma-separated list of column names or ordinal positions
+ * (starting from 1); it exits on an unknown or repeated column.
+ */
+void select_columns(struct table_desc *tbl, const char *list)
+{
+	struct column_desc *col;
+	char *names;
+	char *name;
+	char *next;
+	size_t max;
+	int i;
+
+	if (!list) {
+		max = 0;
+		for (col = tbl->c_head; col; col = col->next)
+			++max;
+		tbl->t_sel = alloc_buff((max ? max : 1) * sizeof(col));
+		tbl->t_nsel = 0;
+		for (col = tbl->c_head; col; col = col->next)
+			tbl->t_sel[tbl->t_nsel++] = col;
+		return;
+	}
+
+	names = alloc_buff(strlen(list) + 1);
+	strcpy(names, list);
+	max = 1;
+	for (name = names; *name; ++name)
+		if (*name == ',')
+			++max;
+	tbl->t_sel = alloc_buff(max * sizeof(col));
+	tbl->t_nsel = 0;
+
+	for (name = names; name; name = next) {
+		next = strchr(name, ',');
+		if (next)
+			*next++ = '\0';
+		name = trim_blanks(name);
+		if (*name == '\0')
+			fmt_err_exit("%s", "Empty column name in column list");
+
+		col = find_column(tbl, name);
+		if (!col)
+			fmt_err_exit("Unknown column: %s", name);
+		for (i = 0; i < tbl->t_nsel; ++i)
+			if (tbl->t_sel[i] == col)
+				fmt_err_exit("Column selected twice: %s", name);
+		tbl->t_sel[tbl->t_nsel++] = col;
+	}
+
+	free_buff(names);
+}
+
+/*
+ * Returns the columns named in `list', taken as by select_columns(), or
+ * those of the primary key of `tbl' in key order if `list' is NULL, and
+ * their number in `*ncols', 0 if there is no primary key.
+ */
+const struct column_desc **select_key(const struct table_desc *tbl,
+				      const char *list, int *ncols)
+{
+	const struct column_desc **cols;
+	const struct column_desc *col;
+	struct table_desc key;
+	size_t max;
+	int i;
+
+	if (list) {
+		key = *tbl;
+		select_columns(&key, list);
+		*ncols = key.t_nsel;
+		return (const struct column_desc **)key.t_sel;
+	}
+
+	max = 1;
+	for (col = tbl->c_head; col; col = col->next)
+		++max;
+	cols = alloc_buff(max * sizeof(*cols));
+	*ncols = 0;
+	for (i = 1;; ++i) {
+		for (col = tbl->c_head; col; col = col->next)
+			if (col->c_pkpos == i)
+				break;
+		if (!col)
+			break;
+		cols[(*ncols)++] = col;
+	}
+
+	return cols;
+}
+
+/*
+ * Returns the column named `name', or at the ordinal position `name'
+ * if it consists of digits, NULL if not found. Names are compared
+ * case-sensitively first, then case-insensitively.
+ */
+struct column_desc *find_column(const struct table_desc *tbl, const char *name)
+{
+	struct column_desc *col;
+	long colno;
+
+	if (is_digits(name)) {
+		colno = str_to_long(name);
+		for (col = tbl->c_head; col; col = col->next)
+			if (col->c_colno == colno)
+				return col;
+		return NULL;
+	}
+
+	for (col = tbl->c_head; col; col = col->next)
+		if (strcmp(col->c_name, name) == 0)
+			return col;
+	for (col = tbl->c_head; col; col = col->next)
+		if (strcasecmp(col->c_name, name) == 0)
+			return col;
+
+	return NULL;
+}
+
+/*
+ * Points `val' at the bytes of the value of `col' in D records `recs',
+ * after its indicators, and returns their number; `val' is NULL if the
+ * value is null.
+ */
+size_t column_value(const unsigned char *const *recs,
+		    const struct column_desc *col, const unsigned char **val)
+{
+	const unsigned char *src;
+
+	src = recs[col->c_drid - 1] + IXFDCOLS_OFFSET + col->c_offset;
+	if (col->c_nullable) {
+		if (column_is_null(src)) {
+			*val = NULL;
+			return 0;
+		}
+		src += NULL_VAL_IND_BYTES;
+	}
+
+	*val = src;
+	switch (col->c_type) {
+	case VARCHAR:
+	case LONG_VARCHAR:
+	case VARBINARY:
+	case XML:
+		*val += VARCHAR_CUR_LEN_IND_BYTES;
+		return get_varchar_cur_len(src);
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		*val += VARCHAR_CUR_LEN_IND_BYTES;
+		return get_varchar_cur_len(src) * GRAPHIC_CHAR_BYTES;
+	case GRAPHIC:
+		return col->c_len * GRAPHIC_CHAR_BYTES;
+	case DECIMAL:
+		return packed_decimal_size(col->c_len);
+	case DECFLOAT:
+		return decfloat_size(col->c_len);
+	default:
+		return col->c_len;
+	}
+}
+
+/*
+ * Returns the bytes of each D record of a row of `tbl' that may be read
+ * for its columns, even if the record is shorter, in a new array.
+ */
+size_t *record_spans(const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	size_t *spans;
+	size_t span;
+
+	spans = alloc_buff((size_t) tbl->t_ndrec * sizeof(*spans));
+	memset(spans, 0, (size_t) tbl->t_ndrec * sizeof(*spans));
+	for (col = tbl->c_head; col; col = col->next) {
+		span = IXFDCOLS_OFFSET + (size_t) col->c_offset
+		    + column_span(col);
+		if (span > spans[col->c_drid - 1])
+			spans[col->c_drid - 1] = span;
+	}
+
+	return spans;
+}
+
+/* Return true if `str' is a non-empty string of decimal digits. */
+static bool is_digits(const char *str)
+{
+	if (*str == '\0')
+		return false;
+	while (*str)
+		if (!isdigit((unsigned char)*str++))
+			return false;
+	return true;
+}
+
+/* strip leading and trailing blanks of `str' in place */
+static char *trim_blanks(char *str)
+{
+	char *end;
+
+	while (isspace((unsigned char)*str))
+		++str;
+	end = str + strlen(str);
+	while (end > str && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+
+	return str;
+}
+
+/* Returns the bytes of a value of `col' at most, with its indicators. */
+size_t column_span(const struct column_desc *col)
+{
+	size_t size;
+
+	size = col->c_nullable ? NULL_VAL_IND_BYTES : 0;
+	switch (col->c_type) {
+	case VARCHAR:
+	case LONG_VARCHAR:
+	case VARBINARY:
+	case XML:
+		return size + VARCHAR_CUR_LEN_IND_BYTES + col->c_len;
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		return size + VARCHAR_CUR_LEN_IND_BYTES
+		    + col->c_len * GRAPHIC_CHAR_BYTES;
+	case GRAPHIC:
+		return size + col->c_len * GRAPHIC_CHAR_BYTES;
+	case DECIMAL:
+		return size + packed_decimal_size(col->c_len);
+	case DECFLOAT:
+		return size + decfloat_size(col->c_len);
+	default:
+		return size + col->c_len;
+	}
+}
@@ -0,0 +1,642 @@
+/*
+ * sort.c - sort the rows by their key for --sort-by-pk
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "codepage.h"
+#include "parse_d.h"
+#include "sort.h"
+#include "util.h"
+
+/*
+ * A row is kept as an entry: its length, its normalized key, which
+ * memcmp() orders as the key values, its number, which keeps the rows of
+ * equal keys in file order, then the length and the bytes of each of its
+ * D records, padded with zeros to what may be read of it. The entries
+ * are sorted in memory up to the budget, written to a temporary file as
+ * a sorted run when it is reached, and the runs are merged at the end.
+ */
+#define LEN_BYTES 4		/* of an entry or of a D record in it */
+#define SEQ_BYTES 8
+#define MIN_ARENA_SIZE (1UL << 20)
+#define RUN_BUFF_SIZE (256UL << 10)
+#define MAX_MERGE_WAY 64	/* runs merged at a time */
+#define TMP_TEMPLATE "/ixfcvt-sort.XXXXXX"
+#define SIGN_BIT 0x80
+#define DIGITS_MASK 0xF0	/* of the last byte of a packed decimal */
+#define IDEOGRAPHIC_SPACE "\xE3\x80\x80"	/* U+3000, the DBCS space */
+
+/* a column of the sort key and the bytes of its normalized form */
+struct sort_key {
+	const struct column_desc *k_col;
+	size_t k_len;
+	/* after a varying-length value, a blank of a graphic one */
+	unsigned char k_pad[GRAPHIC_CHAR_BYTES];
+};
+
+/* a sorted run being merged, with its current entry */
+struct run_reader {
+	FILE *r_fp;
+	unsigned char *r_entry;
+	size_t r_size;		/* of `r_entry' */
+};
+
+static size_t key_size(const struct column_desc *col, unsigned char *pad);
+static void graphic_blank(const struct column_desc *col, unsigned char *pad);
+static void encode_key(unsigned char *dst, const unsigned char *const *recs);
+static void encode_value(unsigned char *dst, const unsigned char *src,
+			 const struct sort_key *key);
+static void encode_double(unsigned char *dst, double val);
+static void spill_run(void);
+static FILE *open_run(void);
+static void sort_entries(void);
+static int compare_entries(const void *a, const void *b);
+static bool merge_runs(FILE **in, int nin, FILE *out, sorted_row_fn emit,
+		       void *arg);
+static bool read_entry(struct run_reader *rd);
+static void sift_down(struct run_reader **heap, int n, int i);
+static void write_entry(FILE *fp, const unsigned char *entry);
+static bool emit_entry(const unsigned char *entry, sorted_row_fn emit,
+		       void *arg);
+static void put_len(unsigned char *dst, size_t len);
+static size_t get_len(const unsigned char *src);
+
+static struct sort_key *keys;
+static int nkeys;
+static size_t key_len;		/* of a normalized key and the row number */
+static int ndrec;		/* D records of a row */
+static size_t *spans;		/* bytes read of each D record of a row */
+static size_t budget;		/* of the entries in memory */
+static unsigned char *arena;	/* entries of the run being made */
+static size_t arena_size;
+static size_t arena_used;
+static size_t *entries;		/* offsets in `arena' */
+static size_t nentries;
+static size_t entries_cap;
+static FILE **runs;		/* sorted runs written */
+static int nruns;
+static uint64_t seq;		/* rows added */
+static const unsigned char **row;	/* D records of an entry */
+static size_t *row_lens;	/* and their bytes */
+static unsigned char *key_a;	/* normalized keys of compare_sort_keys() */
+static unsigned char *key_b;
+
+/*
+ * Starts sorting rows of `tbl' by the columns in comma-separated `list',
+ * or by the primary key if `list' is NULL, in `memory' bytes at most.
+ */
+void open_sort(const struct table_desc *tbl, const char *list,
+	       size_t memory)
+{
+	const struct column_desc **cols;
+	int i;
+
+	cols = select_key(tbl, list, &nkeys);
+	if (nkeys == 0)
+		fmt_err_exit("%s", "No primary key to sort by, "
+			     "give the columns with --sort-key");
+
+	keys = alloc_buff((size_t) nkeys * sizeof(*keys));
+	key_len = SEQ_BYTES;
+	for (i = 0; i < nkeys; ++i) {
+		keys[i].k_col = cols[i];
+		keys[i].k_len = key_size(cols[i], keys[i].k_pad);
+		key_len += keys[i].k_len;
+	}
+	free_buff(cols);
+
+	ndrec = tbl->t_ndrec;
+	spans = record_spans(tbl);
+
+	row = alloc_buff((size_t) ndrec * sizeof(*row));
+	row_lens = alloc_buff((size_t) ndrec * sizeof(*row_lens));
+	key_a = alloc_buff(key_len - SEQ_BYTES);
+	key_b = alloc_buff(key_len - SEQ_BYTES);
+	budget = memory;
+	seq = 0;
+}
+
+/*
+ * Adds the row in D records `recs', of `lens' bytes each, writing out
+ * the rows in memory as a sorted run first if they reach the budget.
+ */
+void add_sort_row(const unsigned char *const *recs, const size_t *lens)
+{
+	unsigned char *entry;
+	unsigned char *dst;
+	size_t size;
+	size_t need;
+	size_t len;
+	int i;
+
+	size = LEN_BYTES + key_len;
+	for (i = 0; i < ndrec; ++i)
+		size += LEN_BYTES + (lens[i] > spans[i] ? lens[i] : spans[i]);
+
+	if (nentries > 0 && arena_used + size + (nentries + 1)
+	    * sizeof(*entries) > budget)
+		spill_run();
+
+	need = arena_used + size;
+	if (need > arena_size) {
+		arena_size = arena_size ? arena_size * 2 : MIN_ARENA_SIZE;
+		if (arena_size > budget)
+			arena_size = budget;
+		if (arena_size < need)
+			arena_size = need;
+		arena = resize_buff(arena, arena_size);
+	}
+	if (nentries == entries_cap) {
+		entries_cap = entries_cap ? entries_cap * 2 : 1024;
+		entries = resize_buff(entries, entries_cap * sizeof(*entries));
+	}
+
+	entry = arena + arena_used;
+	put_len(entry, size);
+	encode_key(entry + LEN_BYTES, recs);
+	dst = entry + LEN_BYTES + key_len - SEQ_BYTES;
+	for (i = 0; i < SEQ_BYTES; ++i)
+		*dst++ = (unsigned char)(seq >> (SEQ_BYTES - 1 - i) * 8);
+	++seq;
+	for (i = 0; i < ndrec; ++i) {
+		len = lens[i] > spans[i] ? lens[i] : spans[i];
+		put_len(dst, lens[i]);
+		memcpy(dst + LEN_BYTES, recs[i], lens[i]);
+		memset(dst + LEN_BYTES + lens[i], 0, len - lens[i]);
+		dst += LEN_BYTES + len;
+	}
+
+	entries[nentries++] = arena_used;
+	arena_used += size;
+}
+
+/*
+ * Calls `emit' with `arg' for each row added, in the order of their keys,
+ * until it returns false.
+ */
+void output_sorted_rows(sorted_row_fn emit, void *arg)
+{
+	FILE *out;
+	size_t i;
+
+	if (nruns == 0) {
+		sort_entries();
+		for (i = 0; i < nentries; ++i)
+			if (!emit_entry(arena + entries[i], emit, arg))
+				break;
+		return;
+	}
+
+	if (nentries > 0)
+		spill_run();
+	/* the memory of the entries goes to the buffers of the runs */
+	free_buff(arena);
+	free_buff(entries);
+	arena = NULL;
+	entries = NULL;
+	arena_size = entries_cap = 0;
+
+	while (nruns > MAX_MERGE_WAY) {
+		out = open_run();
+		merge_runs(runs, MAX_MERGE_WAY, out, NULL, NULL);
+		memmove(runs, runs + MAX_MERGE_WAY,
+			(size_t) (nruns - MAX_MERGE_WAY) * sizeof(*runs));
+		nruns -= MAX_MERGE_WAY;
+		runs[nruns++] = out;
+	}
+	merge_runs(runs, nruns, NULL, emit, arg);
+	nruns = 0;
+}
+
+/* free everything of the sort, removing the runs left */
+void close_sort(void)
+{
+	int i;
+
+	for (i = 0; i < nruns; ++i)
+		fclose(runs[i]);
+	free_buff(runs);
+	free_buff(arena);
+	free_buff(entries);
+	free_buff(keys);
+	free_buff(spans);
+	free_buff(row);
+	free_buff(row_lens);
+	free_buff(key_a);
+	free_buff(key_b);
+	runs = NULL;
+	arena = NULL;
+	entries = NULL;
+	keys = NULL;
+	spans = NULL;
+	row = NULL;
+	row_lens = NULL;
+	key_a = key_b = NULL;
+	nruns = 0;
+	arena_size = arena_used = nentries = entries_cap = 0;
+}
+
+/*
+ * Returns the bytes of the normalized form of a value of `col', with
+ * the padding of a varying-length value in the GRAPHIC_CHAR_BYTES bytes
+ * of `pad'.
+ */
+static size_t key_size(const struct column_desc *col, unsigned char *pad)
+{
+	size_t size;
+
+	memset(pad, 0x00, GRAPHIC_CHAR_BYTES);
+	switch (col->c_type) {
+	case SMALLINT:
+	case INTEGER:
+	case BIGINT:
+	case CHAR:
+	case BINARY:
+	case DATE:
+	case TIME:
+	case TIMESTAMP:
+		size = col->c_len;
+		break;
+	case FLOATING_POINT:
+		size = sizeof(double);
+		break;
+	case DECIMAL:
+		size = 1 + packed_decimal_size(col->c_len);
+		break;
+	case VARCHAR:
+		/* trailing blanks do not count, as in SQL */
+		size = col->c_len;
+		if (!col->c_bitdata
+		    && (!col->c_codec
+			|| from_utf8(pad, " ", 1, col->c_codec) != 1))
+			*pad = ' ';
+		pad[1] = pad[0];
+		break;
+	case VARBINARY:
+		size = col->c_len;
+		break;
+	case GRAPHIC:
+		size = col->c_len * GRAPHIC_CHAR_BYTES;
+		break;
+	case VARGRAPHIC:
+		size = col->c_len * GRAPHIC_CHAR_BYTES;
+		graphic_blank(col, pad);
+		break;
+	default:
+		fmt_err_exit("Column %s cannot be a sort key", col->c_name);
+		return 0;
+	}
+
+	return col->c_nullable ? size + 1 : size;
+}
+
+/*
+ * Writes the blank of the graphic code page of `col' to `pad': the DBCS
+ * space of a double-byte code page, else U+0020 as in UTF-16 ones.
+ */
+static void graphic_blank(const struct column_desc *col, unsigned char *pad)
+{
+	if (col->c_codec && from_utf8(pad, IDEOGRAPHIC_SPACE,
+				      strlen(IDEOGRAPHIC_SPACE),
+				      col->c_codec) == GRAPHIC_CHAR_BYTES)
+		return;
+
+	pad[0] = 0x00;
+	pad[1] = ' ';
+}
+
+/*
+ * Compares the keys of the rows in D records `a' and `b', returns less
+ * than, equal to or greater than zero as the key of `a' sorts before, with
+ * or after that of `b'.
+ */
+int compare_sort_keys(const unsigned char *const *a,
+		      const unsigned char *const *b)
+{
+	encode_key(key_a, a);
+	encode_key(key_b, b);
+
+	return memcmp(key_a, key_b, key_len - SEQ_BYTES);
+}
+
+/* write the normalized key of the row in `recs' to `dst' */
+static void encode_key(unsigned char *dst, const unsigned char *const *recs)
+{
+	const struct column_desc *col;
+	int i;
+
+	for (i = 0; i < nkeys; ++i) {
+		col = keys[i].k_col;
+		encode_value(dst, recs[col->c_drid - 1] + IXFDCOLS_OFFSET
+			     + col->c_offset, &keys[i]);
+		dst += keys[i].k_len;
+	}
+}
+
+/*
+ * Writes the value of a key column at `src' to `dst' so that memcmp()
+ * orders the values as SQL does, nulls last. Character data is in the
+ * byte order of its code page.
+ */
+static void encode_value(unsigned char *dst, const unsigned char *src,
+			 const struct sort_key *key)
+{
+	const struct column_desc *col;
+	unsigned char *end;
+	size_t len;
+	size_t i;
+	bool neg;
+
+	col = key->k_col;
+	end = dst + key->k_len;
+	if (col->c_nullable) {
+		if (column_is_null(src)) {
+			*dst = 1;
+			memset(dst + 1, 0, key->k_len - 1);
+			return;
+		}
+		*dst++ = 0;
+		src += NULL_VAL_IND_BYTES;
+	}
+
+	switch (col->c_type) {
+	case SMALLINT:
+	case INTEGER:
+	case BIGINT:
+		/* little-endian to big-endian, with the sign bit flipped */
+		for (i = 0; i < col->c_len; ++i)
+			dst[i] = src[col->c_len - 1 - i];
+		dst[0] ^= SIGN_BIT;
+		break;
+	case FLOATING_POINT:
+		encode_double(dst, parse_ixf_float(src, col->c_len));
+		break;
+	case DECIMAL:
+		len = (size_t) (end - dst) - 1;
+		neg = packed_is_negative(src, len);
+		*dst++ = neg ? 0 : 1;
+		memcpy(dst, src, len);
+		dst[len - 1] &= DIGITS_MASK;
+		if (neg)
+			for (i = 0; i < len; ++i)
+				dst[i] = (unsigned char)~dst[i];
+		break;
+	case VARCHAR:
+	case VARBINARY:
+	case VARGRAPHIC:
+		len = get_varchar_cur_len(src);
+		if (col->c_type == VARGRAPHIC)
+			len *= GRAPHIC_CHAR_BYTES;
+		if (len > (size_t) (end - dst))
+			len = (size_t) (end - dst);
+		memcpy(dst, src + VARCHAR_CUR_LEN_IND_BYTES, len);
+		for (i = 0; dst + len + i < end; ++i)
+			dst[len + i] = key->k_pad[i % GRAPHIC_CHAR_BYTES];
+		break;
+	default:
+		memcpy(dst, src, (size_t) (end - dst));
+		break;
+	}
+}
+
+/* write `val' as 8 bytes that memcmp() orders as the values */
+static void encode_double(unsigned char *dst, double val)
+{
+	uint64_t bits;
+	int i;
+
+	if (!(val < 0.0) && !(val > 0.0))
+		val = 0.0;	/* -0.0 is 0.0 */
+	memcpy(&bits, &val, sizeof(bits));
+	bits = bits >> 63 ? ~bits : bits | (uint64_t) 1 << 63;
+
+	for (i = 0; i < 8; ++i)
+		dst[i] = (unsigned char)(bits >> (56 - i * 8));
+}
+
+/* write the entries in memory to a new run, in order, and forget them */
+static void spill_run(void)
+{
+	FILE *fp;
+	size_t i;
+
+	sort_entries();
+	fp = open_run();
+	for (i = 0; i < nentries; ++i)
+		write_entry(fp, arena + entries[i]);
+
+	runs = resize_buff(runs, (size_t) (nruns + 1) * sizeof(*runs));
+	runs[nruns++] = fp;
+	arena_used = 0;
+	nentries = 0;
+}
+
+/* Returns a new temporary file in $TMPDIR or /tmp, removed when closed. */
+static FILE *open_run(void)
+{
+	const char *dir;
+	char *name;
+	FILE *fp;
+	int fd;
+
+	dir = getenv("TMPDIR");
+	if (!dir || *dir == '\0')
+		dir = "/tmp";
+	name = alloc_buff(strlen(dir) + sizeof(TMP_TEMPLATE));
+	strcpy(name, dir);
+	strcat(name, TMP_TEMPLATE);
+
+	fd = mkstemp(name);
+	if (fd == -1)
+		err_exit(name);
+	unlink(name);
+	free_buff(name);
+
+	fp = fdopen(fd, "w+b");
+	if (!fp)
+		err_exit("fdopen");
+	setvbuf(fp, NULL, _IOFBF, RUN_BUFF_SIZE);
+
+	return fp;
+}
+
+static void sort_entries(void)
+{
+	qsort(entries, nentries, sizeof(*entries), compare_entries);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	return memcmp(arena + *(const size_t *)a + LEN_BYTES,
+		      arena + *(const size_t *)b + LEN_BYTES, key_len);
+}
+
+/*
+ * Merges the runs `in' into `out', or passes the rows to `emit' if `out'
+ * is NULL, and closes them. Returns false if `emit' stopped it.
+ */
+static bool merge_runs(FILE **in, int nin, FILE *out, sorted_row_fn emit,
+		       void *arg)
+{
+	struct run_reader *rds;
+	struct run_reader **heap;
+	struct run_reader *top;
+	bool more;
+	int n;
+	int i;
+
+	rds = alloc_buff((size_t) nin * sizeof(*rds));
+	heap = alloc_buff((size_t) nin * sizeof(*heap));
+	n = 0;
+	for (i = 0; i < nin; ++i) {
+		rds[i].r_fp = in[i];
+		rds[i].r_entry = NULL;
+		rds[i].r_size = 0;
+		rewind(in[i]);
+		if (read_entry(&rds[i]))
+			heap[n++] = &rds[i];
+	}
+	for (i = n / 2 - 1; i >= 0; --i)
+		sift_down(heap, n, i);
+
+	more = true;
+	while (n > 0) {
+		top = heap[0];
+		if (out) {
+			write_entry(out, top->r_entry);
+		} else if (!emit_entry(top->r_entry, emit, arg)) {
+			more = false;
+			break;
+		}
+		if (!read_entry(top))
+			heap[0] = heap[--n];
+		sift_down(heap, n, 0);
+	}
+
+	for (i = 0; i < nin; ++i) {
+		fclose(rds[i].r_fp);
+		free_buff(rds[i].r_entry);
+	}
+	free_buff(rds);
+	free_buff(heap);
+	if (out && fflush(out) == EOF)
+		err_exit("fflush");
+
+	return more;
+}
+
+/* Reads the next entry of a run, returns false at its end. */
+static bool read_entry(struct run_reader *rd)
+{
+	unsigned char len_buff[LEN_BYTES];
+	size_t n_read;
+	size_t len;
+
+	n_read = fread(len_buff, 1, LEN_BYTES, rd->r_fp);
+	if (n_read == 0 && feof(rd->r_fp))
+		return false;
+	if (n_read != LEN_BYTES)
+		fmt_err_exit("%s", "Error reading a temporary file of the sort");
+
+	len = get_len(len_buff);
+	if (len > rd->r_size) {
+		rd->r_entry = resize_buff(rd->r_entry, len);
+		rd->r_size = len;
+	}
+	memcpy(rd->r_entry, len_buff, LEN_BYTES);
+	if (fread(rd->r_entry + LEN_BYTES, 1, len - LEN_BYTES, rd->r_fp)
+	    != len - LEN_BYTES)
+		fmt_err_exit("%s", "Error reading a temporary file of the sort");
+
+	return true;
+}
+
+/* move `heap[i]' down to keep the smallest entry of the `n' at the top */
+static void sift_down(struct run_reader **heap, int n, int i)
+{
+	struct run_reader *tmp;
+	int least;
+	int child;
+
+	for (;;) {
+		least = i;
+		for (child = 2 * i + 1; child <= 2 * i + 2 && child < n;
+		     ++child)
+			if (memcmp(heap[child]->r_entry + LEN_BYTES,
+				   heap[least]->r_entry + LEN_BYTES,
+				   key_len) < 0)
+				least = child;
+		if (least == i)
+			return;
+		tmp = heap[i];
+		heap[i] = heap[least];
+		heap[least] = tmp;
+		i = least;
+	}
+}
+
+static void write_entry(FILE *fp, const unsigned char *entry)
+{
+	size_t len;
+
+	len = get_len(entry);
+	if (fwrite(entry, 1, len, fp) != len)
+		err_exit("fwrite");
+}
+
+/* pass the row of `entry' to `emit' with `arg', returns what it returns */
+static bool emit_entry(const unsigned char *entry, sorted_row_fn emit,
+		       void *arg)
+{
+	const unsigned char *src;
+	uint64_t n;
+	int i;
+
+	src = entry + LEN_BYTES + key_len - SEQ_BYTES;
+	n = 0;
+	for (i = 0; i < SEQ_BYTES; ++i)
+		n = n << 8 | *src++;
+	for (i = 0; i < ndrec; ++i) {
+		row_lens[i] = get_len(src);
+		row[i] = src + LEN_BYTES;
+		src += LEN_BYTES + (row_lens[i] > spans[i] ? row_lens[i]
+				    : spans[i]);
+	}
+
+	return emit(row, row_lens, n, arg);
+}
+
+static void put_len(unsigned char *dst, size_t len)
+{
+	uint32_t n;
+
+	n = (uint32_t) len;
+	memcpy(dst, &n, LEN_BYTES);
+}
+
+static size_t get_len(const unsigned char *src)
+{
+	uint32_t n;
+
+	memcpy(&n, src, LEN_BYTES);
+	return n;
+}
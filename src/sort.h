@@ -0,0 +1,46 @@
+/*
+ * sort.h - declarations of the external merge sort of --sort-by-pk
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_SORT_H_
+#define IXFCVT_SORT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ixfcvt.h"
+
+#define DEF_SORT_MEMORY (256UL << 20)	/* bytes, of --sort-memory */
+#define MIN_SORT_MEMORY (1UL << 20)
+
+/*
+ * called with each row in order, with the bytes of its D records and its
+ * number in the order added from 0, returns false to stop
+ */
+typedef bool (*sorted_row_fn) (const unsigned char *const *recs,
+			       const size_t *lens, uint64_t seq, void *arg);
+
+void open_sort(const struct table_desc *tbl, const char *list,
+	       size_t memory);
+void add_sort_row(const unsigned char *const *recs, const size_t *lens);
+void output_sorted_rows(sorted_row_fn emit, void *arg);
+int compare_sort_keys(const unsigned char *const *a,
+		      const unsigned char *const *b);
+void close_sort(void);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * split.c - copy the records of an IXF file to several, for --split-ixf
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "split.h"
+#include "util.h"
+
+/*
+ * The records are copied as read, behind the record length, which is
+ * written again as the 6 digits it was read from. Each file has a buffer
+ * of its own, so that rows are written in large blocks.
+ */
+#define REC_LEN_BYTES 6
+#define MAX_REC_LEN 999999
+#define SPLIT_BUFF_SIZE (64UL << 10)
+
+/* an A record met within a row, written with the row */
+struct held_record {
+	unsigned char *h_rec;
+	size_t h_len;
+	int h_drid;		/* D records of the row before it */
+};
+
+static void put_record(int part, const unsigned char *rec, size_t len);
+static void put_held(int part, int drid);
+static void flush_split(int part);
+
+static const int *fds;		/* of the files, in order */
+static int nfds;
+static unsigned char **buffs;	/* of the files, allocated when needed */
+static size_t *used;		/* bytes in `buffs' */
+static struct held_record *held;	/* of the row being read */
+static int nheld;
+static int held_cap;		/* entries of `held' */
+
+/* Copies the records to the `nsplits' files `split_fds'. */
+void open_splits(const int *split_fds, int nsplits)
+{
+	int i;
+
+	fds = split_fds;
+	nfds = nsplits;
+	buffs = alloc_buff((size_t) nfds * sizeof(*buffs));
+	used = alloc_buff((size_t) nfds * sizeof(*used));
+	for (i = 0; i < nfds; ++i) {
+		buffs[i] = NULL;
+		used[i] = 0;
+	}
+}
+
+/* write record `rec' of `len' bytes to file `part', or ALL_SPLITS */
+void split_record(int part, const unsigned char *rec, size_t len)
+{
+	int i;
+
+	if (part != ALL_SPLITS) {
+		put_record(part, rec, len);
+		return;
+	}
+	for (i = 0; i < nfds; ++i)
+		put_record(i, rec, len);
+}
+
+/*
+ * Keeps record `rec' of `len' bytes, met after the first `drid' D records
+ * of a row, to be written with the row by split_row().
+ */
+void hold_record(const unsigned char *rec, size_t len, int drid)
+{
+	struct held_record *h;
+
+	if (nheld == held_cap) {
+		held_cap = held_cap ? held_cap * 2 : 4;
+		held = resize_buff(held, (size_t) held_cap * sizeof(*held));
+	}
+	h = &held[nheld++];
+	h->h_rec = alloc_buff(len);
+	memcpy(h->h_rec, rec, len);
+	h->h_len = len;
+	h->h_drid = drid;
+}
+
+/*
+ * write the `ndrec' D records `recs' of a row, of `lens' bytes each, with
+ * the records held within it in their places
+ */
+void split_row(int part, const unsigned char *const *recs,
+	       const size_t *lens, int ndrec)
+{
+	int i;
+
+	for (i = 0; i < ndrec; ++i) {
+		if (nheld > 0)
+			put_held(part, i);
+		put_record(part, recs[i], lens[i]);
+	}
+	drop_held();
+}
+
+/* write the records held to file `part', or ALL_SPLITS, and forget them */
+void split_held(int part)
+{
+	int i;
+
+	for (i = 0; i < nheld; ++i)
+		split_record(part, held[i].h_rec, held[i].h_len);
+	drop_held();
+}
+
+/* forget the records held, those of a row not written */
+void drop_held(void)
+{
+	int i;
+
+	for (i = 0; i < nheld; ++i)
+		free_buff(held[i].h_rec);
+	nheld = 0;
+}
+
+/* write out what is buffered and free the buffers */
+void close_splits(void)
+{
+	int i;
+
+	for (i = 0; i < nfds; ++i) {
+		flush_split(i);
+		free_buff(buffs[i]);
+	}
+	free_buff(buffs);
+	free_buff(used);
+	drop_held();
+	free_buff(held);
+	buffs = NULL;
+	used = NULL;
+	held = NULL;
+	held_cap = 0;
+	fds = NULL;
+	nfds = 0;
+}
+
+static void put_record(int part, const unsigned char *rec, size_t len)
+{
+	char len_buff[REC_LEN_BYTES + 1];
+
+	if (len > MAX_REC_LEN)
+		fmt_err_exit("Record of %lu bytes too long", (unsigned long)len);
+
+	if (!buffs[part])
+		buffs[part] = alloc_buff(SPLIT_BUFF_SIZE);
+	if (used[part] + REC_LEN_BYTES + len > SPLIT_BUFF_SIZE)
+		flush_split(part);
+
+	sprintf(len_buff, "%06lu", (unsigned long)len);
+	if (REC_LEN_BYTES + len > SPLIT_BUFF_SIZE) {
+		/* larger than the buffer, written as is */
+		write_bytes(fds[part], len_buff, REC_LEN_BYTES);
+		write_bytes(fds[part], rec, len);
+		return;
+	}
+	memcpy(buffs[part] + used[part], len_buff, REC_LEN_BYTES);
+	memcpy(buffs[part] + used[part] + REC_LEN_BYTES, rec, len);
+	used[part] += REC_LEN_BYTES + len;
+}
+
+/* write the records held after the first `drid' D records of the row */
+static void put_held(int part, int drid)
+{
+	int i;
+
+	for (i = 0; i < nheld; ++i)
+		if (held[i].h_drid == drid)
+			put_record(part, held[i].h_rec, held[i].h_len);
+}
+
+static void flush_split(int part)
+{
+	if (used[part] == 0)
+		return;
+	write_bytes(fds[part], buffs[part], used[part]);
+	used[part] = 0;
+}
@@ -0,0 +1,35 @@
+/*
+ * split.h - declarations of the IXF files of --split-ixf
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_SPLIT_H_
+#define IXFCVT_SPLIT_H_
+
+#include <stddef.h>
+
+#define ALL_SPLITS -1		/* a record of every file */
+
+void open_splits(const int *split_fds, int nsplits);
+void split_record(int part, const unsigned char *rec, size_t len);
+void hold_record(const unsigned char *rec, size_t len, int drid);
+void split_row(int part, const unsigned char *const *recs,
+	       const size_t *lens, int ndrec);
+void split_held(int part);
+void drop_held(void);
+void close_splits(void);
+
+#endif
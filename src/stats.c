@@ -0,0 +1,270 @@
+/*
+ * stats.c - collect and print the run statistics of --stats
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "ixfcvt.h"
+#include "stats.h"
+#include "util.h"
+
+#define NS_PER_SEC 1000000000.0
+#define MAX_TYPE_CODE 1000	/* above the DB2 data types of ixfcvt.h */
+#define RECORD_TYPES "HTCDA"
+
+/* time and CPU time of a phase */
+struct phase_time {
+	double p_wall;		/* in seconds */
+	double p_user;
+	double p_sys;
+};
+
+static const char *const PHASE_NAMES[PHASE_DONE] = {
+	"summary scan", "schema", "rows", "ddl"
+};
+
+static const struct {
+	int type;
+	const char *name;
+} TYPE_NAMES[] = {
+	{CHAR, "CHAR"},
+	{VARCHAR, "VARCHAR"},
+	{LONG_VARCHAR, "LONG VARCHAR"},
+	{GRAPHIC, "GRAPHIC"},
+	{VARGRAPHIC, "VARGRAPHIC"},
+	{LONG_VARGRAPHIC, "LONG VARGRAPHIC"},
+	{BINARY, "BINARY"},
+	{VARBINARY, "VARBINARY"},
+	{SMALLINT, "SMALLINT"},
+	{INTEGER, "INTEGER"},
+	{BIGINT, "BIGINT"},
+	{DECIMAL, "DECIMAL"},
+	{DATE, "DATE"},
+	{TIME, "TIME"},
+	{TIMESTAMP, "TIMESTAMP"},
+	{FLOATING_POINT, "REAL/DOUBLE"},
+	{DECFLOAT, "DECFLOAT"},
+	{XML, "XML"}
+};
+
+static bool enabled;
+static enum run_phase cur_phase = PHASE_DONE;	/* none yet */
+static struct phase_time phase_start;
+static struct phase_time run_start;
+static struct phase_time phases[PHASE_DONE];
+static unsigned long long bytes_read;
+static unsigned long long bytes_written;
+static unsigned long long phase_written[PHASE_DONE + 1];
+static unsigned long reads;
+static unsigned long writes;
+static unsigned long seeks;
+static unsigned long records[sizeof(RECORD_TYPES)];	/* and unknown ones */
+static unsigned long long record_bytes[sizeof(RECORD_TYPES)];
+static long rows_read;
+static long rows_output;
+static double format_ns[MAX_TYPE_CODE];
+static unsigned long format_values[MAX_TYPE_CODE];
+
+static void get_phase_time(struct phase_time *pt);
+static const char *type_name(int type);
+
+/* start collecting statistics, the time of the run starts now */
+void enable_stats(void)
+{
+	enabled = true;
+	get_phase_time(&run_start);
+}
+
+/* Returns true if --stats is given. */
+bool stats_enabled(void)
+{
+	return enabled;
+}
+
+/* end the current phase, if any, and start `phase' */
+void enter_phase(enum run_phase phase)
+{
+	struct phase_time now;
+
+	if (!enabled)
+		return;
+
+	get_phase_time(&now);
+	if (cur_phase != PHASE_DONE) {
+		phases[cur_phase].p_wall += now.p_wall - phase_start.p_wall;
+		phases[cur_phase].p_user += now.p_user - phase_start.p_user;
+		phases[cur_phase].p_sys += now.p_sys - phase_start.p_sys;
+	}
+	cur_phase = phase;
+	phase_start = now;
+}
+
+/* count a read() of `bytes' bytes */
+void count_read(size_t bytes)
+{
+	++reads;
+	bytes_read += bytes;
+}
+
+/* count `calls' reads of `bytes' bytes in all, made by other threads */
+void count_reads(unsigned long calls, unsigned long long bytes)
+{
+	reads += calls;
+	bytes_read += bytes;
+}
+
+/* count a write() of `bytes' bytes */
+void count_write(size_t bytes)
+{
+	++writes;
+	bytes_written += bytes;
+	phase_written[cur_phase] += bytes;
+}
+
+/* count an lseek() */
+void count_seek(void)
+{
+	++seeks;
+}
+
+/* count a record of `type' (H, T, C, D or A) of `bytes' bytes */
+void count_record(unsigned char type, size_t bytes)
+{
+	const char *p;
+	size_t i;
+
+	p = type ? strchr(RECORD_TYPES, type) : NULL;
+	i = p ? (size_t)(p - RECORD_TYPES) : sizeof(RECORD_TYPES) - 1;
+	++records[i];
+	record_bytes[i] += bytes;
+}
+
+/* set the numbers of rows read from the IXF file and output */
+void count_rows(long read, long output)
+{
+	rows_read = read;
+	rows_output = output;
+}
+
+/* Returns the time of a monotonic clock in nanoseconds. */
+double stats_clock(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err_exit("clock_gettime");
+
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* add `ns' nanoseconds of formatting a value of a column of `type' */
+void count_format(int type, double ns)
+{
+	if (type < 0 || type >= MAX_TYPE_CODE)
+		return;
+	format_ns[type] += ns;
+	++format_values[type];
+}
+
+/* write the statistics to the standard error */
+void print_stats(void)
+{
+	struct phase_time now;
+	struct rusage ru;
+	const char *d_rec;
+	size_t d_idx;
+	bool header_done;	/* of the formatting times */
+	int i;
+
+	enter_phase(PHASE_DONE);
+	get_phase_time(&now);
+	header_done = false;
+
+	err_msg("%s\n", "--- ixfcvt statistics ---");
+	err_msg("%-14s %10s %10s %10s\n", "phase", "wall (s)", "user (s)",
+		"sys (s)");
+	for (i = 0; i < PHASE_DONE; ++i)
+		err_msg("%-14s %10.3f %10.3f %10.3f\n", PHASE_NAMES[i],
+			phases[i].p_wall, phases[i].p_user, phases[i].p_sys);
+	err_msg("%-14s %10.3f %10.3f %10.3f\n", "total",
+		now.p_wall - run_start.p_wall, now.p_user - run_start.p_user,
+		now.p_sys - run_start.p_sys);
+
+	err_msg("read: %llu bytes in %lu calls, %lu seeks\n", bytes_read,
+		reads, seeks);
+	err_msg("written: %llu bytes in %lu calls\n", bytes_written, writes);
+	err_msg("records:");
+	for (i = 0; RECORD_TYPES[i]; ++i)
+		err_msg(" %c %lu,", RECORD_TYPES[i], records[i]);
+	err_msg(" other %lu\n", records[sizeof(RECORD_TYPES) - 1]);
+
+	d_rec = strchr(RECORD_TYPES, 'D');
+	d_idx = (size_t)(d_rec - RECORD_TYPES);
+	err_msg("rows: %ld read, %ld output", rows_read, rows_output);
+	if (rows_read > 0)
+		err_msg(", %.1f bytes per IXF row",
+			(double)record_bytes[d_idx] / rows_read);
+	if (rows_output > 0 && phase_written[PHASE_ROWS] > 0)
+		err_msg(", %.1f bytes per SQL row",
+			(double)phase_written[PHASE_ROWS] / rows_output);
+	err_msg("\n");
+
+	if (getrusage(RUSAGE_SELF, &ru) == -1)
+		err_exit("getrusage");
+	err_msg("peak RSS: %ld KB\n", (long)ru.ru_maxrss);
+
+	for (i = 0; i < MAX_TYPE_CODE; ++i) {
+		if (format_values[i] == 0)
+			continue;
+		if (!header_done) {
+			err_msg("%-16s %12s %10s %10s\n", "formatting",
+				"values", "time (s)", "ns/value");
+			header_done = true;
+		}
+		err_msg("%-16s %12lu %10.3f %10.1f\n", type_name(i),
+			format_values[i], format_ns[i] / NS_PER_SEC,
+			format_ns[i] / format_values[i]);
+	}
+}
+
+/* the wall clock and CPU time of the process up to now */
+static void get_phase_time(struct phase_time *pt)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) == -1)
+		err_exit("getrusage");
+
+	pt->p_wall = stats_clock() / NS_PER_SEC;
+	pt->p_user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+	pt->p_sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* the name of a DB2 data type */
+static const char *type_name(int type)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); ++i)
+		if (TYPE_NAMES[i].type == type)
+			return TYPE_NAMES[i].name;
+
+	return "other";
+}
@@ -0,0 +1,47 @@
+/*
+ * stats.h - declarations of the run statistics of --stats
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_STATS_H_
+#define IXFCVT_STATS_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* phases of a run, in order */
+enum run_phase {
+	PHASE_SUMMARY,		/* scan of the IXF file by get_ixf_summary() */
+	PHASE_SCHEMA,		/* H, T and C records */
+	PHASE_ROWS,		/* D records to rows */
+	PHASE_DDL,		/* CREATE TABLE, or the result of an option */
+	PHASE_DONE
+};
+
+void enable_stats(void);
+bool stats_enabled(void);
+void enter_phase(enum run_phase phase);
+void count_read(size_t bytes);
+void count_reads(unsigned long calls, unsigned long long bytes);
+void count_write(size_t bytes);
+void count_seek(void);
+void count_record(unsigned char type, size_t bytes);
+void count_rows(long read, long output);
+double stats_clock(void);
+void count_format(int type, double ns);
+void print_stats(void);
+
+#endif
@@ -16,14 +16,30 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "boundary.h"
 #include "ixfcvt.h"
+#include "pagecache.h"
+#include "stats.h"
 #include "util.h"
 
 #define SUMMARY_BYTES 7		/* record length(6) + record type) */
+#define REC_LEN_BYTES 6
 
+static bool scan_data_part(int fd, off_t start, int nthreads, long *d_cnt,
+			   off_t *max);
+static void report_break(int fd, off_t off);
+
+/*
+ * Scans the records of the IXF file for the number of C and D records and
+ * the maximum record size. Unless `s_scan_all' is set, the scan stops at
+ * the first D record and the D records are not counted.  The records from
+ * the first D record on are counted a window at a time, on `s_threads'
+ * threads.
+ */
 void get_ixf_summary(int fd, struct summary *sum)
 {
 	char buff[SUMMARY_BYTES];
@@ -41,6 +57,7 @@ void get_ixf_summary(int fd, struct summary *sum)
 	d_cnt = 0L;
 	seek_file(fd, 0, SEEK_SET);
 	while ((n_read = read(fd, buff, SUMMARY_BYTES)) == SUMMARY_BYTES) {
+		count_read(SUMMARY_BYTES);
 		if (buff[SUMMARY_BYTES - 1] == 'C')
 			++c_cnt;
 		else if (buff[SUMMARY_BYTES - 1] == 'D')
@@ -50,8 +67,19 @@ void get_ixf_summary(int fd, struct summary *sum)
 		len = (off_t) str_to_long(buff);
 		max = len > max ? len : max;
 
+		if (d_cnt > 0 && !sum->s_scan_all) {
+			d_cnt = -1L;	/* not counted */
+			break;
+		}
+		if (d_cnt == 1
+		    && scan_data_part(fd, seek_file(fd, 0, SEEK_CUR)
+				      - SUMMARY_BYTES, sum->s_threads,
+				      &d_cnt, &max))
+			break;
+
 		/* go to next record */
 		seek_file(fd, len - 1, SEEK_CUR);
+		cache_read(fd, SUMMARY_BYTES + (size_t) len - 1);
 	}
 
 	if (n_read == -1)
@@ -63,3 +91,57 @@ void get_ixf_summary(int fd, struct summary *sum)
 
 	seek_file(fd, orig, SEEK_SET);	/* restore */
 }
+
+/*
+ * Counts the D records from the first one at `start' to the end into
+ * `d_cnt', and takes their lengths into `max', on `nthreads' threads, or
+ * on the calling one if the file is too small for them.  Exits where the
+ * chain of records breaks.  Returns false, counting nothing, if the file
+ * is not a regular one.
+ */
+static bool scan_data_part(int fd, off_t start, int nthreads, long *d_cnt,
+			   off_t *max)
+{
+	struct record_range ranges[MAX_THREADS];
+	int n;
+	int i;
+
+	n = find_record_ranges(fd, start, nthreads, ranges);
+	if (n == 0) {
+		if (!walk_records(fd, start, &ranges[0]))
+			return false;
+		n = 1;
+	}
+	if (ranges[n - 1].rr_broken)
+		report_break(fd, ranges[n - 1].rr_end);
+
+	*d_cnt = 0L;
+	for (i = 0; i < n; ++i) {
+		*d_cnt += ranges[i].rr_dcnt;
+		if ((off_t) ranges[i].rr_maxlen > *max)
+			*max = (off_t) ranges[i].rr_maxlen;
+	}
+
+	return true;
+}
+
+/*
+ * Exits on the record at `off' of `fd', whose length is not a number or
+ * which runs past the end of the file.
+ */
+static void report_break(int fd, off_t off)
+{
+	char buff[REC_LEN_BYTES + 1];
+	ssize_t n_read;
+
+	memset(buff, '\0', sizeof(buff));
+	n_read = pread(fd, buff, REC_LEN_BYTES, off);
+	if (n_read == -1)
+		err_exit("pread");
+	if (n_read == REC_LEN_BYTES
+	    && strspn(buff, "0123456789") == REC_LEN_BYTES && atol(buff) > 0)
+		fmt_err_exit("Record of %ld bytes at offset %lld runs past "
+			     "the end of the file", atol(buff), (long long)off);
+	fmt_err_exit("Invalid record length (%s) at offset %lld", buff,
+		     (long long)off);
+}
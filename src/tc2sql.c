@@ -16,6 +16,18 @@
  * limitations under the License.
  */
 
+/*
+ * The types of DB2 are mapped to the nearest ones of the target dialect.
+ * With a post-load script, the table is created without its primary key
+ * (and, where the dialect can add them later, without its NOT NULL
+ * constraints) and unlogged where the dialect allows it; the script then
+ * adds the constraints, so that their index is built once after the rows
+ * are in instead of being maintained by every INSERT, and gathers the
+ * statistics of the table.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -23,184 +35,666 @@
 #include "util.h"
 
 #define DEF_BUFF_SIZE 1000
-#define MIN_AVAIL_SIZE 200
-#define INCREMENT_SIZE 500
+#define TIMESTAMP_INT_LEN 20	/* characters before the fraction */
+#define DB2_TIMESTAMP_PREC 6	/* fraction digits of plain TIMESTAMP */
+#define DECFLOAT_TEXT_EXTRA 8	/* -0.00000 or -.E+6144 besides the digits */
+
+/* the longest strings of the dialects before a large object is needed */
+#define MYSQL_MAX_VARCHAR 16383
+#define ORACLE_MAX_VARCHAR2 4000
+#define ORACLE_MAX_NVARCHAR2 2000
+#define ORACLE_MAX_RAW 2000
 
-static int sprint_column(char *buff, const struct column_desc *col);
-static int sprint_anon_pk(char *buff, const struct column_desc *col_head);
-static void sprint_named_pk(char *buff, const struct table_desc *tbl);
-static int max_pk_pos(const struct column_desc *col_head);
-static void *ensure_capacity(void *buff, size_t * cur_size, size_t used);
+static void append_create_table(const struct table_desc *tbl, int npk);
+static void append_post_load(const struct table_desc *tbl, int npk);
+static void append_column(const struct column_desc *col, int npk);
+static void append_type(const struct column_desc *col);
+static void append_db2_type(const struct column_desc *col);
+static void append_postgresql_type(const struct column_desc *col);
+static void append_mysql_type(const struct column_desc *col);
+static void append_oracle_type(const struct column_desc *col);
+static void append_sqlite_type(const struct column_desc *col);
+static bool append_not_nulls(const struct table_desc *tbl, int npk);
+static void append_pk(const struct table_desc *tbl, int npk, bool open);
+static void append_pk_columns(const struct table_desc *tbl, int npk);
+static void append_analyze(const struct table_desc *tbl);
+static void append(const char *format, ...);
+static bool not_null_deferred(const struct column_desc *col, int npk);
+static size_t timestamp_prec(const struct column_desc *col, size_t max);
+static int selected_pk_len(const struct table_desc *tbl);
+static const struct column_desc *pk_column(const struct table_desc *tbl,
+					   int pos);
+
+static enum sql_dialect dialect;	/* of the statements */
+static bool deferred;		/* constraints go to the post-load script */
+static char *sql;		/* statements being built */
+static size_t sql_size;
+static size_t sql_len;
 
 /*
- * This function generates a CREATE TABLE statement from
- * `tbl' and writes it to the file specified by `fd'.
+ * This function generates a CREATE TABLE statement from `tbl' and
+ * writes it to the file specified by `fd', and the post-load script to
+ * the file of `sum' if any.
  */
-void table_desc_to_sql(int fd, const struct table_desc *tbl)
+void table_desc_to_sql(int fd, const struct summary *sum,
+		       const struct table_desc *tbl)
 {
-	char *buff;
-	size_t size;
-	long stored;
-	const struct column_desc *col;
+	int npk;
 
-	size = DEF_BUFF_SIZE;
-	buff = alloc_buff(size);
-	stored = sprintf(buff, "CREATE TABLE %s (\n", tbl->t_name);
-	for (col = tbl->c_head; col; col = col->next) {
-		buff = ensure_capacity(buff, &size, (size_t) stored);
-		stored += sprint_column(buff + stored, col);
-	}
+	dialect = sum->s_dialect;
+	deferred = sum->s_post_fd >= 0;
+	npk = selected_pk_len(tbl);
 
-	buff = ensure_capacity(buff, &size, (size_t) stored);
-	if (tbl->t_pkname && strlen(tbl->t_pkname) > 0) {
-		strcpy(buff + stored, "\n);\n\n");
-		stored += strlen("\n);\n\n");
-		sprint_named_pk(buff + stored, tbl);
-	} else {
-		stored += sprint_anon_pk(buff + stored, tbl->c_head);
-		strcpy(buff + stored, "\n);\n");
+	sql_size = DEF_BUFF_SIZE;
+	sql = alloc_buff(sql_size);
+	sql_len = 0;
+	append_create_table(tbl, npk);
+	write_file(fd, sql);
+
+	if (deferred) {
+		sql_len = 0;
+		sql[0] = '\0';
+		append_post_load(tbl, npk);
+		write_file(sum->s_post_fd, sql);
 	}
 
-	write_file(fd, buff);
-	free_buff(buff);
+	free_buff(sql);
 }
 
-/* enlarge buffer if necessary */
-static void *ensure_capacity(void *buff, size_t * cur_size, size_t used)
+/* Appends the CREATE TABLE statement, with its primary key unless deferred */
+static void append_create_table(const struct table_desc *tbl, int npk)
 {
-	if (used + MIN_AVAIL_SIZE > *cur_size) {
-		buff = resize_buff(buff, *cur_size + INCREMENT_SIZE);
-		*cur_size += INCREMENT_SIZE;
+	bool named;
+	int i;
+
+	append("CREATE %sTABLE %s (\n", deferred && dialect == SQL_POSTGRESQL
+	       ? "UNLOGGED " : "", tbl->t_name);
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		append_column(tbl->t_sel[i], npk);
+		if (i < tbl->t_nsel - 1)
+			append(",\n");
 	}
 
-	return buff;
+	named = tbl->t_pkname && strlen(tbl->t_pkname) > 0;
+	if (deferred) {
+		append("\n)%s;\n", dialect == SQL_ORACLE ? " NOLOGGING" : "");
+	} else if (named && dialect != SQL_SQLITE) {
+		append("\n);\n\n");
+		append_pk(tbl, npk, false);
+	} else {
+		/* SQLite cannot add a primary key to a table */
+		if (npk > 0) {
+			append(",\n\t");
+			if (named)
+				append("CONSTRAINT %s ", tbl->t_pkname);
+			append("PRIMARY KEY (");
+			append_pk_columns(tbl, npk);
+			append(")");
+		}
+		append("\n);\n");
+	}
 }
 
-/* Writes the named primary key list to `buff' */
-static void sprint_named_pk(char *buff, const struct table_desc *tbl)
+/* Appends the statements to run once the rows are loaded */
+static void append_post_load(const struct table_desc *tbl, int npk)
 {
-	const struct column_desc *col;
-	int pk_max;
-	int cnt;
-	int i;
+	bool open;
 
-	pk_max = max_pk_pos(tbl->c_head);
-	if (pk_max == 0)
-		return;
+	if (dialect == SQL_POSTGRESQL)
+		append("ALTER TABLE %s SET LOGGED;\n", tbl->t_name);
+	open = append_not_nulls(tbl, npk);
+	append_pk(tbl, npk, open);
+	if (dialect == SQL_ORACLE)
+		append("ALTER TABLE %s LOGGING;\n", tbl->t_name);
+	append_analyze(tbl);
+}
 
-	cnt =
-	    sprintf(buff, "ALTER TABLE %s ADD CONSTRAINT %s PRIMARY KEY (",
-		    tbl->t_name, tbl->t_pkname);
+/* Appends the definition of `col' */
+static void append_column(const struct column_desc *col, int npk)
+{
+	append("\t%s ", col->c_name);
+	append_type(col);
+	if (!col->c_nullable && !not_null_deferred(col, npk))
+		append(" NOT NULL");
+}
 
-	for (i = 1; i <= pk_max; ++i) {
-		for (col = tbl->c_head; col; col = col->next)
-			if (col->c_pkpos == i)
-				break;
-		if (i < pk_max)
-			cnt += sprintf(buff + cnt, "%s, ", col->c_name);
-		else
-			cnt += sprintf(buff + cnt, "%s);\n", col->c_name);
+/* Appends the type of `col' in the dialect */
+static void append_type(const struct column_desc *col)
+{
+	switch (dialect) {
+	case SQL_POSTGRESQL:
+		append_postgresql_type(col);
+		break;
+	case SQL_MYSQL:
+		append_mysql_type(col);
+		break;
+	case SQL_ORACLE:
+		append_oracle_type(col);
+		break;
+	case SQL_SQLITE:
+		append_sqlite_type(col);
+		break;
+	default:
+		append_db2_type(col);
+		break;
 	}
 }
 
-/* Writes the anonymous primary key list to `buff', returns the bytes written. */
-static int sprint_anon_pk(char *buff, const struct column_desc *col_head)
+static void append_db2_type(const struct column_desc *col)
 {
-	const struct column_desc *col;
-	int pk_max;
-	int cnt;
-	int i;
+	size_t prec;
 
-	pk_max = max_pk_pos(col_head);
-	if (pk_max == 0)
-		return 0;
-
-	strcpy(buff, ",\n\tPRIMARY KEY (");
-	cnt = (int)strlen(",\n\tPRIMARY KEY (");
-
-	for (i = 1; i <= pk_max; ++i) {
-		for (col = col_head; col; col = col->next)
-			if (col->c_pkpos == i)
-				break;
-		if (i < pk_max)
-			cnt += sprintf(buff + cnt, "%s, ", col->c_name);
+	switch (col->c_type) {
+	case CHAR:
+		append("CHAR(%zu)", col->c_len);
+		break;
+	case VARCHAR:
+		append("VARCHAR(%zu)", col->c_len);
+		break;
+	case LONG_VARCHAR:
+		append("LONG VARCHAR");
+		break;
+	case LONG_VARGRAPHIC:
+		append("LONG VARGRAPHIC");
+		break;
+	case BINARY:
+		append("BINARY(%zu)", col->c_len);
+		break;
+	case VARBINARY:
+		append("VARBINARY(%zu)", col->c_len);
+		break;
+	case GRAPHIC:
+		append("GRAPHIC(%zu)", col->c_len);
+		break;
+	case VARGRAPHIC:
+		append("VARGRAPHIC(%zu)", col->c_len);
+		break;
+	case SMALLINT:
+		append("SMALLINT");
+		break;
+	case INTEGER:
+		append("INTEGER");
+		break;
+	case BIGINT:
+		append("BIGINT");
+		break;
+	case DECIMAL:
+		append("DECIMAL(%zu, %zu)", col->c_len / 100U,
+		       col->c_len % 100U);
+		break;
+	case DATE:
+		append("DATE");
+		break;
+	case TIME:
+		append("TIME");
+		break;
+	case TIMESTAMP:
+		prec = timestamp_prec(col, SIZE_MAX);
+		if (prec == DB2_TIMESTAMP_PREC)
+			append("TIMESTAMP");
 		else
-			cnt += sprintf(buff + cnt, "%s)", col->c_name);
+			append("TIMESTAMP(%zu)", prec);
+		break;
+	case FLOATING_POINT:
+		append(col->c_len == 4 ? "REAL" : "DOUBLE");
+		break;
+	case DECFLOAT:
+		append("DECFLOAT(%zu)", col->c_len);
+		break;
+	case XML:
+		append("XML");
+		break;
+	default:
+		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
 	}
 
-	return cnt;
+	if (col->c_bitdata && col->c_type != BINARY
+	    && col->c_type != VARBINARY)
+		append(" FOR BIT DATA");
 }
 
-/* Returns the biggest c_pkpos among the colunms, or 0 if no pk found */
-static int max_pk_pos(const struct column_desc *col_head)
+static void append_postgresql_type(const struct column_desc *col)
 {
-	const struct column_desc *col;
-	int max;
-
-	max = 0;
-	for (col = col_head; col; col = col->next)
-		if (col->c_pkpos > max)
-			max = col->c_pkpos;
-
-	return max;
+	switch (col->c_type) {
+	case CHAR:
+	case GRAPHIC:
+		if (col->c_bitdata)
+			append("BYTEA");
+		else
+			append("CHAR(%zu)", col->c_len);
+		break;
+	case VARCHAR:
+	case VARGRAPHIC:
+		if (col->c_bitdata)
+			append("BYTEA");
+		else
+			append("VARCHAR(%zu)", col->c_len);
+		break;
+	case LONG_VARCHAR:
+	case LONG_VARGRAPHIC:
+	case XML:
+		append(col->c_bitdata ? "BYTEA" : "TEXT");
+		break;
+	case BINARY:
+	case VARBINARY:
+		append("BYTEA");
+		break;
+	case SMALLINT:
+		append("SMALLINT");
+		break;
+	case INTEGER:
+		append("INTEGER");
+		break;
+	case BIGINT:
+		append("BIGINT");
+		break;
+	case DECIMAL:
+		append("NUMERIC(%zu, %zu)", col->c_len / 100U,
+		       col->c_len % 100U);
+		break;
+	case DATE:
+		append("DATE");
+		break;
+	case TIME:
+		append("TIME");
+		break;
+	case TIMESTAMP:
+		append("TIMESTAMP(%zu)", timestamp_prec(col, 6));
+		break;
+	case FLOATING_POINT:
+		append(col->c_len == 4 ? "REAL" : "DOUBLE PRECISION");
+		break;
+	case DECFLOAT:
+		append("NUMERIC");
+		break;
+	default:
+		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
+	}
 }
 
-/*
- * This function interprets and writes the definition of `col',
- * returns the number of characters populated into the buffer.
- */
-static int sprint_column(char *buff, const struct column_desc *col)
+static void append_mysql_type(const struct column_desc *col)
 {
-	int cnt;
+	switch (col->c_type) {
+	case CHAR:
+	case GRAPHIC:
+		append(col->c_bitdata ? "BINARY(%zu)" : "CHAR(%zu)",
+		       col->c_len);
+		break;
+	case VARCHAR:
+	case VARGRAPHIC:
+		if (col->c_bitdata)
+			append("VARBINARY(%zu)", col->c_len);
+		else if (col->c_len <= MYSQL_MAX_VARCHAR)
+			append("VARCHAR(%zu)", col->c_len);
+		else
+			append("TEXT");
+		break;
+	case LONG_VARCHAR:
+	case LONG_VARGRAPHIC:
+		append(col->c_bitdata ? "LONGBLOB" : "LONGTEXT");
+		break;
+	case BINARY:
+		append("BINARY(%zu)", col->c_len);
+		break;
+	case VARBINARY:
+		append("VARBINARY(%zu)", col->c_len);
+		break;
+	case SMALLINT:
+		append("SMALLINT");
+		break;
+	case INTEGER:
+		append("INTEGER");
+		break;
+	case BIGINT:
+		append("BIGINT");
+		break;
+	case DECIMAL:
+		append("DECIMAL(%zu, %zu)", col->c_len / 100U,
+		       col->c_len % 100U);
+		break;
+	case DATE:
+		append("DATE");
+		break;
+	case TIME:
+		append("TIME");
+		break;
+	case TIMESTAMP:
+		/* TIMESTAMP of MySQL ends in 2038 */
+		append("DATETIME(%zu)", timestamp_prec(col, 6));
+		break;
+	case FLOATING_POINT:
+		append(col->c_len == 4 ? "FLOAT" : "DOUBLE");
+		break;
+	case DECFLOAT:
+		/* no exact type takes its exponents, Infinity or NaN */
+		append("VARCHAR(%zu)", col->c_len + DECFLOAT_TEXT_EXTRA);
+		break;
+	case XML:
+		append("TEXT");
+		break;
+	default:
+		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
+	}
+}
 
-	cnt = 0;
+static void append_oracle_type(const struct column_desc *col)
+{
 	switch (col->c_type) {
 	case CHAR:
-		cnt = sprintf(buff, "\t%s CHAR(%zd)", col->c_name, col->c_len);
+		/* lengths in characters, UTF-8 may take more bytes */
+		append(col->c_bitdata ? "RAW(%zu)" : "CHAR(%zu CHAR)",
+		       col->c_len);
 		break;
 	case VARCHAR:
-		cnt =
-		    sprintf(buff, "\t%s VARCHAR(%zd)", col->c_name, col->c_len);
+		if (col->c_bitdata && col->c_len <= ORACLE_MAX_RAW)
+			append("RAW(%zu)", col->c_len);
+		else if (col->c_bitdata)
+			append("BLOB");
+		else if (col->c_len <= ORACLE_MAX_VARCHAR2)
+			append("VARCHAR2(%zu CHAR)", col->c_len);
+		else
+			append("CLOB");
+		break;
+	case LONG_VARCHAR:
+		append(col->c_bitdata ? "BLOB" : "CLOB");
+		break;
+	case LONG_VARGRAPHIC:
+		append("NCLOB");
+		break;
+	case BINARY:
+		append("RAW(%zu)", col->c_len);
+		break;
+	case VARBINARY:
+		if (col->c_len <= ORACLE_MAX_RAW)
+			append("RAW(%zu)", col->c_len);
+		else
+			append("BLOB");
+		break;
+	case GRAPHIC:
+		append("NCHAR(%zu)", col->c_len);
+		break;
+	case VARGRAPHIC:
+		if (col->c_len <= ORACLE_MAX_NVARCHAR2)
+			append("NVARCHAR2(%zu)", col->c_len);
+		else
+			append("NCLOB");
 		break;
 	case SMALLINT:
-		cnt = sprintf(buff, "\t%s SMALLINT", col->c_name);
+		append("NUMBER(5)");
 		break;
 	case INTEGER:
-		cnt = sprintf(buff, "\t%s INTEGER", col->c_name);
+		append("NUMBER(10)");
 		break;
 	case BIGINT:
-		cnt = sprintf(buff, "\t%s BIGINT", col->c_name);
+		append("NUMBER(19)");
 		break;
 	case DECIMAL:
-		cnt = sprintf(buff, "\t%s DECIMAL(%zd, %zd)", col->c_name,
-			      col->c_len / 100U, col->c_len % 100U);
+		append("NUMBER(%zu, %zu)", col->c_len / 100U,
+		       col->c_len % 100U);
 		break;
 	case DATE:
-		cnt = sprintf(buff, "\t%s DATE", col->c_name);
+		append("DATE");
 		break;
 	case TIME:
-		cnt = sprintf(buff, "\t%s TIME", col->c_name);
+		/* no time of day type, keep the text of DB2 */
+		append("VARCHAR2(%zu)", col->c_len);
 		break;
 	case TIMESTAMP:
-		cnt = sprintf(buff, "\t%s TIMESTAMP", col->c_name);
+		append("TIMESTAMP(%zu)", timestamp_prec(col, 9));
 		break;
 	case FLOATING_POINT:
-		cnt = sprintf(buff, "\t%s %s", col->c_name,
-			      col->c_len == 4 ? "REAL" : "DOUBLE");
+		append(col->c_len == 4 ? "BINARY_FLOAT" : "BINARY_DOUBLE");
+		break;
+	case DECFLOAT:
+		append("NUMBER");
+		break;
+	case XML:
+		append("CLOB");
 		break;
 	default:
 		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
+	}
+}
+
+/* Appends the type of the affinity of `col' */
+static void append_sqlite_type(const struct column_desc *col)
+{
+	switch (col->c_type) {
+	case CHAR:
+	case VARCHAR:
+	case LONG_VARCHAR:
+		append(col->c_bitdata ? "BLOB" : "TEXT");
+		break;
+	case GRAPHIC:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+	case DATE:
+	case TIME:
+	case TIMESTAMP:
+	case XML:
+		append("TEXT");
+		break;
+	case BINARY:
+	case VARBINARY:
+		append("BLOB");
+		break;
+	case SMALLINT:
+	case INTEGER:
+	case BIGINT:
+		append("INTEGER");
+		break;
+	case DECIMAL:
+	case DECFLOAT:
+		append("NUMERIC");
+		break;
+	case FLOATING_POINT:
+		append("REAL");
+		break;
+	default:
+		fmt_err_exit(E_DATA_TYPE_NOT_IMPL, col->c_type);
+	}
+}
+
+/*
+ * Appends the NOT NULL constraints left out of CREATE TABLE, in one
+ * ALTER TABLE statement with the primary key where the dialect can;
+ * returns true if the statement is left open for the primary key.
+ */
+static bool append_not_nulls(const struct table_desc *tbl, int npk)
+{
+	const struct column_desc *col;
+	int cnt;
+	int i;
+
+	cnt = 0;
+	for (i = 0; i < tbl->t_nsel; ++i) {
+		col = tbl->t_sel[i];
+		if (col->c_nullable || !not_null_deferred(col, npk))
+			continue;
+
+		switch (dialect) {
+		case SQL_POSTGRESQL:
+			append(cnt++ ? ",\n\t" : "ALTER TABLE %s\n\t",
+			       tbl->t_name);
+			append("ALTER COLUMN %s SET NOT NULL", col->c_name);
+			break;
+		case SQL_MYSQL:
+			append(cnt++ ? ",\n\t" : "ALTER TABLE %s\n\t",
+			       tbl->t_name);
+			append("MODIFY %s ", col->c_name);
+			append_type(col);
+			append(" NOT NULL");
+			break;
+		default:	/* SQL_ORACLE */
+			append(cnt++ ? ", " : "ALTER TABLE %s MODIFY (",
+			       tbl->t_name);
+			append("%s NOT NULL", col->c_name);
+			break;
+		}
+	}
 
+	if (cnt == 0)
+		return false;
+	if (dialect == SQL_ORACLE) {
+		append(");\n");
+		return false;
 	}
+	if (npk > 0) {
+		append(",\n\t");
+		return true;
+	}
+	append(";\n");
+	return false;
+}
+
+/*
+ * Appends the statement adding the primary key, or only its clause if
+ * an ALTER TABLE statement is still `open'.
+ */
+static void append_pk(const struct table_desc *tbl, int npk, bool open)
+{
+	bool named;
+
+	if (npk == 0)
+		return;
 
-	if (!col->c_nullable) {
-		strcpy(buff + cnt, " NOT NULL");
-		cnt += strlen(" NOT NULL");
+	named = tbl->t_pkname && strlen(tbl->t_pkname) > 0;
+	if (dialect == SQL_SQLITE) {
+		/* only an index can be added */
+		if (named)
+			append("CREATE UNIQUE INDEX %s ON %s (", tbl->t_pkname,
+			       tbl->t_name);
+		else
+			append("CREATE UNIQUE INDEX %s_PK ON %s (",
+			       tbl->t_name, tbl->t_name);
+		append_pk_columns(tbl, npk);
+		append(");\n");
+		return;
 	}
-	if (col->next) {
-		strcpy(buff + cnt, ",\n");
-		cnt += strlen(",\n");
+
+	if (!open)
+		append("ALTER TABLE %s ", tbl->t_name);
+	if (named)
+		append("ADD CONSTRAINT %s PRIMARY KEY (", tbl->t_pkname);
+	else
+		append("ADD PRIMARY KEY (");
+	append_pk_columns(tbl, npk);
+	append(");\n");
+}
+
+/* Appends the comma-separated columns of the primary key */
+static void append_pk_columns(const struct table_desc *tbl, int npk)
+{
+	int i;
+
+	for (i = 1; i <= npk; ++i)
+		append(i < npk ? "%s, " : "%s", pk_column(tbl, i)->c_name);
+}
+
+/* Appends the statement gathering the statistics of the table */
+static void append_analyze(const struct table_desc *tbl)
+{
+	const char *dot;
+
+	switch (dialect) {
+	case SQL_POSTGRESQL:
+	case SQL_SQLITE:
+		append("ANALYZE %s;\n", tbl->t_name);
+		break;
+	case SQL_MYSQL:
+		append("ANALYZE TABLE %s;\n", tbl->t_name);
+		break;
+	case SQL_ORACLE:
+		dot = strchr(tbl->t_name, '.');
+		if (dot)
+			append("CALL DBMS_STATS.GATHER_TABLE_STATS('%.*s', "
+			       "'%s');\n", (int)(dot - tbl->t_name),
+			       tbl->t_name, dot + 1);
+		else
+			append("CALL DBMS_STATS.GATHER_TABLE_STATS(USER, "
+			       "'%s');\n", tbl->t_name);
+		break;
+	default:
+		append("CALL SYSPROC.ADMIN_CMD('RUNSTATS ON TABLE %s "
+		       "WITH DISTRIBUTION AND INDEXES ALL');\n", tbl->t_name);
+		break;
+	}
+}
+
+/* Appends the `format'ted text to the statements, enlarging the buffer */
+static void append(const char *format, ...)
+{
+	va_list ap;
+	int len;
+
+	for (;;) {
+		va_start(ap, format);
+		len = vsnprintf(sql + sql_len, sql_size - sql_len, format, ap);
+		va_end(ap);
+		if (len < 0)
+			err_exit("vsnprintf");
+		if (sql_len + (size_t)len < sql_size)
+			break;
+		sql_size = (sql_len + (size_t)len + 1) * 2;
+		sql = resize_buff(sql, sql_size);
 	}
+	sql_len += (size_t)len;
+}
+
+/*
+ * Tells whether the NOT NULL constraint of `col' goes to the post-load
+ * script: the columns of the primary key keep theirs, and DB2 (which puts
+ * the table in reorg pending state) and SQLite (which cannot) do not add
+ * NOT NULL constraints later.
+ */
+static bool not_null_deferred(const struct column_desc *col, int npk)
+{
+	if (!deferred || dialect == SQL_DB2 || dialect == SQL_SQLITE)
+		return false;
+
+	return npk == 0 || col->c_pkpos == 0 || col->c_pkpos > npk;
+}
+
+/* Returns the fraction digits of TIMESTAMP column `col', at most `max' */
+static size_t timestamp_prec(const struct column_desc *col, size_t max)
+{
+	size_t prec;
+
+	prec = col->c_len - TIMESTAMP_INT_LEN;
+	return prec < max ? prec : max;
+}
+
+/*
+ * Returns the number of columns in the primary key, or 0 if no pk found
+ * or some of the key columns are not selected for output.
+ */
+static int selected_pk_len(const struct table_desc *tbl)
+{
+	const struct column_desc *col;
+	int max;
+	int i;
+
+	max = 0;
+	for (col = tbl->c_head; col; col = col->next)
+		if (col->c_pkpos > max)
+			max = col->c_pkpos;
+
+	for (i = 1; i <= max; ++i)
+		if (!pk_column(tbl, i))
+			return 0;
+
+	return max;
+}
+
+/* Returns the selected column at position `pos' of the pk, or NULL */
+static const struct column_desc *pk_column(const struct table_desc *tbl,
+					   int pos)
+{
+	int i;
+
+	for (i = 0; i < tbl->t_nsel; ++i)
+		if (tbl->t_sel[i]->c_pkpos == pos)
+			return tbl->t_sel[i];
 
-	return cnt;
+	return NULL;
 }
@@ -20,11 +20,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "pagecache.h"
+#include "stats.h"
 #include "util.h"
 
 static bool is_blanks(const char *str);
@@ -154,6 +157,7 @@ int open_file(const char *file, int oflags, mode_t mode)
 /* wrappper function for close; exit on error */
 void close_file(int fd)
 {
+	cache_close(fd);
 	if (close(fd) == -1)
 		err_exit("close");
 }
@@ -166,6 +170,7 @@ off_t seek_file(int fd, off_t offset, int whence)
 	ret = lseek(fd, offset, whence);
 	if (ret == -1)
 		err_exit("lseek");
+	count_seek();
 
 	return ret;
 }
@@ -173,14 +178,22 @@ off_t seek_file(int fd, off_t offset, int whence)
 /* write a null terminated buffer to a file */
 void write_file(int fd, const char *buff)
 {
-	size_t to_write;
+	write_bytes(fd, buff, strlen(buff));
+}
+
+/* write `len' bytes of `buff' to a file */
+void write_bytes(int fd, const void *buff, size_t len)
+{
 	ssize_t written;
 
-	to_write = strlen(buff);
-	if ((written = write(fd, buff, to_write)) == -1)
+	if (cache_write(fd, buff, len))
+		return;		/* buffered for O_DIRECT */
+	if ((written = write(fd, buff, len)) == -1)
 		fmt_err_exit("output file: %s", strerror(errno));
-	else if (written != (ssize_t) to_write)
+	else if (written != (ssize_t) len)
 		fmt_err_exit("output file: resource limit reached");
+	count_write(len);
+	cache_written(fd, len);
 }
 
 /* locks an entire file, returns true on success, false otherwise */
@@ -235,9 +248,15 @@ void show_progress(long cur, long sum)
 	const char PROC_MSG[] = "Processing...";
 	const char DONE_MSG[] = "Processing complete";
 	static int pct;
+	static long next;	/* `cur' of the next percent */
 	int tmp;
 
+	/* most calls return here, without a division */
+	if (cur < next && cur < sum)
+		return;
+
 	tmp = (int)((double)cur / (double)sum * 100.0);
+	next = (long)((double)(tmp + 1) * (double)sum / 100.0);
 	if (tmp > pct) {
 		pct = tmp;
 		if (pct == 0)
@@ -248,3 +267,28 @@ void show_progress(long cur, long sum)
 			err_msg("%s (%d%%)\r", PROC_MSG, pct);
 	}
 }
+
+/*
+ * Returns a well-mixed 64-bit hash of `x', by the finalizer of
+ * SplitMix64: equal inputs give equal hashes, close ones unrelated.
+ */
+uint64_t hash64(uint64_t x)
+{
+	x = (x ^ x >> 30) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ x >> 27) * 0x94D049BB133111EBULL;
+	return x ^ x >> 31;
+}
+
+/*
+ * Returns the 64-bit FNV-1a hash of `hash' followed by the `len' bytes of
+ * `buff'; start from FNV1A_BASIS.
+ */
+uint64_t fnv1a_hash(uint64_t hash, const void *buff, size_t len)
+{
+	const unsigned char *p;
+
+	for (p = buff; len > 0; --len)
+		hash = (hash ^ *p++) * 0x100000001B3ULL;
+
+	return hash;
+}
@@ -20,8 +20,11 @@
 #define IXFCVT_UTIL_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+#define FNV1A_BASIS 0xCBF29CE484222325ULL	/* hash of no bytes */
+
 void err_msg(const char *format, ...);
 void fmt_err_exit(const char *format, ...);
 void err_exit(const char *msg);
@@ -34,8 +37,11 @@ int open_file(const char *file, int oflags, mode_t mode);
 void close_file(int fd);
 off_t seek_file(int fd, off_t offset, int whence);
 void write_file(int fd, const char *buff);
+void write_bytes(int fd, const void *buff, size_t len);
 bool lock_entire_file(int fd, short lock_type);
 bool prompt_y_or_n(void);
 void show_progress(long cur, long sum);
+uint64_t hash64(uint64_t x);
+uint64_t fnv1a_hash(uint64_t hash, const void *buff, size_t len);
 
 #endif
@@ -0,0 +1,622 @@
+/*
+ * verify.c - check an IXF file without converting it: --verify
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The D records are cut into the ranges of find_record_ranges(), each
+ * checked on a thread of its own: the framing of the records, the order
+ * of their IXFDRIDs, and for each column that its value lies within the
+ * D record, its null indicator is x'0000' or x'FFFF', a current length
+ * is at most its IXFCLENG, a packed decimal has digits and a sign in its
+ * nibbles, and a DATE, TIME or TIMESTAMP is one.  A thread keeps the
+ * first errors of its range only, and the IXFDRIDs where it starts and
+ * ends, to be checked against those of its neighbours when all are done.
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "boundary.h"
+#include "ixfcvt.h"
+#include "parse_d.h"
+#include "stats.h"
+#include "util.h"
+#include "verify.h"
+
+#define REC_LEN_BYTES 6
+#define HEADER_BYTES 7		/* record length and type */
+#define IXFDRID_OFFSET 1
+#define IXFDRID_BYTES 3
+#define LOW_NIBBLE 0x0F
+#define MIN_SIGN_NIBBLE 0x0A	/* A to F, D and B negative */
+#define DATE_LEN 10		/* yyyy-mm-dd */
+#define TIMESTAMP_INT_LEN 19	/* yyyy-mm-dd-hh.mm.ss */
+#define MAX_DATETIME_LEN 32	/* TIMESTAMP(12) */
+#define ERR_MSG_SIZE 320
+#define LINE_SIZE (ERR_MSG_SIZE + 64)
+
+/* an error found in the file */
+struct verify_error {
+	off_t ve_off;		/* of the record */
+	long ve_seq;		/* order of those of the same record */
+	long ve_row;		/* from 1, 0 if before the first row */
+	char ve_msg[ERR_MSG_SIZE];
+};
+
+/* a range of the file and the thread checking it */
+struct verifier {
+	int v_fd;
+	off_t v_size;		/* of the file */
+	off_t v_from;		/* first record of the range */
+	off_t v_to;		/* end of the range */
+	struct verify_error *v_errs;	/* the first `max_errors' */
+	int v_nerrs;
+	long v_total;		/* errors found */
+	long v_rows;		/* D records with IXFDRID 1 */
+	int v_first_drid;	/* of the first D record, 0 if none */
+	off_t v_first_d;	/* offset of it */
+	int v_last_drid;	/* of the last D record */
+	off_t v_end;		/* where the walk stopped */
+	unsigned long v_reads;
+	unsigned long long v_bytes;
+};
+
+static void check_columns_count(struct verifier *v, off_t first_d);
+static void init_verifier(struct verifier *v, int fd, off_t size,
+			  off_t from, off_t to);
+static void *verify_range(void *arg);
+static void verify_d_record(struct verifier *v, const unsigned char *rec,
+			    long len, off_t off, int *prev);
+static void verify_column(struct verifier *v, const struct column_desc *col,
+			  const unsigned char *rec, long len, off_t off);
+static void verify_packed(struct verifier *v, const struct column_desc *col,
+			  const unsigned char *src, off_t off);
+static void verify_datetime(struct verifier *v,
+			    const struct column_desc *col,
+			    const unsigned char *src, off_t off);
+static bool is_date(const unsigned char *p);
+static bool is_time(const unsigned char *p);
+static long parse_digits(const unsigned char *p, int n);
+static void add_error(struct verifier *v, off_t off, const char *format, ...);
+static void check_neighbours(struct verifier *vs, int n,
+			     struct verifier *extra);
+static void report(int ofd, struct verifier *vs, int n,
+		   struct verifier *extra);
+static int compare_errors(const void *a, const void *b);
+
+static const struct table_desc *table;
+static int ndrec;		/* D records of a row */
+/* the columns of each D record, by IXFDRID, NULL-ended */
+static const struct column_desc ***drec_cols;
+static int max_errors;		/* kept by each verifier */
+static bool passed = true;	/* no error found */
+
+/*
+ * Checks the D records of IXF file `ifd' of table `tbl', the first of them
+ * at `first_d' (-1 if none), on the threads of `sum', and writes the
+ * first errors found and a line of the rows and errors to `ofd'.
+ */
+void verify_file(int ifd, int ofd, const struct summary *sum,
+		 const struct table_desc *tbl, off_t first_d)
+{
+	struct record_range ranges[MAX_THREADS];
+	struct verifier vs[MAX_THREADS];
+	pthread_t threads[MAX_THREADS];
+	struct verifier extra;	/* errors between the ranges */
+	const struct column_desc *col;
+	struct stat st;
+	int *ncols;
+	int n;
+	int i;
+	int rc;
+
+	table = tbl;
+	ndrec = tbl->t_ndrec;
+	max_errors = sum->s_max_errors;
+	if (fstat(ifd, &st) == -1)
+		err_exit("fstat");
+
+	/* the columns of each D record, not to search all for each */
+	ncols = alloc_buff((size_t) (ndrec + 1) * sizeof(*ncols));
+	memset(ncols, 0, (size_t) (ndrec + 1) * sizeof(*ncols));
+	drec_cols = alloc_buff((size_t) (ndrec + 1) * sizeof(*drec_cols));
+	for (col = tbl->c_head; col; col = col->next)
+		++ncols[col->c_drid - 1];
+	for (i = 0; i < ndrec; ++i) {
+		drec_cols[i] = alloc_buff((size_t) (ncols[i] + 1)
+					  * sizeof(**drec_cols));
+		ncols[i] = 0;
+	}
+	for (col = tbl->c_head; col; col = col->next)
+		drec_cols[col->c_drid - 1][ncols[col->c_drid - 1]++] = col;
+	for (i = 0; i < ndrec; ++i)
+		drec_cols[i][ncols[i]] = NULL;
+	free_buff(ncols);
+
+	init_verifier(&extra, ifd, st.st_size, 0, 0);
+	check_columns_count(&extra, first_d < 0 ? st.st_size : first_d);
+
+	n = 0;
+	if (first_d >= 0) {
+		n = find_record_ranges(ifd, first_d, sum->s_threads, ranges);
+		if (n == 0) {
+			ranges[0].rr_start = first_d;
+			n = 1;
+		}
+		/* the last one goes on to complain where the chain broke */
+		for (i = 0; i < n; ++i)
+			init_verifier(&vs[i], ifd, st.st_size,
+				      ranges[i].rr_start, i == n - 1
+				      ? st.st_size : ranges[i].rr_end);
+		for (i = 1; i < n; ++i) {
+			rc = pthread_create(&threads[i], NULL, verify_range,
+					    &vs[i]);
+			if (rc != 0)
+				fmt_err_exit("pthread_create: %s",
+					     strerror(rc));
+		}
+		verify_range(&vs[0]);
+		for (i = 1; i < n; ++i) {
+			rc = pthread_join(threads[i], NULL);
+			if (rc != 0)
+				fmt_err_exit("pthread_join: %s", strerror(rc));
+		}
+		for (i = 0; i < n; ++i)
+			count_reads(vs[i].v_reads, vs[i].v_bytes);
+		check_neighbours(vs, n, &extra);
+	}
+
+	report(ofd, vs, n, &extra);
+
+	for (i = 0; i < n; ++i)
+		free_buff(vs[i].v_errs);
+	free_buff(extra.v_errs);
+	for (i = 0; i < ndrec; ++i)
+		free_buff(drec_cols[i]);
+	free_buff(drec_cols);
+	drec_cols = NULL;
+}
+
+/* Returns true if --verify found no error. */
+bool verify_passed(void)
+{
+	return passed;
+}
+
+/* Checks the C records of the table against IXFTCCNT. */
+static void check_columns_count(struct verifier *v, off_t first_d)
+{
+	const struct column_desc *col;
+	int n;
+
+	n = 0;
+	for (col = table->c_head; col; col = col->next)
+		++n;
+	if (n != table->t_ncols)
+		add_error(v, first_d, "%d C records, IXFTCCNT %d", n,
+			  table->t_ncols);
+}
+
+static void init_verifier(struct verifier *v, int fd, off_t size,
+			  off_t from, off_t to)
+{
+	memset(v, 0, sizeof(*v));
+	v->v_fd = fd;
+	v->v_size = size;
+	v->v_from = from;
+	v->v_to = to;
+	v->v_errs = alloc_buff((size_t) max_errors * sizeof(*v->v_errs));
+}
+
+/* Checks the records of the range of verifier `arg'. */
+static void *verify_range(void *arg)
+{
+	struct verifier *v;
+	struct window w;
+	const unsigned char *hdr;
+	const unsigned char *rec;
+	off_t pos;
+	long len;
+	int prev;		/* IXFDRID of the D record before */
+
+	v = arg;
+	open_window(&w, v->v_fd, v->v_size);
+	prev = 0;
+	for (pos = v->v_from; pos < v->v_to; pos += REC_LEN_BYTES + len) {
+		if (!(hdr = peek_window(&w, pos, HEADER_BYTES))) {
+			add_error(v, pos, "%lld bytes after the last record",
+				  (long long)(v->v_size - pos));
+			break;
+		}
+		if ((len = parse_digits(hdr, REC_LEN_BYTES)) < 1) {
+			add_error(v, pos, "%s", "record length not a number, "
+				  "no record can be found after it");
+			break;
+		}
+		rec = peek_window(&w, pos + REC_LEN_BYTES, (size_t) len);
+		if (!rec) {
+			add_error(v, pos, "record of %ld bytes past the end "
+				  "of the file", len);
+			break;
+		}
+
+		switch (*rec) {
+		case 'D':
+			verify_d_record(v, rec, len, pos, &prev);
+			break;
+		case 'A':
+			break;
+		default:
+			add_error(v, pos, "record type x'%02X' among the D "
+				  "records", *rec);
+		}
+	}
+	v->v_end = pos;
+	close_window(&w);
+	v->v_reads = w.w_reads;
+	v->v_bytes = w.w_bytes;
+
+	return NULL;
+}
+
+/*
+ * Checks D record `rec' of `len' bytes at `off', the IXFDRID of the one
+ * before it in the range in `prev'.
+ */
+static void verify_d_record(struct verifier *v, const unsigned char *rec,
+			    long len, off_t off, int *prev)
+{
+	const struct column_desc *const *cols;
+	long drid;
+
+	if (len < IXFDCOLS_OFFSET) {
+		add_error(v, off, "D record of %ld bytes, shorter than its "
+			  "header", len);
+		return;
+	}
+	drid = parse_digits(rec + IXFDRID_OFFSET, IXFDRID_BYTES);
+	if (drid < 1 || drid > ndrec) {
+		add_error(v, off, "IXFDRID '%.3s' not from 1 to %d",
+			  rec + IXFDRID_OFFSET, ndrec);
+		return;
+	}
+
+	if (drid == 1)
+		++v->v_rows;
+	if (v->v_first_drid == 0) {
+		v->v_first_drid = (int)drid;
+		v->v_first_d = off;
+	} else if (drid != *prev % ndrec + 1) {
+		add_error(v, off, "D record %ld found where %d expected", drid,
+			  *prev % ndrec + 1);
+	}
+	*prev = v->v_last_drid = (int)drid;
+
+	for (cols = drec_cols[drid - 1]; *cols; ++cols)
+		verify_column(v, *cols, rec, len, off);
+}
+
+/* Checks the value of `col' in D record `rec' of `len' bytes at `off'. */
+static void verify_column(struct verifier *v, const struct column_desc *col,
+			  const unsigned char *rec, long len, off_t off)
+{
+	size_t at;		/* of the value in `rec' */
+	size_t cur_len;
+	size_t bytes;
+
+	at = IXFDCOLS_OFFSET + (size_t) col->c_offset;
+	if (col->c_nullable) {
+		if (at + NULL_VAL_IND_BYTES > (size_t) len) {
+			add_error(v, off, "column %s: past the end of the "
+				  "D record", col->c_name);
+			return;
+		}
+		if (rec[at] != rec[at + 1]
+		    || (rec[at] != 0x00 && rec[at] != 0xFF)) {
+			add_error(v, off, "column %s: null indicator "
+				  "x'%02X%02X'", col->c_name, rec[at],
+				  rec[at + 1]);
+			return;
+		}
+		if (rec[at] == 0xFF)
+			return;
+		at += NULL_VAL_IND_BYTES;
+	}
+
+	switch (col->c_type) {
+	case VARCHAR:
+	case LONG_VARCHAR:
+	case VARBINARY:
+	case XML:
+	case VARGRAPHIC:
+	case LONG_VARGRAPHIC:
+		if (at + VARCHAR_CUR_LEN_IND_BYTES > (size_t) len) {
+			add_error(v, off, "column %s: past the end of the "
+				  "D record", col->c_name);
+			return;
+		}
+		cur_len = get_varchar_cur_len(rec + at);
+		if (cur_len > col->c_len) {
+			add_error(v, off, "column %s: current length %zu "
+				  "over %zu", col->c_name, cur_len,
+				  col->c_len);
+			return;
+		}
+		at += VARCHAR_CUR_LEN_IND_BYTES;
+		bytes = col->c_type == VARGRAPHIC
+		    || col->c_type == LONG_VARGRAPHIC
+		    ? cur_len * GRAPHIC_CHAR_BYTES : cur_len;
+		break;
+	default:
+		bytes = column_span(col)
+		    - (col->c_nullable ? NULL_VAL_IND_BYTES : 0);
+		break;
+	}
+	if (at + bytes > (size_t) len) {
+		add_error(v, off, "column %s: value past the end of the "
+			  "D record", col->c_name);
+		return;
+	}
+
+	switch (col->c_type) {
+	case DECIMAL:
+		verify_packed(v, col, rec + at, off);
+		break;
+	case DATE:
+	case TIME:
+	case TIMESTAMP:
+		verify_datetime(v, col, rec + at, off);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Checks the nibbles of packed decimal `src' of `col'. */
+static void verify_packed(struct verifier *v, const struct column_desc *col,
+			  const unsigned char *src, off_t off)
+{
+	size_t bytes;
+	size_t i;
+
+	bytes = packed_decimal_size(col->c_len);
+	for (i = 0; i < bytes; ++i) {
+		if ((src[i] >> 4) > 9
+		    || (i < bytes - 1 && (src[i] & LOW_NIBBLE) > 9)) {
+			add_error(v, off, "column %s: packed decimal digit "
+				  "in x'%02X'", col->c_name, src[i]);
+			return;
+		}
+	}
+	if ((src[bytes - 1] & LOW_NIBBLE) < MIN_SIGN_NIBBLE)
+		add_error(v, off, "column %s: packed decimal sign x'%X'",
+			  col->c_name, src[bytes - 1] & LOW_NIBBLE);
+}
+
+/* Checks the DATE, TIME or TIMESTAMP `src' of `col'. */
+static void verify_datetime(struct verifier *v,
+			    const struct column_desc *col,
+			    const unsigned char *src, off_t off)
+{
+	char text[MAX_DATETIME_LEN + 1];
+	size_t len;
+	size_t i;
+	bool valid;
+
+	len = col->c_len;
+	switch (col->c_type) {
+	case DATE:
+		valid = is_date(src);
+		break;
+	case TIME:
+		valid = is_time(src);
+		break;
+	default:
+		/* yyyy-mm-dd-hh.mm.ss.nnnnnn, as many digits as IXFCLENG */
+		valid = len >= TIMESTAMP_INT_LEN && is_date(src)
+		    && src[DATE_LEN] == '-' && is_time(src + DATE_LEN + 1);
+		if (valid && len > TIMESTAMP_INT_LEN)
+			valid = src[TIMESTAMP_INT_LEN] == '.'
+			    || (len == TIMESTAMP_INT_LEN + 1
+				&& src[TIMESTAMP_INT_LEN] == ' ');
+		for (i = TIMESTAMP_INT_LEN + 1; valid && i < len; ++i)
+			valid = src[i] >= '0' && src[i] <= '9';
+		break;
+	}
+	if (valid)
+		return;
+
+	if (len > MAX_DATETIME_LEN)
+		len = MAX_DATETIME_LEN;
+	for (i = 0; i < len; ++i)
+		text[i] = src[i] >= ' ' && src[i] < 0x7F ? (char)src[i] : '?';
+	text[len] = '\0';
+	add_error(v, off, "column %s: invalid %s '%s'", col->c_name,
+		  col->c_type == DATE ? "DATE" : col->c_type == TIME ? "TIME"
+		  : "TIMESTAMP", text);
+}
+
+/* Returns true if `p' is a date yyyy-mm-dd. */
+static bool is_date(const unsigned char *p)
+{
+	static const int DAYS[] = {
+		31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+	};
+	long year;
+	long month;
+	long day;
+
+	year = parse_digits(p, 4);
+	month = parse_digits(p + 5, 2);
+	day = parse_digits(p + 8, 2);
+	if (p[4] != '-' || p[7] != '-' || year < 1 || month < 1 || month > 12
+	    || day < 1 || day > DAYS[month - 1])
+		return false;
+	/* February 29 of a leap year only */
+	return month != 2 || day != 29 || (year % 4 == 0
+					   && (year % 100 != 0
+					       || year % 400 == 0));
+}
+
+/* Returns true if `p' is a time hh.mm.ss, up to 24.00.00. */
+static bool is_time(const unsigned char *p)
+{
+	long hour;
+	long minute;
+	long second;
+
+	hour = parse_digits(p, 2);
+	minute = parse_digits(p + 3, 2);
+	second = parse_digits(p + 6, 2);
+	if (p[2] != '.' || p[5] != '.' || hour < 0 || minute < 0
+	    || second < 0 || minute > 59 || second > 59)
+		return false;
+
+	return hour < 24 || (hour == 24 && minute == 0 && second == 0);
+}
+
+/* Returns the number of the `n' decimal digits at `p', -1 if not all are. */
+static long parse_digits(const unsigned char *p, int n)
+{
+	long val;
+	int i;
+
+	val = 0L;
+	for (i = 0; i < n; ++i) {
+		if (p[i] < '0' || p[i] > '9')
+			return -1L;
+		val = val * 10 + (p[i] - '0');
+	}
+
+	return val;
+}
+
+/* Counts an error of the record at `off', keeping the first ones. */
+static void add_error(struct verifier *v, off_t off, const char *format, ...)
+{
+	struct verify_error *e;
+	va_list ap;
+
+	if (v->v_nerrs < max_errors) {
+		e = &v->v_errs[v->v_nerrs++];
+		e->ve_off = off;
+		e->ve_seq = v->v_total;
+		e->ve_row = v->v_rows;
+		va_start(ap, format);
+		vsnprintf(e->ve_msg, sizeof(e->ve_msg), format, ap);
+		va_end(ap);
+	}
+	++v->v_total;
+}
+
+/*
+ * Checks the IXFDRIDs where each range starts against those where the
+ * one before ends, and that the last row is whole, into `extra'; makes
+ * the row numbers of the errors of each range those of the file.
+ */
+static void check_neighbours(struct verifier *vs, int n,
+			     struct verifier *extra)
+{
+	long rows;		/* before the range */
+	int last;		/* IXFDRID of the last D record so far */
+	int i;
+	int j;
+
+	rows = 0L;
+	last = ndrec;		/* as if a row had just ended */
+	for (i = 0; i < n; ++i) {
+		for (j = 0; j < vs[i].v_nerrs; ++j)
+			vs[i].v_errs[j].ve_row += rows;
+		if (vs[i].v_first_drid != 0) {
+			if (vs[i].v_first_drid != last % ndrec + 1) {
+				extra->v_rows = rows
+				    + (vs[i].v_first_drid == 1);
+				add_error(extra, vs[i].v_first_d,
+					  "D record %d found where %d "
+					  "expected", vs[i].v_first_drid,
+					  last % ndrec + 1);
+			}
+			last = vs[i].v_last_drid;
+		}
+		rows += vs[i].v_rows;
+	}
+	if (n > 0 && last != ndrec)
+		add_error(extra, vs[n - 1].v_end, "%s",
+			  "incomplete row at the end of the file");
+	extra->v_rows = rows;
+}
+
+/* Writes the first errors of all, by offset, and the totals to `ofd'. */
+static void report(int ofd, struct verifier *vs, int n,
+		   struct verifier *extra)
+{
+	struct verify_error *all;
+	char line[LINE_SIZE];
+	long total;
+	int nall;
+	int i;
+	int j;
+
+	total = extra->v_total;
+	nall = extra->v_nerrs;
+	for (i = 0; i < n; ++i) {
+		total += vs[i].v_total;
+		nall += vs[i].v_nerrs;
+	}
+	all = alloc_buff((size_t) (nall + 1) * sizeof(*all));
+	memcpy(all, extra->v_errs, (size_t) extra->v_nerrs * sizeof(*all));
+	nall = extra->v_nerrs;
+	for (i = 0; i < n; ++i) {
+		memcpy(all + nall, vs[i].v_errs,
+		       (size_t) vs[i].v_nerrs * sizeof(*all));
+		nall += vs[i].v_nerrs;
+	}
+	qsort(all, (size_t) nall, sizeof(*all), compare_errors);
+
+	for (j = 0; j < nall && j < max_errors; ++j) {
+		if (all[j].ve_row > 0)
+			sprintf(line, "offset %lld, row %ld: %s\n",
+				(long long)all[j].ve_off, all[j].ve_row,
+				all[j].ve_msg);
+		else
+			sprintf(line, "offset %lld: %s\n",
+				(long long)all[j].ve_off, all[j].ve_msg);
+		write_file(ofd, line);
+	}
+	sprintf(line, "%ld row%s, %ld error%s%s\n", extra->v_rows,
+		extra->v_rows == 1 ? "" : "s", total, total == 1 ? "" : "s",
+		total > max_errors ? ", the first ones shown" : "");
+	write_file(ofd, line);
+	passed = total == 0;
+
+	free_buff(all);
+}
+
+/* order errors by the offset of their record, then as found */
+static int compare_errors(const void *a, const void *b)
+{
+	const struct verify_error *x = a;
+	const struct verify_error *y = b;
+
+	if (x->ve_off != y->ve_off)
+		return x->ve_off < y->ve_off ? -1 : 1;
+	return x->ve_seq < y->ve_seq ? -1 : x->ve_seq > y->ve_seq;
+}
@@ -0,0 +1,34 @@
+/*
+ * verify.h - declarations of the IXF file check of --verify
+ *
+ * Copyright 2016 Guo, Xingchun <guoxingchun@gmail.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IXFCVT_VERIFY_H_
+#define IXFCVT_VERIFY_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "ixfcvt.h"
+
+#define DEF_MAX_ERRORS 20
+#define MAX_ERRORS 100000
+
+void verify_file(int ifd, int ofd, const struct summary *sum,
+		 const struct table_desc *tbl, off_t first_d);
+bool verify_passed(void);
+
+#endif